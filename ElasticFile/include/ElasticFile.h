@@ -2,49 +2,99 @@
 #include <efile_types.h>
 #include <TEFileSectorsTable.h>
 #include <TEFileCursor.h>
+#include <TEFileCompactor.h>
+#include <TEFileEditPlan.h>
+#include <TEFileReadPlanner.h>
+#include <TEFileReadView.h>
+#include <TEFileBlockCache.h>
+#include <TEFileWriteCombiner.h>
+#include <TEFileSnapshot.h>
 
 class ElasticFile
 {
 public:
 	friend class TEFileCursor;
 	friend class TEFileSectorsTable;
+	friend class TEFileCompactor;
+	friend class TEFileEditPlan;
 
 	ElasticFile();
 	~ElasticFile();
 
 	size_file_t Write(const PBYTE buffer, const size_file_t& size, bool overwrite);
 	size_file_t Read(PBYTE buffer, const size_file_t& size);
+	size_file_t Writev(const TEFileIOVector* vectors, const size_t& vectors_count, bool overwrite);
+	size_file_t Readv(const TEFileIOVector* vectors, const size_t& vectors_count);
+	size_file_t Read(TEFileCursor& cursor, PBYTE buffer, const size_file_t& size);
+	size_file_t Readv(TEFileCursor& cursor, const TEFileIOVector* vectors, const size_t& vectors_count);
+	size_file_t ReadAt(const size_file_t& position, PBYTE buffer, const size_file_t& size);
+	size_file_t WriteAt(const size_file_t& position, const PBYTE buffer, const size_file_t& size, bool overwrite);
+	void GetView(const size_file_t& position, const size_file_t& size, TEFileReadView& view);
 	size_file_t Truncate(const size_file_t& cut_size);
-	TEFileHandle Open(const std::string& file_name, const TEFileOpenMode& mode);
+	void ApplyEdits(const TEFileEdit* edits, const size_t& edits_count);
+	TEFileHandle Open(const std::string& file_name, const TEFileOpenMode& mode, const TEFileBackendType& backend = EF_BACKEND_DEFAULT);
 	void Close();
 	void SetPosition(const size_file_t& offset, const TEFileCursorMoveMode& mode);
-	const size_file_t& GetPosition();
+	size_file_t GetPosition();
+	size_file_t GetDataSize();
+	TEFileCursorPtr CreateCursor();
+	void SetPosition(TEFileCursor& cursor, const size_file_t& offset, const TEFileCursorMoveMode& mode);
+	TEFileSnapshotPtr CreateSnapshot();
 	TEFileSectorsList::iterator Extend(const size_file_t& size_to_extend);
+	void SetAllocationPolicy(const TEFileAllocationPolicy& policy);
+	void SetReadOrder(const TEFileReadOrder& order, const size_file_t& gap_tolerance);
+	bool Compact(const TEFileCompactMode& mode, const size_file_t& bytes_limit);
+	void SetCache(const TEFileCachePolicy& policy, const TEFileCacheWriteMode& write_mode, const size_file_t& budget);
+	const TEFileCacheStats& GetCacheStats() const;
+	void GetCountersSnapshot(TEFileCountersSnapshot& snapshot) const;
+	void SetWriteCombining(const size_file_t& buffer_size);
+	void ConvertTable();
+	void Sync();
+	void Preallocate(const size_file_t& size);
 
 protected:
 	TEFileSectorsTable& GetSectorsTable();
 	const TEFileHandle& GetHandle();
+	const TEFileCountersPtr& GetCounters();
 	TEFileCursor& GetCursor();
 	const TEFileOpenMode& GetMode();
 	void SetHandle(TEFileHandle file);
 	bool Modified();
 	void SetModified();
 	int close();
-	size_file_t WriteSector(TEFileSectorsList::iterator sector_it, PBYTE buffer, const size_file_t& from, const size_file_t& sizeToWrite);
-	size_file_t WriteOverwrite(const PBYTE buffer, const size_file_t& size);
-	size_file_t WriteInsert(const PBYTE buffer, const size_file_t& size);
-	TEFileHandle OpenLow(const std::string& file_name, const std::string& lowMode);
+	size_file_t WriteSector(TEFileCursor& cursor, TEFileSectorsList::iterator sector_it, const TEFileIOVector* vectors, const size_file_t& from, const size_file_t& sizeToWrite);
+	size_file_t WriteOverwrite(TEFileCursor& cursor, const TEFileIOVector* vectors, size_t vectors_count, const size_file_t& size);
+	size_file_t WriteInsert(TEFileCursor& cursor, const TEFileIOVector* vectors, size_t vectors_count, const size_file_t& size);
+	size_file_t WriteReplace(TEFileCursor& cursor, const TEFileIOVector* vectors, size_t vectors_count, const size_file_t& size);
+	void DeleteData(size_file_t position, size_file_t size);
+	TEFileHandle OpenLow(const TEFileHandle& file_handle, const std::string& file_name, bool create);
 	void Init(const TEFileHandle& file_handle, const TEFileOpenMode& mode);
-	TEFileHandle InitLow(const std::string& file_name, const TEFileOpenMode& mode);
+	TEFileHandle InitLow(const std::string& file_name, const TEFileOpenMode& mode, const TEFileBackendType& backend);
 	void CheckHandle();
 	void CheckHandle(const TEFileHandle& file_handle);
+	void CheckCursor(TEFileCursor& cursor);
+	void ClearSpace(const size_file_t& addr, const size_file_t& size);
 	void CheckSize(const size_file_t& size);
-	void CheckFileExists(const std::string& file_name);
+	void CheckFileExists(const TEFileHandle& file_handle, const std::string& file_name);
+	size_file_t ReadData(const TEFileIOSegments& segments);
+	size_file_t WriteData(const TEFileIOSegments& segments);
+	void FlushCache();
+	void DropCache();
+	size_file_t WriteCombined(const TEFileIOVector* vectors, size_t vectors_count, const size_file_t& size);
+	void FlushWrites();
 
 private:
+	TEFileCountersPtr m_counters; // Shared with the backend and its readers, which can outlive the file
 	TEFileHandle m_handle;
 	TEFileCursor m_cursor;
 	TEFileSectorsTable m_sectors_table;
+	TEFileIOSegments m_segments; // Segments of the current I/O request
+	TEFileReadPlanner m_read_planner;
+	TEFileBlockCache m_cache;
+	TEFileWriteCombiner m_write_combiner;
+	TEFileMapping m_mapping;
+	std::shared_ptr<size_t> m_generation; // Count of modifications, views made before the last one are not valid
+	std::weak_ptr<TEFileSnapshot> m_snapshot; // The last snapshot is shared while the table is not changed
 	bool m_modified;
 	TEFileOpenMode m_mode;
 };
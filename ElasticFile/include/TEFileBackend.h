@@ -0,0 +1,71 @@
+#pragma once
+#include <efile_types.h>
+#include <TEFileCounters.h>
+
+class TEFileMappedRegion;
+typedef std::shared_ptr<TEFileMappedRegion> TEFileMappedRegionPtr;
+
+// Layer which keeps the bytes of a file. All the I/O of ElasticFile, of the sectors table,
+// of the cache and of the snapshots goes through it, and every transfer takes its position,
+// so nothing depends on a seek position shared by the callers. The handle of an open file
+// (TEFileHandle) is a backend object
+class TEFileBackend
+{
+public:
+	virtual ~TEFileBackend(void);
+
+	// Makes a backend which isn't opened yet
+	static TEFileHandle Create(const TEFileBackendType& type);
+
+	// The file is created or truncated if create is set, otherwise it must exist
+	virtual bool Open(const std::string& file_name, bool create) = 0;
+	virtual bool Exists(const std::string& file_name) = 0;
+	virtual bool Close() = 0;
+	// Opens the same file once more for reading. The reader can be used by any count of threads
+	// and stays valid after this backend is closed. NULL if the file can't be opened
+	virtual TEFileHandle CreateReader() = 0;
+
+	// Return the count of bytes transferred until the first error or the end of the file
+	virtual size_file_t ReadAt(size_file_t addr, PBYTE buffer, size_file_t size) = 0;
+	virtual size_file_t WriteAt(size_file_t addr, const BYTE* buffer, size_file_t size) = 0;
+	// Return the count of bytes transferred in the order of the segments until the first one which is not transferred
+	size_file_t Read(const TEFileIOSegments& segments);
+	size_file_t Write(const TEFileIOSegments& segments);
+
+	virtual bool GetSize(size_file_t& size) = 0;
+	// The new space is filled with zeros
+	virtual bool Resize(size_file_t size) = 0;
+	// Reserves the space for the file to grow up to the size, the size of the file is not changed
+	virtual bool Preallocate(size_file_t size) = 0;
+	// Zeroes the range by the file system without writing it, false if the backend can't do it
+	virtual bool ZeroRange(size_file_t addr, size_file_t size);
+	// Makes the written data visible to the readers of the file
+	virtual bool Flush() = 0;
+	// Writes the data to the disk
+	virtual bool Sync() = 0;
+
+	// Read-only mapping of the first bytes of the file, it isn't changed by the later writes
+	// only until the file is modified
+	virtual TEFileMappedRegionPtr Map(size_file_t size);
+
+	// Calls of the system and transferred bytes are counted to the counters of the file, the readers share them
+	void SetCounters(const TEFileCountersPtr& counters);
+
+protected:
+	TEFileBackend(void);
+
+	// Transfers the segments one by one through ReadAt or WriteAt
+	virtual size_file_t Transfer(const TEFileIOSegments& segments, bool write);
+	// Descriptor of the operating system for the mapping, -1 if there is no one
+	virtual int GetDescriptor();
+
+	static bool FileExists(const std::string& file_name);
+	static bool PreallocateDescriptor(int file_descriptor, size_file_t size);
+
+protected:
+	TEFileCountersPtr m_counters;
+
+private:
+	TEFileBackend(const TEFileBackend&);
+	TEFileBackend& operator=(const TEFileBackend&);
+};
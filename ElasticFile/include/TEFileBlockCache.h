@@ -0,0 +1,87 @@
+#pragma once
+#include <efile_types.h>
+
+class TEFileReadPlanner;
+
+// Cache of the file data in blocks of EF_CACHE_BLOCK_SIZE bytes keyed by the physical
+// block number. All the I/O of the data goes through it, so the cached blocks are always
+// the same as the file or newer (dirty blocks of the write-back mode). Only whole blocks
+// are cached: a block which can't be read completely, like the last one of the file, is
+// always read from the file. Data which is written to the file past the cache (the
+// sectors table) needs Flush and Clear before.
+class TEFileBlockCache
+{
+public:
+	TEFileBlockCache();
+	~TEFileBlockCache(void);
+
+	// Dirty blocks must be flushed before. The count of blocks is budget / EF_CACHE_BLOCK_SIZE
+	void Configure(const TEFileCachePolicy& policy, const TEFileCacheWriteMode& write_mode, const size_file_t& budget);
+	bool IsEnabled() const;
+
+	// Return the count of bytes transferred in the logical order until the first segment which is not transferred
+	size_file_t Read(const TEFileHandle& file_handle, const TEFileIOSegments& segments, TEFileReadPlanner& read_planner);
+	size_file_t Write(const TEFileHandle& file_handle, const TEFileIOSegments& segments);
+
+	// Writes all the dirty blocks to the file
+	bool Flush(const TEFileHandle& file_handle);
+	// Drops the blocks which are completely inside of the range without writing them
+	void Invalidate(size_file_t addr, size_file_t size);
+	// Drops all the blocks without writing them
+	void Clear();
+
+	const TEFileCacheStats& GetStats() const;
+
+private:
+	struct TFrame
+	{
+		size_file_t Block;
+		size_t Prev;
+		size_t Next;
+		bool Dirty;
+		bool Referenced;
+		bool Pinned;
+	};
+
+	// Part of a segment inside of one block
+	struct TPiece
+	{
+		size_file_t Block;
+		size_file_t Offset;
+		size_file_t Size;
+		PBYTE Buffer;
+		size_t Segment;
+	};
+
+	typedef std::unordered_map<size_file_t, size_t> TFramesIndex;
+
+	size_t FindFrame(size_file_t block) const;
+	size_t AllocateFrame(const TEFileHandle& file_handle, size_file_t block);
+	size_t ChooseVictim();
+	void DropFrame(size_t frame);
+	void Touch(size_t frame);
+	void Link(size_t frame);
+	void Unlink(size_t frame);
+	BYTE* FrameData(size_t frame);
+
+	void TransferDirect(const TEFileHandle& file_handle, bool write);
+	size_file_t GetTransferredSize(const TEFileIOSegments& segments);
+
+private:
+	TEFileCachePolicy m_policy;
+	TEFileCacheWriteMode m_write_mode;
+	std::vector<TFrame> m_frames;
+	std::vector<BYTE> m_data;
+	TFramesIndex m_index;
+	std::vector<size_t> m_free_frames;
+	size_t m_lru_head; // The most recently used frame
+	size_t m_lru_tail;
+	size_t m_clock_hand;
+	TEFileCacheStats m_stats;
+
+	std::vector<TPiece> m_pieces;
+	std::vector<TPiece> m_direct_pieces; // Pieces which are transferred past the cache
+	std::vector<size_t> m_batch_frames;
+	std::vector<bool> m_failed_segments;
+	TEFileIOSegments m_segments;
+};
@@ -0,0 +1,32 @@
+#pragma once
+#include <efile_types.h>
+
+class ElasticFile;
+
+// Moves the data of a file to the beginning of its space in the logical order.
+// Logically adjacent data sectors become one physically continuous sector, free
+// sectors are moved to the end and cut off from the file.
+// Every step copies a part of a sector to free space and only then switches the sector
+// in the sectors table, so the table is always consistent with the data. The space freed
+// by the steps isn't reused until the new table is synced, so the table on the disk stays
+// consistent as well.
+class TEFileCompactor
+{
+public:
+	TEFileCompactor(ElasticFile& file);
+	~TEFileCompactor(void);
+
+	// Returns true when the file is compacted completely
+	bool Compact(const TEFileCompactMode& mode, const size_file_t& bytes_limit);
+
+private:
+	void Commit();
+	size_file_t PlaceSector(TEFileSectorsList::iterator sector_it, TEFileSectorsList::iterator place_it, size_file_t bytes_left);
+	size_file_t EvictSector(TEFileSectorsList::iterator sector_it, size_file_t size);
+	void CopyData(size_file_t from_addr, size_file_t to_addr, size_file_t size);
+
+private:
+	ElasticFile& m_file;
+	std::vector<BYTE> m_buffer;
+	TEFileIOSegments m_segments;
+};
@@ -0,0 +1,41 @@
+#pragma once
+#include <efile_types.h>
+
+// Counters of one file. Every value is also added to the global counters of the process, which
+// are kept per thread and are summed only when they are read, so the threads don't share a
+// cache line on every operation. The values are relaxed atomics: a snapshot taken while the
+// file is used is not consistent between the counters, but every counter is exact
+class TEFileCounters
+{
+public:
+	TEFileCounters(void);
+	~TEFileCounters(void);
+
+	void Add(const TEFileCounter& counter, unsigned __int64 value)
+	{
+		m_values[counter].fetch_add(value, std::memory_order_relaxed);
+		AddGlobal(counter, value);
+	}
+
+	void GetSnapshot(TEFileCountersSnapshot& snapshot) const;
+
+	// Counters of all the files of the process since its start
+	static void GetGlobalSnapshot(TEFileCountersSnapshot& snapshot);
+
+protected:
+	static void AddGlobal(const TEFileCounter& counter, unsigned __int64 value);
+
+private:
+	TEFileCounters(const TEFileCounters&);
+	TEFileCounters& operator=(const TEFileCounters&);
+
+private:
+	std::atomic<unsigned __int64> m_values[EF_COUNTERS_COUNT];
+};
+
+// The counters can be NULL (a backend which is not opened by a file)
+#ifdef EF_COUNTERS
+#define EF_COUNT(counters, counter, value) do { if(counters) (counters)->Add(counter, value); } while(0)
+#else
+#define EF_COUNT(counters, counter, value) do { } while(0)
+#endif
@@ -3,6 +3,10 @@
 
 class ElasticFile;
 
+// Position in the data of a file with the sector where it is. A file has its own cursor
+// and any count of cursors of the readers. A cursor keeps its sector only until the
+// sectors table is changed, then the sector is found again by the position, so a change
+// made through one cursor doesn't break the others.
 class TEFileCursor
 {
 public:
@@ -11,6 +15,7 @@ public:
 
 	void SetPosition(const size_file_t& offset, TEFileCursorMoveMode mode);
 	const size_file_t& GetPosition();
+	void Refresh();
 	void Update(TEFileSectorsList::iterator sector);
 	void Update(TEFileSectorsList::iterator sector, const size_file_t& offset_in_sector);
 	void Update(TEFileSectorsList::iterator sector, const size_file_t& offset_in_sector, const size_file_t& position);
@@ -18,12 +23,19 @@ public:
 	TEFileSectorsList::iterator GetSectorInPosition(const size_file_t& position, size_file_t& offset_in_sector);
 	TEFileSectorsList::iterator GetSectorInPosition2(const size_file_t& position, size_file_t& offset_in_sector);
 	const size_file_t& GetOffsetInSector();
+	ElasticFile& GetFile();
+
+private:
+	void CheckChanges();
 
 private:
 	size_file_t m_position;
 	TEFileSectorsList::iterator m_sector;
 	size_file_t m_offset_in_sector;
+	size_t m_changes_count; // Changes count of the sectors table when the sector was found
 	ElasticFile& m_file;
 };
 
+typedef std::shared_ptr<TEFileCursor> TEFileCursorPtr;
+
 
@@ -0,0 +1,47 @@
+#pragma once
+#include <efile_types.h>
+
+class ElasticFile;
+
+// Applies a batch of inserts and deletes to a file. The operations are sorted by their
+// positions and checked before anything is changed: deletes must not overlap and nothing
+// can be inserted inside of a deleted range. Then the space for all the inserted data is
+// allocated and the data is written by one vectored call, and only after that the sectors
+// are switched in the sectors table in one pass from the beginning of the file to the end.
+// So a failed batch doesn't change the data of the file.
+class TEFileEditPlan
+{
+public:
+	TEFileEditPlan(ElasticFile& file);
+	~TEFileEditPlan(void);
+
+	void Apply(const TEFileEdit* edits, const size_t& edits_count);
+
+private:
+	// Inserts go before deletes on the same position, so the order of the input doesn't matter
+	struct TPositionLess
+	{
+		TPositionLess(const TEFileEdit* edits) : m_edits(edits) {}
+		bool operator()(size_t first, size_t second) const
+		{
+			if(m_edits[first].Position != m_edits[second].Position)
+				return m_edits[first].Position < m_edits[second].Position;
+
+			return m_edits[first].Type == EF_EDIT_INSERT && m_edits[second].Type == EF_EDIT_DELETE;
+		}
+
+		const TEFileEdit* m_edits;
+	};
+
+	size_file_t Check(const TEFileEdit* edits);
+	void WriteInserts(const TEFileEdit* edits, const size_file_t& insert_size);
+	void PlaceInserts(const TEFileEdit* edits);
+	void ApplyDeletes(const TEFileEdit* edits);
+
+private:
+	ElasticFile& m_file;
+	std::vector<size_t> m_order; // Indexes of the operations sorted by position
+	TEFileSectorsIterators m_sectors; // Sectors of the inserted data in the order of the operations
+	std::vector<size_t> m_sectors_ends; // Index of the end of the sectors of every operation
+	TEFileIOSegments m_segments;
+};
@@ -0,0 +1,25 @@
+#pragma once
+#include <efile_types.h>
+
+#define EF_NO_EPOCH ((size_t)-1)
+
+// Versions of the sectors table which are pinned by snapshots. A version is the count of
+// changes of the table when the snapshot was made. Snapshots are released in any thread,
+// so the versions are locked, but only for the time of one call
+class TEFileEpochs
+{
+public:
+	TEFileEpochs();
+	~TEFileEpochs(void);
+
+	void Pin(size_t version);
+	void Unpin(size_t version);
+	// EF_NO_EPOCH if no version is pinned
+	size_t GetOldest() const;
+
+private:
+	mutable std::mutex m_lock;
+	std::multiset<size_t> m_versions;
+};
+
+typedef std::shared_ptr<TEFileEpochs> TEFileEpochsPtr;
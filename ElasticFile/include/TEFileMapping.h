@@ -0,0 +1,40 @@
+#pragma once
+#include <TEFileBackend.h>
+
+// Read-only mapping of the first bytes of a file into memory
+class TEFileMappedRegion
+{
+public:
+	TEFileMappedRegion(int file_descriptor, size_file_t size);
+	// Region over memory which isn't mapped from a file, the owner keeps the memory
+	TEFileMappedRegion(const BYTE* data, size_file_t size, const std::shared_ptr<void>& owner);
+	~TEFileMappedRegion(void);
+
+	const BYTE* GetData() const;
+	size_file_t GetSize() const;
+
+private:
+	TEFileMappedRegion(const TEFileMappedRegion&);
+	TEFileMappedRegion& operator=(const TEFileMappedRegion&);
+
+private:
+	BYTE* m_data;
+	size_file_t m_size;
+	void* m_mapping;
+	std::shared_ptr<void> m_owner;
+};
+
+// Mapping of the sectors of a file. The file is mapped again when its size is changed,
+// but the previous region is unmapped only when the last view which uses it is destroyed
+class TEFileMapping
+{
+public:
+	TEFileMapping();
+	~TEFileMapping(void);
+
+	TEFileMappedRegionPtr Map(const TEFileHandle& file_handle, size_file_t size);
+	void Unmap();
+
+private:
+	TEFileMappedRegionPtr m_region;
+};
@@ -0,0 +1,64 @@
+#pragma once
+#include <TEFileBackend.h>
+
+// Backend which keeps the files in memory, for tests and benchmarks without the disk.
+// The files are found by their names in a registry of the process and stay there after
+// they are closed, until they are removed or the process ends
+class TEFileMemoryBackend : public TEFileBackend
+{
+public:
+	TEFileMemoryBackend();
+	virtual ~TEFileMemoryBackend(void);
+
+	// Frees the memory of the file, the handles which are still open keep their data
+	static bool Remove(const std::string& file_name);
+
+	virtual bool Open(const std::string& file_name, bool create);
+	virtual bool Exists(const std::string& file_name);
+	virtual bool Close();
+	virtual TEFileHandle CreateReader();
+
+	virtual size_file_t ReadAt(size_file_t addr, PBYTE buffer, size_file_t size);
+	virtual size_file_t WriteAt(size_file_t addr, const BYTE* buffer, size_file_t size);
+
+	virtual bool GetSize(size_file_t& size);
+	virtual bool Resize(size_file_t size);
+	virtual bool Preallocate(size_file_t size);
+	virtual bool Flush();
+	virtual bool Sync();
+
+	virtual TEFileMappedRegionPtr Map(size_file_t size);
+
+protected:
+	virtual size_file_t Transfer(const TEFileIOSegments& segments, bool write);
+
+private:
+	typedef std::vector<BYTE> TData;
+	typedef std::shared_ptr<TData> TDataPtr;
+
+	struct TMemoryFile
+	{
+		std::mutex Lock;
+		// The data is never moved inside of its vector: a file which outgrows it gets a new
+		// vector, and the old one lives while it is mapped
+		TDataPtr Data;
+	};
+
+	typedef std::shared_ptr<TMemoryFile> TMemoryFilePtr;
+
+	struct TRegistry
+	{
+		std::mutex Lock;
+		std::map<std::string, TMemoryFilePtr> Files;
+	};
+
+	static TRegistry& GetRegistry();
+
+	// The lock of the file must be taken
+	bool Reserve(size_file_t size);
+	size_file_t TransferLow(size_file_t addr, PBYTE buffer, size_file_t size, bool write);
+
+private:
+	TMemoryFilePtr m_file;
+	bool m_read_only;
+};
@@ -0,0 +1,41 @@
+#pragma once
+#include <TEFilePosixBackend.h>
+
+#ifndef _WIN32
+
+// Backend which transfers the data by copying it from and to a shared mapping of the file.
+// The mapping is larger than the file and grows geometrically in steps of EF_MMAP_GROWTH,
+// so appends don't map the file again every time. The file itself always has its exact size.
+// Other handles of the file see the copied data at once, Sync writes it to the disk
+class TEFileMmapBackend : public TEFilePosixBackend
+{
+public:
+	TEFileMmapBackend();
+	virtual ~TEFileMmapBackend(void);
+
+	virtual bool Open(const std::string& file_name, bool create);
+	virtual bool Close();
+
+	virtual size_file_t ReadAt(size_file_t addr, PBYTE buffer, size_file_t size);
+	virtual size_file_t WriteAt(size_file_t addr, const BYTE* buffer, size_file_t size);
+
+	virtual bool GetSize(size_file_t& size);
+	virtual bool Resize(size_file_t size);
+	virtual bool Preallocate(size_file_t size);
+	virtual bool Sync();
+
+protected:
+	virtual size_file_t Transfer(const TEFileIOSegments& segments, bool write);
+
+private:
+	// Maps the file again if the mapping is smaller than the size
+	bool Reserve(size_file_t size);
+	void Unmap();
+
+private:
+	BYTE* m_data;
+	size_file_t m_capacity;
+	size_file_t m_size;
+};
+
+#endif
@@ -0,0 +1,115 @@
+#pragma once
+#include <vector>
+#include <cstddef>
+#include <new>
+
+// Included by efile_types.h
+
+// Pool of small memory blocks for the nodes of the sectors table containers.
+// Blocks are cut from big chunks and are kept in free lists of their size class
+// after deallocation, so there is no heap header per node and nodes are placed close
+// to each other. The memory is returned to the heap only when the pool is destroyed.
+class TEFileNodePool
+{
+public:
+	TEFileNodePool();
+	~TEFileNodePool();
+
+	void* Allocate(size_t size);
+	void Deallocate(void* block, size_t size);
+
+	// Bytes taken from the heap by the pool
+	size_t GetReservedSize() const;
+	// Bytes of the blocks which are allocated now
+	size_t GetAllocatedSize() const;
+
+private:
+	TEFileNodePool(const TEFileNodePool&);
+	TEFileNodePool& operator=(const TEFileNodePool&);
+
+	static size_t GetSizeClass(size_t size);
+
+private:
+	enum
+	{
+		EF_POOL_ALIGNMENT = 8,
+		EF_POOL_SIZE_CLASSES = 16, // Blocks up to 128 bytes
+		EF_POOL_CHUNK_SIZE = 64 * 1024
+	};
+
+	struct TFreeBlock
+	{
+		TFreeBlock* Next;
+	};
+
+	TFreeBlock* m_free_blocks[EF_POOL_SIZE_CLASSES];
+	std::vector<char*> m_chunks;
+	char* m_chunk_position;
+	size_t m_chunk_left;
+	size_t m_allocated_size;
+};
+
+// Allocator of the standard containers which takes the nodes from a pool
+template<class T>
+class TEFilePoolAllocator
+{
+public:
+	typedef T value_type;
+	typedef T* pointer;
+	typedef const T* const_pointer;
+	typedef T& reference;
+	typedef const T& const_reference;
+	typedef size_t size_type;
+	typedef ptrdiff_t difference_type;
+
+	template<class U>
+	struct rebind
+	{
+		typedef TEFilePoolAllocator<U> other;
+	};
+
+	explicit TEFilePoolAllocator(TEFileNodePool* pool)
+		: m_pool(pool)
+	{
+	}
+
+	template<class U>
+	TEFilePoolAllocator(const TEFilePoolAllocator<U>& allocator)
+		: m_pool(allocator.GetPool())
+	{
+	}
+
+	pointer allocate(size_type count, const void* = 0)
+	{
+		return static_cast<pointer>(m_pool->Allocate(count * sizeof(T)));
+	}
+
+	void deallocate(pointer block, size_type count)
+	{
+		m_pool->Deallocate(block, count * sizeof(T));
+	}
+
+	void construct(pointer block, const T& value)
+	{
+		new(static_cast<void*>(block)) T(value);
+	}
+
+	void destroy(pointer block)
+	{
+		block->~T();
+	}
+
+	pointer address(reference value) const { return &value; }
+	const_pointer address(const_reference value) const { return &value; }
+	size_type max_size() const { return size_type(-1) / sizeof(T); }
+
+	TEFileNodePool* GetPool() const { return m_pool; }
+
+	template<class U>
+	bool operator==(const TEFilePoolAllocator<U>& allocator) const { return m_pool == allocator.GetPool(); }
+	template<class U>
+	bool operator!=(const TEFilePoolAllocator<U>& allocator) const { return m_pool != allocator.GetPool(); }
+
+private:
+	TEFileNodePool* m_pool;
+};
@@ -0,0 +1,41 @@
+#pragma once
+#include <TEFileBackend.h>
+
+#ifndef _WIN32
+
+// Backend over a file descriptor. Transfers are positional (pread/pwrite), so they
+// need no locks, and the runs of physically adjacent segments take one preadv/pwritev
+// call each or are submitted through io_uring at once (EF_IO_URING)
+class TEFilePosixBackend : public TEFileBackend
+{
+public:
+	TEFilePosixBackend();
+	virtual ~TEFilePosixBackend(void);
+
+	virtual bool Open(const std::string& file_name, bool create);
+	virtual bool Exists(const std::string& file_name);
+	virtual bool Close();
+	virtual TEFileHandle CreateReader();
+
+	virtual size_file_t ReadAt(size_file_t addr, PBYTE buffer, size_file_t size);
+	virtual size_file_t WriteAt(size_file_t addr, const BYTE* buffer, size_file_t size);
+
+	virtual bool GetSize(size_file_t& size);
+	virtual bool Resize(size_file_t size);
+	virtual bool Preallocate(size_file_t size);
+	virtual bool ZeroRange(size_file_t addr, size_file_t size);
+	virtual bool Flush();
+	virtual bool Sync();
+
+protected:
+	virtual size_file_t Transfer(const TEFileIOSegments& segments, bool write);
+	virtual int GetDescriptor();
+
+	bool OpenDescriptor(const std::string& file_name, int flags);
+
+protected:
+	int m_file_descriptor;
+	std::string m_file_name;
+};
+
+#endif
@@ -0,0 +1,38 @@
+#pragma once
+#include <efile_types.h>
+
+// Planner of the reads which span many sectors. The segments of a request are read
+// in the order of their physical addresses instead of the logical order, so the disk
+// is passed in one direction. Holes between the segments which are not bigger than
+// the gap tolerance are read through into a scratch buffer, so neighbour segments are
+// read by one call. The data gets to its logical place in the buffers of the caller
+// directly, because every segment points to its own part of them.
+class TEFileReadPlanner
+{
+public:
+	TEFileReadPlanner();
+	~TEFileReadPlanner(void);
+
+	void SetOrder(const TEFileReadOrder& order, const size_file_t& gap_tolerance);
+	const TEFileReadOrder& GetOrder() const;
+	const size_file_t& GetGapTolerance() const;
+
+	// Returns the count of bytes read in the logical order until the first segment which is not read
+	size_file_t Read(const TEFileHandle& file_handle, const TEFileIOSegments& segments);
+
+private:
+	struct TAddrLess
+	{
+		TAddrLess(const TEFileIOSegments& segments) : m_segments(segments) {}
+		bool operator()(size_t first, size_t second) const { return m_segments[first].Addr < m_segments[second].Addr; }
+
+		const TEFileIOSegments& m_segments;
+	};
+
+	TEFileReadOrder m_order;
+	size_file_t m_gap_tolerance;
+	std::vector<size_t> m_segments_order;
+	std::vector<size_file_t> m_segments_ends; // Count of planned bytes up to the end of every segment
+	TEFileIOSegments m_plan;
+	std::vector<BYTE> m_gap_buffer;
+};
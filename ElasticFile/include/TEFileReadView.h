@@ -0,0 +1,35 @@
+#pragma once
+#include <efile_types.h>
+#include <TEFileMapping.h>
+
+// Read-only view of a logical range of a file. It is a sequence of spans, one per data
+// sector, which point straight into the mapping of the file, so the data is not copied.
+// The view keeps its mapping alive, but it is valid only until the file is modified or
+// closed: after that the spans may point to the bytes of other data or to free space
+class TEFileReadView
+{
+public:
+	typedef TEFileSpans::const_iterator const_iterator;
+
+	TEFileReadView();
+	~TEFileReadView(void);
+
+	const_iterator begin() const;
+	const_iterator end() const;
+	bool empty() const;
+	// Count of spans
+	size_t size() const;
+	// Count of bytes in all the spans
+	size_file_t GetSize() const;
+
+	bool IsValid() const;
+
+private:
+	friend class ElasticFile;
+
+	TEFileSpans m_spans;
+	size_file_t m_size;
+	TEFileMappedRegionPtr m_region;
+	std::shared_ptr<const size_t> m_file_generation;
+	size_t m_generation;
+};
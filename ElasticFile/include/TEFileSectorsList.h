@@ -0,0 +1,132 @@
+#pragma once
+#include <iterator>
+#include <cstddef>
+#include <vector>
+
+// Included by efile_types.h right after TEFileSector is declared.
+
+// Node of the indexed sectors sequence. Besides the sector itself it stores
+// the count of data bytes in its subtree, so a logical position can be
+// resolved by descending from the root.
+struct TEFileSectorsListNode
+{
+	TEFileSectorsListNode()
+		: Parent(NULL)
+		, Left(NULL)
+		, Right(NULL)
+		, Priority(0)
+		, SubtreeDataSize(0)
+	{
+	}
+
+	TEFileSectorsListNode* Parent;
+	TEFileSectorsListNode* Left;
+	TEFileSectorsListNode* Right;
+	unsigned int Priority;
+	size_file_t SubtreeDataSize; // Data bytes of all non-free sectors in the subtree
+	TEFileSector Sector;
+};
+
+// Logical sequence of sectors. Has the interface of std::list which is used by the
+// sectors table, but is built as a treap (randomized balanced tree) ordered by the
+// logical position of sectors. Insert, erase, splice and lookup of a sector by a
+// logical offset are O(log n). Iterators stay valid until the sector is erased.
+// Nodes are allocated from the pool of the sectors table.
+class TEFileSectorsList
+{
+public:
+	class iterator
+	{
+	public:
+		typedef std::bidirectional_iterator_tag iterator_category;
+		typedef TEFileSector value_type;
+		typedef std::ptrdiff_t difference_type;
+		typedef TEFileSector* pointer;
+		typedef TEFileSector& reference;
+
+		iterator()
+			: m_node(NULL)
+		{
+		}
+
+		explicit iterator(TEFileSectorsListNode* node)
+			: m_node(node)
+		{
+		}
+
+		reference operator*() const { return m_node->Sector; }
+		pointer operator->() const { return &m_node->Sector; }
+
+		iterator& operator++() { m_node = TEFileSectorsList::Next(m_node); return *this; }
+		iterator operator++(int) { iterator it(*this); ++*this; return it; }
+		iterator& operator--() { m_node = TEFileSectorsList::Prev(m_node); return *this; }
+		iterator operator--(int) { iterator it(*this); --*this; return it; }
+
+		bool operator==(const iterator& it) const { return m_node == it.m_node; }
+		bool operator!=(const iterator& it) const { return m_node != it.m_node; }
+
+		TEFileSectorsListNode* Node() const { return m_node; }
+
+	private:
+		TEFileSectorsListNode* m_node;
+	};
+
+	typedef std::reverse_iterator<iterator> reverse_iterator;
+
+	explicit TEFileSectorsList(TEFileNodePool& pool);
+	~TEFileSectorsList();
+
+	iterator begin();
+	iterator end();
+	reverse_iterator rbegin();
+	reverse_iterator rend();
+	bool empty() const;
+	size_t size() const;
+
+	iterator insert(iterator before, const TEFileSector& sector);
+	iterator erase(iterator sector_it);
+	void splice(iterator before, TEFileSectorsList& list, iterator sector_it);
+	void clear();
+
+	// Builds the sequence from the sectors in O(n). data_offsets[i] is the logical position
+	// of the sector i and data_offsets[count] is the whole data size. The list must be empty
+	void Build(const TEFileSector* sectors, size_t count, const size_file_t* data_offsets);
+
+	// Must be called after SectorSize or Free of the sector have been changed
+	void Update(iterator sector_it);
+
+	// Data bytes in the whole sequence
+	size_file_t GetDataSize() const;
+	// Logical position of the first byte of the sector
+	size_file_t GetPosition(iterator sector_it) const;
+	// The data sector which contains the position, or end() if position is beyond the data
+	iterator Find(size_file_t position, size_file_t& offset_in_sector, size_t& nodes_visited);
+
+	static TEFileSectorsListNode* Next(TEFileSectorsListNode* node);
+	static TEFileSectorsListNode* Prev(TEFileSectorsListNode* node);
+
+private:
+	TEFileSectorsList(const TEFileSectorsList&);
+	TEFileSectorsList& operator=(const TEFileSectorsList&);
+
+	void Link(TEFileSectorsListNode* node, TEFileSectorsListNode* before);
+	void Unlink(TEFileSectorsListNode* node);
+	void Rotate(TEFileSectorsListNode* node);
+	void UpdatePath(TEFileSectorsListNode* node);
+	void Destroy(TEFileSectorsListNode* node);
+	unsigned int GeneratePriority();
+	TEFileSectorsListNode* CreateNode(const TEFileSector& sector);
+	void DeleteNode(TEFileSectorsListNode* node);
+
+	static void Recalculate(TEFileSectorsListNode* node);
+	static size_file_t SubtreeDataSize(const TEFileSectorsListNode* node);
+	static size_file_t DataSize(const TEFileSectorsListNode* node);
+
+private:
+	// m_header.Left is the root. The header itself plays the role of end()
+	TEFileSectorsListNode m_header;
+	TEFileSectorsListNode* m_begin;
+	TEFileNodePool& m_pool;
+	size_t m_size;
+	unsigned int m_seed;
+};
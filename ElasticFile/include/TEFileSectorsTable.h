@@ -1,27 +1,53 @@
 #pragma once
 #include <efile_types.h>
+#include <TEFileEpochs.h>
 
 class ElasticFile;
 class TEFileSectorsTable
 {
 public:
+	friend class TEFileCompactor;
+	friend class TEFileEditPlan;
+
 	TEFileSectorsTable(ElasticFile& file);
 	~TEFileSectorsTable();
 
 	int Load();
 	bool Write();
+	// The next Write writes the whole table in the current format instead of appending the journal
+	void Rewrite();
 	void Allocate(size_file_t size_to_allocate, TEFileSectorsIterators& allocated_sectors_iterators);
 	TEFileSectorsList::iterator AllocateNewSector(size_file_t size_to_allocate);
+	void AllocateNewSectors(size_file_t size_to_allocate, TEFileSectorsIterators& allocated_sectors_iterators);
+	void SetAllocationPolicy(TEFileAllocationPolicy policy);
+	TEFileAllocationPolicy GetAllocationPolicy() const;
 
 	size_file_t GetSectorsCount() const;
 	const size_file_t& GetDataSize() const;
 	const size_file_t& GetFileSize() const;
+	// Grows on every change of the sectors, so a cursor can check that its sector is still valid
+	const size_t& GetChangesCount() const;
+	const TEFileEpochsPtr& GetEpochs() const;
+	// Data or free space is referenced by snapshots, so it can't be overwritten or moved.
+	// The free space which isn't referenced any more is returned for the allocation first
+	bool IsSpacePinned();
+	// Space freed between BeginRelocation and EndRelocation isn't allocated, because the table on
+	// the disk still refers to it. EndRelocation is called when a table which doesn't is synced
+	void BeginRelocation();
+	void EndRelocation();
+	// The table on the disk is in the current format and its journal can be appended
+	bool IsJournalValid() const;
 	TEFileSectorsList& List();
 	TEFileSectorsMap& Map();
 	TEFileSectorsMap& FreeSectors();
 
+	TEFileSectorsList::iterator GetSectorInPosition(const size_file_t& position, size_file_t& offset_in_sector);
+	TEFileSectorsList::iterator GetNextDataSector(TEFileSectorsList::iterator sector_it);
+
 	void SetSectorFree(TEFileSectorsList::iterator sector, bool free);
+	void SetSectorState(TEFileSectorsList::iterator sector, BYTE state);
 
+	std::pair<TEFileSectorsList::iterator, TEFileSectorsList::iterator> SplitSector(TEFileSectorsList::iterator sector_it, size_file_t offset_in_sector);
 	std::pair<TEFileSectorsList::iterator, TEFileSectorsList::iterator> TruncateSector(TEFileSectorsList::iterator sector, size_file_t from, size_file_t truncation_size);
 	void MoveSectorsTo(TEFileSectorsIterators& sectors_to_move, size_file_t position);
 	void MoveSectorTo(TEFileSectorsList::iterator sector_it, size_file_t position);
@@ -30,11 +56,15 @@ public:
 	TUniteStatus CheckAndUniteSector(TEFileSectorsList::iterator sector_it, TUniteResult& unite_result);
 
 	void ExtendSector(TEFileSectorsList::iterator sector_it, size_file_t size_to_extend);
-	size_file_t CalculateGarbageSize();
 
+	// Writes the table right after the data, which must be in the beginning of the file,
+	// and cuts off the free space after it
+	bool Shrink();
+	bool ResizeFile(size_file_t file_size);
 	void Clear();
 
 private:
+	static bool CanUniteSectors(const TEFileSector& first, const TEFileSector& second);
 	TEFileSectorsList::iterator UniteSectors(TEFileSectorsList::iterator first_it, TEFileSectorsList::iterator second_it);
 	TUniteStatus CheckAndUniteFreeSector(TEFileSectorsList::iterator sector_it, TUniteResult& unite_result);
 	TUniteStatus CheckAndUniteDataSector(TEFileSectorsList::iterator sector_it, TUniteResult& unite_result);
@@ -42,17 +72,49 @@ private:
 	void MoveSector(TEFileSectorsList::iterator sector_it, TEFileSectorsList::iterator before_it);
 	
 	TEFileSectorsList::iterator InsertSector(const TEFileSector& sector, TEFileSectorsList::iterator before);
-	std::pair<TEFileSectorsList::iterator, TEFileSectorsList::iterator> SplitSector(TEFileSectorsList::iterator sector_it, size_file_t offset_in_sector);
 
 	int Parse();
+	int ParseLegacy(size_file_t file_size);
+	int ParseJournal(size_file_t file_size, const TEFileTableFooter& footer, bool format32);
+	int ReadSnapshot(size_file_t snapshot_addr, size_file_t file_size, bool format32);
+	bool ReadChunkHeader(size_file_t chunk_addr, bool format32, TEFileJournalHeader& header);
+	bool ReadChunkRecords(size_file_t chunk_addr, const TEFileJournalHeader& header, size_file_t file_size, bool format32, TEFileJournal& records);
+	int ReadLegacySectors(size_file_t table_addr, size_file_t sectors_count);
+	int LoadSectors(const std::vector<TEFileSector>& sectors);
+	static bool ValidateSectors(const std::vector<TEFileSector>& sectors, std::vector<size_file_t>& data_offsets);
+	bool ApplyJournalRecord(const TEFileJournalRecord& record);
 	void Create();
+
+	bool WriteSnapshot(size_file_t table_addr = EF_NO_SECTOR);
+	bool WriteJournal();
+	bool WriteFooter();
+	bool WriteFooter(size_file_t footer_position);
+	void EncodeSectors(std::vector<BYTE>& data);
+	void EncodeJournal(std::vector<BYTE>& data);
+	// Positional I/O of the table, true if all the bytes are transferred
+	bool ReadTable(size_file_t addr, void* buffer, size_file_t size);
+	bool WriteTable(size_file_t addr, const void* buffer, size_file_t size);
+	void ReleaseTableSector(TEFileSectorsList::iterator sector_it);
+	TEFileSectorsList::iterator RelocateSector(TEFileSectorsList::iterator sector_it, TEFileSectorsList::iterator target_it);
+	bool NeedCompaction() const;
+	TEFileSectorsList::iterator AllocateTableSector(size_file_t size, size_file_t table_addr = EF_NO_SECTOR);
+	void KeepFooter(size_file_t sector_size);
+	void Journal(BYTE type, size_file_t sector_addr, size_file_t size, size_file_t next_addr, BYTE state);
+	TEFileSectorsList::iterator FindSector(size_file_t sector_addr);
+	size_file_t GetSectorAddr(TEFileSectorsList::iterator sector_it);
 	
-	TEFileSectorsList::iterator GetFirstFreeSector();
-	size_file_t GetTableSize() const;
+	TEFileSectorsList::iterator FindFreeSector(size_file_t size, bool exact);
+	void AddFreeSector(TEFileSectorsList::iterator sector_it);
+	void RemoveFreeSector(TEFileSectorsList::iterator sector_it);
+	void ReclaimSectors();
+	void RetireSector(size_file_t sector_addr);
+	bool IsRetired(size_file_t sector_addr) const;
 	size_file_t MinFileSize() const;
 
 
 private:
+	// Declared first in order to be destroyed after all the containers
+	TEFileNodePool m_pool;
 	TEFileSectorsList m_sectors_list;
 	TEFileSectorsMap m_sectors_map;
 	TEFileSectorsCount m_sectors_count;
@@ -60,4 +122,26 @@ private:
 	size_file_t m_data_size;
 	ElasticFile& m_file;
 	TEFileSectorsMap m_free_sectors_map;
+	TEFileFreeSectorsSizes m_free_sectors_sizes;
+	TEFileAllocationPolicy m_allocation_policy;
+
+	// Changes of the table which are not written to the file yet
+	TEFileJournal m_journal;
+	// Addresses of the sectors which keep the base snapshot and the journal chunks
+	std::vector<size_file_t> m_table_sectors;
+	size_file_t m_base_addr;
+	size_file_t m_last_chunk_addr;
+	size_file_t m_journal_records; // Records in the journal chunks on disk
+	std::vector<BYTE> m_table_data; // Encoded snapshot or journal chunk which is read or written
+	bool m_journal_valid; // The file has a base snapshot, so changes can be appended to it
+	int m_journal_suspended;
+	size_t m_changes_count;
+
+	// Snapshots pin versions of the table. The data freed while a snapshot exists is kept
+	// out of the free sectors maps with the count of changes when it was freed, until all
+	// the snapshots made before are released
+	TEFileEpochsPtr m_epochs;
+	std::map<size_file_t, size_t> m_retired_sectors;
+	size_t m_retired_version; // Not more than the lowest version of the retired sectors
+	bool m_relocating; // The freed space is retired until the table is synced
 };
\ No newline at end of file
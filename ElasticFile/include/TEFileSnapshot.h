@@ -0,0 +1,48 @@
+#pragma once
+#include <efile_types.h>
+#include <TEFileEpochs.h>
+
+class TEFileSectorsTable;
+
+// Read-only version of the data of a file. It keeps the data sectors as they were when it
+// was made and pins this version of the sectors table, so the space of the data is not
+// overwritten or reused until the snapshot is released. The file is read through a handle
+// of the snapshot and no lock of the file is taken, so any count of threads can read a
+// snapshot while the file is modified. After the file is closed the data can be read until
+// the file is opened and modified again
+class TEFileSnapshot
+{
+public:
+	TEFileSnapshot(const TEFileHandle& file_handle, TEFileSectorsTable& sectors_table);
+	~TEFileSnapshot(void);
+
+	size_file_t Read(const size_file_t& position, PBYTE buffer, const size_file_t& size);
+	const size_file_t& GetDataSize() const;
+	const size_t& GetVersion() const;
+
+private:
+	TEFileSnapshot(const TEFileSnapshot&);
+	TEFileSnapshot& operator=(const TEFileSnapshot&);
+
+	// Data which is continuous both in the file and logically
+	struct TExtent
+	{
+		size_file_t Position;
+		size_file_t Addr;
+		size_file_t Size;
+	};
+
+	struct TPositionLess
+	{
+		bool operator()(const size_file_t& position, const TExtent& extent) const { return position < extent.Position; }
+	};
+
+private:
+	TEFileHandle m_handle;
+	std::vector<TExtent> m_extents;
+	size_file_t m_data_size;
+	size_t m_version;
+	TEFileEpochsPtr m_epochs;
+};
+
+typedef std::shared_ptr<TEFileSnapshot> TEFileSnapshotPtr;
@@ -0,0 +1,78 @@
+#pragma once
+#include <efile_types.h>
+
+// Spans are collected in memory and written to the file by this count of bytes
+#define EF_SPANS_BUFFER_SIZE	(64 * 1024)
+
+// Writes the time of the long steps of files (loading and writing the sectors table, extension
+// of a file, insertion of many sectors) from all the threads to a file in the Chrome trace event
+// format, which trace viewers open. While no file is written, a step only checks a flag
+class TEFileSpansRecorder
+{
+public:
+	TEFileSpansRecorder(void);
+	~TEFileSpansRecorder(void);
+
+	// Stops the current file and starts a new one
+	void Start(const std::string& file_name);
+	void Stop();
+
+	bool IsEnabled() const
+	{
+		return m_enabled.load(std::memory_order_relaxed);
+	}
+
+	// The start is the time of the clock, the size is written to the arguments of the span if it is not 0
+	void Write(const char* name, unsigned __int64 start, unsigned __int64 duration, const size_file_t& size);
+
+	static TEFileSpansRecorder& Get();
+	// Nanoseconds of a steady clock
+	static unsigned __int64 GetClock();
+
+protected:
+	void Flush();
+	unsigned int GetThread();
+
+private:
+	std::mutex m_lock;
+	std::atomic<bool> m_enabled;
+	std::atomic<unsigned int> m_files_count; // Threads are numbered again in every file
+	std::atomic<unsigned int> m_threads_count;
+	FILE* m_file;
+	std::string m_buffer;
+	bool m_first_span;
+	unsigned __int64 m_start;
+};
+
+// One step of a file, written when the object is destroyed. The name must be a literal
+class TEFileSpanScope
+{
+public:
+	TEFileSpanScope(const char* name, const size_file_t& size = 0)
+		: m_name(name)
+		, m_size(size)
+		, m_start(TEFileSpansRecorder::Get().IsEnabled() ? TEFileSpansRecorder::GetClock() : 0)
+	{
+	}
+
+	~TEFileSpanScope(void)
+	{
+		if(m_start != 0)
+			TEFileSpansRecorder::Get().Write(m_name, m_start, TEFileSpansRecorder::GetClock() - m_start, m_size);
+	}
+
+	// Bytes processed by the step if they are known only in its end
+	void SetSize(const size_file_t& size)
+	{
+		m_size = size;
+	}
+
+private:
+	TEFileSpanScope(const TEFileSpanScope&);
+	TEFileSpanScope& operator=(const TEFileSpanScope&);
+
+private:
+	const char* m_name;
+	size_file_t m_size;
+	unsigned __int64 m_start; // 0 if there was no file when the step started
+};
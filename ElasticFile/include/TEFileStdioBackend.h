@@ -0,0 +1,37 @@
+#pragma once
+#include <TEFileBackend.h>
+
+// Backend over a stdio stream. The stream has one position for all the callers,
+// so every transfer seeks and is done under the lock of the backend
+class TEFileStdioBackend : public TEFileBackend
+{
+public:
+	TEFileStdioBackend();
+	virtual ~TEFileStdioBackend(void);
+
+	virtual bool Open(const std::string& file_name, bool create);
+	virtual bool Exists(const std::string& file_name);
+	virtual bool Close();
+	virtual TEFileHandle CreateReader();
+
+	virtual size_file_t ReadAt(size_file_t addr, PBYTE buffer, size_file_t size);
+	virtual size_file_t WriteAt(size_file_t addr, const BYTE* buffer, size_file_t size);
+
+	virtual bool GetSize(size_file_t& size);
+	virtual bool Resize(size_file_t size);
+	virtual bool Preallocate(size_file_t size);
+	virtual bool Flush();
+	virtual bool Sync();
+
+protected:
+	virtual int GetDescriptor();
+
+private:
+	bool OpenStream(const std::string& file_name, const char* mode);
+	bool Seek(size_file_t addr);
+
+private:
+	FILE* m_stream;
+	std::string m_file_name;
+	std::mutex m_lock;
+};
@@ -0,0 +1,28 @@
+#pragma once
+#include <efile_types.h>
+
+// Variable-width encoding of the sectors table on disk. Numbers are written by 7 bits
+// per byte, and addresses as the signed distance from the address which is expected
+// next, so a sector of a file without holes takes 2-5 bytes whatever the offsets are.
+// The address passed by reference is the base of the next sector or record and is moved
+// by every call, so a sequence must be decoded in the order it has been encoded
+class TEFileTableCodec
+{
+public:
+	// A sector is expected right after the previous one
+	static void EncodeSector(const TEFileSector& sector, size_file_t& next_addr, std::vector<BYTE>& data);
+	static bool DecodeSector(const BYTE*& data, const BYTE* data_end, size_file_t& next_addr, TEFileSector& sector);
+
+	// A journal record is expected at the sector of the previous one
+	static void EncodeRecord(const TEFileJournalRecord& record, size_file_t& prev_addr, std::vector<BYTE>& data);
+	static bool DecodeRecord(const BYTE*& data, const BYTE* data_end, size_file_t& prev_addr, TEFileJournalRecord& record);
+
+	// Numbers by 7 bits per byte, they are used by the traces of the API as well
+	static void EncodeNumber(unsigned __int64 value, std::vector<BYTE>& data);
+	static bool DecodeNumber(const BYTE*& data, const BYTE* data_end, unsigned __int64& value);
+
+private:
+	static void EncodeDelta(size_file_t value, size_file_t base, std::vector<BYTE>& data);
+	static bool DecodeDelta(const BYTE*& data, const BYTE* data_end, size_file_t base, size_file_t& value);
+	static bool HasNextAddr(BYTE type);
+};
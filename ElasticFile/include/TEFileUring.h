@@ -0,0 +1,73 @@
+#pragma once
+#include <efile_types.h>
+
+#if defined(EF_IO_URING) && defined(__linux__)
+#include <sys/uio.h>
+
+// io_uring ring of a thread. All the runs of physically adjacent segments of a request are
+// submitted by one system call which also waits for their completion, so a fragmented
+// request takes one call instead of one per run. The ring is set up by the system calls
+// without liburing and is not shared between threads, so it needs no locks
+class TEFileUring
+{
+public:
+	~TEFileUring(void);
+
+	// The ring of the calling thread or NULL if the kernel doesn't support io_uring
+	static TEFileUring* Get();
+
+	// Returns the count of bytes transferred in the logical order until the first failed run
+	size_file_t Transfer(int file_descriptor, const TEFileIOSegments& segments, bool write);
+	// Count of io_uring_enter calls made by the last transfer
+	size_t GetSystemCalls() const;
+
+private:
+	TEFileUring();
+	TEFileUring(const TEFileUring&);
+	TEFileUring& operator=(const TEFileUring&);
+
+	bool Setup();
+	void Release();
+	// Submits the pending runs [first_run, first_run + runs_count) and waits for their completion
+	bool Submit(size_t first_run, size_t runs_count, bool write, int file_descriptor);
+
+	// Physically continuous part of a request
+	struct TRun
+	{
+		size_file_t Addr;
+		size_file_t Size;
+		size_t FirstVector;
+		size_t VectorsCount;
+		size_file_t Transferred;
+		long long Result; // Result of the last request of the run
+	};
+
+	// Moves the vectors of the run after the transferred bytes
+	void SkipVectors(TRun& run, size_t bytes);
+
+private:
+	int m_ring_fd;
+	void* m_sq_ring;
+	size_t m_sq_ring_size;
+	void* m_cq_ring;
+	size_t m_cq_ring_size;
+	void* m_sqes;
+	size_t m_sqes_size;
+
+	unsigned* m_sq_head;
+	unsigned* m_sq_tail;
+	unsigned* m_sq_mask;
+	unsigned* m_sq_array;
+	unsigned* m_cq_head;
+	unsigned* m_cq_tail;
+	unsigned* m_cq_mask;
+	void* m_cqes;
+	unsigned m_entries;
+	size_t m_system_calls;
+
+	std::vector<TRun> m_runs;
+	std::vector<struct iovec> m_vectors;
+	std::vector<size_t> m_pending_runs; // Runs which are not transferred completely yet
+};
+
+#endif
@@ -0,0 +1,24 @@
+#pragma once
+#include <efile_types.h>
+
+// Scatter/gather I/O of the file data. A request is described as a list of segments
+// (physical address, size, memory buffer) and is submitted to the backend at once: the
+// POSIX backend transfers every run of physically adjacent segments by one positional
+// preadv/pwritev call, so the count of system calls depends on the fragmentation and not
+// on the count of sectors.
+class TEFileVectorIO
+{
+public:
+	// Adds the physical range to the request, it is joined with the last segment if both are continuous
+	static void AddSegment(TEFileIOSegments& segments, size_file_t addr, size_file_t size, PBYTE buffer);
+
+	// Maps the physical range to the next bytes of the buffers. vector_index and offset_in_vector
+	// point to the first byte which is not mapped yet and are moved after the range
+	static void AddSegments(TEFileIOSegments& segments, size_file_t addr, size_file_t size, const TEFileIOVector* vectors, size_t& vector_index, size_file_t& offset_in_vector);
+
+	// Return the count of bytes transferred until the first error or the end of the file
+	static size_file_t Read(const TEFileHandle& file_handle, const TEFileIOSegments& segments);
+	static size_file_t Write(const TEFileHandle& file_handle, const TEFileIOSegments& segments);
+
+	static size_file_t GetSize(const TEFileIOVector* vectors, size_t count);
+};
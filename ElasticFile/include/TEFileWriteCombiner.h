@@ -0,0 +1,30 @@
+#pragma once
+#include <efile_types.h>
+
+// Buffer of the small inserts which follow each other at the advancing cursor. The data
+// is collected in memory and is inserted into the file by one call when the buffer is
+// full or before any other operation, so a stream of small writes costs one sector
+// allocation and one write per buffer instead of per call.
+class TEFileWriteCombiner
+{
+public:
+	TEFileWriteCombiner();
+	~TEFileWriteCombiner(void);
+
+	// The buffered data must be written before. A zero capacity disables the buffer
+	void SetCapacity(const size_file_t& capacity);
+	bool IsEnabled() const;
+
+	// Returns true if the data of the given size can be added to the buffer
+	bool Fits(const size_file_t& size) const;
+	void Append(const TEFileIOVector* vectors, const size_t& vectors_count);
+
+	bool Empty() const;
+	size_file_t GetSize() const;
+	PBYTE GetData();
+	void Clear();
+
+private:
+	std::vector<BYTE> m_buffer;
+	size_file_t m_capacity;
+};
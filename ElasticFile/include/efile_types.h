@@ -1,16 +1,53 @@
 #pragma once
-#include <list>
 #include <map>
+#include <memory>
+#include <mutex>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <set>
+#include <thread>
+#include <unordered_map>
 #include <vector>
 #include <iostream>
 #include <sstream>
-#include <windows.h>
+#include <string>
+#include <stdio.h>
+#include <string.h>
+
+// The types of windows.h which are used by the framework, declared the same way.
+// DWORD is 32-bit on every platform because it is a part of the format of the file
+typedef unsigned char BYTE;
+typedef BYTE* PBYTE;
+#ifdef _WIN32
+typedef unsigned long DWORD;
+#else
+typedef unsigned int DWORD;
+#endif
+
+#if !defined(_MSC_VER) && !defined(__int64)
+#define __int64 long long
+#endif
 
 #define LOG_ERROR
 //#define LOG_DEV
 //#define LOG_INFO
 
-typedef unsigned int size_file_t;
+// Linux: the data is transferred through io_uring, preadv/pwritev are used if the kernel doesn't support it
+//#define EF_IO_URING
+
+// Counters of the work on the hot paths (ElasticFileAPI::FileGetCounters), without it they are compiled out
+#define EF_COUNTERS
+
+// Latency histograms of the calls of ElasticFileAPI (ElasticFileAPI::GetLatencyHistogram), without it they are compiled out
+#define EF_LATENCY_HISTOGRAMS
+
+// Logical and physical offsets and sizes
+typedef unsigned __int64 size_file_t;
 
 struct TEFileSector
 {
@@ -21,16 +58,215 @@ struct TEFileSector
 	{
 	}
 
-	BYTE Free;
 	size_file_t SectorAddr; // Real file offset
-	size_file_t SectorSize; // Size of the sector in bytes
+	DWORD SectorSize : 30; // Size of the sector in bytes, not more than EF_MAX_SECTOR_SIZE
+	DWORD Free : 2; // EF_SECTOR_DATA, EF_SECTOR_FREE or EF_SECTOR_TABLE
 };
 
+// The state of a sector is kept in the high bits of its size
+#define EF_MAX_SECTOR_SIZE		0x3fffffff
+
+// Record of the sectors table in files of the first format
+struct TEFileLegacySector
+{
+	BYTE Free;
+	DWORD SectorAddr;
+	DWORD SectorSize;
+};
+
+// States of a sector
+#define EF_SECTOR_DATA			0
+#define EF_SECTOR_FREE			1
+#define EF_SECTOR_TABLE			2 // Keeps a snapshot or a journal chunk of the sectors table
+
+// Address which is not used by any sector
+#define EF_NO_SECTOR			((size_file_t)-1)
+
+// Sectors table on disk.
+// The footer is in the end of the file and points to the base snapshot and to the last journal chunk.
+// Every journal chunk points to the previous one. The snapshot and the chunks are kept in EF_SECTOR_TABLE sectors.
+// Sectors and journal records are encoded by TEFileTableCodec, their sizes vary
+#define EF_TABLE_MAGIC			0x32424645 // "EFB2"
+#define EF_JOURNAL_MAGIC		0x324a4645 // "EFJ2"
+#define EF_FOOTER_MAGIC			0x32544645 // "EFT2"
+
+// Compact the journal into a new snapshot when it has more records than sectors plus this count
+#define EF_JOURNAL_MIN_RECORDS	1024
+
+// The longest encoded sector and journal record
+#define EF_MAX_ENCODED_SECTOR	15
+#define EF_MAX_ENCODED_RECORD	31
+
+struct TEFileTableHeader
+{
+	DWORD Magic;
+	DWORD RecordsSize; // Bytes of the encoded sectors after the header
+	size_file_t SectorsCount;
+};
+
+struct TEFileJournalHeader
+{
+	DWORD Magic;
+	DWORD RecordsSize; // Bytes of the encoded records after the header
+	size_file_t PrevChunkAddr;
+	size_file_t RecordsCount;
+};
+
+struct TEFileTableFooter
+{
+	DWORD Magic;
+	DWORD Reserved;
+	size_file_t BaseAddr;
+	size_file_t LastChunkAddr;
+	size_file_t JournalRecords;
+};
+
+// Sectors table of files with 32-bit offsets: the same snapshot and journal of records of a fixed size.
+// Such a table is read and is written in the current format on the next write
+#define EF_TABLE_MAGIC32		0x54424645 // "EFBT"
+#define EF_JOURNAL_MAGIC32		0x4a524645 // "EFRJ"
+#define EF_FOOTER_MAGIC32		0x46544645 // "EFTF"
+#define EF_NO_SECTOR32			((DWORD)-1)
+
+struct TEFileSector32
+{
+	DWORD SectorAddr;
+	DWORD SectorSize : 30;
+	DWORD Free : 2;
+};
+
+struct TEFileTableHeader32
+{
+	DWORD Magic;
+	DWORD SectorsCount;
+};
+
+struct TEFileJournalHeader32
+{
+	DWORD Magic;
+	DWORD PrevChunkAddr;
+	DWORD RecordsCount;
+};
+
+struct TEFileTableFooter32
+{
+	DWORD Magic;
+	DWORD BaseAddr;
+	DWORD LastChunkAddr;
+	DWORD JournalRecords;
+};
+
+struct TEFileJournalRecord32
+{
+	BYTE Type;
+	BYTE State;
+	DWORD SectorAddr;
+	DWORD Size;
+	DWORD NextAddr;
+};
+
+enum TEFileJournalRecordType
+{
+	EF_JOURNAL_INSERT = 1,	// New sector with Size and State before NextAddr
+	EF_JOURNAL_SPLIT,		// Split the sector at the offset Size
+	EF_JOURNAL_UNITE,		// Unite the sector with the sector at NextAddr
+	EF_JOURNAL_FREE,		// Set State of the sector
+	EF_JOURNAL_MOVE,		// Move the sector before NextAddr
+	EF_JOURNAL_EXTEND,		// Extend the sector by Size
+	EF_JOURNAL_REMOVE		// Remove the sector
+};
+
+struct TEFileJournalRecord
+{
+	BYTE Type;
+	BYTE State;
+	size_file_t SectorAddr;
+	size_file_t Size;
+	size_file_t NextAddr;
+};
+
+typedef std::vector<TEFileJournalRecord> TEFileJournal;
+
 typedef std::shared_ptr<TEFileSector> TEFileSectorPtr;
 
 typedef size_file_t TEFileSectorsCount;
 
-typedef FILE* TEFileHandle;
+// Layer which keeps the bytes of a file (TEFileBackend)
+enum TEFileBackendType
+{
+	EF_BACKEND_STDIO,	// FILE* of the C runtime
+	EF_BACKEND_POSIX,	// Descriptor with pread/pwrite, preadv/pwritev and io_uring, not on Windows
+	EF_BACKEND_MMAP,	// Shared mapping of the whole file, not on Windows
+	EF_BACKEND_MEMORY	// Memory of the process, a file lives until it is removed (TEFileMemoryBackend::Remove)
+};
+
+#ifdef _WIN32
+#define EF_BACKEND_DEFAULT		EF_BACKEND_STDIO
+#else
+#define EF_BACKEND_DEFAULT		EF_BACKEND_POSIX
+#endif
+
+// The mapping of EF_BACKEND_MMAP grows by this count of bytes at least
+#define EF_MMAP_GROWTH			(1024 * 1024)
+
+class TEFileBackend;
+typedef std::shared_ptr<TEFileBackend> TEFileHandle;
+
+class TEFileCounters;
+typedef std::shared_ptr<TEFileCounters> TEFileCountersPtr;
+
+// Handle of a file opened through ElasticFileAPI: the generation of a slot of the handles
+// table in the high half and the index of the slot in the low half. The generation changes
+// when the file is closed, so an old handle never gets to a file opened later in the same slot
+typedef unsigned __int64 TEFileDescriptor;
+#define EF_NULL_DESCRIPTOR 0
+
+// Buffer of a vectored read or write
+struct TEFileIOVector
+{
+	PBYTE Buffer;
+	size_file_t Size;
+};
+
+// Continuous part of the data of a file in memory
+struct TEFileSpan
+{
+	const BYTE* Data;
+	size_file_t Size;
+};
+
+typedef std::vector<TEFileSpan> TEFileSpans;
+
+// Part of an I/O request which is continuous both in the file and in the memory
+struct TEFileIOSegment
+{
+	size_file_t Addr;
+	size_file_t Size;
+	PBYTE Buffer;
+};
+
+typedef std::vector<TEFileIOSegment> TEFileIOSegments;
+
+// Count of buffers passed to one preadv/pwritev call (IOV_MAX on Linux)
+#define EF_IO_MAX_VECTORS		1024
+// Entries of the submission queue of io_uring, a longer request is submitted in several batches
+#define EF_URING_ENTRIES		64
+
+enum TEFileEditType
+{
+	EF_EDIT_INSERT,	// Insert Size bytes from Buffer before the data at Position
+	EF_EDIT_DELETE	// Delete Size bytes from Position
+};
+
+// Operation of an edit batch. Positions of all the operations of a batch are positions
+// in the data before the batch, so the operations don't depend on each other
+struct TEFileEdit
+{
+	TEFileEditType Type;
+	size_file_t Position;
+	size_file_t Size;
+	PBYTE Buffer;
+};
 
 typedef DWORD TEFileOpenMode;
 #define EF_MODE_APPEND			0x000001
@@ -62,13 +298,100 @@ enum
 	EF_TRUNCATE_ON_APPEND,
 	EF_TRUNCATE_ERROR,
 	EF_CURSOR_ERROR,
+	EF_SPACE_PINNED,
 	EF_UNKNOWN_ERROR
 };
 
-typedef std::list<TEFileSector> TEFileSectorsList;
+#include <TEFileNodePool.h>
+#include <TEFileSectorsList.h>
+
 typedef std::vector<TEFileSectorsList::iterator> TEFileSectorsIterators;
 
-typedef std::map<size_file_t, TEFileSectorsList::iterator> TEFileSectorsMap;
+// Nodes of the containers of the sectors table are taken from the pool of the table
+typedef std::map<size_file_t, TEFileSectorsList::iterator, std::less<size_file_t>, TEFilePoolAllocator<std::pair<const size_file_t, TEFileSectorsList::iterator> > > TEFileSectorsMap;
+
+// Free sectors ordered by size and then by address
+typedef std::pair<size_file_t, size_file_t> TEFileFreeSectorSize;
+typedef std::set<TEFileFreeSectorSize, std::less<TEFileFreeSectorSize>, TEFilePoolAllocator<TEFileFreeSectorSize> > TEFileFreeSectorsSizes;
+
+enum TEFileAllocationPolicy
+{
+	EF_ALLOCATE_FILL_HOLES,	// Fill free sectors from the lowest address, the data can be split over several sectors
+	EF_ALLOCATE_BEST_FIT,	// The smallest free sector which fits the whole data, or a new sector in the end
+	EF_ALLOCATE_EXACT_FIT	// A free sector of exactly the same size, or a new sector in the end
+};
+
+enum TEFileReadOrder
+{
+	EF_READ_LOGICAL,	// Read the sectors of a request one by one in the logical order
+	EF_READ_PHYSICAL	// Read the sectors of a request in the order of their addresses
+};
+
+// Holes between the sectors of a read which are not bigger than this are read through by default
+#define EF_READ_GAP_TOLERANCE	(4 * 1024)
+
+enum TEFileCachePolicy
+{
+	EF_CACHE_NONE,	// Every read and write goes to the file
+	EF_CACHE_LRU,	// The least recently used block is evicted
+	EF_CACHE_CLOCK	// A block which has not been used since the last pass of the clock hand is evicted
+};
+
+enum TEFileCacheWriteMode
+{
+	EF_CACHE_WRITE_THROUGH,	// Writes go to the file at once, cached copies are updated
+	EF_CACHE_WRITE_BACK		// Writes stay in cached blocks until they are evicted or flushed
+};
+
+// Size of a block of the cache, blocks are aligned by it in the file
+#define EF_CACHE_BLOCK_SIZE		(4 * 1024)
+
+struct TEFileCacheStats
+{
+	TEFileCacheStats()
+		: Hits(0)
+		, Misses(0)
+		, Evictions(0)
+		, WriteBacks(0)
+	{
+	}
+
+	unsigned __int64 Hits;			// Blocks read from the cache
+	unsigned __int64 Misses;		// Blocks read from the file
+	unsigned __int64 Evictions;		// Blocks evicted to get space for others
+	unsigned __int64 WriteBacks;	// Dirty blocks written to the file
+};
+
+enum TEFileCounter
+{
+	EF_COUNTER_SYSCALLS,			// Calls of the I/O functions of the system or of the C library (seek, read, write, resize, sync, map)
+	EF_COUNTER_BYTES_READ,			// Bytes read from the file, the sectors table included
+	EF_COUNTER_BYTES_WRITTEN,		// Bytes written to the file, the sectors table included
+	EF_COUNTER_SECTORS_VISITED,		// Sectors passed to find a position or to get to the next data sector
+	EF_COUNTER_SPLITS,				// Sectors split in two
+	EF_COUNTER_UNITES,				// Neighbour sectors united
+	EF_COUNTER_ALLOCATIONS,			// Sectors allocated for new data or for the sectors table
+	EF_COUNTER_TABLE_BYTES_WRITTEN,	// Bytes of the snapshots, the journal chunks and the footers of the sectors table
+	EF_COUNTERS_COUNT
+};
+
+// Values of the counters at some moment, they only grow, so the work between two moments is the difference
+struct TEFileCountersSnapshot
+{
+	TEFileCountersSnapshot()
+	{
+		for(int counter = 0; counter < EF_COUNTERS_COUNT; counter++)
+			Values[counter] = 0;
+	}
+
+	unsigned __int64 Values[EF_COUNTERS_COUNT];
+};
+
+enum TEFileCompactMode
+{
+	EF_COMPACT_INCREMENTAL,	// Move not more than the given count of bytes per call
+	EF_COMPACT_FULL			// Compact the whole file at once
+};
 
 enum TEFileCursorMoveMode
 {
@@ -77,6 +400,146 @@ enum TEFileCursorMoveMode
 	EF_CURSOR_END
 };
 
+// Operations of ElasticFileAPI which are written to a trace (ElasticFileAPI::TraceStart)
+enum TEFileTraceOperation
+{
+	EF_TRACE_OPEN,
+	EF_TRACE_SET_CURSOR,
+	EF_TRACE_READ,
+	EF_TRACE_WRITE,
+	EF_TRACE_TRUNCATE,
+	EF_TRACE_CLOSE,
+	EF_TRACE_OPERATIONS_COUNT
+};
+
+// Call of an operation in a trace. Times are nanoseconds since the start of the trace
+struct TEFileTraceRecord
+{
+	TEFileTraceRecord()
+		: Operation(EF_TRACE_OPEN)
+		, Thread(0)
+		, Time(0)
+		, Duration(0)
+		, File(EF_NULL_DESCRIPTOR)
+		, Argument(0)
+		, Mode(0)
+		, Backend(EF_BACKEND_DEFAULT)
+		, Result(0)
+	{
+	}
+
+	TEFileTraceOperation Operation;
+	unsigned int Thread;		// Threads are numbered in the order of their first traced call
+	unsigned __int64 Time;
+	unsigned __int64 Duration;
+	TEFileDescriptor File;		// Descriptor returned by the open of the file in the traced process
+	size_file_t Argument;		// Offset of the cursor, size of the data or, for an open, the data size of the opened file
+	DWORD Mode;					// Open mode, cursor move mode or overwrite flag of a write
+	TEFileBackendType Backend;	// Only for an open
+	std::string FileName;		// Only for an open
+	unsigned __int64 Result;	// Returned descriptor, count of bytes or 1 for success
+};
+
+enum TEFileReplayTiming
+{
+	EF_REPLAY_FULL_SPEED,		// The next operation starts when the previous one returns
+	EF_REPLAY_ORIGINAL_TIMING	// Operations start at their times in the trace unless the previous ones are late
+};
+
+struct TEFileTraceReplayOptions
+{
+	TEFileTraceReplayOptions()
+		: Timing(EF_REPLAY_FULL_SPEED)
+		, NamePrefix("replay_")
+		, UseTracedBackend(true)
+		, Backend(EF_BACKEND_DEFAULT)
+	{
+	}
+
+	TEFileReplayTiming Timing;
+	std::string NamePrefix;		// Files are replayed in their directories under their names with the prefix, it can't be empty
+	bool UseTracedBackend;		// Otherwise all the files are opened with Backend
+	TEFileBackendType Backend;
+};
+
+struct TEFileTraceReplayStats
+{
+	TEFileTraceReplayStats()
+		: Operations(0)
+		, Divergences(0)
+		, Nanoseconds(0)
+	{
+		for(int operation = 0; operation < EF_TRACE_OPERATIONS_COUNT; operation++)
+		{
+			OperationsCount[operation] = 0;
+			OperationsNanoseconds[operation] = 0;
+			TracedNanoseconds[operation] = 0;
+		}
+	}
+
+	unsigned __int64 Operations;
+	unsigned __int64 Divergences;	// Operations whose result differs from the traced one
+	unsigned __int64 Nanoseconds;	// From the start to the end of the replay
+	unsigned __int64 OperationsCount[EF_TRACE_OPERATIONS_COUNT];
+	unsigned __int64 OperationsNanoseconds[EF_TRACE_OPERATIONS_COUNT];	// Time spent in the operations by the replay
+	unsigned __int64 TracedNanoseconds[EF_TRACE_OPERATIONS_COUNT];		// Time spent in them by the traced process
+};
+
+// Operations of ElasticFileAPI which have latency histograms. Calls with a cursor go to the same
+// operations as the calls without it
+enum TEFileOperation
+{
+	EF_OPERATION_OPEN,
+	EF_OPERATION_SET_CURSOR,
+	EF_OPERATION_GET_CURSOR,
+	EF_OPERATION_READ,
+	EF_OPERATION_WRITE,
+	EF_OPERATION_READV,
+	EF_OPERATION_WRITEV,
+	EF_OPERATION_READ_AT,
+	EF_OPERATION_WRITE_AT,
+	EF_OPERATION_CREATE_CURSOR,
+	EF_OPERATION_CREATE_SNAPSHOT,
+	EF_OPERATION_READ_SNAPSHOT,
+	EF_OPERATION_GET_VIEW,
+	EF_OPERATION_TRUNCATE,
+	EF_OPERATION_APPLY_EDITS,
+	EF_OPERATION_CLOSE,
+	EF_OPERATION_COMPACT,
+	EF_OPERATION_SYNC,
+	EF_OPERATION_PREALLOCATE,
+	EF_OPERATION_CONVERT,
+	EF_OPERATIONS_COUNT
+};
+
+// Latencies are nanoseconds in log-linear buckets: the values below EF_LATENCY_SUB_BUCKETS have
+// a bucket each, every next power of two is divided into EF_LATENCY_SUB_BUCKETS equal buckets,
+// so the error is not more than 1/EF_LATENCY_SUB_BUCKETS of the value. Values of
+// EF_LATENCY_MAX_BITS bits and more (about 18 minutes) go to the last bucket
+#define EF_LATENCY_SUB_BUCKET_BITS	4
+#define EF_LATENCY_SUB_BUCKETS		(1 << EF_LATENCY_SUB_BUCKET_BITS)
+#define EF_LATENCY_MAX_BITS			40
+#define EF_LATENCY_BUCKETS			((EF_LATENCY_MAX_BITS - EF_LATENCY_SUB_BUCKET_BITS + 1) * EF_LATENCY_SUB_BUCKETS)
+
+struct TEFileLatencyHistogram
+{
+	TEFileLatencyHistogram()
+		: Count(0)
+		, Sum(0)
+		, Min(0)
+		, Max(0)
+	{
+		for(int bucket = 0; bucket < EF_LATENCY_BUCKETS; bucket++)
+			Buckets[bucket] = 0;
+	}
+
+	unsigned __int64 Count;
+	unsigned __int64 Sum;	// Nanoseconds of all the calls
+	unsigned __int64 Min;	// Exact values, 0 if there are no calls
+	unsigned __int64 Max;
+	unsigned __int64 Buckets[EF_LATENCY_BUCKETS];
+};
+
 typedef std::pair<TEFileSectorsList::iterator, size_file_t> TUniteResult;
 	
 enum TUniteStatus
@@ -1,14 +1,20 @@
 #include <efile_types.h>
-#include <sys/stat.h>
-#include <sys/types.h>
 #include <ElasticFile.h>
 #include <TEFileException.h>
+#include <TEFileVectorIO.h>
+#include <TEFileBackend.h>
+#include <TEFileCounters.h>
+#include <TEFileSpans.h>
+
+#define EF_CLEAR_BLOCK_SIZE (64 * 1024)
 
 ElasticFile::ElasticFile()
-	: m_handle(0)
-	, m_modified(false)
+	: m_counters(new TEFileCounters())
+	, m_handle()
 	, m_cursor(*this)
 	, m_sectors_table(*this)
+	, m_generation(new size_t(0))
+	, m_modified(false)
 {
 }
 
@@ -43,6 +49,18 @@ void ElasticFile::SetModified()
 {
 	if(!m_modified)
 		m_modified = true;
+
+	(*m_generation)++;
+}
+
+const TEFileCountersPtr& ElasticFile::GetCounters()
+{
+	return m_counters;
+}
+
+void ElasticFile::GetCountersSnapshot(TEFileCountersSnapshot& snapshot) const
+{
+	m_counters->GetSnapshot(snapshot);
 }
 
 TEFileSectorsTable& ElasticFile::GetSectorsTable()
@@ -55,53 +73,47 @@ const TEFileOpenMode& ElasticFile::GetMode()
 	return m_mode;
 }
 
-TEFileHandle ElasticFile::Open(const std::string& file_name, const TEFileOpenMode& mode)
+TEFileHandle ElasticFile::Open(const std::string& file_name, const TEFileOpenMode& mode, const TEFileBackendType& backend)
 {
-	m_handle = InitLow(file_name, mode);
+	m_handle = InitLow(file_name, mode, backend);
 	Init(m_handle, mode);
 	return m_handle;
 }
 
-TEFileHandle ElasticFile::InitLow(const std::string& file_name, const TEFileOpenMode& mode)
+TEFileHandle ElasticFile::InitLow(const std::string& file_name, const TEFileOpenMode& mode, const TEFileBackendType& backend)
 {
-	std::string low_open_mode;
+	TEFileHandle file_handle = TEFileBackend::Create(backend);
+	file_handle->SetCounters(m_counters);
 
-	bool checked(false);
-	if(mode & EF_MODE_APPEND)
-	{
-		low_open_mode = "rb+";
-	}
+	// The file is created or truncated, otherwise it must exist
+	bool create(false);
 
+	bool checked(false);
 	if(mode & EF_MODE_CREATE)
 	{
-		low_open_mode = "wb+";
+		create = true;
 	}
 	else if(mode & EF_MODE_CREATENEW)
 	{
-		CheckFileExists(file_name);
-		low_open_mode = "wb+";
+		CheckFileExists(file_handle, file_name);
+		create = true;
 		checked = true;
 	}
-	else if(mode & EF_MODE_OPEN)
-	{
-		low_open_mode = "rb+";
-	}
 	else if(mode & EF_MODE_OPEN_OR_CREATE)
 	{
-		CheckFileExists(file_name);
-		low_open_mode = "rb+";
+		CheckFileExists(file_handle, file_name);
 		checked = true;
 	}
 
 	if(mode & EF_MODE_TRUNCATE)
 	{
 		if(!checked)
-			CheckFileExists(file_name);
+			CheckFileExists(file_handle, file_name);
 
-		low_open_mode = "wb+";
+		create = true;
 	}
 
-	return OpenLow(file_name, low_open_mode);
+	return OpenLow(file_handle, file_name, create);
 }
 
 void ElasticFile::Init(const TEFileHandle& file_handle, const TEFileOpenMode& mode)
@@ -121,11 +133,10 @@ void ElasticFile::Init(const TEFileHandle& file_handle, const TEFileOpenMode& mo
 	m_cursor.SetPosition(0, mode & EF_MODE_APPEND ? EF_CURSOR_END : EF_CURSOR_CURRENT);
 }
 
-TEFileHandle ElasticFile::OpenLow(const std::string& file_name, const std::string& low_mode)
+TEFileHandle ElasticFile::OpenLow(const TEFileHandle& file_handle, const std::string& file_name, bool create)
 {
-	TEFileHandle file_handle;
 	// Open the file
-	if(fopen_s(&file_handle, file_name.c_str(), low_mode.c_str()) != 0)
+	if(!file_handle->Open(file_name, create))
 	{
 		throw TEFileException(EF_OPEN_FILE_ERROR, STRING("Can't open file '" << file_name << "'"));
 	}
@@ -143,14 +154,45 @@ void ElasticFile::Close()
 
 int ElasticFile::close()
 {
+	if(!m_handle)
+		return 0;
+
+	bool flushed(true);
+
+	// The buffered inserts are the last changes of the data
+	if(!m_write_combiner.Empty())
+	{
+		try
+		{
+			FlushWrites();
+		}
+		catch(TEFileException&)
+		{
+			m_write_combiner.Clear();
+			flushed = false;
+		}
+	}
+
+	// The table is written past the cache
+	flushed = m_cache.Flush(m_handle) && flushed;
+	m_cache.Clear();
+
 	if(Modified())
 	{
 		m_sectors_table.Write();
 		m_modified = false;
 	}
 
+	// Views of the closed file are not valid, but their regions stay mapped until they are destroyed
+	(*m_generation)++;
+	m_mapping.Unmap();
+
 	m_sectors_table.Clear();
-	return fclose(m_handle);
+
+	bool closed = m_handle->Close();
+	m_handle.reset();
+
+	return closed && flushed ? 0 : EOF;
 }
 
 void ElasticFile::CheckHandle()
@@ -166,76 +208,153 @@ void ElasticFile::CheckHandle(const TEFileHandle& file_handle)
 	}
 }
 
-size_file_t ElasticFile::WriteOverwrite(const PBYTE buffer, const size_file_t& buffer_size)
+size_file_t ElasticFile::WriteOverwrite(TEFileCursor& cursor, const TEFileIOVector* vectors, size_t vectors_count, const size_file_t& buffer_size)
 {
-	DEVLOG( std::endl << "write overwrite '" << std::string((char*)buffer, buffer_size).c_str() << "' from position " << m_cursor.GetPosition() << std::endl);
+	DEVLOG( std::endl << "write overwrite " << buffer_size << " bytes from position " << cursor.GetPosition() << std::endl);
 
-	TEFileSectorsList::iterator sector_it = m_cursor.GetCurrentSector();
+	// The data may be read by snapshots, so it is replaced by new sectors
+	if(m_sectors_table.IsSpacePinned())
+		return WriteReplace(cursor, vectors, vectors_count, buffer_size);
+
+	TEFileSectorsList::iterator sector_it = cursor.GetCurrentSector();
 	TEFileSectorsList::iterator end_it = m_sectors_table.List().end();
 
-	// Overwrite existing data
-	size_file_t bytes_written(0);
-	for(; sector_it != end_it; ++sector_it)
+	// Map the existing data to the buffers
+	size_t vector_index(0);
+	size_file_t offset_in_vector(0);
+	size_file_t from = cursor.GetOffsetInSector();
+	size_file_t bytes_to_overwrite(0);
+
+	m_segments.clear();
+	for(; sector_it != end_it && bytes_to_overwrite != buffer_size; ++sector_it)
 	{
 		TEFileSector& sector(*sector_it);
 
 		if(sector.Free)
 			continue;
 
-		size_file_t from = m_cursor.GetOffsetInSector();
-		size_file_t bytes_to_write = min(buffer_size - bytes_written, sector.SectorSize - from);
+		size_file_t bytes_to_write = std::min<size_file_t>(buffer_size - bytes_to_overwrite, sector.SectorSize - from);
+		TEFileVectorIO::AddSegments(m_segments, sector.SectorAddr + from, bytes_to_write, vectors, vector_index, offset_in_vector);
 
-		bytes_written += WriteSector(sector_it, buffer + bytes_written, from, bytes_to_write);
+		bytes_to_overwrite += bytes_to_write;
+		from = 0;
+	}
 
-		if(bytes_written == buffer_size)
-			return bytes_written;
+	// Overwrite existing data
+	size_file_t bytes_written = WriteData(m_segments);
+
+	if(bytes_written > 0)
+		SetModified();
+
+	cursor.SetPosition(bytes_written, EF_CURSOR_CURRENT);
+
+	if(bytes_written != bytes_to_overwrite)
+	{
+		throw TEFileException(EF_WRITE_DATA_ERROR, STRING(bytes_written << " of " << buffer_size << " bytes have been written"), bytes_written);
 	}
 
 	// Write rest data to the end
 	size_file_t bytes_left = buffer_size - bytes_written;
-	if(bytes_left > 0 && m_cursor.GetPosition() == m_sectors_table.GetDataSize())
-		bytes_written += WriteInsert(buffer + bytes_written, bytes_left);
+	if(bytes_left > 0 && cursor.GetPosition() == m_sectors_table.GetDataSize())
+	{
+		std::vector<TEFileIOVector> rest_vectors(vectors + vector_index, vectors + vectors_count);
+		rest_vectors.front().Buffer += offset_in_vector;
+		rest_vectors.front().Size -= offset_in_vector;
+
+		bytes_written += WriteInsert(cursor, &rest_vectors[0], rest_vectors.size(), bytes_left);
+	}
+
+	return bytes_written;
+}
+
+size_file_t ElasticFile::WriteReplace(TEFileCursor& cursor, const TEFileIOVector* vectors, size_t vectors_count, const size_file_t& buffer_size)
+{
+	size_file_t position = cursor.GetPosition();
+	size_file_t bytes_to_replace = std::min<size_file_t>(buffer_size, m_sectors_table.GetDataSize() - position);
+
+	// The old data is after the inserted one
+	size_file_t bytes_written = WriteInsert(cursor, vectors, vectors_count, buffer_size);
+	DeleteData(position + bytes_written, bytes_to_replace);
 
 	return bytes_written;
 }
 
-size_file_t ElasticFile::WriteInsert(const PBYTE buffer, const size_file_t& bytes_count_to_write)
+void ElasticFile::DeleteData(size_file_t position, size_file_t size)
+{
+	std::pair<TEFileSectorsList::iterator, TEFileSectorsList::iterator> truncation_result;
+	TUniteResult unite_result;
+
+	for(size_file_t bytes_deleted = 0; bytes_deleted < size; )
+	{
+		size_file_t offset_in_sector;
+		TEFileSectorsList::iterator sector_it = m_sectors_table.GetSectorInPosition(position, offset_in_sector);
+
+		if(sector_it == m_sectors_table.List().end())
+		{
+			throw TEFileException(EF_TRUNCATE_ERROR, STRING("Can't find sector in position " << position));
+		}
+
+		size_file_t bytes_to_delete = std::min<size_file_t>(size - bytes_deleted, sector_it->SectorSize - offset_in_sector);
+		m_cache.Invalidate(sector_it->SectorAddr + offset_in_sector, bytes_to_delete);
+
+		truncation_result = m_sectors_table.TruncateSector(sector_it, offset_in_sector, bytes_to_delete);
+		m_sectors_table.CheckAndUniteSector(truncation_result.first, unite_result);
+
+		bytes_deleted += bytes_to_delete;
+	}
+
+	// The data around the deleted range can be united
+	if(size > 0)
+		m_sectors_table.CheckAndUniteSector(truncation_result.second, unite_result);
+
+	SetModified();
+}
+
+size_file_t ElasticFile::WriteInsert(TEFileCursor& cursor, const TEFileIOVector* vectors, size_t vectors_count, const size_file_t& bytes_count_to_write)
 {
-	DEVLOG(std::endl << "write insert '" << std::string((char*)buffer, bytes_count_to_write).c_str() << "' to position " << m_cursor.GetPosition() << std::endl);
+	DEVLOG(std::endl << "write insert " << bytes_count_to_write << " bytes to position " << cursor.GetPosition() << std::endl);
 
-	TEFileSectorsList::iterator current_sector_it = m_cursor.GetCurrentSector();
+	// All the ways below take the data from the vectors until the count of bytes is written
+	if(TEFileVectorIO::GetSize(vectors, vectors_count) < bytes_count_to_write)
+	{
+		throw TEFileException(EF_UNCORRECT_PARAMETER, STRING("The buffers are smaller than " << bytes_count_to_write << " bytes"));
+	}
+
+	TEFileSectorsList::iterator current_sector_it = cursor.GetCurrentSector();
 	TEFileSectorsList& sectors_list = m_sectors_table.List();
 
 	// If just need to write in the end and the virtual end equals the real end in the file. Just extend the end sector and write to extended space
-	if(m_cursor.GetOffsetInSector() == 0 && current_sector_it != sectors_list.begin() && !sectors_list.empty() && m_sectors_table.FreeSectors().empty())
+	if(cursor.GetOffsetInSector() == 0 && current_sector_it != sectors_list.begin() && !sectors_list.empty() && m_sectors_table.FreeSectors().empty())
 	{
 		// Cursor points to offset 0 of the next after extended sector now. So, go to the previous sector in order to extend it
 		--current_sector_it;
 
-		// If the sector is located in the end of the file
-		if(current_sector_it == m_sectors_table.Map().rbegin()->second)
+		// If the data sector is located in the end of the file
+		if(current_sector_it->Free == EF_SECTOR_DATA && current_sector_it == m_sectors_table.Map().rbegin()->second && bytes_count_to_write <= (size_file_t)EF_MAX_SECTOR_SIZE - current_sector_it->SectorSize)
 		{
-			size_file_t bytes_written = WriteSector(current_sector_it, buffer, current_sector_it->SectorSize, bytes_count_to_write);
+			size_file_t bytes_written = WriteSector(cursor, current_sector_it, vectors, current_sector_it->SectorSize, bytes_count_to_write);
 			return bytes_written;
 		}
 	}
 
 	// If only one sector needs to allocate (fast allocating without containers)
-	if(m_sectors_table.FreeSectors().empty())
+	if(m_sectors_table.FreeSectors().empty() && bytes_count_to_write <= EF_MAX_SECTOR_SIZE)
 	{
 		TEFileSectorsList::iterator new_sector_it = m_sectors_table.AllocateNewSector(bytes_count_to_write);
-		m_sectors_table.MoveSectorTo(new_sector_it, m_cursor.GetPosition());
+		m_sectors_table.MoveSectorTo(new_sector_it, cursor.GetPosition());
 
-		size_file_t bytes_written = WriteSector(new_sector_it, buffer, 0, bytes_count_to_write);
+		size_file_t bytes_written = WriteSector(cursor, new_sector_it, vectors, 0, bytes_count_to_write);
 
 		TUniteResult unite_result;
-		if(m_sectors_table.CheckAndUniteSector(new_sector_it, unite_result) == EF_UNITE_RIGHT)
-			m_cursor.Update(unite_result.first, unite_result.second);
+		if(m_sectors_table.CheckAndUniteSector(new_sector_it, unite_result) != EF_UNITE_NONE)
+			cursor.Refresh();
 
 		return bytes_written;
 	}
 
 	// If need to allocate more than one new sectors
+	TEFileSpanScope span("Insert sectors", bytes_count_to_write);
+
 	TEFileSectorsIterators allocated_sectors_iterators;
 	m_sectors_table.Allocate(bytes_count_to_write, allocated_sectors_iterators);
 
@@ -245,29 +364,51 @@ size_file_t ElasticFile::WriteInsert(const PBYTE buffer, const size_file_t& byte
 	}
 
 	// Move allocated sectors to the current position
-	m_sectors_table.MoveSectorsTo(allocated_sectors_iterators, m_cursor.GetPosition());
+	m_sectors_table.MoveSectorsTo(allocated_sectors_iterators, cursor.GetPosition());
 
-	size_file_t bytes_written(0);
 	TEFileSectorsList::iterator first_it = *allocated_sectors_iterators.begin();
 	TEFileSectorsList::iterator last_it = *std::prev(allocated_sectors_iterators.end());
+
+	// Write the data to all the allocated sectors at once
+	size_t vector_index(0);
+	size_file_t offset_in_vector(0);
+
+	m_segments.clear();
+	for(TEFileSectorsList::iterator sector_it = first_it; ; ++sector_it)
+	{
+		TEFileVectorIO::AddSegments(m_segments, sector_it->SectorAddr, sector_it->SectorSize, vectors, vector_index, offset_in_vector);
+
+		if(sector_it == last_it)
+			break;
+	}
+
+	size_file_t bytes_written = WriteData(m_segments);
+	if(bytes_written != bytes_count_to_write)
+	{
+		// The allocated sectors stay free, so nothing has been inserted
+		throw TEFileException(EF_WRITE_DATA_ERROR, STRING(bytes_written << " of " << bytes_count_to_write << " bytes have been written"), 0);
+	}
+
 	TEFileSectorsList::iterator sector_it = first_it;
-	do
+	while(true)
 	{
 		bool is_last = sector_it == last_it;
+		TEFileSectorsList::iterator next_sector_it = std::next(sector_it);
 
-		size_file_t bytes_to_write = sector_it->SectorSize;
-		bytes_written += WriteSector(sector_it, buffer + bytes_written, 0, bytes_to_write);
+		m_sectors_table.SetSectorFree(sector_it, 0);
 
+		// Only the last sector can be united with the right one, so the next allocated sector stays valid
 		TUniteResult unite_result;
-		if(m_sectors_table.CheckAndUniteSector(sector_it, unite_result) == EF_UNITE_RIGHT)
-			m_cursor.Update(unite_result.first, unite_result.second);
+		m_sectors_table.CheckAndUniteSector(sector_it, unite_result);
 
-		if(!is_last)
-			sector_it = m_cursor.GetCurrentSector(); // The next sector after WriteSector
-		else
+		if(is_last)
 			break;
+
+		sector_it = next_sector_it;
 	}
-	while(sector_it != sectors_list.end());
+
+	SetModified();
+	cursor.SetPosition(bytes_written, EF_CURSOR_CURRENT);
 
 	return bytes_written;
 }
@@ -276,16 +417,40 @@ TEFileSectorsList::iterator ElasticFile::Extend(const size_file_t& size_to_exten
 {
 	DEVLOG( "extend file to " << size_to_extend );
 
+	TEFileSpanScope span("Extend", size_to_extend);
+
 	TEFileSectorsIterators allocated_sectors_iterators;
 	m_sectors_table.Allocate(size_to_extend, allocated_sectors_iterators);
 	std::pair<TEFileSectorsList::iterator, TEFileSectorsList::iterator> moved_allocated_sectors_range = m_sectors_table.MoveSectorsBefore(allocated_sectors_iterators, m_sectors_table.List().end());
 
-	// Calculate size of trash to clear it
-	size_file_t size_to_clear = min(m_sectors_table.CalculateGarbageSize(), size_to_extend);
-	size_file_t size_cleared(0);
+	// The dirty blocks of the write-back cache may be after the end of the file on the disk
+	FlushCache();
+
+	size_file_t physical_size;
+	if(!m_handle->GetSize(physical_size))
+	{
+		throw TEFileException(EF_IO_ERROR, "Can't get the size of the file");
+	}
+
+	size_file_t new_physical_size = physical_size;
+
+	// Only the reused space contains garbage, the space after the end of the file is zeroed by the file system
+	for(TEFileSectorsList::iterator sector_it = moved_allocated_sectors_range.first; ; ++sector_it)
+	{
+		const TEFileSector& sector = *sector_it;
+
+		if(sector.SectorAddr < physical_size)
+			ClearSpace(sector.SectorAddr, std::min<size_file_t>((size_file_t)sector.SectorSize, physical_size - sector.SectorAddr));
+
+		new_physical_size = std::max<size_file_t>(new_physical_size, sector.SectorAddr + sector.SectorSize);
+
+		if(sector_it == moved_allocated_sectors_range.second)
+			break;
+	}
+
+	if(new_physical_size > physical_size && !m_sectors_table.ResizeFile(new_physical_size))
+		throw TEFileException(EF_IO_ERROR, STRING("Can't extend the file to " << new_physical_size << " bytes"));
 
-	// Value which will be filled with garbage
-	byte initial_value = 0;
 	TEFileSectorsList::iterator sector_it = moved_allocated_sectors_range.first;
 	do
 	{
@@ -294,36 +459,10 @@ TEFileSectorsList::iterator ElasticFile::Extend(const size_file_t& size_to_exten
 		// Mark a sector as free
 		m_sectors_table.SetSectorFree(sector_it, 0);
 
-		// Try to unite sectors
+		// Try to unite sectors. The cursor which extends the file is placed by itself
 		TUniteResult unite_result;
 		if(m_sectors_table.CheckAndUniteSector(sector_it, unite_result) != EF_UNITE_NONE)
-		{
 			sector_it = unite_result.first;
-			m_cursor.Update(sector_it, unite_result.second);
-		}
-
-		// Increase real file size
-		TEFileSector& sector = *sector_it;
-		size_file_t clear_left = size_to_clear - size_cleared;
-		if(clear_left == 0)
-		{
-			// Just write a single byte to the end of a sector for increase file by SectorSize and fill it with zero
-			_fseeki64(m_handle, sector.SectorAddr + sector.SectorSize-1, SEEK_SET);
-			fwrite(&initial_value, 1, 1, m_handle);
-			++sector_it;
-			continue;
-		}
-
-		// Clear garbage in free file space
-		size_file_t local_size_to_clear = sector.SectorSize;
-		if(local_size_to_clear > clear_left)
-			local_size_to_clear = clear_left;
-
-		_fseeki64(m_handle, sector.SectorAddr, SEEK_SET);
-		for(size_file_t virtual_cursor = 0; virtual_cursor != local_size_to_clear; ++virtual_cursor)
-			fwrite(&initial_value, 1, 1, m_handle);
-
-		size_cleared += local_size_to_clear;
 
 		if(last)
 			break;
@@ -331,13 +470,50 @@ TEFileSectorsList::iterator ElasticFile::Extend(const size_file_t& size_to_exten
 		++sector_it;
 	}
 	while(sector_it != m_sectors_table.List().end());
-	fflush(m_handle);
 
 	SetModified();
 
 	return sector_it;
 }
 
+void ElasticFile::ClearSpace(const size_file_t& addr, const size_file_t& size)
+{
+	static BYTE zeros[EF_CLEAR_BLOCK_SIZE] = {0};
+
+	// The whole blocks of the cache are zeroed by the file system and dropped from the cache,
+	// only the parts of the blocks on the edges are written
+	size_file_t zeroed_begin = (addr + EF_CACHE_BLOCK_SIZE - 1) / EF_CACHE_BLOCK_SIZE * EF_CACHE_BLOCK_SIZE;
+	size_file_t zeroed_end = (addr + size) / EF_CACHE_BLOCK_SIZE * EF_CACHE_BLOCK_SIZE;
+
+	if(zeroed_begin < zeroed_end && m_handle->ZeroRange(zeroed_begin, zeroed_end - zeroed_begin))
+		m_cache.Invalidate(zeroed_begin, zeroed_end - zeroed_begin);
+	else
+		zeroed_begin = zeroed_end = addr + size;
+
+	// All the blocks are written from the same buffer by one vectored call
+	m_segments.clear();
+	size_file_t bytes_to_write(0);
+	for(size_file_t block_addr = addr; block_addr < addr + size; )
+	{
+		if(block_addr == zeroed_begin)
+		{
+			block_addr = zeroed_end;
+			continue;
+		}
+
+		size_file_t block_end = std::min<size_file_t>(addr + size, block_addr + EF_CLEAR_BLOCK_SIZE);
+		if(block_addr < zeroed_begin)
+			block_end = std::min<size_file_t>(block_end, zeroed_begin);
+
+		TEFileVectorIO::AddSegment(m_segments, block_addr, block_end - block_addr, zeros);
+		bytes_to_write += block_end - block_addr;
+		block_addr = block_end;
+	}
+
+	if(WriteData(m_segments) != bytes_to_write)
+		throw TEFileException(EF_WRITE_DATA_ERROR, STRING("Can't clear " << size << " bytes at " << addr));
+}
+
 void ElasticFile::CheckSize(const size_file_t& size)
 {
 	if(size < 0)
@@ -349,65 +525,255 @@ void ElasticFile::CheckSize(const size_file_t& size)
 // Main interface
 size_file_t ElasticFile::Write(const PBYTE buffer, const size_file_t& size, bool overwrite)
 {
+	TEFileIOVector vector;
+	vector.Buffer = buffer;
+	vector.Size = size;
+
+	return Writev(&vector, 1, overwrite);
+}
+
+size_file_t ElasticFile::Writev(const TEFileIOVector* vectors, const size_t& vectors_count, bool overwrite)
+{
+	size_file_t size = TEFileVectorIO::GetSize(vectors, vectors_count);
+
 	CheckSize(size);
 	CheckHandle();
-	return overwrite ? WriteOverwrite(buffer, size) : WriteInsert(buffer, size);
+
+	if(size == 0)
+		return 0;
+
+	if(!overwrite && m_write_combiner.IsEnabled())
+		return WriteCombined(vectors, vectors_count, size);
+
+	FlushWrites();
+
+	return overwrite ? WriteOverwrite(m_cursor, vectors, vectors_count, size) : WriteInsert(m_cursor, vectors, vectors_count, size);
 }
 
 size_file_t ElasticFile::Read(PBYTE buffer, const size_file_t& size)
 {
+	TEFileIOVector vector;
+	vector.Buffer = buffer;
+	vector.Size = size;
+
+	return Readv(&vector, 1);
+}
+
+size_file_t ElasticFile::Readv(const TEFileIOVector* vectors, const size_t& vectors_count)
+{
+	return Readv(m_cursor, vectors, vectors_count);
+}
+
+size_file_t ElasticFile::Read(TEFileCursor& cursor, PBYTE buffer, const size_file_t& size)
+{
+	TEFileIOVector vector;
+	vector.Buffer = buffer;
+	vector.Size = size;
+
+	return Readv(cursor, &vector, 1);
+}
+
+size_file_t ElasticFile::Readv(TEFileCursor& cursor, const TEFileIOVector* vectors, const size_t& vectors_count)
+{
+	size_file_t size = TEFileVectorIO::GetSize(vectors, vectors_count);
+
 	CheckSize(size);
 	CheckHandle();
+	CheckCursor(cursor);
 
 	if (m_mode & EF_MODE_APPEND)
 	{
 		throw TEFileException(EF_READ_ON_APPEND, "Can't read in append mode");
 	}
 
-	TEFileSectorsList::iterator first_sector_it = m_cursor.GetCurrentSector();
+	FlushWrites();
+
 	TEFileSectorsList::iterator end_it = m_sectors_table.List().end();
 
-	TEFileSector sector;
-	size_file_t bytes_read(0);
-	for(TEFileSectorsList::iterator sector_it = first_sector_it; sector_it != end_it; ++sector_it)
+	// Map the data to the buffers. Only the first sector is read from the offset of the cursor
+	size_t vector_index(0);
+	size_file_t offset_in_vector(0);
+	size_file_t from = cursor.GetOffsetInSector();
+	size_file_t bytes_to_read(0);
+
+	m_segments.clear();
+	for(TEFileSectorsList::iterator sector_it = cursor.GetCurrentSector(); sector_it != end_it && bytes_to_read != size; ++sector_it)
 	{
 		TEFileSector& sector(*sector_it);
 
 		if(sector.Free)
 			continue;
 
-		// Use sector offset only at first sector because cursor moves only in the end of reading in order to faster read
-		if(sector_it == first_sector_it) 
-			_fseeki64(m_handle, sector.SectorAddr + m_cursor.GetOffsetInSector(), SEEK_SET);
-		else
-			_fseeki64(m_handle, sector.SectorAddr, SEEK_SET);
+		size_file_t local_bytes_to_read = std::min<size_file_t>(size - bytes_to_read, sector.SectorSize - from);
+		TEFileVectorIO::AddSegments(m_segments, sector.SectorAddr + from, local_bytes_to_read, vectors, vector_index, offset_in_vector);
 
-		// Read sector
-		size_file_t bytes_to_read = min(sector.SectorAddr + sector.SectorSize - ftell(m_handle), size - bytes_read);
-		size_file_t local_bytes_read = fread(buffer + bytes_read, sizeof(BYTE), bytes_to_read, m_handle);
-		bytes_read += local_bytes_read;
+		bytes_to_read += local_bytes_to_read;
+		from = 0;
+	}
 
-		if(local_bytes_read != bytes_to_read)
-		{
-			m_cursor.SetPosition(bytes_read, EF_CURSOR_CURRENT);
-			throw TEFileException(EF_READ_DATA_ERROR, STRING("Read " << bytes_read << " bytes of " << size), bytes_read);
-		}
+	size_file_t bytes_read = ReadData(m_segments);
+	cursor.SetPosition(bytes_read, EF_CURSOR_CURRENT);
 
-		if(bytes_read == size)
-			break;
+	if(bytes_read != bytes_to_read)
+	{
+		throw TEFileException(EF_READ_DATA_ERROR, STRING("Read " << bytes_read << " bytes of " << size), bytes_read);
 	}
 
 	if(bytes_read < size)
 	{
-		m_cursor.SetPosition(bytes_read, EF_CURSOR_CURRENT);
 		throw TEFileException(EF_READ_DATA_ERROR, STRING("Read " << bytes_read << " bytes of " << size << ". End of file reached"), bytes_read);
 	}
 
-	m_cursor.SetPosition(bytes_read, EF_CURSOR_CURRENT);
-
 	return bytes_read;
 }
 
+size_file_t ElasticFile::ReadAt(const size_file_t& position, PBYTE buffer, const size_file_t& size)
+{
+	// A cursor of its own, so the cursor of the file stays where it is
+	TEFileCursor cursor(*this);
+	cursor.Update(m_sectors_table.List().end(), 0, position);
+	cursor.Refresh();
+
+	return Read(cursor, buffer, size);
+}
+
+size_file_t ElasticFile::WriteAt(const size_file_t& position, const PBYTE buffer, const size_file_t& size, bool overwrite)
+{
+	CheckSize(position);
+	CheckSize(size);
+	CheckHandle();
+
+	if(size == 0)
+		return 0;
+
+	FlushWrites();
+
+	if((m_mode & EF_MODE_APPEND) && position < m_sectors_table.GetDataSize())
+	{
+		throw TEFileException(EF_SET_POSITION_ERROR, "Can't go back with append mode");
+	}
+
+	TEFileIOVector vector;
+	vector.Buffer = buffer;
+	vector.Size = size;
+
+	TEFileCursor cursor(*this);
+	cursor.SetPosition(position, EF_CURSOR_BEGIN);
+
+	return overwrite ? WriteOverwrite(cursor, &vector, 1, size) : WriteInsert(cursor, &vector, 1, size);
+}
+
+TEFileCursorPtr ElasticFile::CreateCursor()
+{
+	CheckHandle();
+
+	TEFileCursorPtr cursor(new TEFileCursor(*this));
+	cursor->Refresh();
+
+	return cursor;
+}
+
+void ElasticFile::SetPosition(TEFileCursor& cursor, const size_file_t& offset, const TEFileCursorMoveMode& mode)
+{
+	CheckSize(offset);
+	CheckCursor(cursor);
+	FlushWrites();
+	cursor.SetPosition(offset, mode);
+}
+
+TEFileSnapshotPtr ElasticFile::CreateSnapshot()
+{
+	CheckHandle();
+
+	if (m_mode & EF_MODE_APPEND)
+	{
+		throw TEFileException(EF_READ_ON_APPEND, "Can't read in append mode");
+	}
+
+	FlushWrites();
+
+	// The table is not changed, so the last snapshot is the same version
+	TEFileSnapshotPtr snapshot = m_snapshot.lock();
+	if(snapshot && snapshot->GetVersion() == m_sectors_table.GetChangesCount())
+		return snapshot;
+
+	// The snapshot reads the file past the cache and the buffers of the handle
+	FlushCache();
+	if(!m_handle->Flush())
+	{
+		throw TEFileException(EF_WRITE_DATA_ERROR, "Can't flush the data of the file");
+	}
+
+	TEFileHandle snapshot_handle = m_handle->CreateReader();
+	if(!snapshot_handle)
+	{
+		throw TEFileException(EF_OPEN_FILE_ERROR, "Can't open the file for a snapshot");
+	}
+
+	snapshot.reset(new TEFileSnapshot(snapshot_handle, m_sectors_table));
+	m_snapshot = snapshot;
+
+	return snapshot;
+}
+
+void ElasticFile::CheckCursor(TEFileCursor& cursor)
+{
+	if(&cursor.GetFile() != this)
+	{
+		throw TEFileException(EF_UNCORRECT_PARAMETER, "The cursor belongs to another file");
+	}
+}
+
+void ElasticFile::GetView(const size_file_t& position, const size_file_t& size, TEFileReadView& view)
+{
+	CheckSize(size);
+	CheckHandle();
+
+	if (m_mode & EF_MODE_APPEND)
+	{
+		throw TEFileException(EF_READ_ON_APPEND, "Can't read in append mode");
+	}
+
+	FlushWrites();
+
+	if(position > m_sectors_table.GetDataSize() || size > m_sectors_table.GetDataSize() - position)
+	{
+		throw TEFileException(EF_READ_DATA_ERROR, STRING("Can't view " << size << " bytes from " << position << ". End of file reached"));
+	}
+
+	// The mapping shows the file, so the data must be there and not in the buffers of the handle
+	FlushCache();
+	if(!m_handle->Flush())
+	{
+		throw TEFileException(EF_WRITE_DATA_ERROR, "Can't flush the data of the file");
+	}
+
+	view.m_spans.clear();
+	view.m_size = 0;
+	view.m_region = m_mapping.Map(m_handle, m_sectors_table.GetFileSize());
+	view.m_file_generation = m_generation;
+	view.m_generation = *m_generation;
+
+	TEFileSectorsList::iterator end_it = m_sectors_table.List().end();
+
+	size_file_t from;
+	for(TEFileSectorsList::iterator sector_it = m_sectors_table.GetSectorInPosition(position, from); sector_it != end_it && view.m_size != size; ++sector_it)
+	{
+		TEFileSector& sector(*sector_it);
+
+		if(sector.Free)
+			continue;
+
+		TEFileSpan span;
+		span.Data = view.m_region->GetData() + sector.SectorAddr + from;
+		span.Size = std::min<size_file_t>(size - view.m_size, sector.SectorSize - from);
+		view.m_spans.push_back(span);
+
+		view.m_size += span.Size;
+		from = 0;
+	}
+}
+
 size_file_t ElasticFile::Truncate(const size_file_t& cut_size)
 {
 	CheckSize(cut_size);
@@ -418,6 +784,8 @@ size_file_t ElasticFile::Truncate(const size_file_t& cut_size)
 		throw TEFileException(EF_TRUNCATE_ON_APPEND, "Can't truncate in append mode");
 	}
 
+	FlushWrites();
+
 	DEVLOG( std::endl << "truncate from " << m_cursor.GetPosition() << " by " << cut_size << std::endl );
 
 	TEFileSectorsList::iterator sector_it = m_cursor.GetCurrentSector();
@@ -435,7 +803,9 @@ size_file_t ElasticFile::Truncate(const size_file_t& cut_size)
 		}
 
 		// Truncate
-		size_file_t bytes_to_truncate = min(cut_size - bytes_truncated, sector.SectorSize - m_cursor.GetOffsetInSector());
+		size_file_t bytes_to_truncate = std::min<size_file_t>(cut_size - bytes_truncated, sector.SectorSize - m_cursor.GetOffsetInSector());
+		m_cache.Invalidate(sector.SectorAddr + m_cursor.GetOffsetInSector(), bytes_to_truncate);
+
 		std::pair<TEFileSectorsList::iterator, TEFileSectorsList::iterator> truncation_result;
 		truncation_result = m_sectors_table.TruncateSector(sector_it, m_cursor.GetOffsetInSector(), bytes_to_truncate);
 		bytes_truncated += bytes_to_truncate;
@@ -449,8 +819,8 @@ size_file_t ElasticFile::Truncate(const size_file_t& cut_size)
 		if(bytes_truncated == cut_size)	
 		{
 			// Check can we unite two sectors between which we have truncated data
-			if(m_sectors_table.CheckAndUniteSector(truncation_result.second, unite_result) != EF_UNITE_NONE)
-				m_cursor.Update(unite_result.first, unite_result.second);
+			m_sectors_table.CheckAndUniteSector(truncation_result.second, unite_result);
+			m_cursor.Refresh();
 			return bytes_truncated;
 		}
 
@@ -467,12 +837,22 @@ size_file_t ElasticFile::Truncate(const size_file_t& cut_size)
 	return bytes_truncated;
 }
 
-void ElasticFile::CheckFileExists(const std::string& file_name)
+void ElasticFile::ApplyEdits(const TEFileEdit* edits, const size_t& edits_count)
 {
-	struct _stat64 filestat;
-	int result = _stati64(file_name.c_str(), &filestat);
+	CheckHandle();
+	FlushWrites();
+
+	TEFileEditPlan edit_plan(*this);
+	edit_plan.Apply(edits, edits_count);
+
+	// The cursor keeps its position if it is still in the data
+	m_cursor.Update(m_sectors_table.List().end(), 0, std::min<size_file_t>(m_cursor.GetPosition(), m_sectors_table.GetDataSize()));
+	m_cursor.Refresh();
+}
 
-	if(result != 0)
+void ElasticFile::CheckFileExists(const TEFileHandle& file_handle, const std::string& file_name)
+{
+	if(!file_handle->Exists(file_name))
 	{
 		throw (TEFileException(EF_FILE_NOT_EXISTS, STRING("File " << file_name << " does not exists")));
 	}
@@ -481,27 +861,186 @@ void ElasticFile::CheckFileExists(const std::string& file_name)
 void ElasticFile::SetPosition(const size_file_t& offset, const TEFileCursorMoveMode& mode)
 {
 	CheckSize(offset);
+	FlushWrites();
 	m_cursor.SetPosition(offset, mode);
 }
 
-const size_file_t& ElasticFile::GetPosition()
+size_file_t ElasticFile::GetPosition()
 {
-	return m_cursor.GetPosition();
+	// The buffered data is already written for the caller
+	return m_cursor.GetPosition() + m_write_combiner.GetSize();
 }
 
-size_file_t ElasticFile::WriteSector(TEFileSectorsList::iterator sector_it, PBYTE buffer, const size_file_t& from, const size_file_t& size_to_write)
+size_file_t ElasticFile::GetDataSize()
+{
+	// The buffered inserts are counted like in the position
+	return m_sectors_table.GetDataSize() + m_write_combiner.GetSize();
+}
+
+void ElasticFile::SetAllocationPolicy(const TEFileAllocationPolicy& policy)
+{
+	m_sectors_table.SetAllocationPolicy(policy);
+}
+
+void ElasticFile::SetReadOrder(const TEFileReadOrder& order, const size_file_t& gap_tolerance)
+{
+	m_read_planner.SetOrder(order, gap_tolerance);
+}
+
+bool ElasticFile::Compact(const TEFileCompactMode& mode, const size_file_t& bytes_limit)
+{
+	CheckHandle();
+
+	// Every incremental call must be able to move some data
+	if(mode == EF_COMPACT_INCREMENTAL && bytes_limit == 0)
+		throw TEFileException(EF_UNCORRECT_PARAMETER, "The limit of the incremental compaction is 0");
+
+	FlushWrites();
+
+	// Nothing can be moved while the snapshots read it, and the compaction isn't completed either
+	if(m_sectors_table.IsSpacePinned())
+		throw TEFileException(EF_SPACE_PINNED, "Can't compact the file while its snapshots exist");
+
+	TEFileCompactor compactor(*this);
+	return compactor.Compact(mode, bytes_limit);
+}
+
+// Tables of the older formats are read as well, so the whole table is written again on close
+void ElasticFile::ConvertTable()
+{
+	CheckHandle();
+	m_sectors_table.Rewrite();
+	SetModified();
+}
+
+void ElasticFile::Sync()
+{
+	CheckHandle();
+
+	FlushWrites();
+	DropCache();
+
+	// The table on the disk must describe the synced data
+	if(Modified())
+	{
+		if(!m_sectors_table.Write())
+		{
+			throw TEFileException(EF_WRITE_DATA_ERROR, "Can't write the sectors table");
+		}
+
+		m_modified = false;
+	}
+
+	if(!m_handle->Sync())
+	{
+		throw TEFileException(EF_IO_ERROR, "Can't write the file to the disk");
+	}
+
+	// The table on the disk doesn't refer to the space freed by a compaction any more
+	m_sectors_table.EndRelocation();
+}
+
+void ElasticFile::Preallocate(const size_file_t& size)
+{
+	CheckHandle();
+
+	if(!m_handle->Preallocate(size))
+	{
+		throw TEFileException(EF_ALLOCATE_ERROR, STRING("Can't reserve " << size << " bytes for the file"));
+	}
+}
+
+void ElasticFile::SetCache(const TEFileCachePolicy& policy, const TEFileCacheWriteMode& write_mode, const size_file_t& budget)
+{
+	if(m_handle)
+		FlushCache();
+
+	m_cache.Configure(policy, write_mode, budget);
+}
+
+const TEFileCacheStats& ElasticFile::GetCacheStats() const
+{
+	return m_cache.GetStats();
+}
+
+size_file_t ElasticFile::ReadData(const TEFileIOSegments& segments)
+{
+	return m_cache.Read(m_handle, segments, m_read_planner);
+}
+
+size_file_t ElasticFile::WriteData(const TEFileIOSegments& segments)
+{
+	return m_cache.Write(m_handle, segments);
+}
+
+void ElasticFile::FlushCache()
+{
+	if(!m_cache.Flush(m_handle))
+		throw TEFileException(EF_WRITE_DATA_ERROR, "Can't write the cached data to the file");
+}
+
+void ElasticFile::DropCache()
+{
+	FlushCache();
+	m_cache.Clear();
+}
+
+void ElasticFile::SetWriteCombining(const size_file_t& buffer_size)
+{
+	if(m_handle)
+		FlushWrites();
+
+	m_write_combiner.SetCapacity(buffer_size);
+}
+
+size_file_t ElasticFile::WriteCombined(const TEFileIOVector* vectors, size_t vectors_count, const size_file_t& size)
+{
+	if(!m_write_combiner.Fits(size))
+		FlushWrites();
+
+	// A write which is bigger than the buffer goes to the file at once
+	if(!m_write_combiner.Fits(size))
+		return WriteInsert(m_cursor, vectors, vectors_count, size);
+
+	m_write_combiner.Append(vectors, vectors_count);
+	return size;
+}
+
+void ElasticFile::FlushWrites()
+{
+	if(m_write_combiner.Empty())
+		return;
+
+	TEFileIOVector vector;
+	vector.Buffer = m_write_combiner.GetData();
+	vector.Size = m_write_combiner.GetSize();
+
+	size_file_t bytes_written = WriteInsert(m_cursor, &vector, 1, vector.Size);
+	m_write_combiner.Clear();
+
+	if(bytes_written != vector.Size)
+	{
+		throw TEFileException(EF_WRITE_DATA_ERROR, STRING(bytes_written << " of " << vector.Size << " buffered bytes have been written"), bytes_written);
+	}
+}
+
+size_file_t ElasticFile::WriteSector(TEFileCursor& cursor, TEFileSectorsList::iterator sector_it, const TEFileIOVector* vectors, const size_file_t& from, const size_file_t& size_to_write)
 {
 	TEFileSector& sector = *sector_it;
 
-	_fseeki64(m_handle, sector.SectorAddr + from, SEEK_SET);
-	size_file_t bytes_written = fwrite(buffer, sizeof(BYTE), size_to_write, m_handle);
+	size_t vector_index(0);
+	size_file_t offset_in_vector(0);
+
+	m_segments.clear();
+	TEFileVectorIO::AddSegments(m_segments, sector.SectorAddr + from, size_to_write, vectors, vector_index, offset_in_vector);
+	size_file_t bytes_written = WriteData(m_segments);
 
 	m_sectors_table.SetSectorFree(sector_it, 0);
 
 	if(from + size_to_write > sector.SectorSize)
 		m_sectors_table.ExtendSector(sector_it, bytes_written);
 
-	m_cursor.Update(std::next(sector_it), 0, m_cursor.GetPosition() + bytes_written);
+	cursor.Update(std::next(sector_it), 0, cursor.GetPosition() + bytes_written);
 
 	SetModified();
 
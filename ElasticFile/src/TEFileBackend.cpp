@@ -0,0 +1,121 @@
+#include <TEFileBackend.h>
+#include <TEFileException.h>
+#include <TEFileMapping.h>
+#include <TEFileStdioBackend.h>
+#include <TEFilePosixBackend.h>
+#include <TEFileMmapBackend.h>
+#include <TEFileMemoryBackend.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#if defined(__linux__)
+#include <fcntl.h>
+#endif
+
+TEFileBackend::TEFileBackend(void)
+{
+}
+
+TEFileBackend::~TEFileBackend(void)
+{
+}
+
+TEFileHandle TEFileBackend::Create(const TEFileBackendType& type)
+{
+	switch(type)
+	{
+	case EF_BACKEND_STDIO:
+		return TEFileHandle(new TEFileStdioBackend());
+
+#ifndef _WIN32
+	case EF_BACKEND_POSIX:
+		return TEFileHandle(new TEFilePosixBackend());
+
+	case EF_BACKEND_MMAP:
+		return TEFileHandle(new TEFileMmapBackend());
+#endif
+
+	case EF_BACKEND_MEMORY:
+		return TEFileHandle(new TEFileMemoryBackend());
+
+	default:
+		break;
+	}
+
+	throw TEFileException(EF_UNCORRECT_PARAMETER, STRING("Backend " << type << " is not supported on this platform"));
+}
+
+size_file_t TEFileBackend::Read(const TEFileIOSegments& segments)
+{
+	return Transfer(segments, false);
+}
+
+size_file_t TEFileBackend::Write(const TEFileIOSegments& segments)
+{
+	return Transfer(segments, true);
+}
+
+size_file_t TEFileBackend::Transfer(const TEFileIOSegments& segments, bool write)
+{
+	size_file_t bytes_transferred(0);
+
+	for(TEFileIOSegments::const_iterator segment_it = segments.begin(); segment_it != segments.end(); ++segment_it)
+	{
+		size_file_t bytes = write ? WriteAt(segment_it->Addr, segment_it->Buffer, segment_it->Size) : ReadAt(segment_it->Addr, segment_it->Buffer, segment_it->Size);
+		bytes_transferred += bytes;
+
+		if(bytes != segment_it->Size)
+			break;
+	}
+
+	return bytes_transferred;
+}
+
+void TEFileBackend::SetCounters(const TEFileCountersPtr& counters)
+{
+	m_counters = counters;
+}
+
+TEFileMappedRegionPtr TEFileBackend::Map(size_file_t size)
+{
+	// Everything written through the buffers of the backend must be visible in the mapping
+	if(!Flush())
+	{
+		throw TEFileException(EF_IO_ERROR, "Can't flush the file before mapping");
+	}
+
+	EF_COUNT(m_counters, EF_COUNTER_SYSCALLS, 1);
+	return TEFileMappedRegionPtr(new TEFileMappedRegion(GetDescriptor(), size));
+}
+
+bool TEFileBackend::ZeroRange(size_file_t, size_file_t)
+{
+	// The caller writes the zeros itself
+	return false;
+}
+
+int TEFileBackend::GetDescriptor()
+{
+	return -1;
+}
+
+bool TEFileBackend::FileExists(const std::string& file_name)
+{
+#ifdef _WIN32
+	struct _stat64 file_stat;
+	return _stati64(file_name.c_str(), &file_stat) == 0;
+#else
+	struct stat file_stat;
+	return stat(file_name.c_str(), &file_stat) == 0;
+#endif
+}
+
+bool TEFileBackend::PreallocateDescriptor(int file_descriptor, size_file_t size)
+{
+#if defined(__linux__)
+	// The size of the file stays the same, only the blocks are reserved
+	return fallocate(file_descriptor, FALLOC_FL_KEEP_SIZE, 0, size) == 0;
+#else
+	// Nothing is reserved where the file system has no such call
+	return file_descriptor >= 0;
+#endif
+}
@@ -0,0 +1,456 @@
+#include <TEFileBlockCache.h>
+#include <TEFileReadPlanner.h>
+#include <TEFileVectorIO.h>
+#include <TEFileException.h>
+
+#define EF_CACHE_NO_FRAME ((size_t)-1)
+
+TEFileBlockCache::TEFileBlockCache()
+	: m_policy(EF_CACHE_NONE)
+	, m_write_mode(EF_CACHE_WRITE_THROUGH)
+	, m_lru_head(EF_CACHE_NO_FRAME)
+	, m_lru_tail(EF_CACHE_NO_FRAME)
+	, m_clock_hand(0)
+{
+}
+
+TEFileBlockCache::~TEFileBlockCache(void)
+{
+}
+
+void TEFileBlockCache::Configure(const TEFileCachePolicy& policy, const TEFileCacheWriteMode& write_mode, const size_file_t& budget)
+{
+	size_t frames_count = policy == EF_CACHE_NONE ? 0 : budget / EF_CACHE_BLOCK_SIZE;
+
+	m_policy = frames_count > 0 ? policy : EF_CACHE_NONE;
+	m_write_mode = write_mode;
+
+	m_frames.resize(frames_count);
+	m_data.resize(frames_count * EF_CACHE_BLOCK_SIZE);
+	Clear();
+}
+
+bool TEFileBlockCache::IsEnabled() const
+{
+	return m_policy != EF_CACHE_NONE;
+}
+
+size_file_t TEFileBlockCache::Read(const TEFileHandle& file_handle, const TEFileIOSegments& segments, TEFileReadPlanner& read_planner)
+{
+	if(!IsEnabled())
+		return read_planner.Read(file_handle, segments);
+
+	m_failed_segments.assign(segments.size(), false);
+	m_pieces.clear();
+	m_direct_pieces.clear();
+
+	// Cached blocks are copied at once, the others are collected
+	for(size_t segment_index = 0; segment_index < segments.size(); ++segment_index)
+	{
+		const TEFileIOSegment& segment = segments[segment_index];
+
+		for(size_file_t bytes_done = 0; bytes_done < segment.Size; )
+		{
+			TPiece piece;
+			piece.Block = (segment.Addr + bytes_done) / EF_CACHE_BLOCK_SIZE;
+			piece.Offset = (segment.Addr + bytes_done) % EF_CACHE_BLOCK_SIZE;
+			piece.Size = std::min<size_file_t>(EF_CACHE_BLOCK_SIZE - piece.Offset, segment.Size - bytes_done);
+			piece.Buffer = segment.Buffer + bytes_done;
+			piece.Segment = segment_index;
+
+			size_t frame = FindFrame(piece.Block);
+			if(frame != EF_CACHE_NO_FRAME)
+			{
+				memcpy(piece.Buffer, FrameData(frame) + piece.Offset, piece.Size);
+				Touch(frame);
+				m_stats.Hits++;
+			}
+			else
+			{
+				m_pieces.push_back(piece);
+				m_stats.Misses++;
+			}
+
+			bytes_done += piece.Size;
+		}
+	}
+
+	// Missing blocks are read by batches which fit into the cache
+	for(size_t piece_index = 0; piece_index < m_pieces.size(); )
+	{
+		m_batch_frames.clear();
+		m_segments.clear();
+
+		size_t batch_end = piece_index;
+		for(; batch_end < m_pieces.size(); ++batch_end)
+		{
+			if(FindFrame(m_pieces[batch_end].Block) != EF_CACHE_NO_FRAME)
+				continue;
+
+			size_t frame = AllocateFrame(file_handle, m_pieces[batch_end].Block);
+			if(frame == EF_CACHE_NO_FRAME)
+				break;
+
+			m_frames[frame].Pinned = true;
+			m_batch_frames.push_back(frame);
+			TEFileVectorIO::AddSegment(m_segments, m_frames[frame].Block * EF_CACHE_BLOCK_SIZE, EF_CACHE_BLOCK_SIZE, FrameData(frame));
+		}
+
+		// Blocks which are read partially are not cached
+		size_file_t blocks_read = read_planner.Read(file_handle, m_segments) / EF_CACHE_BLOCK_SIZE;
+		for(size_t batch_index = 0; batch_index < m_batch_frames.size(); ++batch_index)
+		{
+			m_frames[m_batch_frames[batch_index]].Pinned = false;
+
+			if(batch_index >= blocks_read)
+				DropFrame(m_batch_frames[batch_index]);
+		}
+
+		for(; piece_index < batch_end; ++piece_index)
+		{
+			const TPiece& piece = m_pieces[piece_index];
+
+			size_t frame = FindFrame(piece.Block);
+			if(frame != EF_CACHE_NO_FRAME)
+				memcpy(piece.Buffer, FrameData(frame) + piece.Offset, piece.Size);
+			else
+				m_direct_pieces.push_back(piece);
+		}
+	}
+
+	TransferDirect(file_handle, false);
+
+	return GetTransferredSize(segments);
+}
+
+size_file_t TEFileBlockCache::Write(const TEFileHandle& file_handle, const TEFileIOSegments& segments)
+{
+	if(!IsEnabled())
+		return TEFileVectorIO::Write(file_handle, segments);
+
+	m_failed_segments.assign(segments.size(), false);
+	m_direct_pieces.clear();
+
+	for(size_t segment_index = 0; segment_index < segments.size(); ++segment_index)
+	{
+		const TEFileIOSegment& segment = segments[segment_index];
+
+		for(size_file_t bytes_done = 0; bytes_done < segment.Size; )
+		{
+			TPiece piece;
+			piece.Block = (segment.Addr + bytes_done) / EF_CACHE_BLOCK_SIZE;
+			piece.Offset = (segment.Addr + bytes_done) % EF_CACHE_BLOCK_SIZE;
+			piece.Size = std::min<size_file_t>(EF_CACHE_BLOCK_SIZE - piece.Offset, segment.Size - bytes_done);
+			piece.Buffer = segment.Buffer + bytes_done;
+			piece.Segment = segment_index;
+
+			bytes_done += piece.Size;
+
+			if(m_write_mode == EF_CACHE_WRITE_THROUGH)
+			{
+				m_direct_pieces.push_back(piece);
+				continue;
+			}
+
+			// A whole block doesn't need to be read before it is cached
+			size_t frame = FindFrame(piece.Block);
+			if(frame == EF_CACHE_NO_FRAME && piece.Size == EF_CACHE_BLOCK_SIZE)
+				frame = AllocateFrame(file_handle, piece.Block);
+
+			if(frame == EF_CACHE_NO_FRAME)
+			{
+				m_direct_pieces.push_back(piece);
+				continue;
+			}
+
+			memcpy(FrameData(frame) + piece.Offset, piece.Buffer, piece.Size);
+			m_frames[frame].Dirty = true;
+			Touch(frame);
+		}
+	}
+
+	TransferDirect(file_handle, true);
+
+	return GetTransferredSize(segments);
+}
+
+bool TEFileBlockCache::Flush(const TEFileHandle& file_handle)
+{
+	if(!IsEnabled())
+		return true;
+
+	m_batch_frames.clear();
+	for(TFramesIndex::iterator index_it = m_index.begin(); index_it != m_index.end(); ++index_it)
+	{
+		if(m_frames[index_it->second].Dirty)
+			m_batch_frames.push_back(index_it->second);
+	}
+
+	if(m_batch_frames.empty())
+		return true;
+
+	// Write the blocks in the order of addresses, so neighbour blocks are joined
+	std::vector<std::pair<size_file_t, size_t> > dirty_blocks;
+	dirty_blocks.reserve(m_batch_frames.size());
+	for(std::vector<size_t>::iterator frame_it = m_batch_frames.begin(); frame_it != m_batch_frames.end(); ++frame_it)
+		dirty_blocks.push_back(std::make_pair(m_frames[*frame_it].Block, *frame_it));
+
+	std::sort(dirty_blocks.begin(), dirty_blocks.end());
+
+	m_segments.clear();
+	for(size_t block_index = 0; block_index < dirty_blocks.size(); ++block_index)
+		TEFileVectorIO::AddSegment(m_segments, dirty_blocks[block_index].first * EF_CACHE_BLOCK_SIZE, EF_CACHE_BLOCK_SIZE, FrameData(dirty_blocks[block_index].second));
+
+	size_file_t blocks_written = TEFileVectorIO::Write(file_handle, m_segments) / EF_CACHE_BLOCK_SIZE;
+	for(size_t block_index = 0; block_index < blocks_written; ++block_index)
+		m_frames[dirty_blocks[block_index].second].Dirty = false;
+
+	m_stats.WriteBacks += blocks_written;
+
+	return blocks_written == dirty_blocks.size();
+}
+
+void TEFileBlockCache::Invalidate(size_file_t addr, size_file_t size)
+{
+	if(!IsEnabled())
+		return;
+
+	size_file_t first_block = (addr + EF_CACHE_BLOCK_SIZE - 1) / EF_CACHE_BLOCK_SIZE;
+	size_file_t end_block = (addr + size) / EF_CACHE_BLOCK_SIZE;
+
+	if(first_block >= end_block)
+		return;
+
+	// A big range is checked by the cached blocks, not by its own ones
+	if(end_block - first_block > m_index.size())
+	{
+		m_batch_frames.clear();
+		for(TFramesIndex::iterator index_it = m_index.begin(); index_it != m_index.end(); ++index_it)
+		{
+			if(index_it->first >= first_block && index_it->first < end_block)
+				m_batch_frames.push_back(index_it->second);
+		}
+
+		for(std::vector<size_t>::iterator frame_it = m_batch_frames.begin(); frame_it != m_batch_frames.end(); ++frame_it)
+			DropFrame(*frame_it);
+
+		return;
+	}
+
+	for(size_file_t block = first_block; block < end_block; ++block)
+	{
+		size_t frame = FindFrame(block);
+		if(frame != EF_CACHE_NO_FRAME)
+			DropFrame(frame);
+	}
+}
+
+void TEFileBlockCache::Clear()
+{
+	m_index.clear();
+	m_free_frames.clear();
+
+	for(size_t frame = m_frames.size(); frame > 0; --frame)
+	{
+		m_frames[frame - 1].Dirty = false;
+		m_frames[frame - 1].Pinned = false;
+		m_free_frames.push_back(frame - 1);
+	}
+
+	m_lru_head = EF_CACHE_NO_FRAME;
+	m_lru_tail = EF_CACHE_NO_FRAME;
+	m_clock_hand = 0;
+}
+
+const TEFileCacheStats& TEFileBlockCache::GetStats() const
+{
+	return m_stats;
+}
+
+size_t TEFileBlockCache::FindFrame(size_file_t block) const
+{
+	TFramesIndex::const_iterator index_it = m_index.find(block);
+	return index_it == m_index.end() ? EF_CACHE_NO_FRAME : index_it->second;
+}
+
+size_t TEFileBlockCache::AllocateFrame(const TEFileHandle& file_handle, size_file_t block)
+{
+	size_t frame;
+
+	if(!m_free_frames.empty())
+	{
+		frame = m_free_frames.back();
+		m_free_frames.pop_back();
+	}
+	else
+	{
+		frame = ChooseVictim();
+		if(frame == EF_CACHE_NO_FRAME)
+			return EF_CACHE_NO_FRAME;
+
+		if(m_frames[frame].Dirty)
+		{
+			TEFileIOSegments segments;
+			TEFileVectorIO::AddSegment(segments, m_frames[frame].Block * EF_CACHE_BLOCK_SIZE, EF_CACHE_BLOCK_SIZE, FrameData(frame));
+
+			if(TEFileVectorIO::Write(file_handle, segments) != EF_CACHE_BLOCK_SIZE)
+			{
+				throw TEFileException(EF_WRITE_DATA_ERROR, STRING("Can't write back the cached block " << m_frames[frame].Block));
+			}
+
+			m_stats.WriteBacks++;
+		}
+
+		DropFrame(frame);
+		m_free_frames.pop_back();
+		m_stats.Evictions++;
+	}
+
+	TFrame& new_frame = m_frames[frame];
+	new_frame.Block = block;
+	new_frame.Dirty = false;
+	new_frame.Referenced = true;
+	new_frame.Pinned = false;
+
+	m_index[block] = frame;
+	Link(frame);
+
+	return frame;
+}
+
+size_t TEFileBlockCache::ChooseVictim()
+{
+	if(m_policy == EF_CACHE_LRU)
+	{
+		for(size_t frame = m_lru_tail; frame != EF_CACHE_NO_FRAME; frame = m_frames[frame].Prev)
+		{
+			if(!m_frames[frame].Pinned)
+				return frame;
+		}
+
+		return EF_CACHE_NO_FRAME;
+	}
+
+	// Every frame gets a second chance, so two turns of the hand are enough
+	for(size_t step = 0; step < 2 * m_frames.size(); ++step)
+	{
+		size_t frame = m_clock_hand;
+		m_clock_hand = (m_clock_hand + 1) % m_frames.size();
+
+		if(m_frames[frame].Pinned)
+			continue;
+
+		if(m_frames[frame].Referenced)
+		{
+			m_frames[frame].Referenced = false;
+			continue;
+		}
+
+		return frame;
+	}
+
+	return EF_CACHE_NO_FRAME;
+}
+
+void TEFileBlockCache::DropFrame(size_t frame)
+{
+	m_index.erase(m_frames[frame].Block);
+	Unlink(frame);
+
+	m_frames[frame].Dirty = false;
+	m_frames[frame].Pinned = false;
+	m_free_frames.push_back(frame);
+}
+
+void TEFileBlockCache::Touch(size_t frame)
+{
+	if(m_policy == EF_CACHE_LRU)
+	{
+		Unlink(frame);
+		Link(frame);
+	}
+	else
+	{
+		m_frames[frame].Referenced = true;
+	}
+}
+
+void TEFileBlockCache::Link(size_t frame)
+{
+	if(m_policy != EF_CACHE_LRU)
+		return;
+
+	m_frames[frame].Prev = EF_CACHE_NO_FRAME;
+	m_frames[frame].Next = m_lru_head;
+
+	if(m_lru_head != EF_CACHE_NO_FRAME)
+		m_frames[m_lru_head].Prev = frame;
+	else
+		m_lru_tail = frame;
+
+	m_lru_head = frame;
+}
+
+void TEFileBlockCache::Unlink(size_t frame)
+{
+	if(m_policy != EF_CACHE_LRU)
+		return;
+
+	TFrame& unlinked_frame = m_frames[frame];
+
+	if(unlinked_frame.Prev != EF_CACHE_NO_FRAME)
+		m_frames[unlinked_frame.Prev].Next = unlinked_frame.Next;
+	else
+		m_lru_head = unlinked_frame.Next;
+
+	if(unlinked_frame.Next != EF_CACHE_NO_FRAME)
+		m_frames[unlinked_frame.Next].Prev = unlinked_frame.Prev;
+	else
+		m_lru_tail = unlinked_frame.Prev;
+}
+
+BYTE* TEFileBlockCache::FrameData(size_t frame)
+{
+	return &m_data[frame * EF_CACHE_BLOCK_SIZE];
+}
+
+void TEFileBlockCache::TransferDirect(const TEFileHandle& file_handle, bool write)
+{
+	if(m_direct_pieces.empty())
+		return;
+
+	m_segments.clear();
+	for(std::vector<TPiece>::iterator piece_it = m_direct_pieces.begin(); piece_it != m_direct_pieces.end(); ++piece_it)
+		TEFileVectorIO::AddSegment(m_segments, piece_it->Block * EF_CACHE_BLOCK_SIZE + piece_it->Offset, piece_it->Size, piece_it->Buffer);
+
+	size_file_t bytes_transferred = write ? TEFileVectorIO::Write(file_handle, m_segments) : TEFileVectorIO::Read(file_handle, m_segments);
+
+	for(std::vector<TPiece>::iterator piece_it = m_direct_pieces.begin(); piece_it != m_direct_pieces.end(); ++piece_it)
+	{
+		if(bytes_transferred < piece_it->Size)
+		{
+			m_failed_segments[piece_it->Segment] = true;
+			bytes_transferred = 0;
+			continue;
+		}
+
+		bytes_transferred -= piece_it->Size;
+
+		// Cached copies of the written data are updated
+		if(write)
+		{
+			size_t frame = FindFrame(piece_it->Block);
+			if(frame != EF_CACHE_NO_FRAME)
+				memcpy(FrameData(frame) + piece_it->Offset, piece_it->Buffer, piece_it->Size);
+		}
+	}
+}
+
+size_file_t TEFileBlockCache::GetTransferredSize(const TEFileIOSegments& segments)
+{
+	size_file_t bytes_transferred(0);
+	for(size_t segment_index = 0; segment_index < segments.size() && !m_failed_segments[segment_index]; ++segment_index)
+		bytes_transferred += segments[segment_index].Size;
+
+	return bytes_transferred;
+}
@@ -0,0 +1,178 @@
+#include <TEFileCompactor.h>
+#include <TEFileException.h>
+#include <ElasticFile.h>
+#include <TEFileVectorIO.h>
+
+#define EF_COMPACT_BUFFER_SIZE (64 * 1024)
+
+TEFileCompactor::TEFileCompactor(ElasticFile& file)
+	: m_file(file)
+{
+}
+
+TEFileCompactor::~TEFileCompactor(void)
+{
+}
+
+bool TEFileCompactor::Compact(const TEFileCompactMode& mode, const size_file_t& bytes_limit)
+{
+	TEFileSectorsTable& sectors_table = m_file.GetSectorsTable();
+
+	DEVLOG( "compact " << (mode == EF_COMPACT_FULL ? "full" : "incremental") << ", limit " << bytes_limit );
+
+	// All the data before the position is already in [0, addr)
+	size_file_t position(0);
+	size_file_t addr(0);
+	size_file_t bytes_moved(0);
+
+	// The footer on the disk is kept until the new table is synced, so it must be in the current format
+	if(!sectors_table.IsJournalValid())
+	{
+		m_file.SetModified();
+		Commit();
+	}
+
+	// The table on the disk refers to the old places of the moved data and to the released table
+	// sectors, so nothing is written there until the new table is synced
+	sectors_table.BeginRelocation();
+
+	while(true)
+	{
+		size_file_t offset_in_sector;
+		TEFileSectorsList::iterator sector_it = sectors_table.GetSectorInPosition(position, offset_in_sector);
+
+		if(sector_it == sectors_table.List().end())
+			break;
+
+		// The placed sectors are united, so the position may be inside of a sector
+		if(sector_it->SectorAddr + offset_in_sector == addr)
+		{
+			position += sector_it->SectorSize - offset_in_sector;
+			addr += sector_it->SectorSize - offset_in_sector;
+			continue;
+		}
+
+		// Every step moves not more than the rest of the limit
+		size_file_t bytes_left = (mode == EF_COMPACT_INCREMENTAL ? bytes_limit - bytes_moved : EF_NO_SECTOR);
+
+		if(bytes_left == 0)
+		{
+			Commit();
+			return false;
+		}
+
+		if(offset_in_sector != 0)
+			sector_it = sectors_table.SplitSector(sector_it, offset_in_sector).second;
+
+		// The space for the sector is taken by a sector which isn't in place yet
+		TEFileSectorsList::iterator place_it = sectors_table.FindSector(addr);
+
+		// The space has been freed by this pass, the next steps wait for the new table
+		if(place_it->Free == EF_SECTOR_FREE && sectors_table.IsRetired(addr))
+		{
+			Commit();
+
+			if(mode == EF_COMPACT_INCREMENTAL)
+				return false;
+
+			sectors_table.BeginRelocation();
+			continue;
+		}
+
+		if(place_it->Free == EF_SECTOR_TABLE)
+		{
+			sectors_table.ReleaseTableSector(place_it);
+		}
+		else if(place_it->Free == EF_SECTOR_DATA)
+		{
+			bytes_moved += EvictSector(place_it, std::min<size_file_t>(std::min<size_file_t>(sector_it->SectorSize, place_it->SectorSize), bytes_left));
+		}
+		else
+		{
+			size_file_t bytes_placed = PlaceSector(sector_it, place_it, bytes_left);
+			position += bytes_placed;
+			addr += bytes_placed;
+			bytes_moved += bytes_placed;
+		}
+
+		m_file.SetModified();
+	}
+
+	Commit();
+
+	// Only free space and the table are after the data
+	if(!sectors_table.Shrink())
+		throw TEFileException(EF_TRUNCATE_ERROR, "Can't cut off the free space after the compacted data");
+
+	m_file.GetCursor().Refresh();
+	return true;
+}
+
+void TEFileCompactor::Commit()
+{
+	// The moved data and the table which refers to it are synced, then the freed space can be reused
+	m_file.Sync();
+	m_file.GetCursor().Refresh();
+}
+
+size_file_t TEFileCompactor::PlaceSector(TEFileSectorsList::iterator sector_it, TEFileSectorsList::iterator place_it, size_file_t bytes_left)
+{
+	TEFileSectorsTable& sectors_table = m_file.GetSectorsTable();
+
+	size_file_t size = std::min<size_file_t>(std::min<size_file_t>(sector_it->SectorSize, place_it->SectorSize), bytes_left);
+	sectors_table.SplitSector(sector_it, size);
+	sectors_table.SplitSector(place_it, size);
+
+	CopyData(sector_it->SectorAddr, place_it->SectorAddr, size);
+	sectors_table.RelocateSector(sector_it, place_it);
+
+	return size;
+}
+
+size_file_t TEFileCompactor::EvictSector(TEFileSectorsList::iterator sector_it, size_file_t size)
+{
+	TEFileSectorsTable& sectors_table = m_file.GetSectorsTable();
+
+	sectors_table.SplitSector(sector_it, size);
+
+	// Any free sector is after the compacted data, otherwise the file grows
+	TEFileSectorsList::iterator target_it = sectors_table.FindFreeSector(size, false);
+	if(target_it == sectors_table.List().end())
+		target_it = sectors_table.AllocateNewSector(size);
+	else
+		sectors_table.SplitSector(target_it, size);
+
+	DEVLOG( "evict " << size << " bytes from " << sector_it->SectorAddr << " to " << target_it->SectorAddr );
+
+	CopyData(sector_it->SectorAddr, target_it->SectorAddr, size);
+	sectors_table.RelocateSector(sector_it, target_it);
+
+	return size;
+}
+
+void TEFileCompactor::CopyData(size_file_t from_addr, size_file_t to_addr, size_file_t size)
+{
+	m_buffer.resize(EF_COMPACT_BUFFER_SIZE);
+
+	for(size_file_t bytes_copied = 0; bytes_copied < size; )
+	{
+		size_file_t bytes_to_copy = std::min<size_file_t>(size - bytes_copied, (size_file_t)EF_COMPACT_BUFFER_SIZE);
+
+		m_segments.clear();
+		TEFileVectorIO::AddSegment(m_segments, from_addr + bytes_copied, bytes_to_copy, &m_buffer[0]);
+
+		if(m_file.ReadData(m_segments) != bytes_to_copy)
+		{
+			throw TEFileException(EF_READ_DATA_ERROR, STRING("Can't read " << bytes_to_copy << " bytes from " << from_addr + bytes_copied));
+		}
+
+		m_segments.front().Addr = to_addr + bytes_copied;
+
+		if(m_file.WriteData(m_segments) != bytes_to_copy)
+		{
+			throw TEFileException(EF_WRITE_DATA_ERROR, STRING("Can't write " << bytes_to_copy << " bytes to " << to_addr + bytes_copied));
+		}
+
+		bytes_copied += bytes_to_copy;
+	}
+}
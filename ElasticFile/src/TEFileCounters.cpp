@@ -0,0 +1,93 @@
+#include <TEFileCounters.h>
+
+// Global counters of one thread. Only the thread changes them, so an addition is a plain load
+// and store. When the thread exits, its values go to the counters of the finished threads
+struct TThreadCounters
+{
+	TThreadCounters(void);
+	~TThreadCounters(void);
+
+	std::atomic<unsigned __int64> Values[EF_COUNTERS_COUNT];
+};
+
+struct TGlobalCounters
+{
+	TGlobalCounters(void)
+	{
+		for(int counter = 0; counter < EF_COUNTERS_COUNT; counter++)
+			FinishedThreads[counter] = 0;
+	}
+
+	std::mutex Lock;
+	std::set<TThreadCounters*> Threads;
+	unsigned __int64 FinishedThreads[EF_COUNTERS_COUNT];
+};
+
+static TGlobalCounters& global_counters()
+{
+	// It is never destroyed, because threads can exit after the static objects are destroyed
+	static TGlobalCounters* counters = new TGlobalCounters();
+	return *counters;
+}
+
+TThreadCounters::TThreadCounters(void)
+{
+	for(int counter = 0; counter < EF_COUNTERS_COUNT; counter++)
+		Values[counter].store(0, std::memory_order_relaxed);
+
+	TGlobalCounters& global = global_counters();
+
+	std::lock_guard<std::mutex> lock(global.Lock);
+	global.Threads.insert(this);
+}
+
+TThreadCounters::~TThreadCounters(void)
+{
+	TGlobalCounters& global = global_counters();
+
+	std::lock_guard<std::mutex> lock(global.Lock);
+	global.Threads.erase(this);
+
+	for(int counter = 0; counter < EF_COUNTERS_COUNT; counter++)
+		global.FinishedThreads[counter] += Values[counter].load(std::memory_order_relaxed);
+}
+
+TEFileCounters::TEFileCounters(void)
+{
+	for(int counter = 0; counter < EF_COUNTERS_COUNT; counter++)
+		m_values[counter].store(0, std::memory_order_relaxed);
+}
+
+TEFileCounters::~TEFileCounters(void)
+{
+}
+
+void TEFileCounters::GetSnapshot(TEFileCountersSnapshot& snapshot) const
+{
+	for(int counter = 0; counter < EF_COUNTERS_COUNT; counter++)
+		snapshot.Values[counter] = m_values[counter].load(std::memory_order_relaxed);
+}
+
+void TEFileCounters::GetGlobalSnapshot(TEFileCountersSnapshot& snapshot)
+{
+	TGlobalCounters& global = global_counters();
+
+	std::lock_guard<std::mutex> lock(global.Lock);
+
+	for(int counter = 0; counter < EF_COUNTERS_COUNT; counter++)
+		snapshot.Values[counter] = global.FinishedThreads[counter];
+
+	for(std::set<TThreadCounters*>::iterator thread_it = global.Threads.begin(); thread_it != global.Threads.end(); ++thread_it)
+	{
+		for(int counter = 0; counter < EF_COUNTERS_COUNT; counter++)
+			snapshot.Values[counter] += (*thread_it)->Values[counter].load(std::memory_order_relaxed);
+	}
+}
+
+void TEFileCounters::AddGlobal(const TEFileCounter& counter, unsigned __int64 value)
+{
+	static thread_local TThreadCounters thread_counters;
+
+	std::atomic<unsigned __int64>& thread_value = thread_counters.Values[counter];
+	thread_value.store(thread_value.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+}
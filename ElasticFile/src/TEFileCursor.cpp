@@ -5,6 +5,7 @@
 TEFileCursor::TEFileCursor(ElasticFile& file)
 	: m_position(0)
 	, m_offset_in_sector(0)
+	, m_changes_count((size_t)-1)
 	, m_file(file)
 {
 }
@@ -16,18 +17,33 @@ TEFileCursor::~TEFileCursor(void)
 
 TEFileSectorsList::iterator TEFileCursor::GetCurrentSector()
 {
+	CheckChanges();
 	return m_sector;
 }
 
 const size_file_t& TEFileCursor::GetOffsetInSector()
 {
+	CheckChanges();
 	return m_offset_in_sector;
 }
 
+ElasticFile& TEFileCursor::GetFile()
+{
+	return m_file;
+}
+
+void TEFileCursor::CheckChanges()
+{
+	if(m_changes_count != m_file.GetSectorsTable().GetChangesCount())
+		Refresh();
+}
+
 void TEFileCursor::SetPosition(const size_file_t& offset, TEFileCursorMoveMode mode)
 {
 	TEFileSectorsTable& sectors_table = m_file.GetSectorsTable();
 
+	CheckChanges();
+
 	const size_file_t& data_size = sectors_table.GetDataSize();
 	
 	size_file_t new_position(0);
@@ -56,19 +72,16 @@ void TEFileCursor::SetPosition(const size_file_t& offset, TEFileCursorMoveMode m
 	size_file_t offset_in_sector(0);
 	m_sector = GetSectorInPosition(new_position, offset_in_sector);
 	if(m_sector == sectors_table.List().end() && offset_in_sector > 0)
-		m_sector = m_file.Extend(offset_in_sector);
+	{
+		// The file has been extended up to the new position which is the end of the data now
+		m_file.Extend(offset_in_sector);
+		m_sector = sectors_table.List().end();
+		offset_in_sector = 0;
+	}
 
 	m_position = new_position;
 	m_offset_in_sector = offset_in_sector;
-
-	size_file_t position_to_move;
-	if(m_sector == sectors_table.List().end())
-		position_to_move = sectors_table.GetFileSize();
-	else
-		position_to_move = m_sector->SectorAddr + m_offset_in_sector;
-
-	if(_fseeki64(m_file.GetHandle(), position_to_move, SEEK_SET) != 0)
-		throw TEFileException(EF_IO_ERROR, STRING("IO error when seek to " << position_to_move));
+	m_changes_count = sectors_table.GetChangesCount();
 }
 
 TEFileSectorsList::iterator TEFileCursor::GetSectorInPosition(const size_file_t& position, size_file_t& offset_in_sector)
@@ -83,6 +96,7 @@ TEFileSectorsList::iterator TEFileCursor::GetSectorInPosition(const size_file_t&
 	{
 		// Current position
 		offset_in_sector = m_offset_in_sector;
+		EF_COUNT(m_file.GetCounters(), EF_COUNTER_SECTORS_VISITED, 1);
 		DEVLOG( m_sector->SectorAddr << ", " << offset_in_sector );
 		return m_sector;
 	}
@@ -104,101 +118,26 @@ TEFileSectorsList::iterator TEFileCursor::GetSectorInPosition(const size_file_t&
 	{
 		// Begin of the file
 		offset_in_sector = 0;
+		EF_COUNT(m_file.GetCounters(), EF_COUNTER_SECTORS_VISITED, 1);
 		DEVLOG( sectors_list.begin()->SectorAddr << ", " << offset_in_sector );
 		return sectors_list.begin();
 	}
-	else if(m_sector != sectors_list.end() && position > m_position && m_position - m_offset_in_sector + m_sector->SectorSize > position)
+	else if(m_sector != sectors_list.end() && !m_sector->Free && position > m_position && m_position - m_offset_in_sector + m_sector->SectorSize > position)
 	{
 		// If offset in current sector
-		offset_in_sector = position - m_position;
+		offset_in_sector = m_offset_in_sector + position - m_position;
+		EF_COUNT(m_file.GetCounters(), EF_COUNTER_SECTORS_VISITED, 1);
 		DEVLOG( m_sector->SectorAddr << ", " << offset_in_sector );
 		return m_sector;
 	}
-	// So position somewhere between begin and end of the sectors list
-	// Calculate optimal start point
-	size_file_t distance_from_current = max(m_position, position) - min(m_position, position);
-	size_file_t distance_from_begin = position;
-	size_file_t distance_from_end = sectors_table.GetDataSize() - position;
-
-	size_file_t min_distance = min(min(distance_from_current, distance_from_begin), distance_from_end);
-	char vect = 1;
-
-	TEFileSectorsList::iterator begin_it;
-	size_file_t virtual_cursor(0);
-	if(min_distance == distance_from_end)
-	{
-		CURRLOG( " end " );
-		vect = -1;
-		begin_it = sectors_list.end();
-		virtual_cursor = sectors_table.GetDataSize();
-	}
-	else if(min_distance == distance_from_begin)
-	{
-		CURRLOG( " begin " );
-		vect = 1;
-		begin_it = sectors_list.begin();
-		virtual_cursor = 0;
-	}
-	else if(min_distance == distance_from_current)
-	{
-		CURRLOG( " current " );
-		vect = (position > m_position ? 1 : -1);
-		begin_it = m_sector;
-		virtual_cursor = m_position - m_offset_in_sector;
-	}
 
-	// Go to the sector
-	if(vect > 0)
-	{
-		CURRLOG( " > " );
-		// Go right
-		for(TEFileSectorsList::iterator it = begin_it; it != sectors_list.end(); ++it)
-		{
-			TEFileSector& sector(*it);
-
-			if(sector.Free)
-				continue;
-
-			if(virtual_cursor + sector.SectorSize > position)
-			{
-				offset_in_sector = position - virtual_cursor;
-				DEVLOG( it->SectorAddr << ", " << offset_in_sector );
-				return it;
-			}
-
-			virtual_cursor += sector.SectorSize;
-		}
-	}
-	else if(vect < 0)
-	{
-		CURRLOG( " < " );
-		// Go left
-		TEFileSectorsList::reverse_iterator reverse_begin_it(begin_it);
-		if(begin_it != sectors_list.end()) // Skip right-end iterator
-		{
-			--reverse_begin_it;
-			virtual_cursor += begin_it->SectorSize;
-		}
-
-		for(TEFileSectorsList::reverse_iterator it = reverse_begin_it; it != sectors_list.rend(); ++it)
-		{
-			TEFileSector& sector(*it);
-
-			virtual_cursor -= sector.SectorSize;
-
-			if(sector.Free)
-				continue;
-
-			if(virtual_cursor <= position)
-			{
-				offset_in_sector = position - virtual_cursor;
-				DEVLOG( it->SectorAddr << ", " << offset_in_sector );
-				return --it.base();
-			}
-		}
-	}
+	// So position somewhere between begin and end of the sectors list. Look it up in the sectors index
+	TEFileSectorsList::iterator sector_it = sectors_table.GetSectorInPosition(position, offset_in_sector);
+	if(sector_it == sectors_list.end())
+		throw TEFileException(EF_CURSOR_ERROR, STRING("Can't find sector in position " << position << ". Unknown case"));
 
-	throw TEFileException(EF_CURSOR_ERROR, STRING("Can't find sector in position " << position << ". Unknown case"));
+	DEVLOG( sector_it->SectorAddr << ", " << offset_in_sector );
+	return sector_it;
 }
 
 const size_file_t& TEFileCursor::GetPosition()
@@ -206,15 +145,27 @@ const size_file_t& TEFileCursor::GetPosition()
 	return m_position;
 }
 
+void TEFileCursor::Refresh()
+{
+	// Sectors could be united or removed, so find the current sector again by the position
+	m_sector = m_file.GetSectorsTable().GetSectorInPosition(m_position, m_offset_in_sector);
+	if(m_sector == m_file.GetSectorsTable().List().end())
+		m_offset_in_sector = 0;
+
+	m_changes_count = m_file.GetSectorsTable().GetChangesCount();
+}
+
 void TEFileCursor::Update(TEFileSectorsList::iterator sector)
 {
 	m_sector = sector;
+	m_changes_count = m_file.GetSectorsTable().GetChangesCount();
 }
 
 void TEFileCursor::Update(TEFileSectorsList::iterator sector, const size_file_t& offset_in_sector)
 {
 	m_sector = sector;
 	m_offset_in_sector = offset_in_sector;
+	m_changes_count = m_file.GetSectorsTable().GetChangesCount();
 }
 
 void TEFileCursor::Update(TEFileSectorsList::iterator sector, const size_file_t& offset_in_sector, const size_file_t& position)
@@ -222,4 +173,5 @@ void TEFileCursor::Update(TEFileSectorsList::iterator sector, const size_file_t&
 	m_sector = sector;
 	m_position = position;
 	m_offset_in_sector = offset_in_sector;
+	m_changes_count = m_file.GetSectorsTable().GetChangesCount();
 }
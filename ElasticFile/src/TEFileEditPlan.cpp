@@ -0,0 +1,197 @@
+#include <TEFileEditPlan.h>
+#include <TEFileException.h>
+#include <ElasticFile.h>
+#include <TEFileVectorIO.h>
+
+TEFileEditPlan::TEFileEditPlan(ElasticFile& file)
+	: m_file(file)
+{
+}
+
+TEFileEditPlan::~TEFileEditPlan(void)
+{
+}
+
+void TEFileEditPlan::Apply(const TEFileEdit* edits, const size_t& edits_count)
+{
+	DEVLOG( "apply " << edits_count << " edits" );
+
+	// Inserts on the same position keep their order
+	m_order.resize(edits_count);
+	for(size_t edit_index = 0; edit_index < edits_count; ++edit_index)
+		m_order[edit_index] = edit_index;
+
+	std::stable_sort(m_order.begin(), m_order.end(), TPositionLess(edits));
+
+	size_file_t insert_size = Check(edits);
+
+	if(insert_size > 0)
+		WriteInserts(edits, insert_size);
+
+	PlaceInserts(edits);
+	ApplyDeletes(edits);
+
+	m_file.SetModified();
+}
+
+size_file_t TEFileEditPlan::Check(const TEFileEdit* edits)
+{
+	const size_file_t& data_size = m_file.GetSectorsTable().GetDataSize();
+	bool append = (m_file.GetMode() & EF_MODE_APPEND) != 0;
+
+	size_file_t deleted_end(0);
+	size_file_t insert_size(0);
+
+	for(std::vector<size_t>::iterator order_it = m_order.begin(); order_it != m_order.end(); ++order_it)
+	{
+		const TEFileEdit& edit = edits[*order_it];
+
+		if(edit.Size == 0)
+			continue;
+
+		if(edit.Position > data_size)
+		{
+			throw TEFileException(EF_UNCORRECT_PARAMETER, STRING("Can't edit at " << edit.Position << ". End of file is " << data_size));
+		}
+
+		if(edit.Position < deleted_end)
+		{
+			throw TEFileException(EF_UNCORRECT_PARAMETER, STRING("Can't edit at " << edit.Position << " inside of the data deleted up to " << deleted_end));
+		}
+
+		if(edit.Type == EF_EDIT_DELETE)
+		{
+			if(append)
+				throw TEFileException(EF_TRUNCATE_ON_APPEND, "Can't truncate in append mode");
+
+			if(edit.Size > data_size - edit.Position)
+			{
+				throw TEFileException(EF_TRUNCATE_ERROR, STRING("Can't delete " << edit.Size << " bytes from " << edit.Position << ". End of file reached"));
+			}
+
+			deleted_end = edit.Position + edit.Size;
+		}
+		else
+		{
+			if(append && edit.Position < data_size)
+				throw TEFileException(EF_SET_POSITION_ERROR, "Can't go back with append mode");
+
+			if(edit.Size > EF_NO_SECTOR - data_size - insert_size)
+			{
+				throw TEFileException(EF_UNCORRECT_PARAMETER, STRING("Can't insert " << edit.Size << " bytes more"));
+			}
+
+			insert_size += edit.Size;
+		}
+	}
+
+	return insert_size;
+}
+
+void TEFileEditPlan::WriteInserts(const TEFileEdit* edits, const size_file_t& insert_size)
+{
+	TEFileSectorsTable& sectors_table = m_file.GetSectorsTable();
+
+	TEFileSectorsIterators allocated_sectors_iterators;
+	sectors_table.Allocate(insert_size, allocated_sectors_iterators);
+
+	if(allocated_sectors_iterators.empty())
+	{
+		throw TEFileException(EF_ALLOCATE_ERROR, STRING("Can't allocate " << insert_size << " bytes"));
+	}
+
+	// The allocated sectors are split by the borders of the operations
+	TEFileSectorsIterators::iterator allocated_it = allocated_sectors_iterators.begin();
+
+	m_sectors.clear();
+	m_sectors_ends.resize(m_order.size());
+	m_segments.clear();
+
+	for(size_t order_index = 0; order_index < m_order.size(); ++order_index)
+	{
+		const TEFileEdit& edit = edits[m_order[order_index]];
+
+		for(size_file_t bytes_placed = 0; edit.Type == EF_EDIT_INSERT && bytes_placed < edit.Size; )
+		{
+			TEFileSectorsList::iterator sector_it = *allocated_it;
+
+			size_file_t bytes_to_place = edit.Size - bytes_placed;
+			if(bytes_to_place < sector_it->SectorSize)
+				*allocated_it = sectors_table.SplitSector(sector_it, bytes_to_place).second;
+			else
+				++allocated_it;
+
+			TEFileVectorIO::AddSegment(m_segments, sector_it->SectorAddr, sector_it->SectorSize, edit.Buffer + bytes_placed);
+			m_sectors.push_back(sector_it);
+
+			bytes_placed += sector_it->SectorSize;
+		}
+
+		m_sectors_ends[order_index] = m_sectors.size();
+	}
+
+	size_file_t bytes_written = m_file.WriteData(m_segments);
+	if(bytes_written != insert_size)
+	{
+		// The allocated sectors stay free, so nothing has been changed
+		throw TEFileException(EF_WRITE_DATA_ERROR, STRING(bytes_written << " of " << insert_size << " bytes have been written"), 0);
+	}
+}
+
+void TEFileEditPlan::PlaceInserts(const TEFileEdit* edits)
+{
+	TEFileSectorsTable& sectors_table = m_file.GetSectorsTable();
+
+	// Data inserted before a position shifts it
+	size_file_t bytes_inserted(0);
+
+	size_t sectors_begin(0);
+	for(size_t order_index = 0; order_index < m_order.size(); ++order_index)
+	{
+		const TEFileEdit& edit = edits[m_order[order_index]];
+
+		if(edit.Type != EF_EDIT_INSERT || edit.Size == 0)
+			continue;
+
+		TEFileSectorsIterators edit_sectors(m_sectors.begin() + sectors_begin, m_sectors.begin() + m_sectors_ends[order_index]);
+		sectors_begin = m_sectors_ends[order_index];
+
+		sectors_table.MoveSectorsTo(edit_sectors, edit.Position + bytes_inserted);
+
+		// Only the last sector can be united with the right one, so the next sector stays valid
+		for(TEFileSectorsIterators::iterator sector_it = edit_sectors.begin(); sector_it != edit_sectors.end(); ++sector_it)
+		{
+			sectors_table.SetSectorFree(*sector_it, 0);
+
+			TUniteResult unite_result;
+			sectors_table.CheckAndUniteSector(*sector_it, unite_result);
+		}
+
+		bytes_inserted += edit.Size;
+	}
+}
+
+void TEFileEditPlan::ApplyDeletes(const TEFileEdit* edits)
+{
+	// Inserts before a delete and on its position shift it forward, the previous deletes shift it back
+	size_file_t bytes_inserted(0);
+	size_file_t bytes_deleted(0);
+
+	size_t insert_index(0);
+	for(size_t order_index = 0; order_index < m_order.size(); ++order_index)
+	{
+		const TEFileEdit& edit = edits[m_order[order_index]];
+
+		if(edit.Type != EF_EDIT_DELETE || edit.Size == 0)
+			continue;
+
+		for(; insert_index < m_order.size() && edits[m_order[insert_index]].Position <= edit.Position; ++insert_index)
+		{
+			if(edits[m_order[insert_index]].Type == EF_EDIT_INSERT)
+				bytes_inserted += edits[m_order[insert_index]].Size;
+		}
+
+		m_file.DeleteData(edit.Position + bytes_inserted - bytes_deleted, edit.Size);
+		bytes_deleted += edit.Size;
+	}
+}
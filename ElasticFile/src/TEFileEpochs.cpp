@@ -0,0 +1,30 @@
+#include <TEFileEpochs.h>
+
+TEFileEpochs::TEFileEpochs()
+{
+}
+
+TEFileEpochs::~TEFileEpochs(void)
+{
+}
+
+void TEFileEpochs::Pin(size_t version)
+{
+	std::lock_guard<std::mutex> lock(m_lock);
+	m_versions.insert(version);
+}
+
+void TEFileEpochs::Unpin(size_t version)
+{
+	std::lock_guard<std::mutex> lock(m_lock);
+
+	std::multiset<size_t>::iterator version_it = m_versions.find(version);
+	if(version_it != m_versions.end())
+		m_versions.erase(version_it);
+}
+
+size_t TEFileEpochs::GetOldest() const
+{
+	std::lock_guard<std::mutex> lock(m_lock);
+	return m_versions.empty() ? EF_NO_EPOCH : *m_versions.begin();
+}
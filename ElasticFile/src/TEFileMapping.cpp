@@ -0,0 +1,99 @@
+#include <TEFileMapping.h>
+#include <TEFileException.h>
+#ifdef _WIN32
+#define NOMINMAX // std::min and std::max are used instead of the macros of windows.h
+#include <windows.h>
+#include <io.h>
+#else
+#include <sys/mman.h>
+#endif
+
+TEFileMappedRegion::TEFileMappedRegion(int file_descriptor, size_file_t size)
+	: m_data(NULL)
+	, m_size(size)
+	, m_mapping(NULL)
+{
+	if(m_size == 0)
+		return;
+
+	if(file_descriptor < 0)
+	{
+		throw TEFileException(EF_IO_ERROR, "The file can't be mapped");
+	}
+
+#ifdef _WIN32
+	m_mapping = CreateFileMapping((HANDLE)_get_osfhandle(file_descriptor), NULL, PAGE_READONLY, (DWORD)(m_size >> 32), (DWORD)m_size, NULL);
+	if(m_mapping != NULL)
+		m_data = (BYTE*)MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, (SIZE_T)m_size);
+
+	if(m_data == NULL)
+	{
+		if(m_mapping != NULL)
+			CloseHandle(m_mapping);
+
+		throw TEFileException(EF_IO_ERROR, STRING("Can't map " << m_size << " bytes of the file"));
+	}
+#else
+	void* data = mmap(NULL, (size_t)m_size, PROT_READ, MAP_SHARED, file_descriptor, 0);
+	if(data == MAP_FAILED)
+	{
+		throw TEFileException(EF_IO_ERROR, STRING("Can't map " << m_size << " bytes of the file"));
+	}
+
+	m_data = (BYTE*)data;
+#endif
+}
+
+TEFileMappedRegion::TEFileMappedRegion(const BYTE* data, size_file_t size, const std::shared_ptr<void>& owner)
+	: m_data((BYTE*)data)
+	, m_size(size)
+	, m_mapping(NULL)
+	, m_owner(owner)
+{
+}
+
+TEFileMappedRegion::~TEFileMappedRegion(void)
+{
+	// The memory of the owner isn't mapped
+	if(m_data == NULL || m_owner)
+		return;
+
+#ifdef _WIN32
+	UnmapViewOfFile(m_data);
+	CloseHandle((HANDLE)m_mapping);
+#else
+	munmap(m_data, (size_t)m_size);
+#endif
+}
+
+const BYTE* TEFileMappedRegion::GetData() const
+{
+	return m_data;
+}
+
+size_file_t TEFileMappedRegion::GetSize() const
+{
+	return m_size;
+}
+
+TEFileMapping::TEFileMapping()
+{
+}
+
+TEFileMapping::~TEFileMapping(void)
+{
+}
+
+TEFileMappedRegionPtr TEFileMapping::Map(const TEFileHandle& file_handle, size_file_t size)
+{
+	// The file has grown or has been shrunk since the last mapping
+	if(!m_region || m_region->GetSize() != size)
+		m_region = file_handle->Map(size);
+
+	return m_region;
+}
+
+void TEFileMapping::Unmap()
+{
+	m_region.reset();
+}
@@ -0,0 +1,206 @@
+#include <TEFileMemoryBackend.h>
+#include <TEFileMapping.h>
+
+TEFileMemoryBackend::TEFileMemoryBackend()
+	: m_read_only(false)
+{
+}
+
+TEFileMemoryBackend::~TEFileMemoryBackend(void)
+{
+}
+
+bool TEFileMemoryBackend::Remove(const std::string& file_name)
+{
+	TRegistry& registry = GetRegistry();
+	std::lock_guard<std::mutex> lock(registry.Lock);
+
+	return registry.Files.erase(file_name) > 0;
+}
+
+bool TEFileMemoryBackend::Open(const std::string& file_name, bool create)
+{
+	TRegistry& registry = GetRegistry();
+	std::lock_guard<std::mutex> lock(registry.Lock);
+
+	TMemoryFilePtr& file = registry.Files[file_name];
+
+	if(create)
+	{
+		// The handles which are still open keep the old data
+		file.reset(new TMemoryFile());
+		file->Data.reset(new TData());
+	}
+	else if(!file)
+	{
+		registry.Files.erase(file_name);
+		return false;
+	}
+
+	m_file = file;
+	m_read_only = false;
+
+	return true;
+}
+
+bool TEFileMemoryBackend::Exists(const std::string& file_name)
+{
+	TRegistry& registry = GetRegistry();
+	std::lock_guard<std::mutex> lock(registry.Lock);
+
+	return registry.Files.find(file_name) != registry.Files.end();
+}
+
+bool TEFileMemoryBackend::Close()
+{
+	m_file.reset();
+	return true;
+}
+
+TEFileHandle TEFileMemoryBackend::CreateReader()
+{
+	std::shared_ptr<TEFileMemoryBackend> reader(new TEFileMemoryBackend());
+	reader->m_file = m_file;
+	reader->m_read_only = true;
+	reader->m_counters = m_counters;
+
+	return reader;
+}
+
+size_file_t TEFileMemoryBackend::ReadAt(size_file_t addr, PBYTE buffer, size_file_t size)
+{
+	std::lock_guard<std::mutex> lock(m_file->Lock);
+
+	return TransferLow(addr, buffer, size, false);
+}
+
+size_file_t TEFileMemoryBackend::WriteAt(size_file_t addr, const BYTE* buffer, size_file_t size)
+{
+	std::lock_guard<std::mutex> lock(m_file->Lock);
+
+	return TransferLow(addr, (PBYTE)buffer, size, true);
+}
+
+bool TEFileMemoryBackend::GetSize(size_file_t& size)
+{
+	std::lock_guard<std::mutex> lock(m_file->Lock);
+
+	size = m_file->Data->size();
+	return true;
+}
+
+bool TEFileMemoryBackend::Resize(size_file_t size)
+{
+	std::lock_guard<std::mutex> lock(m_file->Lock);
+
+	if(m_read_only || !Reserve(size))
+		return false;
+
+	m_file->Data->resize((size_t)size);
+	return true;
+}
+
+bool TEFileMemoryBackend::Preallocate(size_file_t size)
+{
+	std::lock_guard<std::mutex> lock(m_file->Lock);
+
+	return !m_read_only && Reserve(size);
+}
+
+bool TEFileMemoryBackend::Flush()
+{
+	return true;
+}
+
+bool TEFileMemoryBackend::Sync()
+{
+	return true;
+}
+
+TEFileMappedRegionPtr TEFileMemoryBackend::Map(size_file_t size)
+{
+	std::lock_guard<std::mutex> lock(m_file->Lock);
+
+	// The region keeps the vector, so it stays valid when the file gets a new one
+	TDataPtr& data = m_file->Data;
+	return TEFileMappedRegionPtr(new TEFileMappedRegion(data->data(), std::min<size_file_t>(size, (size_file_t)data->size()), data));
+}
+
+size_file_t TEFileMemoryBackend::Transfer(const TEFileIOSegments& segments, bool write)
+{
+	std::lock_guard<std::mutex> lock(m_file->Lock);
+
+	size_file_t bytes_transferred(0);
+
+	for(TEFileIOSegments::const_iterator segment_it = segments.begin(); segment_it != segments.end(); ++segment_it)
+	{
+		size_file_t bytes = TransferLow(segment_it->Addr, segment_it->Buffer, segment_it->Size, write);
+		bytes_transferred += bytes;
+
+		if(bytes != segment_it->Size)
+			break;
+	}
+
+	return bytes_transferred;
+}
+
+TEFileMemoryBackend::TRegistry& TEFileMemoryBackend::GetRegistry()
+{
+	static TRegistry registry;
+	return registry;
+}
+
+bool TEFileMemoryBackend::Reserve(size_file_t size)
+{
+	TDataPtr& data = m_file->Data;
+
+	if(size <= data->capacity())
+		return true;
+
+	if(size > (size_file_t)data->max_size())
+		return false;
+
+	size_t capacity = std::max<size_t>((size_t)size, data->capacity() * 2);
+
+	TDataPtr new_data(new TData());
+	new_data->reserve(capacity);
+	new_data->assign(data->begin(), data->end());
+
+	data = new_data;
+	return true;
+}
+
+size_file_t TEFileMemoryBackend::TransferLow(size_file_t addr, PBYTE buffer, size_file_t size, bool write)
+{
+	TData& data = *m_file->Data;
+
+	if(!write)
+	{
+		if(addr >= data.size())
+			return 0;
+
+		size_file_t bytes_to_read = std::min<size_file_t>(size, data.size() - addr);
+		memcpy(buffer, &data[(size_t)addr], (size_t)bytes_to_read);
+
+		EF_COUNT(m_counters, EF_COUNTER_BYTES_READ, bytes_to_read);
+
+		return bytes_to_read;
+	}
+
+	if(m_read_only || size == 0)
+		return 0;
+
+	if(addr + size > data.size())
+	{
+		if(!Reserve(addr + size))
+			return 0;
+
+		m_file->Data->resize((size_t)(addr + size));
+	}
+
+	memcpy(&(*m_file->Data)[(size_t)addr], buffer, (size_t)size);
+
+	EF_COUNT(m_counters, EF_COUNTER_BYTES_WRITTEN, size);
+
+	return size;
+}
@@ -0,0 +1,142 @@
+#include <TEFileMmapBackend.h>
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <unistd.h>
+
+TEFileMmapBackend::TEFileMmapBackend()
+	: m_data(NULL)
+	, m_capacity(0)
+	, m_size(0)
+{
+}
+
+TEFileMmapBackend::~TEFileMmapBackend(void)
+{
+	TEFileMmapBackend::Close();
+}
+
+bool TEFileMmapBackend::Open(const std::string& file_name, bool create)
+{
+	if(!TEFilePosixBackend::Open(file_name, create))
+		return false;
+
+	if(!TEFilePosixBackend::GetSize(m_size) || !Reserve(m_size))
+	{
+		Close();
+		return false;
+	}
+
+	return true;
+}
+
+bool TEFileMmapBackend::Close()
+{
+	Unmap();
+	m_size = 0;
+
+	return TEFilePosixBackend::Close();
+}
+
+size_file_t TEFileMmapBackend::ReadAt(size_file_t addr, PBYTE buffer, size_file_t size)
+{
+	if(addr >= m_size)
+		return 0;
+
+	size_file_t bytes_to_read = std::min<size_file_t>(size, m_size - addr);
+	memcpy(buffer, m_data + addr, (size_t)bytes_to_read);
+
+	EF_COUNT(m_counters, EF_COUNTER_BYTES_READ, bytes_to_read);
+
+	return bytes_to_read;
+}
+
+size_file_t TEFileMmapBackend::WriteAt(size_file_t addr, const BYTE* buffer, size_file_t size)
+{
+	if(size == 0)
+		return 0;
+
+	// The pages past the end of the file can't be touched
+	if(addr + size > m_size && !Resize(addr + size))
+		return 0;
+
+	memcpy(m_data + addr, buffer, (size_t)size);
+
+	EF_COUNT(m_counters, EF_COUNTER_BYTES_WRITTEN, size);
+
+	return size;
+}
+
+bool TEFileMmapBackend::GetSize(size_file_t& size)
+{
+	size = m_size;
+	return true;
+}
+
+bool TEFileMmapBackend::Resize(size_file_t size)
+{
+	if(!Reserve(size) || !TEFilePosixBackend::Resize(size))
+		return false;
+
+	m_size = size;
+
+	return true;
+}
+
+bool TEFileMmapBackend::Preallocate(size_file_t size)
+{
+	return TEFilePosixBackend::Preallocate(size) && Reserve(size);
+}
+
+bool TEFileMmapBackend::Sync()
+{
+	EF_COUNT(m_counters, EF_COUNTER_SYSCALLS, m_data != NULL ? 1 : 0);
+
+	if(m_data != NULL && msync(m_data, (size_t)m_capacity, MS_SYNC) != 0)
+		return false;
+
+	return TEFilePosixBackend::Sync();
+}
+
+size_file_t TEFileMmapBackend::Transfer(const TEFileIOSegments& segments, bool write)
+{
+	// Every segment is one copy, there is nothing to join
+	return TEFileBackend::Transfer(segments, write);
+}
+
+bool TEFileMmapBackend::Reserve(size_file_t size)
+{
+	if(size <= m_capacity)
+		return true;
+
+	size_file_t capacity = std::max<size_file_t>(size, m_capacity * 2);
+	capacity = (capacity + EF_MMAP_GROWTH - 1) / EF_MMAP_GROWTH * EF_MMAP_GROWTH;
+
+	// The pages past the end of the file are reserved in the address space but are not used
+	void* data = mmap(NULL, (size_t)capacity, PROT_READ | PROT_WRITE, MAP_SHARED, m_file_descriptor, 0);
+	EF_COUNT(m_counters, EF_COUNTER_SYSCALLS, 1);
+
+	if(data == MAP_FAILED)
+		return false;
+
+	Unmap();
+
+	m_data = (BYTE*)data;
+	m_capacity = capacity;
+
+	return true;
+}
+
+void TEFileMmapBackend::Unmap()
+{
+	if(m_data == NULL)
+		return;
+
+	munmap(m_data, (size_t)m_capacity);
+	EF_COUNT(m_counters, EF_COUNTER_SYSCALLS, 1);
+
+	m_data = NULL;
+	m_capacity = 0;
+}
+
+#endif
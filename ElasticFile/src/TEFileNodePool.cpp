@@ -0,0 +1,92 @@
+#include <efile_types.h>
+
+TEFileNodePool::TEFileNodePool()
+	: m_chunk_position(NULL)
+	, m_chunk_left(0)
+	, m_allocated_size(0)
+{
+	for(size_t size_class = 0; size_class < EF_POOL_SIZE_CLASSES; ++size_class)
+		m_free_blocks[size_class] = NULL;
+}
+
+TEFileNodePool::~TEFileNodePool()
+{
+	for(std::vector<char*>::iterator chunk_it = m_chunks.begin(); chunk_it != m_chunks.end(); ++chunk_it)
+		delete[] *chunk_it;
+}
+
+size_t TEFileNodePool::GetSizeClass(size_t size)
+{
+	return (size + EF_POOL_ALIGNMENT - 1) / EF_POOL_ALIGNMENT - 1;
+}
+
+void* TEFileNodePool::Allocate(size_t size)
+{
+	size_t size_class = GetSizeClass(size);
+
+	// Big blocks, like arrays of containers, are not pooled
+	if(size == 0 || size_class >= EF_POOL_SIZE_CLASSES)
+		return ::operator new(size);
+
+	m_allocated_size += (size_class + 1) * EF_POOL_ALIGNMENT;
+
+	TFreeBlock* block = m_free_blocks[size_class];
+	if(block != NULL)
+	{
+		m_free_blocks[size_class] = block->Next;
+		return block;
+	}
+
+	size_t block_size = (size_class + 1) * EF_POOL_ALIGNMENT;
+	if(m_chunk_left < block_size)
+	{
+		// The rest of the current chunk goes to the free list of its own size
+		if(m_chunk_left > 0)
+		{
+			size_t rest_class = GetSizeClass(m_chunk_left);
+			TFreeBlock* rest_block = reinterpret_cast<TFreeBlock*>(m_chunk_position);
+			rest_block->Next = m_free_blocks[rest_class];
+			m_free_blocks[rest_class] = rest_block;
+		}
+
+		m_chunks.push_back(new char[EF_POOL_CHUNK_SIZE]);
+		m_chunk_position = m_chunks.back();
+		m_chunk_left = EF_POOL_CHUNK_SIZE;
+	}
+
+	void* result = m_chunk_position;
+	m_chunk_position += block_size;
+	m_chunk_left -= block_size;
+
+	return result;
+}
+
+void TEFileNodePool::Deallocate(void* block, size_t size)
+{
+	if(block == NULL)
+		return;
+
+	size_t size_class = GetSizeClass(size);
+
+	if(size == 0 || size_class >= EF_POOL_SIZE_CLASSES)
+	{
+		::operator delete(block);
+		return;
+	}
+
+	m_allocated_size -= (size_class + 1) * EF_POOL_ALIGNMENT;
+
+	TFreeBlock* free_block = static_cast<TFreeBlock*>(block);
+	free_block->Next = m_free_blocks[size_class];
+	m_free_blocks[size_class] = free_block;
+}
+
+size_t TEFileNodePool::GetReservedSize() const
+{
+	return m_chunks.size() * EF_POOL_CHUNK_SIZE;
+}
+
+size_t TEFileNodePool::GetAllocatedSize() const
+{
+	return m_allocated_size;
+}
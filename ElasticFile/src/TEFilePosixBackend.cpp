@@ -0,0 +1,258 @@
+#include <TEFilePosixBackend.h>
+
+#ifndef _WIN32
+#include <TEFileUring.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+
+TEFilePosixBackend::TEFilePosixBackend()
+	: m_file_descriptor(-1)
+{
+}
+
+TEFilePosixBackend::~TEFilePosixBackend(void)
+{
+	TEFilePosixBackend::Close();
+}
+
+bool TEFilePosixBackend::Open(const std::string& file_name, bool create)
+{
+	m_file_name = file_name;
+	return OpenDescriptor(file_name, create ? O_RDWR | O_CREAT | O_TRUNC : O_RDWR);
+}
+
+bool TEFilePosixBackend::Exists(const std::string& file_name)
+{
+	return FileExists(file_name);
+}
+
+bool TEFilePosixBackend::Close()
+{
+	if(m_file_descriptor < 0)
+		return true;
+
+	bool result = close(m_file_descriptor) == 0;
+	m_file_descriptor = -1;
+
+	return result;
+}
+
+TEFileHandle TEFilePosixBackend::CreateReader()
+{
+	std::shared_ptr<TEFilePosixBackend> reader(new TEFilePosixBackend());
+
+	reader->m_file_name = m_file_name;
+	reader->m_counters = m_counters;
+	if(!reader->OpenDescriptor(m_file_name, O_RDONLY))
+		return TEFileHandle();
+
+	return reader;
+}
+
+size_file_t TEFilePosixBackend::ReadAt(size_file_t addr, PBYTE buffer, size_file_t size)
+{
+	size_file_t bytes_read(0);
+
+	while(bytes_read < size)
+	{
+		ssize_t bytes = pread(m_file_descriptor, buffer + bytes_read, size - bytes_read, addr + bytes_read);
+		EF_COUNT(m_counters, EF_COUNTER_SYSCALLS, 1);
+
+		if(bytes < 0 && errno == EINTR)
+			continue;
+
+		// The end of the file
+		if(bytes <= 0)
+			break;
+
+		bytes_read += bytes;
+	}
+
+	EF_COUNT(m_counters, EF_COUNTER_BYTES_READ, bytes_read);
+
+	return bytes_read;
+}
+
+size_file_t TEFilePosixBackend::WriteAt(size_file_t addr, const BYTE* buffer, size_file_t size)
+{
+	size_file_t bytes_written(0);
+
+	while(bytes_written < size)
+	{
+		ssize_t bytes = pwrite(m_file_descriptor, buffer + bytes_written, size - bytes_written, addr + bytes_written);
+		EF_COUNT(m_counters, EF_COUNTER_SYSCALLS, 1);
+
+		if(bytes < 0 && errno == EINTR)
+			continue;
+
+		// No space left
+		if(bytes <= 0)
+			break;
+
+		bytes_written += bytes;
+	}
+
+	EF_COUNT(m_counters, EF_COUNTER_BYTES_WRITTEN, bytes_written);
+
+	return bytes_written;
+}
+
+bool TEFilePosixBackend::GetSize(size_file_t& size)
+{
+	EF_COUNT(m_counters, EF_COUNTER_SYSCALLS, 1);
+
+	struct stat file_stat;
+	if(fstat(m_file_descriptor, &file_stat) != 0)
+		return false;
+
+	size = file_stat.st_size;
+	return true;
+}
+
+bool TEFilePosixBackend::Resize(size_file_t size)
+{
+	EF_COUNT(m_counters, EF_COUNTER_SYSCALLS, 1);
+
+	return ftruncate(m_file_descriptor, size) == 0;
+}
+
+bool TEFilePosixBackend::Preallocate(size_file_t size)
+{
+	EF_COUNT(m_counters, EF_COUNTER_SYSCALLS, 1);
+
+	return PreallocateDescriptor(m_file_descriptor, size);
+}
+
+bool TEFilePosixBackend::ZeroRange(size_file_t addr, size_file_t size)
+{
+#if defined(__linux__)
+	EF_COUNT(m_counters, EF_COUNTER_SYSCALLS, 1);
+
+	// The blocks stay allocated as unwritten extents, so the reused space isn't fragmented
+	if(fallocate(m_file_descriptor, FALLOC_FL_ZERO_RANGE, addr, size) == 0)
+		return true;
+
+	EF_COUNT(m_counters, EF_COUNTER_SYSCALLS, 1);
+
+	// The file systems without zero ranges (tmpfs, older NFS) can still release the blocks
+	return fallocate(m_file_descriptor, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, addr, size) == 0;
+#else
+	return false;
+#endif
+}
+
+bool TEFilePosixBackend::Flush()
+{
+	// Nothing is buffered past the descriptor
+	return m_file_descriptor >= 0;
+}
+
+bool TEFilePosixBackend::Sync()
+{
+	EF_COUNT(m_counters, EF_COUNTER_SYSCALLS, 1);
+
+	return fsync(m_file_descriptor) == 0;
+}
+
+size_file_t TEFilePosixBackend::Transfer(const TEFileIOSegments& segments, bool write)
+{
+#if defined(EF_IO_URING) && defined(__linux__)
+	// All the runs are submitted at once
+	TEFileUring* ring = TEFileUring::Get();
+	if(ring)
+	{
+		size_file_t bytes_transferred = ring->Transfer(m_file_descriptor, segments, write);
+
+		EF_COUNT(m_counters, EF_COUNTER_SYSCALLS, ring->GetSystemCalls());
+		EF_COUNT(m_counters, write ? EF_COUNTER_BYTES_WRITTEN : EF_COUNTER_BYTES_READ, bytes_transferred);
+
+		return bytes_transferred;
+	}
+#endif
+
+	size_file_t bytes_transferred(0);
+	struct iovec vectors[EF_IO_MAX_VECTORS];
+
+	for(size_t segment_index = 0; segment_index < segments.size(); )
+	{
+		// Physically adjacent segments are transferred by one call
+		size_file_t run_addr = segments[segment_index].Addr;
+		size_file_t run_size(0);
+		int vectors_count(0);
+
+		for(; segment_index < segments.size() && vectors_count < EF_IO_MAX_VECTORS && segments[segment_index].Addr == run_addr + run_size; ++segment_index, ++vectors_count)
+		{
+			vectors[vectors_count].iov_base = segments[segment_index].Buffer;
+			vectors[vectors_count].iov_len = segments[segment_index].Size;
+			run_size += segments[segment_index].Size;
+		}
+
+		// A call can transfer a part of the run (Linux stops at 0x7ffff000 bytes), the rest
+		// is transferred from the returned offset by the next calls
+		struct iovec* run_vectors = vectors;
+		size_file_t run_transferred(0);
+
+		while(run_transferred < run_size)
+		{
+			ssize_t bytes;
+			do
+			{
+				bytes = write ? pwritev(m_file_descriptor, run_vectors, vectors_count, run_addr + run_transferred) : preadv(m_file_descriptor, run_vectors, vectors_count, run_addr + run_transferred);
+				EF_COUNT(m_counters, EF_COUNTER_SYSCALLS, 1);
+			}
+			while(bytes < 0 && errno == EINTR);
+
+			// The end of the file, no space left or an error
+			if(bytes <= 0)
+				break;
+
+			run_transferred += bytes;
+			EF_COUNT(m_counters, write ? EF_COUNTER_BYTES_WRITTEN : EF_COUNTER_BYTES_READ, bytes);
+
+			for(size_t bytes_to_skip = (size_t)bytes; bytes_to_skip > 0; )
+			{
+				if(bytes_to_skip >= run_vectors->iov_len)
+				{
+					bytes_to_skip -= run_vectors->iov_len;
+					++run_vectors;
+					--vectors_count;
+				}
+				else
+				{
+					run_vectors->iov_base = (BYTE*)run_vectors->iov_base + bytes_to_skip;
+					run_vectors->iov_len -= bytes_to_skip;
+					bytes_to_skip = 0;
+				}
+			}
+		}
+
+		bytes_transferred += run_transferred;
+
+		if(run_transferred != run_size)
+			break;
+	}
+
+	return bytes_transferred;
+}
+
+int TEFilePosixBackend::GetDescriptor()
+{
+	return m_file_descriptor;
+}
+
+bool TEFilePosixBackend::OpenDescriptor(const std::string& file_name, int flags)
+{
+	do
+	{
+		m_file_descriptor = open(file_name.c_str(), flags, 0644);
+	}
+	while(m_file_descriptor < 0 && errno == EINTR);
+
+	return m_file_descriptor >= 0;
+}
+
+#endif
@@ -0,0 +1,77 @@
+#include <TEFileReadPlanner.h>
+#include <TEFileVectorIO.h>
+
+TEFileReadPlanner::TEFileReadPlanner()
+	: m_order(EF_READ_PHYSICAL)
+	, m_gap_tolerance(EF_READ_GAP_TOLERANCE)
+{
+}
+
+TEFileReadPlanner::~TEFileReadPlanner(void)
+{
+}
+
+void TEFileReadPlanner::SetOrder(const TEFileReadOrder& order, const size_file_t& gap_tolerance)
+{
+	m_order = order;
+	m_gap_tolerance = gap_tolerance;
+	m_gap_buffer.clear();
+}
+
+const TEFileReadOrder& TEFileReadPlanner::GetOrder() const
+{
+	return m_order;
+}
+
+const size_file_t& TEFileReadPlanner::GetGapTolerance() const
+{
+	return m_gap_tolerance;
+}
+
+size_file_t TEFileReadPlanner::Read(const TEFileHandle& file_handle, const TEFileIOSegments& segments)
+{
+	if(m_order == EF_READ_LOGICAL || segments.size() < 2)
+		return TEFileVectorIO::Read(file_handle, segments);
+
+	m_segments_order.resize(segments.size());
+	for(size_t segment_index = 0; segment_index < segments.size(); ++segment_index)
+		m_segments_order[segment_index] = segment_index;
+
+	std::sort(m_segments_order.begin(), m_segments_order.end(), TAddrLess(segments));
+
+	if(m_gap_tolerance > 0 && m_gap_buffer.empty())
+		m_gap_buffer.resize(m_gap_tolerance);
+
+	// Segments in the physical order with the small holes between them
+	m_plan.clear();
+	m_segments_ends.resize(segments.size());
+
+	size_file_t planned_size(0);
+	for(std::vector<size_t>::iterator index_it = m_segments_order.begin(); index_it != m_segments_order.end(); ++index_it)
+	{
+		const TEFileIOSegment& segment = segments[*index_it];
+
+		if(!m_plan.empty())
+		{
+			size_file_t plan_end = m_plan.back().Addr + m_plan.back().Size;
+			if(segment.Addr > plan_end && segment.Addr - plan_end <= m_gap_tolerance)
+			{
+				TEFileVectorIO::AddSegment(m_plan, plan_end, segment.Addr - plan_end, &m_gap_buffer[0]);
+				planned_size += segment.Addr - plan_end;
+			}
+		}
+
+		TEFileVectorIO::AddSegment(m_plan, segment.Addr, segment.Size, segment.Buffer);
+		planned_size += segment.Size;
+		m_segments_ends[*index_it] = planned_size;
+	}
+
+	size_file_t bytes_planned_read = TEFileVectorIO::Read(file_handle, m_plan);
+
+	// The caller gets only the logically continuous part of the data
+	size_file_t bytes_read(0);
+	for(size_t segment_index = 0; segment_index < segments.size() && m_segments_ends[segment_index] <= bytes_planned_read; ++segment_index)
+		bytes_read += segments[segment_index].Size;
+
+	return bytes_read;
+}
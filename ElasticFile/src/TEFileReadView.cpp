@@ -0,0 +1,41 @@
+#include <TEFileReadView.h>
+
+TEFileReadView::TEFileReadView()
+	: m_size(0)
+	, m_generation(0)
+{
+}
+
+TEFileReadView::~TEFileReadView(void)
+{
+}
+
+TEFileReadView::const_iterator TEFileReadView::begin() const
+{
+	return m_spans.begin();
+}
+
+TEFileReadView::const_iterator TEFileReadView::end() const
+{
+	return m_spans.end();
+}
+
+bool TEFileReadView::empty() const
+{
+	return m_spans.empty();
+}
+
+size_t TEFileReadView::size() const
+{
+	return m_spans.size();
+}
+
+size_file_t TEFileReadView::GetSize() const
+{
+	return m_size;
+}
+
+bool TEFileReadView::IsValid() const
+{
+	return m_file_generation && *m_file_generation == m_generation;
+}
@@ -0,0 +1,395 @@
+#include <efile_types.h>
+
+TEFileSectorsList::TEFileSectorsList(TEFileNodePool& pool)
+	: m_begin(&m_header)
+	, m_pool(pool)
+	, m_size(0)
+	, m_seed(2463534242u)
+{
+}
+
+TEFileSectorsList::~TEFileSectorsList()
+{
+	clear();
+}
+
+TEFileSectorsList::iterator TEFileSectorsList::begin()
+{
+	return iterator(m_begin);
+}
+
+TEFileSectorsList::iterator TEFileSectorsList::end()
+{
+	return iterator(&m_header);
+}
+
+TEFileSectorsList::reverse_iterator TEFileSectorsList::rbegin()
+{
+	return reverse_iterator(end());
+}
+
+TEFileSectorsList::reverse_iterator TEFileSectorsList::rend()
+{
+	return reverse_iterator(begin());
+}
+
+bool TEFileSectorsList::empty() const
+{
+	return m_size == 0;
+}
+
+size_t TEFileSectorsList::size() const
+{
+	return m_size;
+}
+
+TEFileSectorsList::iterator TEFileSectorsList::insert(iterator before, const TEFileSector& sector)
+{
+	TEFileSectorsListNode* node = CreateNode(sector);
+
+	Link(node, before.Node());
+	m_size++;
+
+	return iterator(node);
+}
+
+TEFileSectorsList::iterator TEFileSectorsList::erase(iterator sector_it)
+{
+	TEFileSectorsListNode* node = sector_it.Node();
+	TEFileSectorsListNode* next = Next(node);
+
+	Unlink(node);
+	DeleteNode(node);
+	m_size--;
+
+	return iterator(next);
+}
+
+void TEFileSectorsList::splice(iterator before, TEFileSectorsList& list, iterator sector_it)
+{
+	TEFileSectorsListNode* node = sector_it.Node();
+
+	if(node == before.Node() || Next(node) == before.Node())
+		return;
+
+	list.Unlink(node);
+	list.m_size--;
+
+	Link(node, before.Node());
+	m_size++;
+}
+
+void TEFileSectorsList::clear()
+{
+	Destroy(m_header.Left);
+	m_header.Left = NULL;
+	m_begin = &m_header;
+	m_size = 0;
+}
+
+void TEFileSectorsList::Build(const TEFileSector* sectors, size_t count, const size_file_t* data_offsets)
+{
+	if(count == 0)
+		return;
+
+	// Cartesian tree construction: the right spine of the tree is kept in the stack.
+	// The subtree of a node covers a continuous range of sectors, so its data size is
+	// the difference of the offsets at the range bounds
+	std::vector<TEFileSectorsListNode*> nodes(count);
+	std::vector<size_t> first_in_subtree(count);
+	std::vector<size_t> stack;
+	stack.reserve(64);
+
+	for(size_t index = 0; index < count; ++index)
+	{
+		TEFileSectorsListNode* node = CreateNode(sectors[index]);
+		nodes[index] = node;
+		first_in_subtree[index] = index;
+
+		// Nodes with lower priorities become the left subtree of the new node
+		while(!stack.empty() && nodes[stack.back()]->Priority < node->Priority)
+		{
+			size_t child_index = stack.back();
+			stack.pop_back();
+
+			nodes[child_index]->SubtreeDataSize = data_offsets[index] - data_offsets[first_in_subtree[child_index]];
+			node->Left = nodes[child_index];
+			first_in_subtree[index] = first_in_subtree[child_index];
+		}
+
+		if(node->Left != NULL)
+			node->Left->Parent = node;
+
+		if(!stack.empty())
+		{
+			nodes[stack.back()]->Right = node;
+			node->Parent = nodes[stack.back()];
+		}
+
+		stack.push_back(index);
+	}
+
+	// The rest of the right spine ends with the last sector
+	for(std::vector<size_t>::iterator index_it = stack.begin(); index_it != stack.end(); ++index_it)
+		nodes[*index_it]->SubtreeDataSize = data_offsets[count] - data_offsets[first_in_subtree[*index_it]];
+
+	m_header.Left = nodes[stack.front()];
+	m_header.Left->Parent = &m_header;
+	m_begin = nodes.front();
+	m_size = count;
+}
+
+void TEFileSectorsList::Update(iterator sector_it)
+{
+	UpdatePath(sector_it.Node());
+}
+
+size_file_t TEFileSectorsList::GetDataSize() const
+{
+	return SubtreeDataSize(m_header.Left);
+}
+
+size_file_t TEFileSectorsList::GetPosition(iterator sector_it) const
+{
+	const TEFileSectorsListNode* node = sector_it.Node();
+
+	if(node == &m_header)
+		return GetDataSize();
+
+	size_file_t position = SubtreeDataSize(node->Left);
+	for(const TEFileSectorsListNode* parent = node->Parent; parent != &m_header; node = parent, parent = parent->Parent)
+	{
+		if(parent->Right == node)
+			position += SubtreeDataSize(parent->Left) + DataSize(parent);
+	}
+
+	return position;
+}
+
+TEFileSectorsList::iterator TEFileSectorsList::Find(size_file_t position, size_file_t& offset_in_sector, size_t& nodes_visited)
+{
+	TEFileSectorsListNode* node = m_header.Left;
+
+	while(node != NULL)
+	{
+		nodes_visited++;
+
+		size_file_t left_size = SubtreeDataSize(node->Left);
+
+		if(position < left_size)
+		{
+			node = node->Left;
+			continue;
+		}
+
+		position -= left_size;
+		size_file_t sector_size = DataSize(node);
+
+		if(position < sector_size)
+		{
+			offset_in_sector = position;
+			return iterator(node);
+		}
+
+		position -= sector_size;
+		node = node->Right;
+	}
+
+	offset_in_sector = position;
+	return end();
+}
+
+TEFileSectorsListNode* TEFileSectorsList::Next(TEFileSectorsListNode* node)
+{
+	if(node->Right != NULL)
+	{
+		node = node->Right;
+		while(node->Left != NULL)
+			node = node->Left;
+
+		return node;
+	}
+
+	TEFileSectorsListNode* parent = node->Parent;
+	while(parent->Right == node)
+	{
+		node = parent;
+		parent = parent->Parent;
+	}
+
+	return parent;
+}
+
+TEFileSectorsListNode* TEFileSectorsList::Prev(TEFileSectorsListNode* node)
+{
+	if(node->Left != NULL)
+	{
+		node = node->Left;
+		while(node->Right != NULL)
+			node = node->Right;
+
+		return node;
+	}
+
+	TEFileSectorsListNode* parent = node->Parent;
+	while(parent->Left == node)
+	{
+		node = parent;
+		parent = parent->Parent;
+	}
+
+	return parent;
+}
+
+void TEFileSectorsList::Link(TEFileSectorsListNode* node, TEFileSectorsListNode* before)
+{
+	node->Left = NULL;
+	node->Right = NULL;
+
+	// Attach as a leaf which is the in-order predecessor of 'before'
+	TEFileSectorsListNode* parent = before;
+	if(parent->Left == NULL)
+	{
+		parent->Left = node;
+	}
+	else
+	{
+		parent = parent->Left;
+		while(parent->Right != NULL)
+			parent = parent->Right;
+
+		parent->Right = node;
+	}
+
+	node->Parent = parent;
+
+	if(before == m_begin)
+		m_begin = node;
+
+	UpdatePath(node);
+
+	// Restore the heap order of priorities
+	while(node->Parent != &m_header && node->Priority > node->Parent->Priority)
+		Rotate(node);
+}
+
+void TEFileSectorsList::Unlink(TEFileSectorsListNode* node)
+{
+	if(node == m_begin)
+		m_begin = Next(node);
+
+	// Rotate the node down until it has at most one child
+	while(node->Left != NULL && node->Right != NULL)
+	{
+		TEFileSectorsListNode* child = node->Left->Priority > node->Right->Priority ? node->Left : node->Right;
+		Rotate(child);
+	}
+
+	TEFileSectorsListNode* child = node->Left != NULL ? node->Left : node->Right;
+	TEFileSectorsListNode* parent = node->Parent;
+
+	if(child != NULL)
+		child->Parent = parent;
+
+	if(parent->Left == node)
+		parent->Left = child;
+	else
+		parent->Right = child;
+
+	node->Parent = NULL;
+	node->Left = NULL;
+	node->Right = NULL;
+
+	UpdatePath(parent);
+}
+
+void TEFileSectorsList::Rotate(TEFileSectorsListNode* node)
+{
+	// Rotate the node over its parent keeping the in-order sequence
+	TEFileSectorsListNode* parent = node->Parent;
+	TEFileSectorsListNode* grand_parent = parent->Parent;
+
+	if(parent->Left == node)
+	{
+		parent->Left = node->Right;
+		if(node->Right != NULL)
+			node->Right->Parent = parent;
+
+		node->Right = parent;
+	}
+	else
+	{
+		parent->Right = node->Left;
+		if(node->Left != NULL)
+			node->Left->Parent = parent;
+
+		node->Left = parent;
+	}
+
+	parent->Parent = node;
+	node->Parent = grand_parent;
+
+	if(grand_parent->Left == parent)
+		grand_parent->Left = node;
+	else
+		grand_parent->Right = node;
+
+	Recalculate(parent);
+	Recalculate(node);
+}
+
+void TEFileSectorsList::UpdatePath(TEFileSectorsListNode* node)
+{
+	for(; node != &m_header; node = node->Parent)
+		Recalculate(node);
+}
+
+void TEFileSectorsList::Destroy(TEFileSectorsListNode* node)
+{
+	while(node != NULL)
+	{
+		Destroy(node->Left);
+		TEFileSectorsListNode* right = node->Right;
+		DeleteNode(node);
+		node = right;
+	}
+}
+
+unsigned int TEFileSectorsList::GeneratePriority()
+{
+	// xorshift32
+	m_seed ^= m_seed << 13;
+	m_seed ^= m_seed >> 17;
+	m_seed ^= m_seed << 5;
+	return m_seed;
+}
+
+TEFileSectorsListNode* TEFileSectorsList::CreateNode(const TEFileSector& sector)
+{
+	TEFileSectorsListNode* node = new(m_pool.Allocate(sizeof(TEFileSectorsListNode))) TEFileSectorsListNode();
+	node->Sector = sector;
+	node->Priority = GeneratePriority();
+
+	return node;
+}
+
+void TEFileSectorsList::DeleteNode(TEFileSectorsListNode* node)
+{
+	node->~TEFileSectorsListNode();
+	m_pool.Deallocate(node, sizeof(TEFileSectorsListNode));
+}
+
+void TEFileSectorsList::Recalculate(TEFileSectorsListNode* node)
+{
+	node->SubtreeDataSize = SubtreeDataSize(node->Left) + DataSize(node) + SubtreeDataSize(node->Right);
+}
+
+size_file_t TEFileSectorsList::SubtreeDataSize(const TEFileSectorsListNode* node)
+{
+	return node == NULL ? 0 : node->SubtreeDataSize;
+}
+
+size_file_t TEFileSectorsList::DataSize(const TEFileSectorsListNode* node)
+{
+	return node->Sector.Free ? 0 : node->Sector.SectorSize;
+}
@@ -1,12 +1,29 @@
 #include <TEFileSectorsTable.h>
 #include <TEFileException.h>
 #include <ElasticFile.h>
+#include <TEFileTableCodec.h>
+#include <TEFileBackend.h>
+#include <TEFileSpans.h>
 
 TEFileSectorsTable::TEFileSectorsTable(ElasticFile& file)
-	: m_file_size(0)
+	: m_sectors_list(m_pool)
+	, m_sectors_map(TEFileSectorsMap::key_compare(), TEFileSectorsMap::allocator_type(&m_pool))
+	, m_file_size(0)
 	, m_data_size(0)
 	, m_sectors_count(0)
 	, m_file(file)
+	, m_free_sectors_map(TEFileSectorsMap::key_compare(), TEFileSectorsMap::allocator_type(&m_pool))
+	, m_free_sectors_sizes(TEFileFreeSectorsSizes::key_compare(), TEFileFreeSectorsSizes::allocator_type(&m_pool))
+	, m_allocation_policy(EF_ALLOCATE_BEST_FIT)
+	, m_base_addr(EF_NO_SECTOR)
+	, m_last_chunk_addr(EF_NO_SECTOR)
+	, m_journal_records(0)
+	, m_journal_valid(false)
+	, m_journal_suspended(0)
+	, m_changes_count(0)
+	, m_epochs(new TEFileEpochs())
+	, m_retired_version(EF_NO_EPOCH)
+	, m_relocating(false)
 {
 }
 
@@ -14,22 +31,10 @@ TEFileSectorsTable::~TEFileSectorsTable()
 {
 	m_sectors_map.clear();
 	m_free_sectors_map.clear();
+	m_free_sectors_sizes.clear();
 	m_sectors_list.clear();
 }
 
-TEFileSectorsList::iterator TEFileSectorsTable::GetFirstFreeSector() 
-{
-	if(!m_free_sectors_map.empty())
-		return m_free_sectors_map.begin()->second;
-
-	return m_sectors_list.end();
-}
-
-size_file_t TEFileSectorsTable::GetTableSize() const
-{
-	return m_sectors_count * sizeof(TEFileSector) + sizeof(TEFileSectorsCount);
-}
-
 size_file_t TEFileSectorsTable::MinFileSize() const
 {
 	return m_sectors_count * sizeof(BYTE);
@@ -37,33 +42,66 @@ size_file_t TEFileSectorsTable::MinFileSize() const
 
 TEFileSectorsList::iterator TEFileSectorsTable::AllocateNewSector(size_file_t size_to_allocate)
 {
+	KeepFooter(size_to_allocate);
+
 	TEFileSector sector;
 	sector.Free = 1;
 	sector.SectorAddr = m_file_size;
 	sector.SectorSize = size_to_allocate;
 
+	EF_COUNT(m_file.GetCounters(), EF_COUNTER_ALLOCATIONS, 1);
+
 	return InsertSector(sector, m_sectors_list.end());
 }
 
+void TEFileSectorsTable::AllocateNewSectors(size_file_t size_to_allocate, TEFileSectorsIterators& allocated_sectors_iterators)
+{
+	while(size_to_allocate > 0)
+	{
+		size_file_t sector_size = std::min<size_file_t>(size_to_allocate, (size_file_t)EF_MAX_SECTOR_SIZE);
+		allocated_sectors_iterators.push_back(AllocateNewSector(sector_size));
+		size_to_allocate -= sector_size;
+	}
+}
+
 void TEFileSectorsTable::Allocate(size_file_t size_to_allocate, TEFileSectorsIterators& allocated_sectors_iterators)
 {
-	TEFileSectorsList::iterator firstFreeSector_it = GetFirstFreeSector();
+	ReclaimSectors();
+
+	if(m_allocation_policy != EF_ALLOCATE_FILL_HOLES)
+	{
+		// Take one free sector for the whole data in order not to fragment it
+		TEFileSectorsList::iterator sector_it = FindFreeSector(size_to_allocate, m_allocation_policy == EF_ALLOCATE_EXACT_FIT);
+		if(sector_it == m_sectors_list.end())
+		{
+			AllocateNewSectors(size_to_allocate, allocated_sectors_iterators);
+			return;
+		}
+
+		if(size_to_allocate < sector_it->SectorSize)
+			SplitSector(sector_it, size_to_allocate);
+
+		EF_COUNT(m_file.GetCounters(), EF_COUNTER_ALLOCATIONS, 1);
+
+		allocated_sectors_iterators.push_back(sector_it);
+		return;
+	}
+
 	size_file_t bytes_allocated(0);
 
 	// Try to fill holes in file space
-	TEFileSectorsList::iterator sector_it;
-	for(sector_it = firstFreeSector_it; sector_it != m_sectors_list.end(); ++sector_it)
+	for(TEFileSectorsMap::iterator free_it = m_free_sectors_map.begin(); free_it != m_free_sectors_map.end(); ++free_it)
 	{
-		TEFileSector sector = *sector_it;
-		if(!sector.Free)
-			continue;
+		TEFileSectorsList::iterator sector_it = free_it->second;
 
 		size_file_t bytes_to_allocate = size_to_allocate - bytes_allocated;
-		if(bytes_to_allocate < sector.SectorSize)
+		if(bytes_to_allocate < sector_it->SectorSize)
 			SplitSector(sector_it, bytes_to_allocate);
-		else if(bytes_to_allocate > sector.SectorSize)
-			bytes_to_allocate = sector.SectorSize;
-			
+		else if(bytes_to_allocate > sector_it->SectorSize)
+			bytes_to_allocate = sector_it->SectorSize;
+
+		EF_COUNT(m_file.GetCounters(), EF_COUNTER_ALLOCATIONS, 1);
+
 		allocated_sectors_iterators.push_back(sector_it);
 
 		bytes_allocated += bytes_to_allocate;
@@ -74,12 +112,130 @@ void TEFileSectorsTable::Allocate(size_file_t size_to_allocate, TEFileSectorsIte
 
 	size_file_t bytes_to_allocate = size_to_allocate - bytes_allocated;
 
-	// Create a new sector
-	if(bytes_to_allocate > 0)
+	// Create new sectors
+	AllocateNewSectors(bytes_to_allocate, allocated_sectors_iterators);
+}
+
+TEFileSectorsList::iterator TEFileSectorsTable::FindFreeSector(size_file_t size, bool exact)
+{
+	// The first free sector not less than the size. Of the same size ones the lowest address is taken
+	TEFileFreeSectorsSizes::iterator size_it = m_free_sectors_sizes.lower_bound(std::make_pair(size, (size_file_t)0));
+
+	if(size_it == m_free_sectors_sizes.end() || (exact && size_it->first != size))
+		return m_sectors_list.end();
+
+	return m_free_sectors_map[size_it->second];
+}
+
+void TEFileSectorsTable::AddFreeSector(TEFileSectorsList::iterator sector_it)
+{
+	if(IsRetired(sector_it->SectorAddr))
+		return;
+
+	m_free_sectors_map[sector_it->SectorAddr] = sector_it;
+	m_free_sectors_sizes.insert(TEFileFreeSectorSize((size_file_t)sector_it->SectorSize, sector_it->SectorAddr));
+}
+
+void TEFileSectorsTable::RemoveFreeSector(TEFileSectorsList::iterator sector_it)
+{
+	m_free_sectors_map.erase(sector_it->SectorAddr);
+	m_free_sectors_sizes.erase(TEFileFreeSectorSize((size_file_t)sector_it->SectorSize, sector_it->SectorAddr));
+}
+
+void TEFileSectorsTable::ReclaimSectors()
+{
+	if(m_retired_sectors.empty() || m_relocating)
+		return;
+
+	// Snapshots made after a sector was freed don't refer to it
+	size_t oldest_version = m_epochs->GetOldest();
+	if(oldest_version < m_retired_version)
+		return;
+
+	m_retired_version = EF_NO_EPOCH;
+	for(std::map<size_file_t, size_t>::iterator retired_it = m_retired_sectors.begin(); retired_it != m_retired_sectors.end();)
 	{
-		sector_it = AllocateNewSector(bytes_to_allocate);
-		allocated_sectors_iterators.push_back(sector_it);
+		if(oldest_version < retired_it->second)
+		{
+			m_retired_version = std::min<size_t>(m_retired_version, retired_it->second);
+			++retired_it;
+			continue;
+		}
+
+		TEFileSectorsList::iterator sector_it = FindSector(retired_it->first);
+		m_retired_sectors.erase(retired_it++);
+		AddFreeSector(sector_it);
+	}
+}
+
+void TEFileSectorsTable::RetireSector(size_file_t sector_addr)
+{
+	m_retired_sectors[sector_addr] = m_changes_count;
+	m_retired_version = std::min<size_t>(m_retired_version, m_changes_count);
+}
+
+bool TEFileSectorsTable::IsRetired(size_file_t sector_addr) const
+{
+	return !m_retired_sectors.empty() && m_retired_sectors.count(sector_addr) != 0;
+}
+
+bool TEFileSectorsTable::IsSpacePinned()
+{
+	ReclaimSectors();
+	return !m_retired_sectors.empty() || m_epochs->GetOldest() != EF_NO_EPOCH;
+}
+
+bool TEFileSectorsTable::IsJournalValid() const
+{
+	return m_journal_valid;
+}
+
+void TEFileSectorsTable::BeginRelocation()
+{
+	m_relocating = true;
+}
+
+void TEFileSectorsTable::EndRelocation()
+{
+	if(!m_relocating)
+		return;
+
+	// No snapshot is pinned while the space is relocated, so all the retired sectors are free now
+	m_relocating = false;
+	ReclaimSectors();
+}
+
+void TEFileSectorsTable::KeepFooter(size_file_t sector_size)
+{
+	size_file_t file_size(0);
+	if(!m_relocating || !m_file.GetHandle()->GetSize(file_size))
+		return;
+
+	// The footer after the sectors describes the table on the disk, so new sectors go after it
+	while(m_file_size < file_size)
+	{
+		TEFileSector sector;
+		sector.Free = EF_SECTOR_FREE;
+		sector.SectorAddr = m_file_size;
+		sector.SectorSize = std::min<size_file_t>(file_size - m_file_size, (size_file_t)EF_MAX_SECTOR_SIZE);
+
+		RetireSector(sector.SectorAddr);
+		InsertSector(sector, m_sectors_list.end());
 	}
+
+	// The footer is found in the end of the file, so it is copied to the end of the new sector first
+	if(!WriteFooter(m_file_size + sector_size))
+		throw TEFileException(EF_WRITE_DATA_ERROR, STRING("Can't write the footer to " << m_file_size + sector_size));
+}
+
+void TEFileSectorsTable::SetAllocationPolicy(TEFileAllocationPolicy policy)
+{
+	m_allocation_policy = policy;
+}
+
+TEFileAllocationPolicy TEFileSectorsTable::GetAllocationPolicy() const
+{
+	return m_allocation_policy;
 }
 
 TEFileSectorsList::iterator TEFileSectorsTable::InsertSector(const TEFileSector& sector, TEFileSectorsList::iterator before)
@@ -87,10 +243,12 @@ TEFileSectorsList::iterator TEFileSectorsTable::InsertSector(const TEFileSector&
 	TEFileSectorsList::iterator new_sector_it = m_sectors_list.insert(before, sector);
 	m_sectors_map[sector.SectorAddr] = new_sector_it;
 
-	if(!sector.Free)
+	if(sector.Free == EF_SECTOR_DATA)
 		m_data_size += sector.SectorSize;
-	else
-		m_free_sectors_map[sector.SectorAddr] = new_sector_it;
+	else if(sector.Free == EF_SECTOR_FREE)
+		AddFreeSector(new_sector_it);
+
+	Journal(EF_JOURNAL_INSERT, sector.SectorAddr, sector.SectorSize, GetSectorAddr(before), sector.Free);
 
 	m_file_size += sector.SectorSize;
 
@@ -158,11 +316,7 @@ std::pair<TEFileSectorsList::iterator, TEFileSectorsList::iterator> TEFileSector
 	TEFileSectorsList::iterator free_part_it = first_split.second;
 	SetSectorFree(free_part_it, 1);
 
-	TEFileSectorsList::iterator next_sector_it = std::next(free_part_it);
-	while(next_sector_it != m_sectors_list.end() && next_sector_it->Free)
-		++next_sector_it;
-
-	return std::pair<TEFileSectorsList::iterator, TEFileSectorsList::iterator>(free_part_it, next_sector_it);
+	return std::pair<TEFileSectorsList::iterator, TEFileSectorsList::iterator>(free_part_it, GetNextDataSector(free_part_it));
 }
 
 std::pair<TEFileSectorsList::iterator, TEFileSectorsList::iterator> TEFileSectorsTable::SplitSector(TEFileSectorsList::iterator sector_it, size_file_t offset_in_sector)
@@ -187,25 +341,70 @@ std::pair<TEFileSectorsList::iterator, TEFileSectorsList::iterator> TEFileSector
 	secondPart.SectorAddr = sector.SectorAddr + offset_in_sector;
 	secondPart.SectorSize = sector.SectorSize - offset_in_sector;
 
+	Journal(EF_JOURNAL_SPLIT, sector.SectorAddr, offset_in_sector, EF_NO_SECTOR, sector.Free);
+	EF_COUNT(m_file.GetCounters(), EF_COUNTER_SPLITS, 1);
+
+	if(sector.Free == EF_SECTOR_FREE)
+		RemoveFreeSector(sector_it);
+
 	sector.SectorSize = offset_in_sector;
+	m_sectors_list.Update(sector_it);
+
+	if(sector.Free == EF_SECTOR_FREE)
+		AddFreeSector(sector_it);
 
 	m_file_size -= secondPart.SectorSize;
 
-	if(!sector.Free)
+	if(sector.Free == EF_SECTOR_DATA)
 		m_data_size -= secondPart.SectorSize;
 
 
 	TEFileSectorsList::iterator next_sector_it = std::next(sector_it);
 
+	// The free space of a snapshot stays retired in both parts
+	if(sector.Free == EF_SECTOR_FREE && !m_retired_sectors.empty())
+	{
+		std::map<size_file_t, size_t>::iterator retired_it = m_retired_sectors.find(sector.SectorAddr);
+		if(retired_it != m_retired_sectors.end())
+			m_retired_sectors[secondPart.SectorAddr] = retired_it->second;
+	}
+
+	// The second part is a consequence of the split record
+	m_journal_suspended++;
 	TEFileSectorsList::iterator second_part_it = InsertSector(secondPart, next_sector_it);
+	m_journal_suspended--;
 
 	return std::pair<TEFileSectorsList::iterator, TEFileSectorsList::iterator>(sector_it, second_part_it);
 }
 
+TEFileSectorsList::iterator TEFileSectorsTable::GetSectorInPosition(const size_file_t& position, size_file_t& offset_in_sector)
+{
+	size_t sectors_visited(0);
+	TEFileSectorsList::iterator sector_it = m_sectors_list.Find(position, offset_in_sector, sectors_visited);
+
+	EF_COUNT(m_file.GetCounters(), EF_COUNTER_SECTORS_VISITED, sectors_visited);
+
+	return sector_it;
+}
+
+TEFileSectorsList::iterator TEFileSectorsTable::GetNextDataSector(TEFileSectorsList::iterator sector_it)
+{
+	if(sector_it == m_sectors_list.end())
+		return sector_it;
+
+	// The first data sector after a free one starts at the same logical position
+	size_file_t position = m_sectors_list.GetPosition(sector_it);
+	if(!sector_it->Free)
+		position += sector_it->SectorSize;
+
+	size_file_t offset_in_sector;
+	return GetSectorInPosition(position, offset_in_sector);
+}
+
 void TEFileSectorsTable::MoveSectorTo(TEFileSectorsList::iterator sector_it, size_file_t position)
 {
 	size_file_t offset_in_sector;
-	TEFileSectorsList::iterator sectorInPosition_it = m_file.GetCursor().GetSectorInPosition(position, offset_in_sector);
+	TEFileSectorsList::iterator sectorInPosition_it = GetSectorInPosition(position, offset_in_sector);
 
 	if(position != m_data_size && offset_in_sector != 0)
 		sectorInPosition_it = SplitSector(sectorInPosition_it, offset_in_sector).second;
@@ -216,7 +415,7 @@ void TEFileSectorsTable::MoveSectorTo(TEFileSectorsList::iterator sector_it, siz
 void TEFileSectorsTable::MoveSectorsTo(TEFileSectorsIterators& sectorsToMove, size_file_t position)
 {
 	size_file_t offset_in_sector;
-	TEFileSectorsList::iterator sector_in_position_it = m_file.GetCursor().GetSectorInPosition(position, offset_in_sector);
+	TEFileSectorsList::iterator sector_in_position_it = GetSectorInPosition(position, offset_in_sector);
 
 	if(position != m_data_size && offset_in_sector != 0)
 		sector_in_position_it = SplitSector(sector_in_position_it, offset_in_sector).second;
@@ -226,38 +425,56 @@ void TEFileSectorsTable::MoveSectorsTo(TEFileSectorsIterators& sectorsToMove, si
 
 void TEFileSectorsTable::Create()
 {
-	const TEFileHandle& file_handle = m_file.GetHandle();
-
 	Clear();
 
-	_fseeki64(file_handle, 0, SEEK_END);
+	size_file_t file_size(0);
+	m_file.GetHandle()->GetSize(file_size);
 
-	size_file_t file_size = ftell(file_handle);
-
-	if(file_size == 0)
-		return;
+	// The whole file is data
+	for(size_file_t sector_addr = 0; sector_addr < file_size; )
+	{
+		TEFileSector sector;
+		sector.Free = 0;
+		sector.SectorAddr = sector_addr;
+		sector.SectorSize = std::min<size_file_t>(file_size - sector_addr, (size_file_t)EF_MAX_SECTOR_SIZE);
 
-	TEFileSector sector;
-	sector.Free = 0;
-	sector.SectorAddr = 0;
-	sector.SectorSize = file_size;
+		InsertSector(sector, m_sectors_list.end());
 
-	InsertSector(sector, m_sectors_list.end());
+		sector_addr += sector.SectorSize;
+	}
 }
 
 void TEFileSectorsTable::Clear()
 {
+	m_changes_count++;
 	m_sectors_list.clear();
 	m_sectors_map.clear();
 	m_free_sectors_map.clear();
+	m_free_sectors_sizes.clear();
 	m_sectors_count = 0;
 	m_file_size = 0;
 	m_data_size = 0;
+
+	m_journal.clear();
+	m_table_sectors.clear();
+	m_base_addr = EF_NO_SECTOR;
+	m_last_chunk_addr = EF_NO_SECTOR;
+	m_journal_records = 0;
+	m_journal_valid = false;
+
+	// Snapshots of the closed file pin only the versions of their own
+	m_epochs.reset(new TEFileEpochs());
+	m_retired_sectors.clear();
+	m_retired_version = EF_NO_EPOCH;
+	m_relocating = false;
 }
 
 int TEFileSectorsTable::Load()
 {
+	TEFileSpanScope span("Sectors table Load");
+
 	int result = Parse();
+	span.SetSize(m_file_size);
 
 	if(result == EF_IO_ERROR) // If some low-level error
 		return result;
@@ -269,61 +486,472 @@ int TEFileSectorsTable::Load()
 
 int TEFileSectorsTable::Parse()
 {
-	const TEFileHandle& file_handle = m_file.GetHandle();
+	Clear();
 
-	if(_fseeki64(file_handle, 0, SEEK_END) != 0)
+	size_file_t file_size;
+	if(!m_file.GetHandle()->GetSize(file_size))
 		return EF_IO_ERROR;
 
-	size_file_t file_size = ftell(file_handle);
+	TEFileTableFooter footer;
+	footer.Magic = 0;
+	if(file_size >= sizeof(TEFileTableFooter))
+	{
+		if(!ReadTable(file_size - sizeof(TEFileTableFooter), &footer, sizeof(TEFileTableFooter)))
+			return EF_IO_ERROR;
+	}
 
-	TEFileSectorsCount sectors_count(0);
+	bool format32(false);
+	if(footer.Magic != EF_FOOTER_MAGIC)
+	{
+		// Files with 32-bit offsets have a shorter footer, files without the footer keep the whole table in the end
+		TEFileTableFooter32 footer32;
+		if(file_size < sizeof(TEFileTableFooter32))
+			return ParseLegacy(file_size);
+
+		if(!ReadTable(file_size - sizeof(TEFileTableFooter32), &footer32, sizeof(TEFileTableFooter32)))
+			return EF_IO_ERROR;
+
+		if(footer32.Magic != EF_FOOTER_MAGIC32)
+			return ParseLegacy(file_size);
+
+		footer.Magic = EF_FOOTER_MAGIC;
+		footer.BaseAddr = footer32.BaseAddr;
+		footer.LastChunkAddr = footer32.LastChunkAddr == EF_NO_SECTOR32 ? EF_NO_SECTOR : footer32.LastChunkAddr;
+		footer.JournalRecords = footer32.JournalRecords;
+		format32 = true;
+	}
 
-	if(file_size < sizeof(TEFileSectorsCount))
+	// Replay doesn't produce new journal records
+	m_journal_suspended++;
+	int result = ParseJournal(file_size, footer, format32);
+	m_journal_suspended--;
+
+	return result;
+}
+
+int TEFileSectorsTable::ParseJournal(size_file_t file_size, const TEFileTableFooter& footer, bool format32)
+{
+	DEVLOG( "read sectors table snapshot from " << footer.BaseAddr );
+
+	int result = ReadSnapshot(footer.BaseAddr, file_size, format32);
+	if(result != 0)
+		return result;
+
+	// Collect the journal chunks from the last one to the first one
+	std::vector<size_file_t> chunks;
+	for(size_file_t chunk_addr = footer.LastChunkAddr; chunk_addr != EF_NO_SECTOR; )
+	{
+		if(chunks.size() > footer.JournalRecords)
+			return EF_CANNOT_READ_SECTORS;
+
+		chunks.push_back(chunk_addr);
+
+		TEFileJournalHeader chunk_header;
+		if(!ReadChunkHeader(chunk_addr, format32, chunk_header))
+			return EF_CANNOT_READ_SECTORS;
+
+		chunk_addr = chunk_header.PrevChunkAddr;
+	}
+
+	DEVLOG( "replay " << footer.JournalRecords << " journal records in " << chunks.size() << " chunks" );
+
+	size_file_t records_count(0);
+	TEFileJournal records;
+	for(std::vector<size_file_t>::reverse_iterator chunk_it = chunks.rbegin(); chunk_it != chunks.rend(); ++chunk_it)
+	{
+		TEFileJournalHeader chunk_header;
+		if(!ReadChunkHeader(*chunk_it, format32, chunk_header))
+			return EF_CANNOT_READ_SECTORS;
+
+		records_count += chunk_header.RecordsCount;
+		if(records_count > footer.JournalRecords)
+			return EF_CANNOT_READ_SECTORS;
+
+		if(!ReadChunkRecords(*chunk_it, chunk_header, file_size, format32, records))
+			return EF_CANNOT_READ_SECTORS;
+
+		for(TEFileJournal::iterator record_it = records.begin(); record_it != records.end(); ++record_it)
+		{
+			if(!ApplyJournalRecord(*record_it))
+			{
+				DEVLOG( "journal record can't be applied" );
+				return EF_CANNOT_READ_SECTORS;
+			}
+		}
+	}
+
+	if(m_file_size > file_size - (format32 ? sizeof(TEFileTableFooter32) : sizeof(TEFileTableFooter)))
+	{
+		DEVLOG( "data corrupted" << std::endl );
+		return EF_FILE_DATA_LESS;
+	}
+
+	m_table_sectors.push_back(footer.BaseAddr);
+	m_table_sectors.insert(m_table_sectors.end(), chunks.rbegin(), chunks.rend());
+	m_base_addr = footer.BaseAddr;
+	m_last_chunk_addr = footer.LastChunkAddr;
+	m_journal_records = records_count;
+
+	// The table of a file with 32-bit offsets is written in the current format next time
+	m_journal_valid = !format32;
+
+	DEVLOG( "success" << std::endl );
+	return 0;
+}
+
+int TEFileSectorsTable::ReadSnapshot(size_file_t snapshot_addr, size_file_t file_size, bool format32)
+{
+	std::vector<TEFileSector> sectors;
+
+	if(format32)
+	{
+		TEFileTableHeader32 header;
+		if(!ReadTable(snapshot_addr, &header, sizeof(TEFileTableHeader32)) || header.Magic != EF_TABLE_MAGIC32)
+			return EF_CANNOT_READ_SECTORS_COUNT;
+
+		if(header.SectorsCount > file_size / sizeof(TEFileSector32))
+			return EF_CANNOT_READ_SECTORS;
+
+		DEVLOG( "read 32-bit sectors: " << header.SectorsCount );
+
+		// The whole table region is read by one call
+		std::vector<TEFileSector32> sectors32(header.SectorsCount);
+		if(!sectors32.empty() && !ReadTable(snapshot_addr + sizeof(TEFileTableHeader32), &sectors32[0], sectors32.size() * sizeof(TEFileSector32)))
+			return EF_CANNOT_READ_SECTORS;
+
+		sectors.resize(sectors32.size());
+		for(size_t index = 0; index < sectors32.size(); ++index)
+		{
+			sectors[index].SectorAddr = sectors32[index].SectorAddr;
+			sectors[index].SectorSize = sectors32[index].SectorSize;
+			sectors[index].Free = sectors32[index].Free;
+		}
+
+		return LoadSectors(sectors);
+	}
+
+	TEFileTableHeader header;
+	if(!ReadTable(snapshot_addr, &header, sizeof(TEFileTableHeader)) || header.Magic != EF_TABLE_MAGIC)
 		return EF_CANNOT_READ_SECTORS_COUNT;
 
-	if(_fseeki64(file_handle, file_size - sizeof(TEFileSectorsCount), SEEK_SET) != 0)
-		return EF_IO_ERROR;
+	// Every sector takes at least two bytes
+	if(header.RecordsSize > file_size || header.SectorsCount > header.RecordsSize / 2)
+		return EF_CANNOT_READ_SECTORS;
+
+	DEVLOG( "read sectors: " << header.SectorsCount );
+
+	m_table_data.resize(header.RecordsSize);
+	if(!m_table_data.empty() && !ReadTable(snapshot_addr + sizeof(TEFileTableHeader), &m_table_data[0], m_table_data.size()))
+		return EF_CANNOT_READ_SECTORS;
+
+	const BYTE* data = m_table_data.empty() ? NULL : &m_table_data[0];
+	const BYTE* data_end = data + m_table_data.size();
+
+	sectors.resize((size_t)header.SectorsCount);
+	size_file_t next_addr(0);
+	for(std::vector<TEFileSector>::iterator sector_it = sectors.begin(); sector_it != sectors.end(); ++sector_it)
+	{
+		if(!TEFileTableCodec::DecodeSector(data, data_end, next_addr, *sector_it))
+			return EF_CANNOT_READ_SECTORS;
+	}
+
+	if(data != data_end)
+		return EF_CANNOT_READ_SECTORS;
+
+	return LoadSectors(sectors);
+}
+
+bool TEFileSectorsTable::ReadChunkHeader(size_file_t chunk_addr, bool format32, TEFileJournalHeader& header)
+{
+	if(!format32)
+		return ReadTable(chunk_addr, &header, sizeof(TEFileJournalHeader)) && header.Magic == EF_JOURNAL_MAGIC;
+
+	TEFileJournalHeader32 header32;
+	if(!ReadTable(chunk_addr, &header32, sizeof(TEFileJournalHeader32)) || header32.Magic != EF_JOURNAL_MAGIC32)
+		return false;
+
+	header.Magic = EF_JOURNAL_MAGIC;
+	header.RecordsSize = 0;
+	header.PrevChunkAddr = header32.PrevChunkAddr == EF_NO_SECTOR32 ? EF_NO_SECTOR : header32.PrevChunkAddr;
+	header.RecordsCount = header32.RecordsCount;
+	return true;
+}
+
+bool TEFileSectorsTable::ReadChunkRecords(size_file_t chunk_addr, const TEFileJournalHeader& header, size_file_t file_size, bool format32, TEFileJournal& records)
+{
+	// The records follow the header
+	if(format32)
+	{
+		if(header.RecordsCount > file_size / sizeof(TEFileJournalRecord32))
+			return false;
+
+		std::vector<TEFileJournalRecord32> records32((size_t)header.RecordsCount);
+		if(!records32.empty() && !ReadTable(chunk_addr + sizeof(TEFileJournalHeader32), &records32[0], records32.size() * sizeof(TEFileJournalRecord32)))
+			return false;
+
+		records.resize(records32.size());
+		for(size_t index = 0; index < records32.size(); ++index)
+		{
+			records[index].Type = records32[index].Type;
+			records[index].State = records32[index].State;
+			records[index].SectorAddr = records32[index].SectorAddr;
+			records[index].Size = records32[index].Size;
+			records[index].NextAddr = records32[index].NextAddr == EF_NO_SECTOR32 ? EF_NO_SECTOR : records32[index].NextAddr;
+		}
+
+		return true;
+	}
+
+	// Every record takes at least three bytes
+	if(header.RecordsSize > file_size || header.RecordsCount > header.RecordsSize / 3)
+		return false;
+
+	m_table_data.resize(header.RecordsSize);
+	if(!m_table_data.empty() && !ReadTable(chunk_addr + sizeof(TEFileJournalHeader), &m_table_data[0], m_table_data.size()))
+		return false;
+
+	const BYTE* data = m_table_data.empty() ? NULL : &m_table_data[0];
+	const BYTE* data_end = data + m_table_data.size();
+
+	records.resize((size_t)header.RecordsCount);
+	size_file_t prev_addr(0);
+	for(TEFileJournal::iterator record_it = records.begin(); record_it != records.end(); ++record_it)
+	{
+		if(!TEFileTableCodec::DecodeRecord(data, data_end, prev_addr, *record_it))
+			return false;
+	}
+
+	return data == data_end;
+}
+
+bool TEFileSectorsTable::ApplyJournalRecord(const TEFileJournalRecord& record)
+{
+	TEFileSectorsList::iterator sector_it = FindSector(record.SectorAddr);
+
+	if(record.Type == EF_JOURNAL_INSERT)
+	{
+		if(sector_it != m_sectors_list.end() || record.Size == 0 || record.Size > EF_MAX_SECTOR_SIZE || record.State > EF_SECTOR_TABLE)
+			return false;
+
+		TEFileSectorsList::iterator before_it = FindSector(record.NextAddr);
+		if(before_it == m_sectors_list.end() && record.NextAddr != EF_NO_SECTOR)
+			return false;
+
+		TEFileSector sector;
+		sector.Free = record.State;
+		sector.SectorAddr = record.SectorAddr;
+		sector.SectorSize = record.Size;
+
+		InsertSector(sector, before_it);
+		return true;
+	}
+
+	if(sector_it == m_sectors_list.end())
+		return false;
+
+	switch(record.Type)
+	{
+	case EF_JOURNAL_SPLIT:
+		if(record.Size == 0 || record.Size >= sector_it->SectorSize)
+			return false;
+
+		SplitSector(sector_it, record.Size);
+		return true;
+
+	case EF_JOURNAL_UNITE:
+	{
+		TEFileSectorsList::iterator right_it = FindSector(record.NextAddr);
+		if(right_it == m_sectors_list.end() || sector_it->SectorAddr + sector_it->SectorSize != right_it->SectorAddr || !CanUniteSectors(*sector_it, *right_it))
+			return false;
+
+		UniteSectors(sector_it, right_it);
+		return true;
+	}
+
+	case EF_JOURNAL_FREE:
+		if(record.State > EF_SECTOR_TABLE)
+			return false;
+
+		SetSectorState(sector_it, record.State);
+		return true;
+
+	case EF_JOURNAL_MOVE:
+	{
+		TEFileSectorsList::iterator before_it = FindSector(record.NextAddr);
+		if(before_it == m_sectors_list.end() && record.NextAddr != EF_NO_SECTOR)
+			return false;
+
+		MoveSector(sector_it, before_it);
+		return true;
+	}
+
+	case EF_JOURNAL_EXTEND:
+		if(record.Size > (size_file_t)EF_MAX_SECTOR_SIZE - sector_it->SectorSize)
+			return false;
+
+		ExtendSector(sector_it, record.Size);
+		return true;
+
+	case EF_JOURNAL_REMOVE:
+		RemoveSector(sector_it);
+		return true;
+	}
+
+	return false;
+}
+
+int TEFileSectorsTable::ParseLegacy(size_file_t file_size)
+{
+	DWORD sectors_count(0);
+
+	if(file_size < sizeof(DWORD))
+		return EF_CANNOT_READ_SECTORS_COUNT;
 
-	
 	DEVLOG( "read sectors table:" );
 	CURRLOG( "sectors count: " );
 
-	if(fread(&sectors_count, sizeof(TEFileSectorsCount), 1, file_handle) != 1)
+	if(!ReadTable(file_size - sizeof(DWORD), &sectors_count, sizeof(DWORD)))
 	{
 		DEVLOG( "er" << std::endl );
 		return EF_IO_ERROR;
 	}
 	DEVLOG( sectors_count );
 
-	if(_fseeki64(file_handle, file_size - sizeof(TEFileSector)*sectors_count - sizeof(TEFileSectorsCount), SEEK_SET) != 0)
+	size_file_t table_size = sectors_count * sizeof(TEFileLegacySector) + sizeof(DWORD);
+	if(table_size > file_size)
 		return EF_CANNOT_READ_SECTORS;
 
-	m_data_size = 0;
+	int result = ReadLegacySectors(file_size - table_size, sectors_count);
+	if(result != 0)
+		return result;
 
-	DEVLOG( "read sectors: " );
-	TEFileSector sector;
-	size_t elements_to_read = 1;
-	for(size_file_t sector_number = 0; sector_number < sectors_count; ++sector_number)
+	size_file_t file_space = file_size - table_size;
+	if(m_file_size > file_space || m_file_size < MinFileSize())
 	{
-		if(fread(&sector, sizeof(TEFileSector), elements_to_read, file_handle) != elements_to_read)
-		{
-			DEVLOG( "error: " << errno << ", " << feof(file_handle) << ", " << ferror(file_handle));
+		DEVLOG( "data corrupted" << std::endl );
+		return EF_FILE_DATA_LESS;
+	}
+
+	DEVLOG( "success" << std::endl );
+	return 0;
+}
+
+int TEFileSectorsTable::ReadLegacySectors(size_file_t table_addr, size_file_t sectors_count)
+{
+	DEVLOG( "read legacy sectors: " << sectors_count );
+
+	std::vector<TEFileLegacySector> legacy_sectors((size_t)sectors_count);
+	if(sectors_count > 0 && !ReadTable(table_addr, &legacy_sectors[0], sectors_count * sizeof(TEFileLegacySector)))
+		return EF_CANNOT_READ_SECTORS;
+
+	// Sectors bigger than the packed size field allows are split
+	std::vector<TEFileSector> sectors;
+	sectors.reserve(sectors_count);
+	for(std::vector<TEFileLegacySector>::iterator legacy_it = legacy_sectors.begin(); legacy_it != legacy_sectors.end(); ++legacy_it)
+	{
+		if(legacy_it->Free > EF_SECTOR_FREE || legacy_it->SectorSize == 0)
 			return EF_CANNOT_READ_SECTORS;
+
+		for(size_file_t offset_in_sector = 0; offset_in_sector < legacy_it->SectorSize; )
+		{
+			TEFileSector sector;
+			sector.Free = legacy_it->Free;
+			sector.SectorAddr = legacy_it->SectorAddr + offset_in_sector;
+			sector.SectorSize = std::min<size_file_t>(legacy_it->SectorSize - offset_in_sector, (size_file_t)EF_MAX_SECTOR_SIZE);
+			sectors.push_back(sector);
+
+			offset_in_sector += sector.SectorSize;
 		}
+	}
+
+	return LoadSectors(sectors);
+}
+
+bool TEFileSectorsTable::ValidateSectors(const std::vector<TEFileSector>& sectors, std::vector<size_file_t>& data_offsets)
+{
+	size_t sectors_count = sectors.size();
+	const TEFileSector* sector = sectors.empty() ? NULL : &sectors[0];
 
-		DEVLOG( "[" << sector.SectorAddr << "," << sector.SectorSize << "," << (int)sector.Free << "]" );
+	data_offsets.resize(sectors_count + 1);
+	size_file_t* offset = &data_offsets[0];
 
-		InsertSector(sector, m_sectors_list.end());
+	// The loops have no branches in their bodies, so the compiler is able to vectorize them
+	unsigned int invalid(0);
+	for(size_t index = 0; index < sectors_count; ++index)
+		invalid |= (unsigned int)(sector[index].Free > EF_SECTOR_TABLE) | (unsigned int)(sector[index].SectorSize == 0);
+
+	// Logical positions of the sectors
+	size_file_t data_size(0);
+	offset[0] = 0;
+	for(size_t index = 0; index < sectors_count; ++index)
+	{
+		data_size += sector[index].SectorSize & (0 - (size_file_t)(sector[index].Free == EF_SECTOR_DATA));
+		offset[index + 1] = data_size;
 	}
 
-	size_file_t file_space = file_size - GetTableSize();
-	if(m_file_size > file_space || m_file_size < MinFileSize())
+	return invalid == 0;
+}
+
+int TEFileSectorsTable::LoadSectors(const std::vector<TEFileSector>& sectors)
+{
+	std::vector<size_file_t> data_offsets;
+	if(!ValidateSectors(sectors, data_offsets))
 	{
-		DEVLOG( "data corrupted" << std::endl );
-		return EF_FILE_DATA_LESS;
+		DEVLOG( "invalid sectors" );
+		return EF_CANNOT_READ_SECTORS;
 	}
 
-	DEVLOG( "success" << std::endl );
+	size_t sectors_count = sectors.size();
+
+	// Sectors must cover the file space from the beginning without gaps and overlaps
+	std::vector<std::pair<size_file_t, size_t> > sectors_by_addr(sectors_count);
+	for(size_t index = 0; index < sectors_count; ++index)
+		sectors_by_addr[index] = std::make_pair(sectors[index].SectorAddr, index);
+
+	std::sort(sectors_by_addr.begin(), sectors_by_addr.end());
+
+	size_file_t sector_addr(0);
+	for(size_t index = 0; index < sectors_count; ++index)
+	{
+		if(sectors_by_addr[index].first != sector_addr)
+		{
+			DEVLOG( "sectors overlap or have a gap at " << sector_addr );
+			return EF_CANNOT_READ_SECTORS;
+		}
+
+		sector_addr += sectors[sectors_by_addr[index].second].SectorSize;
+	}
+
+	m_sectors_list.Build(sectors_count > 0 ? &sectors[0] : NULL, sectors_count, &data_offsets[0]);
+
+	std::vector<TEFileSectorsList::iterator> sectors_iterators;
+	sectors_iterators.reserve(sectors_count);
+	for(TEFileSectorsList::iterator sector_it = m_sectors_list.begin(); sector_it != m_sectors_list.end(); ++sector_it)
+		sectors_iterators.push_back(sector_it);
+
+	// Addresses are sorted, so every insertion to the maps goes to the end
+	for(size_t index = 0; index < sectors_count; ++index)
+	{
+		TEFileSectorsList::iterator sector_it = sectors_iterators[sectors_by_addr[index].second];
+
+		m_sectors_map.insert(m_sectors_map.end(), std::make_pair(sector_it->SectorAddr, sector_it));
+
+		if(sector_it->Free == EF_SECTOR_FREE)
+			m_free_sectors_map.insert(m_free_sectors_map.end(), std::make_pair(sector_it->SectorAddr, sector_it));
+	}
+
+	std::vector<TEFileFreeSectorSize> free_sizes;
+	free_sizes.reserve(m_free_sectors_map.size());
+	for(TEFileSectorsMap::iterator free_it = m_free_sectors_map.begin(); free_it != m_free_sectors_map.end(); ++free_it)
+		free_sizes.push_back(TEFileFreeSectorSize((size_file_t)free_it->second->SectorSize, free_it->first));
+
+	std::sort(free_sizes.begin(), free_sizes.end());
+	m_free_sectors_sizes.insert(free_sizes.begin(), free_sizes.end());
+
+	m_sectors_count = sectors_count;
+	m_file_size = sector_addr;
+	m_data_size = data_offsets[sectors_count];
+
 	return 0;
 }
 
@@ -332,6 +960,16 @@ const size_file_t& TEFileSectorsTable::GetDataSize() const
 	return m_data_size;
 }
 
+const size_t& TEFileSectorsTable::GetChangesCount() const
+{
+	return m_changes_count;
+}
+
+const TEFileEpochsPtr& TEFileSectorsTable::GetEpochs() const
+{
+	return m_epochs;
+}
+
 const size_file_t& TEFileSectorsTable::GetFileSize() const
 {
 	return m_file_size;
@@ -353,34 +991,164 @@ TEFileSectorsMap& TEFileSectorsTable::FreeSectors()
 
 bool TEFileSectorsTable::Write()
 {
-	const TEFileHandle& file_handle = m_file.GetHandle();
+	TEFileSpanScope span("Sectors table Write");
+
+	// Only the changes are appended while the journal is small enough
+	if(!m_journal_valid || NeedCompaction())
+		return WriteSnapshot();
+
+	if(m_journal.empty())
+		return true;
+
+	return WriteJournal();
+}
+
+void TEFileSectorsTable::Rewrite()
+{
+	m_journal_valid = false;
+	m_journal.clear();
+}
+
+bool TEFileSectorsTable::NeedCompaction() const
+{
+	return m_journal_records + m_journal.size() > m_sectors_count + EF_JOURNAL_MIN_RECORDS;
+}
+
+bool TEFileSectorsTable::WriteSnapshot(size_file_t table_addr)
+{
+	std::vector<size_file_t> old_table_sectors;
+	old_table_sectors.swap(m_table_sectors);
+
+	m_journal_suspended++;
+
+	// The snapshot lists every sector including its own one, which can be split from a free sector.
+	// The allocation and the release of the old table change a few sectors, the space is reserved for them
+	size_file_t reserved_size = sizeof(TEFileTableHeader) + 4 * EF_MAX_ENCODED_SECTOR;
+
+	EncodeSectors(m_table_data);
+	TEFileSectorsList::iterator table_it = AllocateTableSector(reserved_size + m_table_data.size(), table_addr);
+
+	// The old snapshot and journal chunks become free space
+	for(std::vector<size_file_t>::iterator addr_it = old_table_sectors.begin(); addr_it != old_table_sectors.end(); ++addr_it)
+	{
+		TEFileSectorsList::iterator sector_it = FindSector(*addr_it);
+		if(sector_it == m_sectors_list.end())
+			continue;
+
+		SetSectorState(sector_it, EF_SECTOR_FREE);
+
+		TUniteResult unite_result;
+		CheckAndUniteSector(sector_it, unite_result);
+	}
+
+	// In the rare case when the final table doesn't fit, it takes other space
+	for(EncodeSectors(m_table_data); sizeof(TEFileTableHeader) + m_table_data.size() > table_it->SectorSize; EncodeSectors(m_table_data))
+	{
+		SetSectorState(table_it, EF_SECTOR_FREE);
+
+		TUniteResult unite_result;
+		CheckAndUniteSector(table_it, unite_result);
+
+		table_it = AllocateTableSector(reserved_size + m_table_data.size());
+	}
+
+	m_journal_suspended--;
 
-	_fseeki64(file_handle, 0, SEEK_END);
-	size_file_t file_size = ftell(file_handle);
+	m_journal.clear();
+	m_table_sectors.push_back(table_it->SectorAddr);
+	m_base_addr = table_it->SectorAddr;
+	m_last_chunk_addr = EF_NO_SECTOR;
+	m_journal_records = 0;
+	m_journal_valid = true;
 
-	size_file_t table_size = GetTableSize();
-	size_file_t free_space = file_size - m_file_size;
-	size_file_t table_position = free_space <= table_size ? m_file_size : file_size - table_size;
+	DEVLOG( "write sectors table snapshot (" << m_sectors_count << ") to " << m_base_addr ); 
 
-	DEVLOG( "write sectors table (" << m_sectors_count << "):" ); 
+	TEFileTableHeader header;
+	header.Magic = EF_TABLE_MAGIC;
+	header.RecordsSize = (DWORD)m_table_data.size();
+	header.SectorsCount = m_sectors_count;
 
-	if(_fseeki64(file_handle, table_position, SEEK_SET) != 0)
+	if(!WriteTable(m_base_addr, &header, sizeof(TEFileTableHeader)))
 		return false;
 
-	for(TEFileSectorsList::iterator sector_it = m_sectors_list.begin(); sector_it != m_sectors_list.end(); ++sector_it)
+	if(!m_table_data.empty() && !WriteTable(m_base_addr + sizeof(TEFileTableHeader), &m_table_data[0], m_table_data.size()))
 	{
-		CURRLOG( "[" << sector_it->SectorAddr << "," << sector_it->SectorSize << "," << (int)sector_it->Free << "] " );
-		if(fwrite(&(*sector_it), sizeof(TEFileSector), 1, file_handle) != 1)
-		{
-			CURRLOG( "er" << std::endl );
-			return false;
-		}
+		DEVLOG( "er" );
+		return false;
+	}
+
+	return WriteFooter();
+}
+
+bool TEFileSectorsTable::WriteJournal()
+{
+	// Allocation of the chunk adds at most two records to the journal, the records before are encoded the same
+	EncodeJournal(m_table_data);
+	TEFileSectorsList::iterator chunk_it = AllocateTableSector(sizeof(TEFileJournalHeader) + m_table_data.size() + 2 * EF_MAX_ENCODED_RECORD);
+	EncodeJournal(m_table_data);
+
+	TEFileJournalHeader header;
+	header.Magic = EF_JOURNAL_MAGIC;
+	header.RecordsSize = (DWORD)m_table_data.size();
+	header.PrevChunkAddr = m_last_chunk_addr;
+	header.RecordsCount = m_journal.size();
 
-		CURRLOG( "ok" << std::endl );
+	DEVLOG( "write " << m_journal.size() << " journal records to " << chunk_it->SectorAddr ); 
+
+	if(!WriteTable(chunk_it->SectorAddr, &header, sizeof(TEFileJournalHeader)))
+		return false;
+
+	if(!WriteTable(chunk_it->SectorAddr + sizeof(TEFileJournalHeader), &m_table_data[0], m_table_data.size()))
+	{
+		DEVLOG( "er" );
+		return false;
 	}
 
-	CURRLOG( "write size: " );
-	if(fwrite(&m_sectors_count, sizeof(TEFileSectorsCount), 1, file_handle) != 1)
+	m_table_sectors.push_back(chunk_it->SectorAddr);
+	m_last_chunk_addr = chunk_it->SectorAddr;
+	m_journal_records += m_journal.size();
+	m_journal.clear();
+
+	return WriteFooter();
+}
+
+void TEFileSectorsTable::EncodeSectors(std::vector<BYTE>& data)
+{
+	data.clear();
+
+	size_file_t next_addr(0);
+	for(TEFileSectorsList::iterator sector_it = m_sectors_list.begin(); sector_it != m_sectors_list.end(); ++sector_it)
+		TEFileTableCodec::EncodeSector(*sector_it, next_addr, data);
+}
+
+void TEFileSectorsTable::EncodeJournal(std::vector<BYTE>& data)
+{
+	data.clear();
+
+	size_file_t prev_addr(0);
+	for(TEFileJournal::iterator record_it = m_journal.begin(); record_it != m_journal.end(); ++record_it)
+		TEFileTableCodec::EncodeRecord(*record_it, prev_addr, data);
+}
+
+bool TEFileSectorsTable::WriteFooter()
+{
+	size_file_t file_size(0);
+	m_file.GetHandle()->GetSize(file_size);
+
+	// Rewrite the previous footer if it is in the end of the file
+	return WriteFooter(file_size > m_file_size + sizeof(TEFileTableFooter) ? file_size - sizeof(TEFileTableFooter) : m_file_size);
+}
+
+bool TEFileSectorsTable::WriteFooter(size_file_t footer_position)
+{
+	TEFileTableFooter footer;
+	footer.Magic = EF_FOOTER_MAGIC;
+	footer.Reserved = 0;
+	footer.BaseAddr = m_base_addr;
+	footer.LastChunkAddr = m_last_chunk_addr;
+	footer.JournalRecords = m_journal_records;
+
+	if(!WriteTable(footer_position, &footer, sizeof(TEFileTableFooter)))
 	{
 		DEVLOG( "er" );
 		return false;
@@ -390,16 +1158,191 @@ bool TEFileSectorsTable::Write()
 	return true;
 }
 
+bool TEFileSectorsTable::Shrink()
+{
+	size_file_t file_size(0);
+	m_file.GetHandle()->GetSize(file_size);
+
+	// Nothing to cut off when only the snapshot and the footer are after the data
+	if(m_free_sectors_map.empty() && m_retired_sectors.empty() && m_table_sectors.size() <= 1 && file_size <= m_file_size + sizeof(TEFileTableFooter))
+		return true;
+
+	DEVLOG( "shrink file of " << file_size << " bytes" );
+
+	// The old table is freed only when the new snapshot is on the disk, so the snapshot is never
+	// written over it. If the old table is right after the data, the snapshot goes to the end first
+	while(!m_journal_valid || m_table_sectors.size() != 1 || m_table_sectors.front() != m_data_size)
+	{
+		m_journal_valid = false;
+
+		BeginRelocation();
+		if(!WriteSnapshot(m_data_size) || !m_file.GetHandle()->Sync())
+			return false;
+		EndRelocation();
+	}
+
+	// Only free space is after the snapshot now
+	size_file_t tail_addr(m_file_size);
+	size_file_t tail_sectors(0);
+	for(TEFileSectorsMap::reverse_iterator map_it = m_sectors_map.rbegin(); map_it != m_sectors_map.rend() && map_it->second->Free == EF_SECTOR_FREE; ++map_it)
+	{
+		tail_addr = map_it->first;
+		tail_sectors++;
+	}
+
+	m_file.GetHandle()->GetSize(file_size);
+
+	// The removal of the free space is appended to the journal, then the footer is moved to the new end
+	// and the file is cut after it. A chunk or a footer which would overlap the old footer isn't written,
+	// the few bytes of the space stay in the file then
+	size_file_t chunk_size = tail_sectors > 0 ? sizeof(TEFileJournalHeader) + (tail_sectors + 2) * EF_MAX_ENCODED_RECORD : 0;
+	if(tail_addr + chunk_size + 2 * sizeof(TEFileTableFooter) > file_size)
+		return true;
+
+	if(tail_sectors > 0)
+	{
+		while(m_sectors_map.rbegin()->second->Free == EF_SECTOR_FREE)
+			RemoveSector(m_sectors_map.rbegin()->second);
+
+		if(!WriteJournal())
+			return false;
+	}
+
+	if(!WriteFooter(m_file_size) || !m_file.GetHandle()->Sync())
+		return false;
+
+	return ResizeFile(m_file_size + sizeof(TEFileTableFooter));
+}
+
+// The file system fills the new space with zeros, so growing the file writes nothing
+bool TEFileSectorsTable::ResizeFile(size_file_t file_size)
+{
+	return m_file.GetHandle()->Resize(file_size);
+}
+
+bool TEFileSectorsTable::ReadTable(size_file_t addr, void* buffer, size_file_t size)
+{
+	return m_file.GetHandle()->ReadAt(addr, (PBYTE)buffer, size) == size;
+}
+
+bool TEFileSectorsTable::WriteTable(size_file_t addr, const void* buffer, size_file_t size)
+{
+	EF_COUNT(m_file.GetCounters(), EF_COUNTER_TABLE_BYTES_WRITTEN, size);
+
+	return m_file.GetHandle()->WriteAt(addr, (const BYTE*)buffer, size) == size;
+}
+
+void TEFileSectorsTable::ReleaseTableSector(TEFileSectorsList::iterator sector_it)
+{
+	m_table_sectors.erase(std::remove(m_table_sectors.begin(), m_table_sectors.end(), sector_it->SectorAddr), m_table_sectors.end());
+
+	// The chain of the journal is broken, so the whole table is written next time
+	m_journal_valid = false;
+	m_journal.clear();
+
+	SetSectorState(sector_it, EF_SECTOR_FREE);
+
+	TUniteResult unite_result;
+	CheckAndUniteSector(sector_it, unite_result);
+}
+
+TEFileSectorsList::iterator TEFileSectorsTable::RelocateSector(TEFileSectorsList::iterator sector_it, TEFileSectorsList::iterator target_it)
+{
+	// The target takes the logical place and the state of the sector, the sector becomes free space
+	BYTE state = sector_it->Free;
+
+	MoveSector(target_it, sector_it);
+	SetSectorState(sector_it, EF_SECTOR_FREE);
+	SetSectorState(target_it, state);
+
+	TUniteResult unite_result;
+	CheckAndUniteSector(sector_it, unite_result);
+
+	if(CheckAndUniteSector(target_it, unite_result) != EF_UNITE_NONE)
+		return unite_result.first;
+
+	return target_it;
+}
+
+TEFileSectorsList::iterator TEFileSectorsTable::AllocateTableSector(size_file_t size, size_file_t table_addr)
+{
+	if(size > EF_MAX_SECTOR_SIZE)
+		throw TEFileException(EF_ALLOCATE_ERROR, STRING("Can't allocate " << size << " bytes for the sectors table"));
+
+	ReclaimSectors();
+	TEFileSectorsList::iterator sector_it = table_addr == EF_NO_SECTOR ? FindFreeSector(size, false) : FindSector(table_addr);
+
+	// The table is placed at the address if there is enough free space, otherwise in the end of the file
+	if(table_addr != EF_NO_SECTOR && sector_it != m_sectors_list.end() && (sector_it->Free != EF_SECTOR_FREE || IsRetired(table_addr) || sector_it->SectorSize < size))
+		sector_it = m_sectors_list.end();
+
+	EF_COUNT(m_file.GetCounters(), EF_COUNTER_ALLOCATIONS, 1);
+
+	if(sector_it == m_sectors_list.end())
+	{
+		KeepFooter(size);
+
+		TEFileSector sector;
+		sector.Free = EF_SECTOR_TABLE;
+		sector.SectorAddr = m_file_size;
+		sector.SectorSize = size;
+
+		return InsertSector(sector, m_sectors_list.end());
+	}
+
+	if(size < sector_it->SectorSize)
+		SplitSector(sector_it, size);
+
+	SetSectorState(sector_it, EF_SECTOR_TABLE);
+
+	return sector_it;
+}
+
+void TEFileSectorsTable::Journal(BYTE type, size_file_t sector_addr, size_file_t size, size_file_t next_addr, BYTE state)
+{
+	// Every change of the sectors passes here, even if it is not journaled
+	m_changes_count++;
+
+	// Without a base snapshot the whole table is written anyway
+	if(m_journal_suspended > 0 || !m_journal_valid)
+		return;
+
+	TEFileJournalRecord record;
+	memset(&record, 0, sizeof(TEFileJournalRecord));
+	record.Type = type;
+	record.State = state;
+	record.SectorAddr = sector_addr;
+	record.Size = size;
+	record.NextAddr = next_addr;
+
+	m_journal.push_back(record);
+}
+
+TEFileSectorsList::iterator TEFileSectorsTable::FindSector(size_file_t sector_addr)
+{
+	TEFileSectorsMap::iterator map_it = m_sectors_map.find(sector_addr);
+
+	return map_it == m_sectors_map.end() ? m_sectors_list.end() : map_it->second;
+}
+
+size_file_t TEFileSectorsTable::GetSectorAddr(TEFileSectorsList::iterator sector_it)
+{
+	return sector_it == m_sectors_list.end() ? EF_NO_SECTOR : sector_it->SectorAddr;
+}
+
 void TEFileSectorsTable::RemoveSector(TEFileSectorsList::iterator sector_it)
 {
 	if(sector_it == m_sectors_list.end())
 		return;
 
-	if(!sector_it->Free)
+	Journal(EF_JOURNAL_REMOVE, sector_it->SectorAddr, 0, EF_NO_SECTOR, sector_it->Free);
+
+	if(sector_it->Free == EF_SECTOR_DATA)
 		m_data_size -= sector_it->SectorSize;
-	else
-		m_free_sectors_map.erase(sector_it->SectorAddr);
+	else if(sector_it->Free == EF_SECTOR_FREE)
+		RemoveFreeSector(sector_it);
 
+	m_retired_sectors.erase(sector_it->SectorAddr);
 	m_file_size -= sector_it->SectorSize;
 
 	m_sectors_map.erase(sector_it->SectorAddr);
@@ -416,16 +1359,38 @@ size_file_t TEFileSectorsTable::GetSectorsCount() const
 
 void TEFileSectorsTable::SetSectorFree(TEFileSectorsList::iterator sector, bool free)
 {
-	if(free && sector->Free == 1)
+	SetSectorState(sector, free ? EF_SECTOR_FREE : EF_SECTOR_DATA);
+}
+
+void TEFileSectorsTable::SetSectorState(TEFileSectorsList::iterator sector, BYTE state)
+{
+	if(sector->Free == state)
 		return;
 
-	if(!free)
-		m_free_sectors_map.erase(sector->SectorAddr);
-	else
-		m_free_sectors_map[sector->SectorAddr] = sector;
+	Journal(EF_JOURNAL_FREE, sector->SectorAddr, 0, EF_NO_SECTOR, state);
+
+	if(sector->Free == EF_SECTOR_DATA)
+		m_data_size -= sector->SectorSize;
+	else if(sector->Free == EF_SECTOR_FREE)
+		RemoveFreeSector(sector);
+
+	// The freed data may be read by the snapshots or referred to by the table on the disk
+	if(state == EF_SECTOR_FREE && ((sector->Free == EF_SECTOR_DATA && m_epochs->GetOldest() != EF_NO_EPOCH) || m_relocating))
+	{
+		RetireSector(sector->SectorAddr);
+	}
+	else if(state != EF_SECTOR_FREE)
+	{
+		m_retired_sectors.erase(sector->SectorAddr);
+	}
 
-	sector->Free = free;
-	m_data_size += sector->SectorSize * (free ? -1 : 1);
+	sector->Free = state;
+	m_sectors_list.Update(sector);
+
+	if(state == EF_SECTOR_DATA)
+		m_data_size += sector->SectorSize;
+	else if(state == EF_SECTOR_FREE)
+		AddFreeSector(sector);
 }
 
 void TEFileSectorsTable::MoveSector(TEFileSectorsList::iterator sector_it, TEFileSectorsList::iterator before_it)
@@ -436,6 +1401,8 @@ void TEFileSectorsTable::MoveSector(TEFileSectorsList::iterator sector_it, TEFil
 	if(before_it != m_sectors_list.begin() && std::prev(before_it) == sector_it)
 		return;
 
+	Journal(EF_JOURNAL_MOVE, sector_it->SectorAddr, 0, GetSectorAddr(before_it), sector_it->Free);
+
 	m_sectors_list.splice(before_it, m_sectors_list, sector_it);
 }
 
@@ -443,10 +1410,12 @@ TUniteStatus TEFileSectorsTable::CheckAndUniteSector(TEFileSectorsList::iterator
 {
 	if(sector_it == m_sectors_list.end())
 		return EF_UNITE_NONE;
-	else if(sector_it->Free)
+	else if(sector_it->Free == EF_SECTOR_FREE)
 		return CheckAndUniteFreeSector(sector_it, uniteResult);
-	else
+	else if(sector_it->Free == EF_SECTOR_DATA)
 		return CheckAndUniteDataSector(sector_it, uniteResult);
+	else
+		return EF_UNITE_NONE;
 }
 
 TUniteStatus TEFileSectorsTable::CheckAndUniteDataSector(TEFileSectorsList::iterator sector_it, TUniteResult& unite_result)
@@ -464,7 +1433,7 @@ TUniteStatus TEFileSectorsTable::CheckAndUniteDataSector(TEFileSectorsList::iter
 		TEFileSector& sector = *sector_it;
 		TEFileSector& sector_left = *sector_left_it;
 
-		if(sector_left.Free == sector.Free && sector_left.Free == 0 && sector_left.SectorAddr + sector_left.SectorSize == sector.SectorAddr)
+		if(sector_left.Free == sector.Free && sector_left.Free == 0 && sector_left.SectorAddr + sector_left.SectorSize == sector.SectorAddr && CanUniteSectors(sector_left, sector))
 		{
 			offset_in_sector = sector_left.SectorSize;
 			result_it = UniteSectors(sector_left_it, sector_it);
@@ -480,7 +1449,7 @@ TUniteStatus TEFileSectorsTable::CheckAndUniteDataSector(TEFileSectorsList::iter
 		TEFileSector& sector = *result_it;
 		TEFileSector& sector_right = *sector_right_it;
 
-		if(sector.Free == sector_right.Free && sector.Free == 0 && sector.SectorAddr + sector.SectorSize == sector_right.SectorAddr)
+		if(sector.Free == sector_right.Free && sector.Free == 0 && sector.SectorAddr + sector.SectorSize == sector_right.SectorAddr && CanUniteSectors(sector, sector_right))
 		{
 			result_it = UniteSectors(result_it, sector_right_it);
 			unite_status = unite_status == EF_UNITE_LEFT ? EF_UNITE_BOTH : EF_UNITE_RIGHT;
@@ -508,7 +1477,7 @@ TUniteStatus TEFileSectorsTable::CheckAndUniteFreeSector(TEFileSectorsList::iter
 		TEFileSector& sector = *sector_it;
 		TEFileSector& sector_left = *sector_left_it;
 
-		if(sector_left.Free == sector.Free && sector.Free == 1)
+		if(sector_left.Free == sector.Free && sector.Free == 1 && CanUniteSectors(sector_left, sector))
 		{
 			offset_in_sector = sector_left.SectorSize;
 			result_it = UniteSectors(sector_left_it, sector_it);
@@ -524,7 +1493,7 @@ TUniteStatus TEFileSectorsTable::CheckAndUniteFreeSector(TEFileSectorsList::iter
 		TEFileSector& sector = *result_it;
 		TEFileSector& sector_right = *sector_right_it;
 
-		if(sector.Free == sector_right.Free && sector.Free == 1)
+		if(sector.Free == sector_right.Free && sector.Free == 1 && CanUniteSectors(sector, sector_right))
 		{
 			result_it = UniteSectors(result_it, sector_right_it);
 			unite_status = unite_status == EF_UNITE_LEFT ? EF_UNITE_BOTH : EF_UNITE_RIGHT;
@@ -537,6 +1506,11 @@ TUniteStatus TEFileSectorsTable::CheckAndUniteFreeSector(TEFileSectorsList::iter
 	return unite_status;
 }
 
+bool TEFileSectorsTable::CanUniteSectors(const TEFileSector& first, const TEFileSector& second)
+{
+	return first.SectorSize + second.SectorSize <= EF_MAX_SECTOR_SIZE;
+}
+
 TEFileSectorsList::iterator TEFileSectorsTable::UniteSectors(TEFileSectorsList::iterator first_it, TEFileSectorsList::iterator second_it)
 {
 	TEFileSectorsList::iterator sector_left_it;
@@ -553,15 +1527,37 @@ TEFileSectorsList::iterator TEFileSectorsTable::UniteSectors(TEFileSectorsList::
 		sector_right_it = first_it;
 	}
 	
+	Journal(EF_JOURNAL_UNITE, sector_left_it->SectorAddr, 0, sector_right_it->SectorAddr, sector_left_it->Free);
+	EF_COUNT(m_file.GetCounters(), EF_COUNTER_UNITES, 1);
+
+	// Free space stays retired until the latest of the snapshots of its parts is released
+	if(sector_left_it->Free == EF_SECTOR_FREE && !m_retired_sectors.empty())
+	{
+		std::map<size_file_t, size_t>::iterator right_retired_it = m_retired_sectors.find(sector_right_it->SectorAddr);
+		if(right_retired_it != m_retired_sectors.end())
+		{
+			size_t& left_version = m_retired_sectors[sector_left_it->SectorAddr];
+			left_version = std::max<size_t>(left_version, right_retired_it->second);
+			m_retired_sectors.erase(right_retired_it);
+		}
+	}
+
+	if(sector_left_it->Free == EF_SECTOR_FREE)
+		RemoveFreeSector(sector_left_it);
+
 	sector_left_it->SectorSize += sector_right_it->SectorSize;
 
+	if(sector_left_it->Free == EF_SECTOR_FREE)
+		AddFreeSector(sector_left_it);
+
 	DEVLOG( "unite sectors " << sector_left_it->SectorAddr << " and " << sector_right_it->SectorAddr );
 
-	if(sector_right_it->Free)
-		m_free_sectors_map.erase(sector_right_it->SectorAddr);
+	if(sector_right_it->Free == EF_SECTOR_FREE)
+		RemoveFreeSector(sector_right_it);
 
 	m_sectors_map.erase(sector_right_it->SectorAddr);
 	m_sectors_list.erase(sector_right_it);
+	m_sectors_list.Update(sector_left_it);
 
 	m_sectors_count--;
 	
@@ -571,16 +1567,21 @@ TEFileSectorsList::iterator TEFileSectorsTable::UniteSectors(TEFileSectorsList::
 void TEFileSectorsTable::ExtendSector(TEFileSectorsList::iterator sector_it, size_file_t size_to_extend)
 {
 	TEFileSector& sector = *sector_it;
+
+	Journal(EF_JOURNAL_EXTEND, sector.SectorAddr, size_to_extend, EF_NO_SECTOR, sector.Free);
+
+	if(sector.Free == EF_SECTOR_FREE)
+		RemoveFreeSector(sector_it);
+
 	sector.SectorSize += size_to_extend;
-	if(!sector.Free)
+	m_sectors_list.Update(sector_it);
+
+	if(sector.Free == EF_SECTOR_FREE)
+		AddFreeSector(sector_it);
+
+	if(sector.Free == EF_SECTOR_DATA)
 		m_data_size += size_to_extend;
 
 	m_file_size += size_to_extend;
 }
 
-size_file_t TEFileSectorsTable::CalculateGarbageSize()
-{
-	const TEFileHandle& file_handle = m_file.GetHandle();
-	_fseeki64(file_handle, 0, SEEK_END);
-	return ftell(file_handle) - m_data_size;
-}
@@ -0,0 +1,88 @@
+#include <TEFileSnapshot.h>
+#include <TEFileSectorsTable.h>
+#include <TEFileException.h>
+#include <TEFileVectorIO.h>
+
+TEFileSnapshot::TEFileSnapshot(const TEFileHandle& file_handle, TEFileSectorsTable& sectors_table)
+	: m_handle(file_handle)
+	, m_data_size(sectors_table.GetDataSize())
+	, m_version(sectors_table.GetChangesCount())
+	, m_epochs(sectors_table.GetEpochs())
+{
+	m_epochs->Pin(m_version);
+
+	size_file_t position(0);
+	for(TEFileSectorsList::iterator sector_it = sectors_table.List().begin(); sector_it != sectors_table.List().end(); ++sector_it)
+	{
+		if(sector_it->Free)
+			continue;
+
+		if(!m_extents.empty() && m_extents.back().Addr + m_extents.back().Size == sector_it->SectorAddr)
+		{
+			m_extents.back().Size += sector_it->SectorSize;
+		}
+		else
+		{
+			TExtent extent;
+			extent.Position = position;
+			extent.Addr = sector_it->SectorAddr;
+			extent.Size = sector_it->SectorSize;
+			m_extents.push_back(extent);
+		}
+
+		position += sector_it->SectorSize;
+	}
+}
+
+TEFileSnapshot::~TEFileSnapshot(void)
+{
+	m_epochs->Unpin(m_version);
+}
+
+size_file_t TEFileSnapshot::Read(const size_file_t& position, PBYTE buffer, const size_file_t& size)
+{
+	size_file_t bytes_to_read(0);
+	TEFileIOSegments segments;
+
+	if(position < m_data_size)
+	{
+		bytes_to_read = std::min<size_file_t>(size, m_data_size - position);
+
+		// The last extent which begins not after the position
+		std::vector<TExtent>::iterator extent_it = std::upper_bound(m_extents.begin(), m_extents.end(), position, TPositionLess()) - 1;
+		size_file_t from = position - extent_it->Position;
+
+		for(size_file_t bytes_mapped = 0; bytes_mapped < bytes_to_read; ++extent_it)
+		{
+			size_file_t local_bytes_to_read = std::min<size_file_t>(bytes_to_read - bytes_mapped, extent_it->Size - from);
+			TEFileVectorIO::AddSegment(segments, extent_it->Addr + from, local_bytes_to_read, buffer + bytes_mapped);
+
+			bytes_mapped += local_bytes_to_read;
+			from = 0;
+		}
+	}
+
+	size_file_t bytes_read = TEFileVectorIO::Read(m_handle, segments);
+
+	if(bytes_read != bytes_to_read)
+	{
+		throw TEFileException(EF_READ_DATA_ERROR, STRING("Read " << bytes_read << " bytes of " << size), bytes_read);
+	}
+
+	if(bytes_read < size)
+	{
+		throw TEFileException(EF_READ_DATA_ERROR, STRING("Read " << bytes_read << " bytes of " << size << ". End of snapshot reached"), bytes_read);
+	}
+
+	return bytes_read;
+}
+
+const size_file_t& TEFileSnapshot::GetDataSize() const
+{
+	return m_data_size;
+}
+
+const size_t& TEFileSnapshot::GetVersion() const
+{
+	return m_version;
+}
@@ -0,0 +1,131 @@
+#include <TEFileSpans.h>
+#include <TEFileException.h>
+
+TEFileSpansRecorder::TEFileSpansRecorder(void)
+	: m_enabled(false)
+	, m_files_count(0)
+	, m_threads_count(0)
+	, m_file(NULL)
+	, m_first_span(true)
+	, m_start(0)
+{
+}
+
+TEFileSpansRecorder::~TEFileSpansRecorder(void)
+{
+	try
+	{
+		Stop();
+	}
+	catch(...)
+	{
+		ERRLOG( "can't close the spans file" );
+	}
+}
+
+TEFileSpansRecorder& TEFileSpansRecorder::Get()
+{
+	static TEFileSpansRecorder recorder;
+	return recorder;
+}
+
+unsigned __int64 TEFileSpansRecorder::GetClock()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void TEFileSpansRecorder::Start(const std::string& file_name)
+{
+	Stop();
+
+	std::lock_guard<std::mutex> lock(m_lock);
+
+	m_file = fopen(file_name.c_str(), "wb");
+	if(m_file == NULL)
+	{
+		throw TEFileException(EF_OPEN_FILE_ERROR, STRING("Can't create spans file " << file_name));
+	}
+
+	m_buffer = "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+	m_first_span = true;
+
+	m_threads_count.store(0);
+	m_files_count.fetch_add(1);
+	m_start = GetClock();
+	m_enabled.store(true);
+}
+
+void TEFileSpansRecorder::Stop()
+{
+	std::lock_guard<std::mutex> lock(m_lock);
+
+	m_enabled.store(false);
+
+	if(m_file == NULL)
+		return;
+
+	m_buffer += "\n]}\n";
+	Flush();
+
+	int result = fclose(m_file);
+	m_file = NULL;
+
+	if(result != 0)
+	{
+		throw TEFileException(EF_CLOSE_FILE_ERROR, "Can't close the spans file");
+	}
+}
+
+unsigned int TEFileSpansRecorder::GetThread()
+{
+	static thread_local unsigned int thread_file(0);
+	static thread_local unsigned int thread_index(0);
+
+	unsigned int file = m_files_count.load();
+	if(thread_file != file)
+	{
+		thread_file = file;
+		thread_index = m_threads_count.fetch_add(1) + 1;
+	}
+
+	return thread_index;
+}
+
+void TEFileSpansRecorder::Write(const char* name, unsigned __int64 start, unsigned __int64 duration, const size_file_t& size)
+{
+	unsigned int thread = GetThread();
+
+	std::lock_guard<std::mutex> lock(m_lock);
+
+	// The step has started before the file
+	if(m_file == NULL || start < m_start)
+		return;
+
+	// Complete events, the times are microseconds
+	std::ostringstream span;
+	span.setf(std::ios::fixed);
+	span.precision(3);
+	span << (m_first_span ? "" : ",") << "\n{\"name\":\"" << name << "\",\"cat\":\"ElasticFile\",\"ph\":\"X\",\"pid\":1,\"tid\":" << thread
+		<< ",\"ts\":" << (start - m_start) / 1000.0 << ",\"dur\":" << duration / 1000.0;
+
+	if(size > 0)
+		span << ",\"args\":{\"size\":" << size << "}";
+
+	span << "}";
+
+	m_buffer += span.str();
+	m_first_span = false;
+
+	if(m_buffer.size() >= EF_SPANS_BUFFER_SIZE)
+		Flush();
+}
+
+void TEFileSpansRecorder::Flush()
+{
+	if(!m_buffer.empty() && fwrite(m_buffer.data(), sizeof(char), m_buffer.size(), m_file) != m_buffer.size())
+	{
+		ERRLOG( "can't write " << m_buffer.size() << " bytes to the spans file" );
+	}
+
+	m_buffer.clear();
+}
@@ -0,0 +1,204 @@
+#include <TEFileStdioBackend.h>
+#ifdef _WIN32
+#include <io.h>
+#include <share.h>
+#else
+#include <sys/types.h>
+#include <unistd.h>
+#endif
+
+TEFileStdioBackend::TEFileStdioBackend()
+	: m_stream(NULL)
+{
+}
+
+TEFileStdioBackend::~TEFileStdioBackend(void)
+{
+	Close();
+}
+
+bool TEFileStdioBackend::Open(const std::string& file_name, bool create)
+{
+	std::lock_guard<std::mutex> lock(m_lock);
+
+	m_file_name = file_name;
+	return OpenStream(file_name, create ? "wb+" : "rb+");
+}
+
+bool TEFileStdioBackend::Exists(const std::string& file_name)
+{
+	return FileExists(file_name);
+}
+
+bool TEFileStdioBackend::Close()
+{
+	std::lock_guard<std::mutex> lock(m_lock);
+
+	if(m_stream == NULL)
+		return true;
+
+	bool result = fclose(m_stream) == 0;
+	m_stream = NULL;
+
+	return result;
+}
+
+TEFileHandle TEFileStdioBackend::CreateReader()
+{
+	std::shared_ptr<TEFileStdioBackend> reader(new TEFileStdioBackend());
+
+	std::lock_guard<std::mutex> lock(reader->m_lock);
+
+	reader->m_file_name = m_file_name;
+	reader->m_counters = m_counters;
+	if(!reader->OpenStream(m_file_name, "rb"))
+		return TEFileHandle();
+
+	return reader;
+}
+
+size_file_t TEFileStdioBackend::ReadAt(size_file_t addr, PBYTE buffer, size_file_t size)
+{
+	std::lock_guard<std::mutex> lock(m_lock);
+
+	if(!Seek(addr))
+		return 0;
+
+	size_file_t bytes_read = fread(buffer, sizeof(BYTE), (size_t)size, m_stream);
+
+	EF_COUNT(m_counters, EF_COUNTER_SYSCALLS, 1);
+	EF_COUNT(m_counters, EF_COUNTER_BYTES_READ, bytes_read);
+
+	return bytes_read;
+}
+
+size_file_t TEFileStdioBackend::WriteAt(size_file_t addr, const BYTE* buffer, size_file_t size)
+{
+	std::lock_guard<std::mutex> lock(m_lock);
+
+	if(!Seek(addr))
+		return 0;
+
+	size_file_t bytes_written = fwrite(buffer, sizeof(BYTE), (size_t)size, m_stream);
+
+	EF_COUNT(m_counters, EF_COUNTER_SYSCALLS, 1);
+	EF_COUNT(m_counters, EF_COUNTER_BYTES_WRITTEN, bytes_written);
+
+	return bytes_written;
+}
+
+bool TEFileStdioBackend::GetSize(size_file_t& size)
+{
+	std::lock_guard<std::mutex> lock(m_lock);
+
+	EF_COUNT(m_counters, EF_COUNTER_SYSCALLS, 2);
+
+#ifdef _WIN32
+	if(_fseeki64(m_stream, 0, SEEK_END) != 0)
+		return false;
+
+	__int64 file_size = _ftelli64(m_stream);
+#else
+	if(fseeko(m_stream, 0, SEEK_END) != 0)
+		return false;
+
+	off_t file_size = ftello(m_stream);
+#endif
+
+	if(file_size < 0)
+		return false;
+
+	size = file_size;
+	return true;
+}
+
+bool TEFileStdioBackend::Resize(size_file_t size)
+{
+	std::lock_guard<std::mutex> lock(m_lock);
+
+	EF_COUNT(m_counters, EF_COUNTER_SYSCALLS, 2);
+
+	if(fflush(m_stream) != 0)
+		return false;
+
+#ifdef _WIN32
+	return _chsize_s(_fileno(m_stream), size) == 0;
+#else
+	return ftruncate(fileno(m_stream), size) == 0;
+#endif
+}
+
+bool TEFileStdioBackend::Preallocate(size_file_t size)
+{
+	std::lock_guard<std::mutex> lock(m_lock);
+
+	EF_COUNT(m_counters, EF_COUNTER_SYSCALLS, 2);
+
+	if(fflush(m_stream) != 0)
+		return false;
+
+#ifdef _WIN32
+	return PreallocateDescriptor(_fileno(m_stream), size);
+#else
+	return PreallocateDescriptor(fileno(m_stream), size);
+#endif
+}
+
+bool TEFileStdioBackend::Flush()
+{
+	std::lock_guard<std::mutex> lock(m_lock);
+
+	EF_COUNT(m_counters, EF_COUNTER_SYSCALLS, 1);
+
+	return fflush(m_stream) == 0;
+}
+
+bool TEFileStdioBackend::Sync()
+{
+	std::lock_guard<std::mutex> lock(m_lock);
+
+	EF_COUNT(m_counters, EF_COUNTER_SYSCALLS, 2);
+
+	if(fflush(m_stream) != 0)
+		return false;
+
+#ifdef _WIN32
+	return _commit(_fileno(m_stream)) == 0;
+#else
+	return fsync(fileno(m_stream)) == 0;
+#endif
+}
+
+int TEFileStdioBackend::GetDescriptor()
+{
+	std::lock_guard<std::mutex> lock(m_lock);
+
+#ifdef _WIN32
+	return _fileno(m_stream);
+#else
+	return fileno(m_stream);
+#endif
+}
+
+bool TEFileStdioBackend::OpenStream(const std::string& file_name, const char* mode)
+{
+#ifdef _WIN32
+	// Other handles of the file (the readers of the snapshots) must not be denied
+	m_stream = _fsopen(file_name.c_str(), mode, _SH_DENYNO);
+#else
+	m_stream = fopen(file_name.c_str(), mode);
+#endif
+
+	return m_stream != NULL;
+}
+
+bool TEFileStdioBackend::Seek(size_file_t addr)
+{
+	EF_COUNT(m_counters, EF_COUNTER_SYSCALLS, 1);
+
+#ifdef _WIN32
+	return _fseeki64(m_stream, addr, SEEK_SET) == 0;
+#else
+	return fseeko(m_stream, addr, SEEK_SET) == 0;
+#endif
+}
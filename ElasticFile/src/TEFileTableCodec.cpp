@@ -0,0 +1,115 @@
+#include <TEFileTableCodec.h>
+
+void TEFileTableCodec::EncodeSector(const TEFileSector& sector, size_file_t& next_addr, std::vector<BYTE>& data)
+{
+	EncodeNumber(((unsigned __int64)sector.SectorSize << 2) | sector.Free, data);
+	EncodeDelta(sector.SectorAddr, next_addr, data);
+
+	next_addr = sector.SectorAddr + sector.SectorSize;
+}
+
+bool TEFileTableCodec::DecodeSector(const BYTE*& data, const BYTE* data_end, size_file_t& next_addr, TEFileSector& sector)
+{
+	unsigned __int64 size_and_state;
+	size_file_t sector_addr;
+
+	if(!DecodeNumber(data, data_end, size_and_state) || !DecodeDelta(data, data_end, next_addr, sector_addr))
+		return false;
+
+	if((size_and_state >> 2) > EF_MAX_SECTOR_SIZE)
+		return false;
+
+	sector.SectorAddr = sector_addr;
+	sector.SectorSize = (DWORD)(size_and_state >> 2);
+	sector.Free = (DWORD)(size_and_state & 3);
+
+	next_addr = sector.SectorAddr + sector.SectorSize;
+	return true;
+}
+
+void TEFileTableCodec::EncodeRecord(const TEFileJournalRecord& record, size_file_t& prev_addr, std::vector<BYTE>& data)
+{
+	data.push_back((BYTE)((record.Type << 2) | (record.State & 3)));
+	EncodeDelta(record.SectorAddr, prev_addr, data);
+	EncodeNumber(record.Size, data);
+
+	// Only the records which refer to another sector keep its address
+	if(HasNextAddr(record.Type))
+		EncodeDelta(record.NextAddr, record.SectorAddr, data);
+
+	prev_addr = record.SectorAddr;
+}
+
+bool TEFileTableCodec::DecodeRecord(const BYTE*& data, const BYTE* data_end, size_file_t& prev_addr, TEFileJournalRecord& record)
+{
+	if(data == data_end)
+		return false;
+
+	BYTE type_and_state = *data++;
+	record.Type = type_and_state >> 2;
+	record.State = type_and_state & 3;
+
+	if(!DecodeDelta(data, data_end, prev_addr, record.SectorAddr) || !DecodeNumber(data, data_end, record.Size))
+		return false;
+
+	record.NextAddr = EF_NO_SECTOR;
+	if(HasNextAddr(record.Type) && !DecodeDelta(data, data_end, record.SectorAddr, record.NextAddr))
+		return false;
+
+	prev_addr = record.SectorAddr;
+	return true;
+}
+
+void TEFileTableCodec::EncodeNumber(unsigned __int64 value, std::vector<BYTE>& data)
+{
+	// The high bit of a byte means that more bytes follow
+	while(value >= 0x80)
+	{
+		data.push_back((BYTE)(value | 0x80));
+		value >>= 7;
+	}
+
+	data.push_back((BYTE)value);
+}
+
+bool TEFileTableCodec::DecodeNumber(const BYTE*& data, const BYTE* data_end, unsigned __int64& value)
+{
+	value = 0;
+
+	for(int shift = 0; shift < 64; shift += 7)
+	{
+		if(data == data_end)
+			return false;
+
+		BYTE byte = *data++;
+		value |= (unsigned __int64)(byte & 0x7f) << shift;
+
+		if((byte & 0x80) == 0)
+			return true;
+	}
+
+	return false;
+}
+
+void TEFileTableCodec::EncodeDelta(size_file_t value, size_file_t base, std::vector<BYTE>& data)
+{
+	// The difference wraps around, so any address including EF_NO_SECTOR can be encoded.
+	// The sign goes to the lowest bit in order to keep small distances short in both directions
+	unsigned __int64 delta = value - base;
+	EncodeNumber((delta << 1) ^ (0 - (delta >> 63)), data);
+}
+
+bool TEFileTableCodec::DecodeDelta(const BYTE*& data, const BYTE* data_end, size_file_t base, size_file_t& value)
+{
+	unsigned __int64 encoded;
+	if(!DecodeNumber(data, data_end, encoded))
+		return false;
+
+	value = base + ((encoded >> 1) ^ (0 - (encoded & 1)));
+	return true;
+}
+
+bool TEFileTableCodec::HasNextAddr(BYTE type)
+{
+	return type == EF_JOURNAL_INSERT || type == EF_JOURNAL_UNITE || type == EF_JOURNAL_MOVE;
+}
@@ -0,0 +1,294 @@
+#include <TEFileUring.h>
+
+#if defined(EF_IO_URING) && defined(__linux__)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <sched.h>
+#include <errno.h>
+#include <string.h>
+
+TEFileUring::TEFileUring()
+	: m_ring_fd(-1)
+	, m_sq_ring(MAP_FAILED)
+	, m_sq_ring_size(0)
+	, m_cq_ring(MAP_FAILED)
+	, m_cq_ring_size(0)
+	, m_sqes(MAP_FAILED)
+	, m_sqes_size(0)
+	, m_entries(0)
+	, m_system_calls(0)
+{
+}
+
+TEFileUring::~TEFileUring(void)
+{
+	Release();
+}
+
+TEFileUring* TEFileUring::Get()
+{
+	static thread_local TEFileUring ring;
+	static thread_local bool ring_checked(false);
+	static thread_local bool ring_valid(false);
+
+	if(!ring_checked)
+	{
+		ring_checked = true;
+		ring_valid = ring.Setup();
+
+		if(!ring_valid)
+		{
+			DEVLOG( "io_uring is not supported, errno " << errno );
+		}
+	}
+
+	return ring_valid ? &ring : NULL;
+}
+
+bool TEFileUring::Setup()
+{
+	struct io_uring_params params;
+	memset(&params, 0, sizeof(params));
+
+	m_ring_fd = (int)syscall(__NR_io_uring_setup, EF_URING_ENTRIES, &params);
+	if(m_ring_fd < 0)
+		return false;
+
+	m_entries = params.sq_entries;
+	m_sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+	m_cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+
+	// Both rings are in one mapping on the kernels since 5.4
+	if(params.features & IORING_FEAT_SINGLE_MMAP)
+		m_sq_ring_size = m_cq_ring_size = std::max<size_t>(m_sq_ring_size, m_cq_ring_size);
+
+	m_sq_ring = mmap(NULL, m_sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_ring_fd, IORING_OFF_SQ_RING);
+	if(m_sq_ring == MAP_FAILED)
+		return false;
+
+	if(params.features & IORING_FEAT_SINGLE_MMAP)
+		m_cq_ring = m_sq_ring;
+	else
+		m_cq_ring = mmap(NULL, m_cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_ring_fd, IORING_OFF_CQ_RING);
+
+	if(m_cq_ring == MAP_FAILED)
+		return false;
+
+	m_sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+	m_sqes = mmap(NULL, m_sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_ring_fd, IORING_OFF_SQES);
+	if(m_sqes == MAP_FAILED)
+		return false;
+
+	BYTE* sq_ring = (BYTE*)m_sq_ring;
+	m_sq_head = (unsigned*)(sq_ring + params.sq_off.head);
+	m_sq_tail = (unsigned*)(sq_ring + params.sq_off.tail);
+	m_sq_mask = (unsigned*)(sq_ring + params.sq_off.ring_mask);
+	m_sq_array = (unsigned*)(sq_ring + params.sq_off.array);
+
+	BYTE* cq_ring = (BYTE*)m_cq_ring;
+	m_cq_head = (unsigned*)(cq_ring + params.cq_off.head);
+	m_cq_tail = (unsigned*)(cq_ring + params.cq_off.tail);
+	m_cq_mask = (unsigned*)(cq_ring + params.cq_off.ring_mask);
+	m_cqes = cq_ring + params.cq_off.cqes;
+
+	return true;
+}
+
+void TEFileUring::Release()
+{
+	if(m_sqes != MAP_FAILED)
+		munmap(m_sqes, m_sqes_size);
+
+	if(m_cq_ring != MAP_FAILED && m_cq_ring != m_sq_ring)
+		munmap(m_cq_ring, m_cq_ring_size);
+
+	if(m_sq_ring != MAP_FAILED)
+		munmap(m_sq_ring, m_sq_ring_size);
+
+	if(m_ring_fd >= 0)
+		close(m_ring_fd);
+
+	m_sqes = m_cq_ring = m_sq_ring = MAP_FAILED;
+	m_ring_fd = -1;
+}
+
+size_file_t TEFileUring::Transfer(int file_descriptor, const TEFileIOSegments& segments, bool write)
+{
+	m_runs.clear();
+	m_vectors.resize(segments.size());
+	m_system_calls = 0;
+
+	// Physically adjacent segments are one run, as for preadv/pwritev
+	for(size_t segment_index = 0; segment_index < segments.size(); ++segment_index)
+	{
+		const TEFileIOSegment& segment = segments[segment_index];
+
+		if(m_runs.empty() || m_runs.back().Addr + m_runs.back().Size != segment.Addr || m_runs.back().VectorsCount == EF_IO_MAX_VECTORS)
+		{
+			TRun run;
+			run.Addr = segment.Addr;
+			run.Size = 0;
+			run.FirstVector = segment_index;
+			run.VectorsCount = 0;
+			run.Transferred = 0;
+			run.Result = -1;
+			m_runs.push_back(run);
+		}
+
+		m_vectors[segment_index].iov_base = segment.Buffer;
+		m_vectors[segment_index].iov_len = segment.Size;
+
+		m_runs.back().Size += segment.Size;
+		m_runs.back().VectorsCount++;
+	}
+
+	m_pending_runs.resize(m_runs.size());
+	for(size_t run_index = 0; run_index < m_runs.size(); ++run_index)
+		m_pending_runs[run_index] = run_index;
+
+	while(!m_pending_runs.empty())
+	{
+		bool submitted(true);
+		for(size_t first_run = 0; submitted && first_run < m_pending_runs.size(); first_run += m_entries)
+			submitted = Submit(first_run, std::min<size_t>(m_pending_runs.size() - first_run, (size_t)m_entries), write, file_descriptor);
+
+		// A request can transfer a part of the run (Linux stops at 0x7ffff000 bytes), the rest is
+		// submitted again from the returned offset until the run fails or transfers nothing
+		size_t continued_runs(0);
+		for(size_t pending_index = 0; pending_index < m_pending_runs.size(); ++pending_index)
+		{
+			TRun& run = m_runs[m_pending_runs[pending_index]];
+			if(run.Result <= 0)
+				continue;
+
+			size_t bytes = (size_t)run.Result;
+			run.Transferred += bytes;
+			run.Result = -1;
+
+			if(submitted && run.Transferred < run.Size)
+			{
+				SkipVectors(run, bytes);
+				m_pending_runs[continued_runs++] = m_pending_runs[pending_index];
+			}
+		}
+
+		m_pending_runs.resize(continued_runs);
+	}
+
+	// The caller gets only the logically continuous part of the data
+	size_file_t bytes_transferred(0);
+	for(std::vector<TRun>::iterator run_it = m_runs.begin(); run_it != m_runs.end(); ++run_it)
+	{
+		bytes_transferred += run_it->Transferred;
+
+		if(run_it->Transferred != run_it->Size)
+			break;
+	}
+
+	return bytes_transferred;
+}
+
+size_t TEFileUring::GetSystemCalls() const
+{
+	return m_system_calls;
+}
+
+void TEFileUring::SkipVectors(TRun& run, size_t bytes)
+{
+	while(bytes > 0)
+	{
+		struct iovec& vector = m_vectors[run.FirstVector];
+
+		if(bytes >= vector.iov_len)
+		{
+			bytes -= vector.iov_len;
+			run.FirstVector++;
+			run.VectorsCount--;
+		}
+		else
+		{
+			vector.iov_base = (BYTE*)vector.iov_base + bytes;
+			vector.iov_len -= bytes;
+			bytes = 0;
+		}
+	}
+}
+
+bool TEFileUring::Submit(size_t first_run, size_t runs_count, bool write, int file_descriptor)
+{
+	unsigned tail = *m_sq_tail;
+	struct io_uring_sqe* sqes = (struct io_uring_sqe*)m_sqes;
+
+	for(size_t pending_index = first_run; pending_index < first_run + runs_count; ++pending_index)
+	{
+		size_t run_index = m_pending_runs[pending_index];
+		const TRun& run = m_runs[run_index];
+
+		unsigned sqe_index = tail & *m_sq_mask;
+		struct io_uring_sqe& sqe = sqes[sqe_index];
+		memset(&sqe, 0, sizeof(sqe));
+
+		sqe.opcode = write ? IORING_OP_WRITEV : IORING_OP_READV;
+		sqe.fd = file_descriptor;
+		sqe.addr = (unsigned long long)(uintptr_t)&m_vectors[run.FirstVector];
+		sqe.len = (unsigned)run.VectorsCount;
+		sqe.off = run.Addr + run.Transferred;
+		sqe.user_data = run_index;
+
+		m_sq_array[sqe_index] = sqe_index;
+		tail++;
+	}
+
+	// The kernel sees the entries only after the tail is moved
+	__atomic_store_n(m_sq_tail, tail, __ATOMIC_RELEASE);
+
+	size_t runs_to_complete(runs_count);
+	size_t submitted(0);
+	size_t completed(0);
+
+	// A partial submission returns without waiting, so the rest is submitted by the next call
+	while(completed < runs_to_complete)
+	{
+		unsigned to_submit = (unsigned)(runs_to_complete - submitted);
+		int result = (int)syscall(__NR_io_uring_enter, m_ring_fd, to_submit, (unsigned)(runs_to_complete - completed), IORING_ENTER_GETEVENTS, NULL, 0);
+		m_system_calls++;
+
+		if(result >= 0)
+		{
+			submitted += result;
+		}
+		else if(errno != EINTR && errno != EAGAIN && errno != EBUSY)
+		{
+			if(to_submit > 0)
+			{
+				// The entries which are not taken by the kernel are removed, the submitted ones are waited for
+				__atomic_store_n(m_sq_tail, *m_sq_tail - to_submit, __ATOMIC_RELEASE);
+				runs_to_complete = submitted;
+			}
+			else
+			{
+				// The submitted requests still transfer to the buffers of the caller, so the function
+				// doesn't return before their completions even if the kernel can't wait for them
+				sched_yield();
+			}
+		}
+
+		unsigned head = *m_cq_head;
+		unsigned cq_tail = __atomic_load_n(m_cq_tail, __ATOMIC_ACQUIRE);
+		struct io_uring_cqe* cqes = (struct io_uring_cqe*)m_cqes;
+
+		for(; head != cq_tail; ++head, ++completed)
+		{
+			const struct io_uring_cqe& cqe = cqes[head & *m_cq_mask];
+			m_runs[(size_t)cqe.user_data].Result = cqe.res;
+		}
+
+		__atomic_store_n(m_cq_head, head, __ATOMIC_RELEASE);
+	}
+
+	return runs_to_complete == runs_count;
+}
+
+#endif
@@ -0,0 +1,65 @@
+#include <TEFileVectorIO.h>
+#include <TEFileBackend.h>
+
+void TEFileVectorIO::AddSegment(TEFileIOSegments& segments, size_file_t addr, size_file_t size, PBYTE buffer)
+{
+	if(size == 0)
+		return;
+
+	if(!segments.empty())
+	{
+		TEFileIOSegment& last_segment = segments.back();
+
+		if(last_segment.Addr + last_segment.Size == addr && last_segment.Buffer + last_segment.Size == buffer)
+		{
+			last_segment.Size += size;
+			return;
+		}
+	}
+
+	TEFileIOSegment segment;
+	segment.Addr = addr;
+	segment.Size = size;
+	segment.Buffer = buffer;
+	segments.push_back(segment);
+}
+
+void TEFileVectorIO::AddSegments(TEFileIOSegments& segments, size_file_t addr, size_file_t size, const TEFileIOVector* vectors, size_t& vector_index, size_file_t& offset_in_vector)
+{
+	while(size > 0)
+	{
+		const TEFileIOVector& vector = vectors[vector_index];
+
+		size_file_t bytes_to_add = std::min<size_file_t>(size, vector.Size - offset_in_vector);
+		AddSegment(segments, addr, bytes_to_add, vector.Buffer + offset_in_vector);
+
+		addr += bytes_to_add;
+		size -= bytes_to_add;
+		offset_in_vector += bytes_to_add;
+
+		if(offset_in_vector == vector.Size)
+		{
+			vector_index++;
+			offset_in_vector = 0;
+		}
+	}
+}
+
+size_file_t TEFileVectorIO::Read(const TEFileHandle& file_handle, const TEFileIOSegments& segments)
+{
+	return file_handle->Read(segments);
+}
+
+size_file_t TEFileVectorIO::Write(const TEFileHandle& file_handle, const TEFileIOSegments& segments)
+{
+	return file_handle->Write(segments);
+}
+
+size_file_t TEFileVectorIO::GetSize(const TEFileIOVector* vectors, size_t count)
+{
+	size_file_t size(0);
+	for(size_t vector_index = 0; vector_index < count; ++vector_index)
+		size += vectors[vector_index].Size;
+
+	return size;
+}
@@ -0,0 +1,54 @@
+#include <TEFileWriteCombiner.h>
+
+TEFileWriteCombiner::TEFileWriteCombiner()
+	: m_capacity(0)
+{
+}
+
+TEFileWriteCombiner::~TEFileWriteCombiner(void)
+{
+}
+
+void TEFileWriteCombiner::SetCapacity(const size_file_t& capacity)
+{
+	m_capacity = capacity;
+
+	m_buffer.clear();
+	m_buffer.reserve(capacity);
+}
+
+bool TEFileWriteCombiner::IsEnabled() const
+{
+	return m_capacity > 0;
+}
+
+bool TEFileWriteCombiner::Fits(const size_file_t& size) const
+{
+	return size <= m_capacity - m_buffer.size();
+}
+
+void TEFileWriteCombiner::Append(const TEFileIOVector* vectors, const size_t& vectors_count)
+{
+	for(size_t vector_index = 0; vector_index < vectors_count; ++vector_index)
+		m_buffer.insert(m_buffer.end(), vectors[vector_index].Buffer, vectors[vector_index].Buffer + vectors[vector_index].Size);
+}
+
+bool TEFileWriteCombiner::Empty() const
+{
+	return m_buffer.empty();
+}
+
+size_file_t TEFileWriteCombiner::GetSize() const
+{
+	return m_buffer.size();
+}
+
+PBYTE TEFileWriteCombiner::GetData()
+{
+	return m_buffer.empty() ? 0 : &m_buffer[0];
+}
+
+void TEFileWriteCombiner::Clear()
+{
+	m_buffer.clear();
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#if defined(__cpp_impl_coroutine) && __cpp_impl_coroutine >= 201902L
+#define EF_COROUTINES
+#include <coroutine>
+#include <functional>
+
+// Operation of ElasticFileAPI for co_await. The operation is submitted to the asynchronous
+// workers when the coroutine is suspended, and the coroutine is resumed in a worker thread
+// with the result of the operation. The completions don't come from io_uring: an operation
+// changes the sectors table synchronously, so it runs whole in a worker of EFileWorkers, and
+// only its data transfer may go through the ring of that worker (TEFileUring)
+template<typename TResult>
+class EFileAwaitable
+{
+public:
+	typedef std::function<void(TResult)> TCompletion;
+	typedef std::function<void(const TCompletion&)> TSubmit;
+
+	EFileAwaitable(const TSubmit& submit)
+		: m_submit(submit)
+		, m_result()
+	{
+	}
+
+	bool await_ready() const
+	{
+		return false;
+	}
+
+	// The coroutine may be resumed before the submit returns, so nothing is touched after it
+	void await_suspend(std::coroutine_handle<> coroutine)
+	{
+		TResult* result = &m_result;
+		m_submit([result, coroutine](TResult operation_result)
+		{
+			*result = operation_result;
+			coroutine.resume();
+		});
+	}
+
+	TResult await_resume() const
+	{
+		return m_result;
+	}
+
+private:
+	TSubmit m_submit;
+	TResult m_result;
+};
+
+#endif
@@ -1,25 +1,59 @@
 #pragma once
-#include <map>
 #include <ElasticFile.h>
 
+#define EF_HANDLES_CHUNK_SIZE 1024		// Slots of the handles table allocated at once
+#define EF_HANDLES_MAX_CHUNKS 4096		// Not more than 4M files opened at the same time
+
 class EFileController
 {
 public:
+	// Access to an opened file. The file is locked while the object exists, so a call through
+	// EFileController::Get().GetFile(file)->... holds the lock until the end of the expression
+	class TFileAccess
+	{
+	public:
+		TFileAccess(std::unique_lock<std::mutex>&& lock, ElasticFile& file);
+		TFileAccess(TFileAccess&& other);
+
+		ElasticFile* operator->() const;
+		ElasticFile& operator*() const;
+
+	private:
+		std::unique_lock<std::mutex> m_lock;
+		ElasticFile* m_file;
+	};
+
 	EFileController(void);
 	~EFileController(void);
 
-	ElasticFile& GetFile(const TEFileHandle& file_handle);
-	TEFileHandle OpenFile(const std::string& file_name, const TEFileOpenMode& mode);
-	void CloseFile(const TEFileHandle& file);
+	TFileAccess GetFile(const TEFileDescriptor& file_descriptor);
+	TEFileDescriptor OpenFile(const std::string& file_name, const TEFileOpenMode& mode, const TEFileBackendType& backend = EF_BACKEND_DEFAULT);
+	void CloseFile(const TEFileDescriptor& file_descriptor);
 	
 	static EFileController& Get();
 	
+private:
+	struct TSlot
+	{
+		TSlot();
+
+		std::mutex Lock;
+		unsigned int Generation; // Changes with every file closed in the slot, never 0
+		ElasticFilePtr File;
+	};
+
 protected:
-	std::map<TEFileHandle, ElasticFilePtr>::iterator GetFileEntrance(const TEFileHandle& file_handle);
-	void CheckHandle(const TEFileHandle& file_handle);
+	TSlot& GetSlot(const TEFileDescriptor& file_descriptor);
+	size_t AllocateSlot();
+	void FreeSlot(size_t slot_index);
+	void CheckDescriptor(const TEFileDescriptor& file_descriptor);
 
 private:
-	std::map<TEFileHandle, ElasticFilePtr> m_files;
+	// Chunks are never moved or freed while the controller exists, so a slot is found without
+	// any lock. Only opening and closing of files take m_slots_lock to get and return slots
+	std::atomic<TSlot*> m_chunks[EF_HANDLES_MAX_CHUNKS];
+	std::mutex m_slots_lock;
+	size_t m_slots_count;
+	std::vector<size_t> m_free_slots;
 };
 
-
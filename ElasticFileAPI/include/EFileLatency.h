@@ -0,0 +1,130 @@
+#pragma once
+#include <ElasticFile.h>
+
+// Latency histogram of one operation in one thread. Only the thread changes it, so a record is
+// a few plain loads and stores of relaxed atomics in the cache of its core, other threads only
+// read it. The histogram is cleared by its thread when it sees a new generation of the recorder
+class EFileLatencyHistogram
+{
+public:
+	EFileLatencyHistogram(void);
+	~EFileLatencyHistogram(void);
+
+	void Record(unsigned __int64 nanoseconds, unsigned int generation)
+	{
+		if(m_generation.load(std::memory_order_relaxed) != generation)
+		{
+			Clear();
+			m_generation.store(generation, std::memory_order_release);
+		}
+
+		Increase(m_buckets[GetBucket(nanoseconds)], 1);
+		Increase(m_sum, nanoseconds);
+
+		if(nanoseconds < m_min.load(std::memory_order_relaxed))
+			m_min.store(nanoseconds, std::memory_order_relaxed);
+
+		if(nanoseconds > m_max.load(std::memory_order_relaxed))
+			m_max.store(nanoseconds, std::memory_order_relaxed);
+	}
+
+	// Adds the calls to the histogram if they have been recorded in the generation
+	void AddTo(TEFileLatencyHistogram& histogram, unsigned int generation) const;
+	static void Add(TEFileLatencyHistogram& histogram, const TEFileLatencyHistogram& added);
+
+	static size_t GetBucket(unsigned __int64 nanoseconds);
+	// The least value of the bucket and the count of values in it
+	static unsigned __int64 GetBucketValue(size_t bucket);
+	static unsigned __int64 GetBucketWidth(size_t bucket);
+	// The greatest value of the bucket which contains the given part of the calls (0.5 is the median),
+	// but not more than the maximum
+	static unsigned __int64 GetPercentile(const TEFileLatencyHistogram& histogram, double percentile);
+
+protected:
+	void Clear();
+
+	static void Increase(std::atomic<unsigned __int64>& value, unsigned __int64 addition)
+	{
+		value.store(value.load(std::memory_order_relaxed) + addition, std::memory_order_relaxed);
+	}
+
+private:
+	EFileLatencyHistogram(const EFileLatencyHistogram&);
+	EFileLatencyHistogram& operator=(const EFileLatencyHistogram&);
+
+private:
+	std::atomic<unsigned int> m_generation;
+	std::atomic<unsigned __int64> m_buckets[EF_LATENCY_BUCKETS];
+	std::atomic<unsigned __int64> m_sum;
+	std::atomic<unsigned __int64> m_min;
+	std::atomic<unsigned __int64> m_max;
+};
+
+struct TThreadLatencies;
+
+// Histograms of all the operations of ElasticFileAPI in the process. Every thread has its own
+// histograms, created on its first call of an operation, so the threads share no cache lines.
+// They are summed only when a snapshot is taken, when a thread exits its calls go to the
+// histograms of the finished threads. A reset starts a new generation instead of changing the
+// histograms of the threads
+class EFileLatencyRecorder
+{
+public:
+	EFileLatencyRecorder(void);
+	~EFileLatencyRecorder(void);
+
+	void Record(const TEFileOperation& operation, unsigned __int64 nanoseconds);
+	void GetSnapshot(const TEFileOperation& operation, TEFileLatencyHistogram& histogram);
+	void Reset();
+
+	static EFileLatencyRecorder& Get();
+	static const char* GetOperationName(const TEFileOperation& operation);
+
+protected:
+	friend struct TThreadLatencies;
+
+	void AddThread(TThreadLatencies* thread);
+	void RemoveThread(TThreadLatencies* thread);
+
+private:
+	EFileLatencyRecorder(const EFileLatencyRecorder&);
+	EFileLatencyRecorder& operator=(const EFileLatencyRecorder&);
+
+private:
+	std::mutex m_lock;
+	std::atomic<unsigned int> m_generation;
+	std::set<TThreadLatencies*> m_threads;
+	TEFileLatencyHistogram m_finished_threads[EF_OPERATIONS_COUNT];
+};
+
+// Measures the time of a call from its start to the return, including the failed calls
+class EFileLatencyScope
+{
+public:
+	EFileLatencyScope(const TEFileOperation& operation)
+		: m_operation(operation)
+		, m_start(GetClock())
+	{
+	}
+
+	~EFileLatencyScope(void)
+	{
+		EFileLatencyRecorder::Get().Record(m_operation, GetClock() - m_start);
+	}
+
+	// Nanoseconds of a steady clock
+	static unsigned __int64 GetClock()
+	{
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+private:
+	TEFileOperation m_operation;
+	unsigned __int64 m_start;
+};
+
+#ifdef EF_LATENCY_HISTOGRAMS
+#define EF_LATENCY(operation) EFileLatencyScope latency(operation)
+#else
+#define EF_LATENCY(operation)
+#endif
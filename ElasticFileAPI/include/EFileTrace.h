@@ -0,0 +1,128 @@
+#pragma once
+#include <ElasticFile.h>
+
+#define EF_TRACE_SIGNATURE		"EFTRACE1"
+#define EF_TRACE_SIGNATURE_SIZE	8
+// Records are collected in memory and written to the trace file by this count of bytes
+#define EF_TRACE_BUFFER_SIZE	(64 * 1024)
+
+// Writes the calls of ElasticFileAPI to a binary trace file. A record is the operation, its
+// arguments, the result, the start time and the duration, numbers are written by 7 bits per
+// byte (TEFileTableCodec), so a call takes about 10-20 bytes. The data of reads and writes
+// is not written, only the sizes. Calls from all the threads go to the same trace
+class EFileTraceRecorder
+{
+public:
+	EFileTraceRecorder(void);
+	~EFileTraceRecorder(void);
+
+	// Stops the current trace and starts a new one in the file
+	void Start(const std::string& trace_file_name);
+	void Stop();
+
+	bool IsEnabled() const
+	{
+		return m_enabled.load(std::memory_order_relaxed);
+	}
+
+	// The time of the record is the time of the clock when the call started
+	void Write(TEFileTraceRecord& record);
+
+	static EFileTraceRecorder& Get();
+	// Nanoseconds of a steady clock
+	static unsigned __int64 GetClock();
+
+protected:
+	void Flush();
+	unsigned int GetThread();
+
+private:
+	std::mutex m_lock;
+	std::atomic<bool> m_enabled;
+	std::atomic<unsigned int> m_traces_count; // Threads are numbered again in every trace
+	std::atomic<unsigned int> m_threads_count;
+	FILE* m_file;
+	std::vector<BYTE> m_buffer;
+	std::atomic<unsigned __int64> m_start; // Nanoseconds of the steady clock
+};
+
+// One call of ElasticFileAPI. It is written to the trace when the call returns, with the failure
+// result unless another one is set. While there is no trace, only a flag is checked
+class EFileTraceScope
+{
+public:
+	EFileTraceScope(const TEFileTraceOperation& operation, const TEFileDescriptor& file, const size_file_t& argument, const DWORD& mode);
+	~EFileTraceScope(void);
+
+	bool IsEnabled() const
+	{
+		return m_enabled;
+	}
+
+	void SetOpen(const std::string& file_name, const TEFileBackendType& backend);
+	void SetArgument(const size_file_t& argument);
+
+	template<typename TResult>
+	const TResult& Result(const TResult& result)
+	{
+		m_record.Result = (unsigned __int64)result;
+		return result;
+	}
+
+private:
+	bool m_enabled;
+	TEFileTraceRecord m_record;
+};
+
+class EFileTraceReader
+{
+public:
+	EFileTraceReader(void);
+	~EFileTraceReader(void);
+
+	void Open(const std::string& trace_file_name);
+	void Close();
+	// Returns false in the end of the trace
+	bool Read(TEFileTraceRecord& record);
+
+protected:
+	bool Decode(TEFileTraceRecord& record);
+	bool Fill();
+
+private:
+	FILE* m_file;
+	std::vector<BYTE> m_buffer;
+	size_t m_position;
+	bool m_end;
+};
+
+// Runs the operations of a trace again, one by one in the order of the trace. Descriptors of the
+// trace are replaced by the descriptors of the files opened by the replay. The files are replayed
+// in the same directories under other names (TEFileTraceReplayOptions::NamePrefix) and are removed
+// before the first open, so a replay always starts with fresh files. A file which existed when it
+// was opened in the traced process is created with the same size of data first, the data itself
+// is not known. The replay fails if a file opened in the trace can't be opened again
+class EFileTraceReplayer
+{
+public:
+	EFileTraceReplayer(const TEFileTraceReplayOptions& options);
+	~EFileTraceReplayer(void);
+
+	void Replay(const std::string& trace_file_name, TEFileTraceReplayStats& stats);
+
+protected:
+	void PrepareFile(const TEFileTraceRecord& record, const std::string& file_name, const TEFileBackendType& backend);
+	unsigned __int64 Run(const TEFileTraceRecord& record);
+	std::string GetReplayName(const std::string& file_name) const;
+	bool Diverges(const TEFileTraceRecord& record, const unsigned __int64& result);
+	PBYTE GetBuffer(const size_file_t& size);
+	void CloseFiles();
+
+private:
+	typedef std::unordered_map<TEFileDescriptor, TEFileDescriptor> TFilesMap;
+
+	TEFileTraceReplayOptions m_options;
+	TFilesMap m_files; // Descriptors of the trace and of the replay
+	std::set<std::string> m_prepared_files;
+	std::vector<BYTE> m_buffer;
+};
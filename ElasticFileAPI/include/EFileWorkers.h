@@ -0,0 +1,36 @@
+#pragma once
+#include <ElasticFile.h>
+
+#define EF_ASYNC_WORKERS_COUNT 4
+
+// Pool of threads which run the asynchronous operations of ElasticFileAPI. The operations
+// of one file are run one by one in the order of submitting, the operations of different
+// files are run by different workers at the same time
+class EFileWorkers
+{
+public:
+	typedef std::function<void()> TTask;
+
+	EFileWorkers(size_t workers_count);
+	~EFileWorkers(void);
+
+	void Submit(const TEFileDescriptor& file_descriptor, const TTask& task);
+
+	static EFileWorkers& Get();
+
+protected:
+	void Run();
+
+private:
+	// The queue of a file keeps its running task in the front, and the file is in the ready
+	// queue only while none of its tasks is running, so a file is taken by one worker at once
+	typedef std::unordered_map<TEFileDescriptor, std::deque<TTask> > TFileQueues;
+
+	std::mutex m_lock;
+	std::condition_variable m_ready_condition;
+	TFileQueues m_file_queues;
+	std::deque<TEFileDescriptor> m_ready_files;
+	std::vector<std::thread> m_workers;
+	bool m_stopped;
+};
+
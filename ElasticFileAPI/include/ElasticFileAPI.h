@@ -1,19 +1,82 @@
 #pragma once
+#include <EFileAwaitable.h>
 #include <ElasticFile.h>
 
+// Completions of the asynchronous operations, they are called in a thread of the workers
+typedef std::function<void(size_file_t)> TEFileIOCompletion;
+typedef std::function<void(bool)> TEFileTruncateCompletion;
+
 class ElasticFileAPI
 {
 public:
 	ElasticFileAPI(void);
 	~ElasticFileAPI(void);
 
-	static TEFileHandle FileOpen(const std::string& file_name, const TEFileOpenMode& open_mode);
-	static bool FileSetCursor(const TEFileHandle& file, const size_file_t& offset, const TEFileCursorMoveMode& mode);
-	static const size_file_t& FileGetCursor(const TEFileHandle& file);
-	static size_file_t FileRead(const TEFileHandle& file, PBYTE buffer, const size_file_t& size);
-	static size_file_t FileWrite(const TEFileHandle& file, const PBYTE buffer, const size_file_t& size, bool overwrite = false);
-	static bool FileTruncate(const TEFileHandle& file, const size_file_t& cut_size);
-	static bool FileClose(const TEFileHandle& file);
+	static TEFileDescriptor FileOpen(const std::string& file_name, const TEFileOpenMode& open_mode, const TEFileBackendType& backend = EF_BACKEND_DEFAULT);
+	static bool FileSetCursor(const TEFileDescriptor& file, const size_file_t& offset, const TEFileCursorMoveMode& mode);
+	static size_file_t FileGetCursor(const TEFileDescriptor& file);
+	static size_file_t FileRead(const TEFileDescriptor& file, PBYTE buffer, const size_file_t& size);
+	static size_file_t FileWrite(const TEFileDescriptor& file, const PBYTE buffer, const size_file_t& size, bool overwrite = false);
+	static size_file_t FileReadv(const TEFileDescriptor& file, const TEFileIOVector* vectors, const size_t& vectors_count);
+	static size_file_t FileWritev(const TEFileDescriptor& file, const TEFileIOVector* vectors, const size_t& vectors_count, bool overwrite = false);
+	static size_file_t FileReadAt(const TEFileDescriptor& file, const size_file_t& position, PBYTE buffer, const size_file_t& size);
+	static size_file_t FileWriteAt(const TEFileDescriptor& file, const size_file_t& position, const PBYTE buffer, const size_file_t& size, bool overwrite = false);
+	static TEFileCursorPtr FileCreateCursor(const TEFileDescriptor& file);
+	static bool FileSetCursor(const TEFileDescriptor& file, TEFileCursor& cursor, const size_file_t& offset, const TEFileCursorMoveMode& mode);
+	static size_file_t FileRead(const TEFileDescriptor& file, TEFileCursor& cursor, PBYTE buffer, const size_file_t& size);
+	static TEFileSnapshotPtr FileCreateSnapshot(const TEFileDescriptor& file);
+	static size_file_t FileReadSnapshot(const TEFileSnapshotPtr& snapshot, const size_file_t& position, PBYTE buffer, const size_file_t& size);
+	static bool FileGetView(const TEFileDescriptor& file, const size_file_t& position, const size_file_t& size, TEFileReadView& view);
+	static bool FileTruncate(const TEFileDescriptor& file, const size_file_t& cut_size);
+	static bool FileApplyEdits(const TEFileDescriptor& file, const TEFileEdit* edits, const size_t& edits_count);
+	static bool FileClose(const TEFileDescriptor& file);
+	static bool FileSetAllocationPolicy(const TEFileDescriptor& file, const TEFileAllocationPolicy& policy);
+	static bool FileSetReadOrder(const TEFileDescriptor& file, const TEFileReadOrder& order, const size_file_t& gap_tolerance = EF_READ_GAP_TOLERANCE);
+	// Returns false while snapshots of the file exist, completed is true when nothing is left to move
+	static bool FileCompact(const TEFileDescriptor& file, const TEFileCompactMode& mode, const size_file_t& bytes_limit, bool& completed);
+	static bool FileSetCache(const TEFileDescriptor& file, const TEFileCachePolicy& policy, const TEFileCacheWriteMode& write_mode, const size_file_t& budget);
+	static bool FileGetCacheStats(const TEFileDescriptor& file, TEFileCacheStats& stats);
+	// Counters of the operations of the file since it has been opened and of all the files of the process
+	static bool FileGetCounters(const TEFileDescriptor& file, TEFileCountersSnapshot& counters);
+	static bool GetGlobalCounters(TEFileCountersSnapshot& counters);
+	static bool FileSetWriteCombining(const TEFileDescriptor& file, const size_file_t& buffer_size);
+	// Writes all the buffered data and the sectors table to the disk
+	static bool FileSync(const TEFileDescriptor& file);
+	// Reserves the space for the file to grow up to the size without changing its size
+	static bool FilePreallocate(const TEFileDescriptor& file, const size_file_t& size);
+	// Writes the sectors table of a closed file in the current format
+	static bool FileConvert(const std::string& file_name, const TEFileBackendType& backend = EF_BACKEND_DEFAULT);
+
+	// Writes the calls of FileOpen, FileSetCursor, FileRead, FileWrite, FileTruncate and FileClose
+	// from all the threads to a trace file until TraceStop
+	static bool TraceStart(const std::string& trace_file_name);
+	static bool TraceStop();
+	// Runs the calls of a trace again on new files, see EFileTraceReplayer
+	static bool TraceReplay(const std::string& trace_file_name, const TEFileTraceReplayOptions& options, TEFileTraceReplayStats& stats);
+
+	// Latencies of the calls of every operation since the start of the process or the last reset,
+	// see EFileLatencyHistogram::GetPercentile
+	static bool GetLatencyHistogram(const TEFileOperation& operation, TEFileLatencyHistogram& histogram);
+	static bool ResetLatencyHistograms();
+	// Writes the spans of the long steps of all the files to a Chrome trace event file until SpansStop
+	static bool SpansStart(const std::string& file_name);
+	static bool SpansStop();
+
+	// Operations of a file are run in the order of calls, so a read after a write reads the written data.
+	// The buffers must stay valid until the operation is completed
+	static std::future<size_file_t> FileReadAsync(const TEFileDescriptor& file, PBYTE buffer, const size_file_t& size);
+	static std::future<size_file_t> FileWriteAsync(const TEFileDescriptor& file, const PBYTE buffer, const size_file_t& size, bool overwrite = false);
+	static std::future<bool> FileTruncateAsync(const TEFileDescriptor& file, const size_file_t& cut_size);
+	static void FileReadAsync(const TEFileDescriptor& file, PBYTE buffer, const size_file_t& size, const TEFileIOCompletion& completion);
+	static void FileWriteAsync(const TEFileDescriptor& file, const PBYTE buffer, const size_file_t& size, bool overwrite, const TEFileIOCompletion& completion);
+	static void FileTruncateAsync(const TEFileDescriptor& file, const size_file_t& cut_size, const TEFileTruncateCompletion& completion);
+
+#ifdef EF_COROUTINES
+	// co_await ElasticFileAPI::FileReadAwait(file, buffer, size) gives the same result as FileRead
+	static EFileAwaitable<size_file_t> FileReadAwait(const TEFileDescriptor& file, PBYTE buffer, const size_file_t& size);
+	static EFileAwaitable<size_file_t> FileWriteAwait(const TEFileDescriptor& file, const PBYTE buffer, const size_file_t& size, bool overwrite = false);
+	static EFileAwaitable<bool> FileTruncateAwait(const TEFileDescriptor& file, const size_file_t& cut_size);
+#endif
 };
 
 
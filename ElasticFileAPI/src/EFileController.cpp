@@ -1,12 +1,44 @@
 #include <EFileController.h>
 #include <TEFileException.h>
 
+EFileController::TSlot::TSlot()
+	: Generation(1)
+{
+}
+
+EFileController::TFileAccess::TFileAccess(std::unique_lock<std::mutex>&& lock, ElasticFile& file)
+	: m_lock(std::move(lock))
+	, m_file(&file)
+{
+}
+
+EFileController::TFileAccess::TFileAccess(TFileAccess&& other)
+	: m_lock(std::move(other.m_lock))
+	, m_file(other.m_file)
+{
+}
+
+ElasticFile* EFileController::TFileAccess::operator->() const
+{
+	return m_file;
+}
+
+ElasticFile& EFileController::TFileAccess::operator*() const
+{
+	return *m_file;
+}
+
 EFileController::EFileController(void)
+	: m_slots_count(0)
 {
+	for(size_t chunk_index = 0; chunk_index < EF_HANDLES_MAX_CHUNKS; ++chunk_index)
+		m_chunks[chunk_index].store(NULL);
 }
 
 EFileController::~EFileController(void)
 {
+	for(size_t chunk_index = 0; chunk_index < EF_HANDLES_MAX_CHUNKS; ++chunk_index)
+		delete[] m_chunks[chunk_index].load();
 }
 
 EFileController& EFileController::Get()
@@ -15,38 +47,111 @@ EFileController& EFileController::Get()
 	return controller;
 }
 
-ElasticFile& EFileController::GetFile(const TEFileHandle& file_handle)
+EFileController::TFileAccess EFileController::GetFile(const TEFileDescriptor& file_descriptor)
 {
-	return *GetFileEntrance(file_handle)->second;
+	TSlot& slot = GetSlot(file_descriptor);
+
+	std::unique_lock<std::mutex> lock(slot.Lock);
+	if(slot.Generation != (unsigned int)(file_descriptor >> 32) || !slot.File)
+	{
+		throw(TEFileException(EF_HANDLE_NOT_FOUND, "Handle is useless"));
+	}
+
+	return TFileAccess(std::move(lock), *slot.File);
 }
 
-std::map<TEFileHandle, ElasticFilePtr>::iterator EFileController::GetFileEntrance(const TEFileHandle& file_handle)
+EFileController::TSlot& EFileController::GetSlot(const TEFileDescriptor& file_descriptor)
 {
-	CheckHandle(file_handle);
-	std::map<TEFileHandle, ElasticFilePtr>::iterator file_entrance = m_files.find(file_handle);
-	if(file_entrance == m_files.end())
+	CheckDescriptor(file_descriptor);
+
+	size_t slot_index = (size_t)(file_descriptor & 0xFFFFFFFF);
+	size_t chunk_index = slot_index / EF_HANDLES_CHUNK_SIZE;
+
+	TSlot* chunk = chunk_index < EF_HANDLES_MAX_CHUNKS ? m_chunks[chunk_index].load(std::memory_order_acquire) : NULL;
+	if(chunk == NULL)
 	{
 		throw(TEFileException(EF_HANDLE_NOT_FOUND, "Handle is useless"));
 	}
-	return file_entrance;
+
+	return chunk[slot_index % EF_HANDLES_CHUNK_SIZE];
 }
 
-TEFileHandle EFileController::OpenFile(const std::string& file_name, const TEFileOpenMode& mode)
+TEFileDescriptor EFileController::OpenFile(const std::string& file_name, const TEFileOpenMode& mode, const TEFileBackendType& backend)
 {
 	ElasticFilePtr new_file(new ElasticFile());
-	TEFileHandle file_handle = new_file->Open(file_name, mode);
-	m_files[file_handle] = new_file;
-	return file_handle;
+	new_file->Open(file_name, mode, backend);
+
+	size_t slot_index = AllocateSlot();
+	TSlot& slot = m_chunks[slot_index / EF_HANDLES_CHUNK_SIZE].load(std::memory_order_acquire)[slot_index % EF_HANDLES_CHUNK_SIZE];
+
+	std::lock_guard<std::mutex> lock(slot.Lock);
+	slot.File = new_file;
+	return ((TEFileDescriptor)slot.Generation << 32) | slot_index;
+}
+
+void EFileController::CloseFile(const TEFileDescriptor& file_descriptor)
+{
+	TSlot& slot = GetSlot(file_descriptor);
+
+	ElasticFilePtr closed_file;
+	{
+		std::lock_guard<std::mutex> lock(slot.Lock);
+		if(slot.Generation != (unsigned int)(file_descriptor >> 32) || !slot.File)
+		{
+			throw(TEFileException(EF_HANDLE_NOT_FOUND, "Handle is useless"));
+		}
+
+		closed_file.swap(slot.File);
+		if(++slot.Generation == 0)
+			slot.Generation = 1;
+	}
+
+	// The file is closed before the slot can be taken by another one. A failed flush of the
+	// buffered data is reported, and the slot is freed anyway because the handle is useless
+	try
+	{
+		closed_file->Close();
+	}
+	catch(TEFileException&)
+	{
+		FreeSlot((size_t)(file_descriptor & 0xFFFFFFFF));
+		throw;
+	}
+
+	FreeSlot((size_t)(file_descriptor & 0xFFFFFFFF));
+}
+
+size_t EFileController::AllocateSlot()
+{
+	std::lock_guard<std::mutex> lock(m_slots_lock);
+
+	if(!m_free_slots.empty())
+	{
+		size_t slot_index = m_free_slots.back();
+		m_free_slots.pop_back();
+		return slot_index;
+	}
+
+	if(m_slots_count == EF_HANDLES_CHUNK_SIZE * EF_HANDLES_MAX_CHUNKS)
+	{
+		throw(TEFileException(EF_OPEN_FILE_ERROR, STRING("Can't open more than " << m_slots_count << " files")));
+	}
+
+	if(m_slots_count % EF_HANDLES_CHUNK_SIZE == 0)
+		m_chunks[m_slots_count / EF_HANDLES_CHUNK_SIZE].store(new TSlot[EF_HANDLES_CHUNK_SIZE], std::memory_order_release);
+
+	return m_slots_count++;
 }
 
-void EFileController::CloseFile(const TEFileHandle& file)
+void EFileController::FreeSlot(size_t slot_index)
 {
-	m_files.erase(GetFileEntrance(file));
+	std::lock_guard<std::mutex> lock(m_slots_lock);
+	m_free_slots.push_back(slot_index);
 }
 
-void EFileController::CheckHandle(const TEFileHandle& file_handle)
+void EFileController::CheckDescriptor(const TEFileDescriptor& file_descriptor)
 {
-	if(file_handle == NULL)
+	if(file_descriptor == EF_NULL_DESCRIPTOR)
 	{
 		throw(TEFileException(EF_NULL_HANDLE, "Handle is NULL"));
 	}
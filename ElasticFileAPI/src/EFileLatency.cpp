@@ -0,0 +1,249 @@
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#include <EFileLatency.h>
+
+// Index of the highest set bit of a value which is not 0
+static unsigned int highest_bit(unsigned __int64 value)
+{
+#ifdef _MSC_VER
+	unsigned long index;
+	_BitScanReverse64(&index, value);
+	return index;
+#else
+	return 63 - __builtin_clzll(value);
+#endif
+}
+
+// Histograms of one thread, only the thread creates them
+struct TThreadLatencies
+{
+	TThreadLatencies(void)
+	{
+		for(int operation = 0; operation < EF_OPERATIONS_COUNT; operation++)
+			Histograms[operation].store(NULL, std::memory_order_relaxed);
+
+		EFileLatencyRecorder::Get().AddThread(this);
+	}
+
+	~TThreadLatencies(void)
+	{
+		EFileLatencyRecorder::Get().RemoveThread(this);
+
+		for(int operation = 0; operation < EF_OPERATIONS_COUNT; operation++)
+			delete Histograms[operation].load(std::memory_order_relaxed);
+	}
+
+	std::atomic<EFileLatencyHistogram*> Histograms[EF_OPERATIONS_COUNT];
+};
+
+EFileLatencyHistogram::EFileLatencyHistogram(void)
+	: m_generation(0)
+{
+	Clear();
+}
+
+EFileLatencyHistogram::~EFileLatencyHistogram(void)
+{
+}
+
+size_t EFileLatencyHistogram::GetBucket(unsigned __int64 nanoseconds)
+{
+	if(nanoseconds < EF_LATENCY_SUB_BUCKETS)
+		return (size_t)nanoseconds;
+
+	unsigned int bit = highest_bit(nanoseconds);
+	if(bit >= EF_LATENCY_MAX_BITS)
+		return EF_LATENCY_BUCKETS - 1;
+
+	// The bits after the highest one select the bucket in its power of two
+	unsigned int shift = bit - EF_LATENCY_SUB_BUCKET_BITS;
+	return (shift + 1) * EF_LATENCY_SUB_BUCKETS + (size_t)(nanoseconds >> shift) - EF_LATENCY_SUB_BUCKETS;
+}
+
+unsigned __int64 EFileLatencyHistogram::GetBucketValue(size_t bucket)
+{
+	if(bucket < EF_LATENCY_SUB_BUCKETS)
+		return bucket;
+
+	size_t shift = bucket / EF_LATENCY_SUB_BUCKETS - 1;
+	return (unsigned __int64)(bucket % EF_LATENCY_SUB_BUCKETS + EF_LATENCY_SUB_BUCKETS) << shift;
+}
+
+unsigned __int64 EFileLatencyHistogram::GetBucketWidth(size_t bucket)
+{
+	if(bucket < EF_LATENCY_SUB_BUCKETS)
+		return 1;
+
+	return (unsigned __int64)1 << (bucket / EF_LATENCY_SUB_BUCKETS - 1);
+}
+
+unsigned __int64 EFileLatencyHistogram::GetPercentile(const TEFileLatencyHistogram& histogram, double percentile)
+{
+	if(histogram.Count == 0)
+		return 0;
+
+	unsigned __int64 rank = (unsigned __int64)(percentile * histogram.Count + 0.5);
+	rank = std::max<unsigned __int64>(rank, 1);
+
+	unsigned __int64 count(0);
+	for(size_t bucket = 0; bucket < EF_LATENCY_BUCKETS; bucket++)
+	{
+		count += histogram.Buckets[bucket];
+		if(count >= rank)
+			return std::min<unsigned __int64>(GetBucketValue(bucket) + GetBucketWidth(bucket) - 1, histogram.Max);
+	}
+
+	return histogram.Max;
+}
+
+void EFileLatencyHistogram::AddTo(TEFileLatencyHistogram& histogram, unsigned int generation) const
+{
+	if(m_generation.load(std::memory_order_acquire) != generation)
+		return;
+
+	TEFileLatencyHistogram added;
+
+	for(size_t bucket = 0; bucket < EF_LATENCY_BUCKETS; bucket++)
+	{
+		added.Buckets[bucket] = m_buckets[bucket].load(std::memory_order_relaxed);
+		added.Count += added.Buckets[bucket];
+	}
+
+	added.Sum = m_sum.load(std::memory_order_relaxed);
+	added.Min = m_min.load(std::memory_order_relaxed);
+	added.Max = m_max.load(std::memory_order_relaxed);
+
+	Add(histogram, added);
+}
+
+void EFileLatencyHistogram::Add(TEFileLatencyHistogram& histogram, const TEFileLatencyHistogram& added)
+{
+	if(added.Count == 0)
+		return;
+
+	for(size_t bucket = 0; bucket < EF_LATENCY_BUCKETS; bucket++)
+		histogram.Buckets[bucket] += added.Buckets[bucket];
+
+	histogram.Min = histogram.Count == 0 ? added.Min : std::min<unsigned __int64>(histogram.Min, added.Min);
+	histogram.Max = std::max<unsigned __int64>(histogram.Max, added.Max);
+	histogram.Count += added.Count;
+	histogram.Sum += added.Sum;
+}
+
+void EFileLatencyHistogram::Clear()
+{
+	for(size_t bucket = 0; bucket < EF_LATENCY_BUCKETS; bucket++)
+		m_buckets[bucket].store(0, std::memory_order_relaxed);
+
+	m_sum.store(0, std::memory_order_relaxed);
+	m_min.store((unsigned __int64)-1, std::memory_order_relaxed);
+	m_max.store(0, std::memory_order_relaxed);
+}
+
+EFileLatencyRecorder::EFileLatencyRecorder(void)
+	: m_generation(1)
+{
+}
+
+EFileLatencyRecorder::~EFileLatencyRecorder(void)
+{
+}
+
+EFileLatencyRecorder& EFileLatencyRecorder::Get()
+{
+	// It is never destroyed, because threads can exit after the static objects are destroyed
+	static EFileLatencyRecorder* recorder = new EFileLatencyRecorder();
+	return *recorder;
+}
+
+void EFileLatencyRecorder::Record(const TEFileOperation& operation, unsigned __int64 nanoseconds)
+{
+	static thread_local TThreadLatencies thread_latencies;
+
+	EFileLatencyHistogram* histogram = thread_latencies.Histograms[operation].load(std::memory_order_relaxed);
+	if(histogram == NULL)
+	{
+		histogram = new EFileLatencyHistogram();
+		thread_latencies.Histograms[operation].store(histogram, std::memory_order_release);
+	}
+
+	histogram->Record(nanoseconds, m_generation.load(std::memory_order_relaxed));
+}
+
+void EFileLatencyRecorder::GetSnapshot(const TEFileOperation& operation, TEFileLatencyHistogram& histogram)
+{
+	std::lock_guard<std::mutex> lock(m_lock);
+
+	unsigned int generation = m_generation.load(std::memory_order_relaxed);
+
+	histogram = m_finished_threads[operation];
+
+	for(std::set<TThreadLatencies*>::iterator thread_it = m_threads.begin(); thread_it != m_threads.end(); ++thread_it)
+	{
+		const EFileLatencyHistogram* thread_histogram = (*thread_it)->Histograms[operation].load(std::memory_order_acquire);
+		if(thread_histogram != NULL)
+			thread_histogram->AddTo(histogram, generation);
+	}
+}
+
+void EFileLatencyRecorder::Reset()
+{
+	std::lock_guard<std::mutex> lock(m_lock);
+
+	// The histograms of the threads are cleared by the threads on their next calls
+	m_generation.fetch_add(1);
+
+	for(int operation = 0; operation < EF_OPERATIONS_COUNT; operation++)
+		m_finished_threads[operation] = TEFileLatencyHistogram();
+}
+
+void EFileLatencyRecorder::AddThread(TThreadLatencies* thread)
+{
+	std::lock_guard<std::mutex> lock(m_lock);
+	m_threads.insert(thread);
+}
+
+void EFileLatencyRecorder::RemoveThread(TThreadLatencies* thread)
+{
+	std::lock_guard<std::mutex> lock(m_lock);
+	m_threads.erase(thread);
+
+	unsigned int generation = m_generation.load(std::memory_order_relaxed);
+
+	for(int operation = 0; operation < EF_OPERATIONS_COUNT; operation++)
+	{
+		const EFileLatencyHistogram* histogram = thread->Histograms[operation].load(std::memory_order_relaxed);
+		if(histogram != NULL)
+			histogram->AddTo(m_finished_threads[operation], generation);
+	}
+}
+
+const char* EFileLatencyRecorder::GetOperationName(const TEFileOperation& operation)
+{
+	static const char* names[EF_OPERATIONS_COUNT] =
+	{
+		"FileOpen",
+		"FileSetCursor",
+		"FileGetCursor",
+		"FileRead",
+		"FileWrite",
+		"FileReadv",
+		"FileWritev",
+		"FileReadAt",
+		"FileWriteAt",
+		"FileCreateCursor",
+		"FileCreateSnapshot",
+		"FileReadSnapshot",
+		"FileGetView",
+		"FileTruncate",
+		"FileApplyEdits",
+		"FileClose",
+		"FileCompact",
+		"FileSync",
+		"FilePreallocate",
+		"FileConvert"
+	};
+
+	return operation < EF_OPERATIONS_COUNT ? names[operation] : "unknown";
+}
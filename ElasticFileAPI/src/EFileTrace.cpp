@@ -0,0 +1,514 @@
+#include <chrono>
+#include <EFileTrace.h>
+#include <ElasticFileAPI.h>
+#include <TEFileException.h>
+#include <TEFileTableCodec.h>
+#include <TEFileMemoryBackend.h>
+
+// Data of a file which existed before the trace is written by parts of this size
+#define EF_TRACE_FILL_SIZE (1024 * 1024)
+
+// Separators of the directories in the names of the traced files
+#ifdef _WIN32
+#define EF_TRACE_PATH_SEPARATORS "\\/"
+#else
+#define EF_TRACE_PATH_SEPARATORS "/"
+#endif
+
+EFileTraceRecorder::EFileTraceRecorder(void)
+	: m_enabled(false)
+	, m_traces_count(0)
+	, m_threads_count(0)
+	, m_file(NULL)
+	, m_start(0)
+{
+}
+
+EFileTraceRecorder::~EFileTraceRecorder(void)
+{
+	try
+	{
+		Stop();
+	}
+	catch(...)
+	{
+		ERRLOG( "can't close the trace" );
+	}
+}
+
+EFileTraceRecorder& EFileTraceRecorder::Get()
+{
+	static EFileTraceRecorder recorder;
+	return recorder;
+}
+
+unsigned __int64 EFileTraceRecorder::GetClock()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void EFileTraceRecorder::Start(const std::string& trace_file_name)
+{
+	Stop();
+
+	std::lock_guard<std::mutex> lock(m_lock);
+
+	m_file = fopen(trace_file_name.c_str(), "wb");
+	if(m_file == NULL)
+	{
+		throw TEFileException(EF_OPEN_FILE_ERROR, STRING("Can't create trace " << trace_file_name));
+	}
+
+	m_buffer.assign(EF_TRACE_SIGNATURE, EF_TRACE_SIGNATURE + EF_TRACE_SIGNATURE_SIZE);
+
+	m_threads_count.store(0);
+	m_traces_count.fetch_add(1);
+	m_start.store(GetClock());
+	m_enabled.store(true);
+}
+
+void EFileTraceRecorder::Stop()
+{
+	std::lock_guard<std::mutex> lock(m_lock);
+
+	m_enabled.store(false);
+
+	if(m_file == NULL)
+		return;
+
+	Flush();
+
+	int result = fclose(m_file);
+	m_file = NULL;
+
+	if(result != 0)
+	{
+		throw TEFileException(EF_CLOSE_FILE_ERROR, "Can't close the trace");
+	}
+}
+
+unsigned int EFileTraceRecorder::GetThread()
+{
+	static thread_local unsigned int thread_trace(0);
+	static thread_local unsigned int thread_index(0);
+
+	unsigned int trace = m_traces_count.load();
+	if(thread_trace != trace)
+	{
+		thread_trace = trace;
+		thread_index = m_threads_count.fetch_add(1);
+	}
+
+	return thread_index;
+}
+
+void EFileTraceRecorder::Write(TEFileTraceRecord& record)
+{
+	unsigned int thread = GetThread();
+
+	std::lock_guard<std::mutex> lock(m_lock);
+
+	// The call has started before the trace
+	unsigned __int64 start = m_start.load();
+	if(m_file == NULL || record.Time < start)
+		return;
+
+	m_buffer.push_back((BYTE)record.Operation);
+	TEFileTableCodec::EncodeNumber(thread, m_buffer);
+	TEFileTableCodec::EncodeNumber(record.Time - start, m_buffer);
+	TEFileTableCodec::EncodeNumber(record.Duration, m_buffer);
+	TEFileTableCodec::EncodeNumber(record.File, m_buffer);
+	TEFileTableCodec::EncodeNumber(record.Argument, m_buffer);
+	TEFileTableCodec::EncodeNumber(record.Mode, m_buffer);
+	TEFileTableCodec::EncodeNumber(record.Result, m_buffer);
+
+	if(record.Operation == EF_TRACE_OPEN)
+	{
+		TEFileTableCodec::EncodeNumber(record.Backend, m_buffer);
+		TEFileTableCodec::EncodeNumber(record.FileName.size(), m_buffer);
+		m_buffer.insert(m_buffer.end(), record.FileName.begin(), record.FileName.end());
+	}
+
+	if(m_buffer.size() >= EF_TRACE_BUFFER_SIZE)
+		Flush();
+}
+
+void EFileTraceRecorder::Flush()
+{
+	if(!m_buffer.empty() && fwrite(&m_buffer[0], sizeof(BYTE), m_buffer.size(), m_file) != m_buffer.size())
+	{
+		ERRLOG( "can't write " << m_buffer.size() << " bytes to the trace" );
+	}
+
+	m_buffer.clear();
+}
+
+EFileTraceScope::EFileTraceScope(const TEFileTraceOperation& operation, const TEFileDescriptor& file, const size_file_t& argument, const DWORD& mode)
+	: m_enabled(EFileTraceRecorder::Get().IsEnabled())
+{
+	if(!m_enabled)
+		return;
+
+	m_record.Operation = operation;
+	m_record.File = file;
+	m_record.Argument = argument;
+	m_record.Mode = mode;
+	m_record.Time = EFileTraceRecorder::GetClock();
+}
+
+EFileTraceScope::~EFileTraceScope(void)
+{
+	if(!m_enabled)
+		return;
+
+	m_record.Duration = EFileTraceRecorder::GetClock() - m_record.Time;
+
+	try
+	{
+		EFileTraceRecorder::Get().Write(m_record);
+	}
+	catch(...)
+	{
+		ERRLOG( "can't write a record to the trace" );
+	}
+}
+
+void EFileTraceScope::SetOpen(const std::string& file_name, const TEFileBackendType& backend)
+{
+	if(!m_enabled)
+		return;
+
+	m_record.FileName = file_name;
+	m_record.Backend = backend;
+}
+
+void EFileTraceScope::SetArgument(const size_file_t& argument)
+{
+	m_record.Argument = argument;
+}
+
+EFileTraceReader::EFileTraceReader(void)
+	: m_file(NULL)
+	, m_position(0)
+	, m_end(false)
+{
+}
+
+EFileTraceReader::~EFileTraceReader(void)
+{
+	Close();
+}
+
+void EFileTraceReader::Open(const std::string& trace_file_name)
+{
+	Close();
+
+	m_file = fopen(trace_file_name.c_str(), "rb");
+	if(m_file == NULL)
+	{
+		throw TEFileException(EF_FILE_NOT_EXISTS, STRING("Can't open trace " << trace_file_name));
+	}
+
+	m_buffer.clear();
+	m_position = 0;
+	m_end = false;
+
+	while(m_buffer.size() < EF_TRACE_SIGNATURE_SIZE && Fill())
+		;
+
+	if(m_buffer.size() < EF_TRACE_SIGNATURE_SIZE || memcmp(&m_buffer[0], EF_TRACE_SIGNATURE, EF_TRACE_SIGNATURE_SIZE) != 0)
+	{
+		Close();
+		throw TEFileException(EF_UNCORRECT_PARAMETER, STRING(trace_file_name << " is not a trace"));
+	}
+
+	m_position = EF_TRACE_SIGNATURE_SIZE;
+}
+
+void EFileTraceReader::Close()
+{
+	if(m_file != NULL)
+		fclose(m_file);
+
+	m_file = NULL;
+}
+
+bool EFileTraceReader::Read(TEFileTraceRecord& record)
+{
+	// A record can be cut by the end of the buffer, then it is decoded again after the next part is read
+	while(!Decode(record))
+	{
+		if(!Fill())
+		{
+			if(m_position < m_buffer.size())
+			{
+				ERRLOG( "the trace ends with an incomplete record of " << m_buffer.size() - m_position << " bytes" );
+			}
+
+			return false;
+		}
+	}
+
+	return true;
+}
+
+bool EFileTraceReader::Decode(TEFileTraceRecord& record)
+{
+	if(m_position >= m_buffer.size())
+		return false;
+
+	const BYTE* data = &m_buffer[0] + m_position;
+	const BYTE* data_end = &m_buffer[0] + m_buffer.size();
+
+	BYTE operation = *data++;
+	if(operation >= EF_TRACE_OPERATIONS_COUNT)
+	{
+		throw TEFileException(EF_UNCORRECT_PARAMETER, STRING("Unknown operation " << (int)operation << " in the trace"));
+	}
+
+	unsigned __int64 values[7];
+	for(int value_index = 0; value_index < 7; value_index++)
+	{
+		if(!TEFileTableCodec::DecodeNumber(data, data_end, values[value_index]))
+			return false;
+	}
+
+	record.Operation = (TEFileTraceOperation)operation;
+	record.Thread = (unsigned int)values[0];
+	record.Time = values[1];
+	record.Duration = values[2];
+	record.File = values[3];
+	record.Argument = values[4];
+	record.Mode = (DWORD)values[5];
+	record.Result = values[6];
+	record.FileName.clear();
+
+	if(record.Operation == EF_TRACE_OPEN)
+	{
+		unsigned __int64 backend;
+		unsigned __int64 name_size;
+		if(!TEFileTableCodec::DecodeNumber(data, data_end, backend) || !TEFileTableCodec::DecodeNumber(data, data_end, name_size))
+			return false;
+
+		if(name_size > (unsigned __int64)(data_end - data))
+			return false;
+
+		record.Backend = (TEFileBackendType)backend;
+		record.FileName.assign(data, data + (size_t)name_size);
+		data += (size_t)name_size;
+	}
+
+	m_position = data - &m_buffer[0];
+	return true;
+}
+
+bool EFileTraceReader::Fill()
+{
+	if(m_end || m_file == NULL)
+		return false;
+
+	// The decoded records are dropped
+	m_buffer.erase(m_buffer.begin(), m_buffer.begin() + m_position);
+	m_position = 0;
+
+	size_t size = m_buffer.size();
+	m_buffer.resize(size + EF_TRACE_BUFFER_SIZE);
+
+	size_t bytes_read = fread(&m_buffer[size], sizeof(BYTE), EF_TRACE_BUFFER_SIZE, m_file);
+	m_buffer.resize(size + bytes_read);
+
+	if(bytes_read < EF_TRACE_BUFFER_SIZE)
+		m_end = true;
+
+	return bytes_read > 0;
+}
+
+EFileTraceReplayer::EFileTraceReplayer(const TEFileTraceReplayOptions& options)
+	: m_options(options)
+{
+}
+
+EFileTraceReplayer::~EFileTraceReplayer(void)
+{
+	CloseFiles();
+}
+
+void EFileTraceReplayer::Replay(const std::string& trace_file_name, TEFileTraceReplayStats& stats)
+{
+	if(m_options.NamePrefix.empty())
+	{
+		throw TEFileException(EF_UNCORRECT_PARAMETER, "Files of a trace can't be replayed under their own names");
+	}
+
+	EFileTraceReader reader;
+	reader.Open(trace_file_name);
+
+	stats = TEFileTraceReplayStats();
+
+	unsigned __int64 replay_start = EFileTraceRecorder::GetClock();
+
+	TEFileTraceRecord record;
+	while(reader.Read(record))
+	{
+		if(m_options.Timing == EF_REPLAY_ORIGINAL_TIMING)
+		{
+			unsigned __int64 replay_time = EFileTraceRecorder::GetClock() - replay_start;
+			if(replay_time < record.Time)
+				std::this_thread::sleep_for(std::chrono::nanoseconds(record.Time - replay_time));
+		}
+
+		TEFileBackendType backend = m_options.UseTracedBackend ? record.Backend : m_options.Backend;
+		if(record.Operation == EF_TRACE_OPEN)
+			PrepareFile(record, GetReplayName(record.FileName), backend);
+
+		unsigned __int64 operation_start = EFileTraceRecorder::GetClock();
+		unsigned __int64 result = Run(record);
+		unsigned __int64 operation_time = EFileTraceRecorder::GetClock() - operation_start;
+
+		stats.Operations++;
+		stats.OperationsCount[record.Operation]++;
+		stats.OperationsNanoseconds[record.Operation] += operation_time;
+		stats.TracedNanoseconds[record.Operation] += record.Duration;
+
+		if(Diverges(record, result))
+			stats.Divergences++;
+	}
+
+	// The trace can be stopped before the files are closed
+	CloseFiles();
+
+	stats.Nanoseconds = EFileTraceRecorder::GetClock() - replay_start;
+}
+
+void EFileTraceReplayer::PrepareFile(const TEFileTraceRecord& record, const std::string& file_name, const TEFileBackendType& backend)
+{
+	if(!m_prepared_files.insert(file_name).second)
+		return;
+
+	if(backend == EF_BACKEND_MEMORY)
+		TEFileMemoryBackend::Remove(file_name);
+	else
+		remove(file_name.c_str());
+
+	// The traced open has created the file or has failed
+	if((record.Mode & (EF_MODE_CREATE | EF_MODE_CREATENEW | EF_MODE_TRUNCATE)) != 0 || record.Result == EF_NULL_DESCRIPTOR)
+		return;
+
+	TEFileDescriptor file = ElasticFileAPI::FileOpen(file_name, EF_MODE_CREATE, backend);
+	if(file == EF_NULL_DESCRIPTOR)
+	{
+		throw TEFileException(EF_OPEN_FILE_ERROR, STRING("Can't create " << file_name << " for the replay"));
+	}
+
+	for(size_file_t bytes_written = 0; bytes_written < record.Argument; )
+	{
+		size_file_t size = std::min<size_file_t>(record.Argument - bytes_written, (size_file_t)EF_TRACE_FILL_SIZE);
+		if(ElasticFileAPI::FileWrite(file, GetBuffer(size), size) != size)
+		{
+			ElasticFileAPI::FileClose(file);
+			throw TEFileException(EF_WRITE_DATA_ERROR, STRING("Can't write the data of " << file_name << " for the replay"));
+		}
+
+		bytes_written += size;
+	}
+
+	if(!ElasticFileAPI::FileClose(file))
+	{
+		throw TEFileException(EF_CLOSE_FILE_ERROR, STRING("Can't close " << file_name << " for the replay"));
+	}
+}
+
+unsigned __int64 EFileTraceReplayer::Run(const TEFileTraceRecord& record)
+{
+	if(record.Operation == EF_TRACE_OPEN)
+	{
+		TEFileBackendType backend = m_options.UseTracedBackend ? record.Backend : m_options.Backend;
+
+		std::string file_name = GetReplayName(record.FileName);
+
+		TEFileDescriptor file = ElasticFileAPI::FileOpen(file_name, (TEFileOpenMode)record.Mode, backend);
+		if(record.Result != EF_NULL_DESCRIPTOR)
+		{
+			// Otherwise every following operation of the file would only diverge
+			if(file == EF_NULL_DESCRIPTOR)
+			{
+				throw TEFileException(EF_OPEN_FILE_ERROR, STRING("Can't open " << file_name << " for the replay, it was opened in the trace"));
+			}
+
+			m_files[record.Result] = file;
+		}
+		else if(file != EF_NULL_DESCRIPTOR)
+		{
+			// Nothing refers to the file in the trace
+			ElasticFileAPI::FileClose(file);
+		}
+
+		return file;
+	}
+
+	// Files opened before the start of the trace are unknown, their operations fail
+	TFilesMap::iterator file_it = m_files.find(record.File);
+	TEFileDescriptor file = file_it != m_files.end() ? file_it->second : EF_NULL_DESCRIPTOR;
+
+	switch(record.Operation)
+	{
+	case EF_TRACE_SET_CURSOR:
+		return ElasticFileAPI::FileSetCursor(file, record.Argument, (TEFileCursorMoveMode)record.Mode);
+
+	case EF_TRACE_READ:
+		return ElasticFileAPI::FileRead(file, GetBuffer(record.Argument), record.Argument);
+
+	case EF_TRACE_WRITE:
+		return ElasticFileAPI::FileWrite(file, GetBuffer(record.Argument), record.Argument, record.Mode != 0);
+
+	case EF_TRACE_TRUNCATE:
+		return ElasticFileAPI::FileTruncate(file, record.Argument);
+
+	case EF_TRACE_CLOSE:
+		if(file_it != m_files.end())
+			m_files.erase(file_it);
+
+		return ElasticFileAPI::FileClose(file);
+
+	default:
+		throw TEFileException(EF_UNCORRECT_PARAMETER, STRING("Unknown operation " << record.Operation << " in the trace"));
+	}
+}
+
+std::string EFileTraceReplayer::GetReplayName(const std::string& file_name) const
+{
+	// The prefix goes before the name of the file, the directory stays the same
+	size_t name_start = file_name.find_last_of(EF_TRACE_PATH_SEPARATORS);
+	name_start = name_start == std::string::npos ? 0 : name_start + 1;
+
+	return file_name.substr(0, name_start) + m_options.NamePrefix + file_name.substr(name_start);
+}
+
+bool EFileTraceReplayer::Diverges(const TEFileTraceRecord& record, const unsigned __int64& result)
+{
+	// Descriptors differ, only the success of an open is compared
+	if(record.Operation == EF_TRACE_OPEN)
+		return (result != EF_NULL_DESCRIPTOR) != (record.Result != EF_NULL_DESCRIPTOR);
+
+	return result != record.Result;
+}
+
+PBYTE EFileTraceReplayer::GetBuffer(const size_file_t& size)
+{
+	// The data of the trace is not known, any bytes are written
+	if(m_buffer.size() < size || m_buffer.empty())
+		m_buffer.resize((size_t)std::max<size_file_t>(size, (size_file_t)1), 'x');
+
+	return &m_buffer[0];
+}
+
+void EFileTraceReplayer::CloseFiles()
+{
+	for(TFilesMap::iterator file_it = m_files.begin(); file_it != m_files.end(); ++file_it)
+	{
+		if(file_it->second != EF_NULL_DESCRIPTOR)
+			ElasticFileAPI::FileClose(file_it->second);
+	}
+
+	m_files.clear();
+}
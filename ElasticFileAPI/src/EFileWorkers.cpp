@@ -0,0 +1,94 @@
+#include <EFileWorkers.h>
+#include <EFileController.h>
+
+EFileWorkers::EFileWorkers(size_t workers_count)
+	: m_stopped(false)
+{
+	// The files are closed by the controller after the workers are stopped
+	EFileController::Get();
+
+	for(size_t worker_index = 0; worker_index < workers_count; ++worker_index)
+		m_workers.push_back(std::thread(&EFileWorkers::Run, this));
+}
+
+EFileWorkers::~EFileWorkers(void)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_lock);
+		m_stopped = true;
+	}
+
+	m_ready_condition.notify_all();
+
+	// The submitted tasks are completed first
+	for(std::vector<std::thread>::iterator worker_it = m_workers.begin(); worker_it != m_workers.end(); ++worker_it)
+		worker_it->join();
+}
+
+EFileWorkers& EFileWorkers::Get()
+{
+	static EFileWorkers workers(EF_ASYNC_WORKERS_COUNT);
+	return workers;
+}
+
+void EFileWorkers::Submit(const TEFileDescriptor& file_descriptor, const TTask& task)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_lock);
+
+		std::deque<TTask>& file_queue = m_file_queues[file_descriptor];
+		file_queue.push_back(task);
+
+		// Otherwise the file is already waiting or running
+		if(file_queue.size() > 1)
+			return;
+
+		m_ready_files.push_back(file_descriptor);
+	}
+
+	m_ready_condition.notify_one();
+}
+
+void EFileWorkers::Run()
+{
+	std::unique_lock<std::mutex> lock(m_lock);
+
+	while(true)
+	{
+		while(m_ready_files.empty() && !m_stopped)
+			m_ready_condition.wait(lock);
+
+		if(m_ready_files.empty())
+			return;
+
+		TEFileDescriptor file_descriptor = m_ready_files.front();
+		m_ready_files.pop_front();
+
+		TTask task = m_file_queues[file_descriptor].front();
+
+		lock.unlock();
+		try
+		{
+			task();
+		}
+		catch(...)
+		{
+			ERRLOG( "exception in an asynchronous operation" );
+		}
+		lock.lock();
+
+		// The next task of the file goes to the end of the ready queue, so the files take turns
+		std::deque<TTask>& file_queue = m_file_queues[file_descriptor];
+		file_queue.pop_front();
+
+		if(file_queue.empty())
+		{
+			m_file_queues.erase(file_descriptor);
+		}
+		else
+		{
+			m_ready_files.push_back(file_descriptor);
+			m_ready_condition.notify_one();
+		}
+	}
+}
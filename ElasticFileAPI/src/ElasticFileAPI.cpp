@@ -1,6 +1,10 @@
 #include <ElasticFileAPI.h>
 #include <TEFileException.h>
 #include <EFileController.h>
+#include <EFileWorkers.h>
+#include <EFileTrace.h>
+#include <EFileLatency.h>
+#include <TEFileSpans.h>
 
 #ifdef EF_EXCEPTIONS_ENABLED
 #define THROW_EXCEPTION(ex) throw ex
@@ -37,34 +41,48 @@ void ProcessException(char* msg)
 }
 
 
-TEFileHandle ElasticFileAPI::FileOpen(const std::string& fileName, const TEFileOpenMode& openMode)
+TEFileDescriptor ElasticFileAPI::FileOpen(const std::string& fileName, const TEFileOpenMode& openMode, const TEFileBackendType& backend)
 {
+	EF_LATENCY(EF_OPERATION_OPEN);
+	EFileTraceScope trace(EF_TRACE_OPEN, EF_NULL_DESCRIPTOR, 0, openMode);
+	trace.SetOpen(fileName, backend);
+
 	try
 	{
-		return EFileController::Get().OpenFile(fileName, openMode);
+		EFileController& controller = EFileController::Get();
+		TEFileDescriptor file = controller.OpenFile(fileName, openMode, backend);
+
+		// The replay creates the file with the same data size if it has existed
+		if(trace.IsEnabled())
+			trace.SetArgument(controller.GetFile(file)->GetDataSize());
+
+		return trace.Result(file);
 	}
 	catch(TEFileException& ex)
 	{
 		ProcessException(ex);
-		return NULL;
+		return EF_NULL_DESCRIPTOR;
 	}
 	catch(std::exception& ex)
 	{
 		ProcessException(ex);
-		return NULL;
+		return EF_NULL_DESCRIPTOR;
 	}
 	catch(...)
 	{
 		ProcessException(UNKNOWN_EXCEPTION);
-		return NULL;
+		return EF_NULL_DESCRIPTOR;
 	}
 }
 
-bool ElasticFileAPI::FileSetCursor(const TEFileHandle& file, const size_file_t& offset, const TEFileCursorMoveMode& mode)
+bool ElasticFileAPI::FileSetCursor(const TEFileDescriptor& file, const size_file_t& offset, const TEFileCursorMoveMode& mode)
 {
+	EF_LATENCY(EF_OPERATION_SET_CURSOR);
+	EFileTraceScope trace(EF_TRACE_SET_CURSOR, file, offset, mode);
+
 	try
 	{
-		EFileController::Get().GetFile(file).SetPosition(offset, mode);
+		EFileController::Get().GetFile(file)->SetPosition(offset, mode);
 	}
 	catch(TEFileException& ex)
 	{
@@ -82,14 +100,17 @@ bool ElasticFileAPI::FileSetCursor(const TEFileHandle& file, const size_file_t&
 		return false;
 	}
 
-	return true;
+	return trace.Result(true);
 }
 
-const size_file_t& ElasticFileAPI::FileGetCursor(const TEFileHandle& file)
+size_file_t ElasticFileAPI::FileGetCursor(const TEFileDescriptor& file)
 {
+	EF_LATENCY(EF_OPERATION_GET_CURSOR);
+
 	try
 	{
-		return EFileController::Get().GetFile(file).GetPosition();
+		// The position is copied while the file is locked
+		return EFileController::Get().GetFile(file)->GetPosition();
 	}
 	catch(TEFileException& ex)
 	{
@@ -107,11 +128,127 @@ const size_file_t& ElasticFileAPI::FileGetCursor(const TEFileHandle& file)
 	return 0;
 }
 
-size_file_t ElasticFileAPI::FileRead(const TEFileHandle& file, PBYTE buffer, const size_file_t& size)
+size_file_t ElasticFileAPI::FileRead(const TEFileDescriptor& file, PBYTE buffer, const size_file_t& size)
+{
+	EF_LATENCY(EF_OPERATION_READ);
+	EFileTraceScope trace(EF_TRACE_READ, file, size, 0);
+
+	try
+	{
+		return trace.Result(EFileController::Get().GetFile(file)->Read(buffer, size));
+	}
+	catch(TEFileException& ex)
+	{
+		ProcessException(ex);
+		if(ex.error() == EF_READ_DATA_ERROR)
+			return trace.Result(ex.data());
+
+		return 0;
+	}
+	catch(std::exception& ex)
+	{
+		ProcessException(ex);
+		return 0;
+	}
+	catch(...)
+	{
+		ProcessException(UNKNOWN_EXCEPTION);
+		return 0;
+	}
+}
+
+size_file_t ElasticFileAPI::FileWrite(const TEFileDescriptor& file, const PBYTE buffer, const size_file_t& size, bool overwrite)
+{
+	EF_LATENCY(EF_OPERATION_WRITE);
+	EFileTraceScope trace(EF_TRACE_WRITE, file, size, overwrite);
+
+	try
+	{
+		return trace.Result(EFileController::Get().GetFile(file)->Write(buffer, size, overwrite));
+	}
+	catch(TEFileException& ex)
+	{
+		ProcessException(ex);
+		if(ex.error() == EF_WRITE_DATA_ERROR)
+			return trace.Result(ex.data());
+
+		return 0;
+	}
+	catch(std::exception& ex)
+	{
+		ProcessException(ex);
+		return 0;
+	}
+	catch(...)
+	{
+		ProcessException(UNKNOWN_EXCEPTION);
+		return 0;
+	}
+}
+
+size_file_t ElasticFileAPI::FileReadv(const TEFileDescriptor& file, const TEFileIOVector* vectors, const size_t& vectors_count)
+{
+	EF_LATENCY(EF_OPERATION_READV);
+
+	try
+	{
+		return EFileController::Get().GetFile(file)->Readv(vectors, vectors_count);
+	}
+	catch(TEFileException& ex)
+	{
+		ProcessException(ex);
+		if(ex.error() == EF_READ_DATA_ERROR)
+			return ex.data();
+
+		return 0;
+	}
+	catch(std::exception& ex)
+	{
+		ProcessException(ex);
+		return 0;
+	}
+	catch(...)
+	{
+		ProcessException(UNKNOWN_EXCEPTION);
+		return 0;
+	}
+}
+
+size_file_t ElasticFileAPI::FileWritev(const TEFileDescriptor& file, const TEFileIOVector* vectors, const size_t& vectors_count, bool overwrite)
+{
+	EF_LATENCY(EF_OPERATION_WRITEV);
+
+	try
+	{
+		return EFileController::Get().GetFile(file)->Writev(vectors, vectors_count, overwrite);
+	}
+	catch(TEFileException& ex)
+	{
+		ProcessException(ex);
+		if(ex.error() == EF_WRITE_DATA_ERROR)
+			return ex.data();
+
+		return 0;
+	}
+	catch(std::exception& ex)
+	{
+		ProcessException(ex);
+		return 0;
+	}
+	catch(...)
+	{
+		ProcessException(UNKNOWN_EXCEPTION);
+		return 0;
+	}
+}
+
+size_file_t ElasticFileAPI::FileReadAt(const TEFileDescriptor& file, const size_file_t& position, PBYTE buffer, const size_file_t& size)
 {
+	EF_LATENCY(EF_OPERATION_READ_AT);
+
 	try
 	{
-		return EFileController::Get().GetFile(file).Read(buffer, size);
+		return EFileController::Get().GetFile(file)->ReadAt(position, buffer, size);
 	}
 	catch(TEFileException& ex)
 	{
@@ -133,11 +270,13 @@ size_file_t ElasticFileAPI::FileRead(const TEFileHandle& file, PBYTE buffer, con
 	}
 }
 
-size_file_t ElasticFileAPI::FileWrite(const TEFileHandle& file, const PBYTE buffer, const size_file_t& size, bool overwrite)
+size_file_t ElasticFileAPI::FileWriteAt(const TEFileDescriptor& file, const size_file_t& position, const PBYTE buffer, const size_file_t& size, bool overwrite)
 {
+	EF_LATENCY(EF_OPERATION_WRITE_AT);
+
 	try
 	{
-		return EFileController::Get().GetFile(file).Write(buffer, size, overwrite);
+		return EFileController::Get().GetFile(file)->WriteAt(position, buffer, size, overwrite);
 	}
 	catch(TEFileException& ex)
 	{
@@ -159,12 +298,179 @@ size_file_t ElasticFileAPI::FileWrite(const TEFileHandle& file, const PBYTE buff
 	}
 }
 
+TEFileCursorPtr ElasticFileAPI::FileCreateCursor(const TEFileDescriptor& file)
+{
+	EF_LATENCY(EF_OPERATION_CREATE_CURSOR);
+
+	try
+	{
+		return EFileController::Get().GetFile(file)->CreateCursor();
+	}
+	catch(TEFileException& ex)
+	{
+		ProcessException(ex);
+	}
+	catch(std::exception& ex)
+	{
+		ProcessException(ex);
+	}
+	catch(...)
+	{
+		ProcessException(UNKNOWN_EXCEPTION);
+	}
+
+	return TEFileCursorPtr();
+}
+
+bool ElasticFileAPI::FileSetCursor(const TEFileDescriptor& file, TEFileCursor& cursor, const size_file_t& offset, const TEFileCursorMoveMode& mode)
+{
+	EF_LATENCY(EF_OPERATION_SET_CURSOR);
+
+	try
+	{
+		EFileController::Get().GetFile(file)->SetPosition(cursor, offset, mode);
+	}
+	catch(TEFileException& ex)
+	{
+		ProcessException(ex);
+		return false;
+	}
+	catch(std::exception& ex)
+	{
+		ProcessException(ex);
+		return false;
+	}
+	catch(...)
+	{
+		ProcessException(UNKNOWN_EXCEPTION);
+		return false;
+	}
+
+	return true;
+}
+
+size_file_t ElasticFileAPI::FileRead(const TEFileDescriptor& file, TEFileCursor& cursor, PBYTE buffer, const size_file_t& size)
+{
+	EF_LATENCY(EF_OPERATION_READ);
+
+	try
+	{
+		return EFileController::Get().GetFile(file)->Read(cursor, buffer, size);
+	}
+	catch(TEFileException& ex)
+	{
+		ProcessException(ex);
+		if(ex.error() == EF_READ_DATA_ERROR)
+			return ex.data();
+
+		return 0;
+	}
+	catch(std::exception& ex)
+	{
+		ProcessException(ex);
+		return 0;
+	}
+	catch(...)
+	{
+		ProcessException(UNKNOWN_EXCEPTION);
+		return 0;
+	}
+}
+
+TEFileSnapshotPtr ElasticFileAPI::FileCreateSnapshot(const TEFileDescriptor& file)
+{
+	EF_LATENCY(EF_OPERATION_CREATE_SNAPSHOT);
+
+	try
+	{
+		return EFileController::Get().GetFile(file)->CreateSnapshot();
+	}
+	catch(TEFileException& ex)
+	{
+		ProcessException(ex);
+	}
+	catch(std::exception& ex)
+	{
+		ProcessException(ex);
+	}
+	catch(...)
+	{
+		ProcessException(UNKNOWN_EXCEPTION);
+	}
+
+	return TEFileSnapshotPtr();
+}
+
+// The snapshot is read without the lock of its file
+size_file_t ElasticFileAPI::FileReadSnapshot(const TEFileSnapshotPtr& snapshot, const size_file_t& position, PBYTE buffer, const size_file_t& size)
+{
+	EF_LATENCY(EF_OPERATION_READ_SNAPSHOT);
+
+	try
+	{
+		if(!snapshot)
+		{
+			throw TEFileException(EF_UNCORRECT_PARAMETER, "Snapshot is NULL");
+		}
+
+		return snapshot->Read(position, buffer, size);
+	}
+	catch(TEFileException& ex)
+	{
+		ProcessException(ex);
+		if(ex.error() == EF_READ_DATA_ERROR)
+			return ex.data();
+
+		return 0;
+	}
+	catch(std::exception& ex)
+	{
+		ProcessException(ex);
+		return 0;
+	}
+	catch(...)
+	{
+		ProcessException(UNKNOWN_EXCEPTION);
+		return 0;
+	}
+}
+
+
+bool ElasticFileAPI::FileGetView(const TEFileDescriptor& file, const size_file_t& position, const size_file_t& size, TEFileReadView& view)
+{
+	EF_LATENCY(EF_OPERATION_GET_VIEW);
+
+	try
+	{
+		EFileController::Get().GetFile(file)->GetView(position, size, view);
+	}
+	catch(TEFileException& ex)
+	{
+		ProcessException(ex);
+		return false;
+	}
+	catch(std::exception& ex)
+	{
+		ProcessException(ex);
+		return false;
+	}
+	catch(...)
+	{
+		ProcessException(UNKNOWN_EXCEPTION);
+		return false;
+	}
+
+	return true;
+}
 
-bool ElasticFileAPI::FileTruncate(const TEFileHandle& file, const size_file_t& cut_size)
+bool ElasticFileAPI::FileTruncate(const TEFileDescriptor& file, const size_file_t& cut_size)
 {
+	EF_LATENCY(EF_OPERATION_TRUNCATE);
+	EFileTraceScope trace(EF_TRACE_TRUNCATE, file, cut_size, 0);
+
 	try
 	{
-		return EFileController::Get().GetFile(file).Truncate(cut_size) == cut_size;
+		return trace.Result(EFileController::Get().GetFile(file)->Truncate(cut_size) == cut_size);
 	}
 	catch(TEFileException& ex)
 	{
@@ -182,11 +488,13 @@ bool ElasticFileAPI::FileTruncate(const TEFileHandle& file, const size_file_t& c
 	return false;
 }
 
-bool ElasticFileAPI::FileClose(const TEFileHandle& file)
+bool ElasticFileAPI::FileApplyEdits(const TEFileDescriptor& file, const TEFileEdit* edits, const size_t& edits_count)
 {
+	EF_LATENCY(EF_OPERATION_APPLY_EDITS);
+
 	try
 	{
-		EFileController::Get().CloseFile(file);
+		EFileController::Get().GetFile(file)->ApplyEdits(edits, edits_count);
 	}
 	catch(TEFileException& ex)
 	{
@@ -205,4 +513,601 @@ bool ElasticFileAPI::FileClose(const TEFileHandle& file)
 	}
 
 	return true;
-}
\ No newline at end of file
+}
+
+bool ElasticFileAPI::FileClose(const TEFileDescriptor& file)
+{
+	EF_LATENCY(EF_OPERATION_CLOSE);
+	EFileTraceScope trace(EF_TRACE_CLOSE, file, 0, 0);
+
+	try
+	{
+		EFileController::Get().CloseFile(file);
+	}
+	catch(TEFileException& ex)
+	{
+		ProcessException(ex);
+		return false;
+	}
+	catch(std::exception& ex)
+	{
+		ProcessException(ex);
+		return false;
+	}
+	catch(...)
+	{
+		ProcessException(UNKNOWN_EXCEPTION);
+		return false;
+	}
+
+	return trace.Result(true);
+}
+
+bool ElasticFileAPI::FileSetAllocationPolicy(const TEFileDescriptor& file, const TEFileAllocationPolicy& policy)
+{
+	try
+	{
+		EFileController::Get().GetFile(file)->SetAllocationPolicy(policy);
+	}
+	catch(TEFileException& ex)
+	{
+		ProcessException(ex);
+		return false;
+	}
+	catch(std::exception& ex)
+	{
+		ProcessException(ex);
+		return false;
+	}
+	catch(...)
+	{
+		ProcessException(UNKNOWN_EXCEPTION);
+		return false;
+	}
+
+	return true;
+}
+
+bool ElasticFileAPI::FileSetReadOrder(const TEFileDescriptor& file, const TEFileReadOrder& order, const size_file_t& gap_tolerance)
+{
+	try
+	{
+		EFileController::Get().GetFile(file)->SetReadOrder(order, gap_tolerance);
+	}
+	catch(TEFileException& ex)
+	{
+		ProcessException(ex);
+		return false;
+	}
+	catch(std::exception& ex)
+	{
+		ProcessException(ex);
+		return false;
+	}
+	catch(...)
+	{
+		ProcessException(UNKNOWN_EXCEPTION);
+		return false;
+	}
+
+	return true;
+}
+
+bool ElasticFileAPI::FileCompact(const TEFileDescriptor& file, const TEFileCompactMode& mode, const size_file_t& bytes_limit, bool& completed)
+{
+	EF_LATENCY(EF_OPERATION_COMPACT);
+
+	completed = false;
+
+	try
+	{
+		completed = EFileController::Get().GetFile(file)->Compact(mode, bytes_limit);
+	}
+	catch(TEFileException& ex)
+	{
+		ProcessException(ex);
+		return false;
+	}
+	catch(std::exception& ex)
+	{
+		ProcessException(ex);
+		return false;
+	}
+	catch(...)
+	{
+		ProcessException(UNKNOWN_EXCEPTION);
+		return false;
+	}
+
+	return true;
+}
+
+bool ElasticFileAPI::FileSetCache(const TEFileDescriptor& file, const TEFileCachePolicy& policy, const TEFileCacheWriteMode& write_mode, const size_file_t& budget)
+{
+	try
+	{
+		EFileController::Get().GetFile(file)->SetCache(policy, write_mode, budget);
+	}
+	catch(TEFileException& ex)
+	{
+		ProcessException(ex);
+		return false;
+	}
+	catch(std::exception& ex)
+	{
+		ProcessException(ex);
+		return false;
+	}
+	catch(...)
+	{
+		ProcessException(UNKNOWN_EXCEPTION);
+		return false;
+	}
+
+	return true;
+}
+
+bool ElasticFileAPI::FileGetCacheStats(const TEFileDescriptor& file, TEFileCacheStats& stats)
+{
+	try
+	{
+		stats = EFileController::Get().GetFile(file)->GetCacheStats();
+	}
+	catch(TEFileException& ex)
+	{
+		ProcessException(ex);
+		return false;
+	}
+	catch(std::exception& ex)
+	{
+		ProcessException(ex);
+		return false;
+	}
+	catch(...)
+	{
+		ProcessException(UNKNOWN_EXCEPTION);
+		return false;
+	}
+
+	return true;
+}
+
+bool ElasticFileAPI::FileGetCounters(const TEFileDescriptor& file, TEFileCountersSnapshot& counters)
+{
+	try
+	{
+		EFileController::Get().GetFile(file)->GetCountersSnapshot(counters);
+	}
+	catch(TEFileException& ex)
+	{
+		ProcessException(ex);
+		return false;
+	}
+	catch(std::exception& ex)
+	{
+		ProcessException(ex);
+		return false;
+	}
+	catch(...)
+	{
+		ProcessException(UNKNOWN_EXCEPTION);
+		return false;
+	}
+
+	return true;
+}
+
+bool ElasticFileAPI::GetGlobalCounters(TEFileCountersSnapshot& counters)
+{
+	try
+	{
+		TEFileCounters::GetGlobalSnapshot(counters);
+	}
+	catch(TEFileException& ex)
+	{
+		ProcessException(ex);
+		return false;
+	}
+	catch(std::exception& ex)
+	{
+		ProcessException(ex);
+		return false;
+	}
+	catch(...)
+	{
+		ProcessException(UNKNOWN_EXCEPTION);
+		return false;
+	}
+
+	return true;
+}
+
+bool ElasticFileAPI::FileSetWriteCombining(const TEFileDescriptor& file, const size_file_t& buffer_size)
+{
+	try
+	{
+		EFileController::Get().GetFile(file)->SetWriteCombining(buffer_size);
+	}
+	catch(TEFileException& ex)
+	{
+		ProcessException(ex);
+		return false;
+	}
+	catch(std::exception& ex)
+	{
+		ProcessException(ex);
+		return false;
+	}
+	catch(...)
+	{
+		ProcessException(UNKNOWN_EXCEPTION);
+		return false;
+	}
+
+	return true;
+}
+
+bool ElasticFileAPI::FileSync(const TEFileDescriptor& file)
+{
+	EF_LATENCY(EF_OPERATION_SYNC);
+
+	try
+	{
+		EFileController::Get().GetFile(file)->Sync();
+	}
+	catch(TEFileException& ex)
+	{
+		ProcessException(ex);
+		return false;
+	}
+	catch(std::exception& ex)
+	{
+		ProcessException(ex);
+		return false;
+	}
+	catch(...)
+	{
+		ProcessException(UNKNOWN_EXCEPTION);
+		return false;
+	}
+
+	return true;
+}
+
+bool ElasticFileAPI::FilePreallocate(const TEFileDescriptor& file, const size_file_t& size)
+{
+	EF_LATENCY(EF_OPERATION_PREALLOCATE);
+
+	try
+	{
+		EFileController::Get().GetFile(file)->Preallocate(size);
+	}
+	catch(TEFileException& ex)
+	{
+		ProcessException(ex);
+		return false;
+	}
+	catch(std::exception& ex)
+	{
+		ProcessException(ex);
+		return false;
+	}
+	catch(...)
+	{
+		ProcessException(UNKNOWN_EXCEPTION);
+		return false;
+	}
+
+	return true;
+}
+
+bool ElasticFileAPI::FileConvert(const std::string& file_name, const TEFileBackendType& backend)
+{
+	EF_LATENCY(EF_OPERATION_CONVERT);
+
+	try
+	{
+		EFileController& controller = EFileController::Get();
+
+		TEFileDescriptor file = controller.OpenFile(file_name, EF_MODE_OPEN, backend);
+		controller.GetFile(file)->ConvertTable();
+		controller.CloseFile(file);
+	}
+	catch(TEFileException& ex)
+	{
+		ProcessException(ex);
+		return false;
+	}
+	catch(std::exception& ex)
+	{
+		ProcessException(ex);
+		return false;
+	}
+	catch(...)
+	{
+		ProcessException(UNKNOWN_EXCEPTION);
+		return false;
+	}
+
+	return true;
+}
+
+bool ElasticFileAPI::TraceStart(const std::string& trace_file_name)
+{
+	try
+	{
+		EFileTraceRecorder::Get().Start(trace_file_name);
+	}
+	catch(TEFileException& ex)
+	{
+		ProcessException(ex);
+		return false;
+	}
+	catch(std::exception& ex)
+	{
+		ProcessException(ex);
+		return false;
+	}
+	catch(...)
+	{
+		ProcessException(UNKNOWN_EXCEPTION);
+		return false;
+	}
+
+	return true;
+}
+
+bool ElasticFileAPI::TraceStop()
+{
+	try
+	{
+		EFileTraceRecorder::Get().Stop();
+	}
+	catch(TEFileException& ex)
+	{
+		ProcessException(ex);
+		return false;
+	}
+	catch(std::exception& ex)
+	{
+		ProcessException(ex);
+		return false;
+	}
+	catch(...)
+	{
+		ProcessException(UNKNOWN_EXCEPTION);
+		return false;
+	}
+
+	return true;
+}
+
+bool ElasticFileAPI::TraceReplay(const std::string& trace_file_name, const TEFileTraceReplayOptions& options, TEFileTraceReplayStats& stats)
+{
+	try
+	{
+		EFileTraceReplayer replayer(options);
+		replayer.Replay(trace_file_name, stats);
+	}
+	catch(TEFileException& ex)
+	{
+		ProcessException(ex);
+		return false;
+	}
+	catch(std::exception& ex)
+	{
+		ProcessException(ex);
+		return false;
+	}
+	catch(...)
+	{
+		ProcessException(UNKNOWN_EXCEPTION);
+		return false;
+	}
+
+	return true;
+}
+
+bool ElasticFileAPI::GetLatencyHistogram(const TEFileOperation& operation, TEFileLatencyHistogram& histogram)
+{
+	try
+	{
+		if(operation < 0 || operation >= EF_OPERATIONS_COUNT)
+		{
+			throw TEFileException(EF_UNCORRECT_PARAMETER, STRING("Unknown operation " << operation));
+		}
+
+		EFileLatencyRecorder::Get().GetSnapshot(operation, histogram);
+	}
+	catch(TEFileException& ex)
+	{
+		ProcessException(ex);
+		return false;
+	}
+	catch(std::exception& ex)
+	{
+		ProcessException(ex);
+		return false;
+	}
+	catch(...)
+	{
+		ProcessException(UNKNOWN_EXCEPTION);
+		return false;
+	}
+
+	return true;
+}
+
+bool ElasticFileAPI::ResetLatencyHistograms()
+{
+	try
+	{
+		EFileLatencyRecorder::Get().Reset();
+	}
+	catch(TEFileException& ex)
+	{
+		ProcessException(ex);
+		return false;
+	}
+	catch(std::exception& ex)
+	{
+		ProcessException(ex);
+		return false;
+	}
+	catch(...)
+	{
+		ProcessException(UNKNOWN_EXCEPTION);
+		return false;
+	}
+
+	return true;
+}
+
+bool ElasticFileAPI::SpansStart(const std::string& file_name)
+{
+	try
+	{
+		TEFileSpansRecorder::Get().Start(file_name);
+	}
+	catch(TEFileException& ex)
+	{
+		ProcessException(ex);
+		return false;
+	}
+	catch(std::exception& ex)
+	{
+		ProcessException(ex);
+		return false;
+	}
+	catch(...)
+	{
+		ProcessException(UNKNOWN_EXCEPTION);
+		return false;
+	}
+
+	return true;
+}
+
+bool ElasticFileAPI::SpansStop()
+{
+	try
+	{
+		TEFileSpansRecorder::Get().Stop();
+	}
+	catch(TEFileException& ex)
+	{
+		ProcessException(ex);
+		return false;
+	}
+	catch(std::exception& ex)
+	{
+		ProcessException(ex);
+		return false;
+	}
+	catch(...)
+	{
+		ProcessException(UNKNOWN_EXCEPTION);
+		return false;
+	}
+
+	return true;
+}
+
+std::future<size_file_t> ElasticFileAPI::FileReadAsync(const TEFileDescriptor& file, PBYTE buffer, const size_file_t& size)
+{
+	TEFileDescriptor file_descriptor = file;
+	std::shared_ptr<std::packaged_task<size_file_t()> > task(new std::packaged_task<size_file_t()>([=]() { return FileRead(file_descriptor, buffer, size); }));
+
+	EFileWorkers::Get().Submit(file, [=]() { (*task)(); });
+	return task->get_future();
+}
+
+std::future<size_file_t> ElasticFileAPI::FileWriteAsync(const TEFileDescriptor& file, const PBYTE buffer, const size_file_t& size, bool overwrite)
+{
+	TEFileDescriptor file_descriptor = file;
+	std::shared_ptr<std::packaged_task<size_file_t()> > task(new std::packaged_task<size_file_t()>([=]() { return FileWrite(file_descriptor, buffer, size, overwrite); }));
+
+	EFileWorkers::Get().Submit(file, [=]() { (*task)(); });
+	return task->get_future();
+}
+
+std::future<bool> ElasticFileAPI::FileTruncateAsync(const TEFileDescriptor& file, const size_file_t& cut_size)
+{
+	TEFileDescriptor file_descriptor = file;
+	std::shared_ptr<std::packaged_task<bool()> > task(new std::packaged_task<bool()>([=]() { return FileTruncate(file_descriptor, cut_size); }));
+
+	EFileWorkers::Get().Submit(file, [=]() { (*task)(); });
+	return task->get_future();
+}
+
+// Exceptions can't be passed to a completion, so it gets the result of a failed operation
+void ElasticFileAPI::FileReadAsync(const TEFileDescriptor& file, PBYTE buffer, const size_file_t& size, const TEFileIOCompletion& completion)
+{
+	TEFileDescriptor file_descriptor = file;
+	EFileWorkers::Get().Submit(file, [=]()
+	{
+		size_file_t bytes_read(0);
+		try
+		{
+			bytes_read = FileRead(file_descriptor, buffer, size);
+		}
+		catch(...)
+		{
+		}
+		completion(bytes_read);
+	});
+}
+
+void ElasticFileAPI::FileWriteAsync(const TEFileDescriptor& file, const PBYTE buffer, const size_file_t& size, bool overwrite, const TEFileIOCompletion& completion)
+{
+	TEFileDescriptor file_descriptor = file;
+	EFileWorkers::Get().Submit(file, [=]()
+	{
+		size_file_t bytes_written(0);
+		try
+		{
+			bytes_written = FileWrite(file_descriptor, buffer, size, overwrite);
+		}
+		catch(...)
+		{
+		}
+		completion(bytes_written);
+	});
+}
+
+void ElasticFileAPI::FileTruncateAsync(const TEFileDescriptor& file, const size_file_t& cut_size, const TEFileTruncateCompletion& completion)
+{
+	TEFileDescriptor file_descriptor = file;
+	EFileWorkers::Get().Submit(file, [=]()
+	{
+		bool truncated(false);
+		try
+		{
+			truncated = FileTruncate(file_descriptor, cut_size);
+		}
+		catch(...)
+		{
+		}
+		completion(truncated);
+	});
+}
+
+#ifdef EF_COROUTINES
+EFileAwaitable<size_file_t> ElasticFileAPI::FileReadAwait(const TEFileDescriptor& file, PBYTE buffer, const size_file_t& size)
+{
+	TEFileDescriptor file_descriptor = file;
+	return EFileAwaitable<size_file_t>([=](const TEFileIOCompletion& completion) { FileReadAsync(file_descriptor, buffer, size, completion); });
+}
+
+EFileAwaitable<size_file_t> ElasticFileAPI::FileWriteAwait(const TEFileDescriptor& file, const PBYTE buffer, const size_file_t& size, bool overwrite)
+{
+	TEFileDescriptor file_descriptor = file;
+	return EFileAwaitable<size_file_t>([=](const TEFileIOCompletion& completion) { FileWriteAsync(file_descriptor, buffer, size, overwrite, completion); });
+}
+
+EFileAwaitable<bool> ElasticFileAPI::FileTruncateAwait(const TEFileDescriptor& file, const size_file_t& cut_size)
+{
+	TEFileDescriptor file_descriptor = file;
+	return EFileAwaitable<bool>([=](const TEFileTruncateCompletion& completion) { FileTruncateAsync(file_descriptor, cut_size, completion); });
+}
+#endif
@@ -0,0 +1,67 @@
+#include "benchmark.h"
+#include <vector>
+
+// Writes the records one by one to the end of a new file, the way test1 of test_util does
+static DWORD append_records(const std::string& file_name, size_file_t records, size_file_t record_size, size_file_t buffer_size)
+{
+	TEFileDescriptor file = ElasticFileAPI::FileOpen(file_name, EF_MODE_CREATE);
+	ElasticFileAPI::FileSetWriteCombining(file, buffer_size);
+
+	std::vector<BYTE> record(record_size);
+
+	DWORD time = GetTickCount();
+
+	for(size_file_t i = 0; i != records; i++)
+	{
+		record.assign(record_size, (BYTE)('a' + i % 26));
+		if(ElasticFileAPI::FileWrite(file, &record[0], record_size) != record_size)
+			INFO("Can't write the record " << i);
+	}
+
+	ElasticFileAPI::FileClose(file);
+
+	return GetTickCount() - time;
+}
+
+static bool check_records(const std::string& file_name, size_file_t records, size_file_t record_size)
+{
+	TEFileDescriptor file = ElasticFileAPI::FileOpen(file_name, EF_MODE_OPEN);
+
+	std::vector<BYTE> data(records * record_size);
+	bool valid = data.empty() || ElasticFileAPI::FileRead(file, &data[0], data.size()) == data.size();
+
+	for(size_file_t i = 0; valid && i != data.size(); i++)
+		valid = data[i] == (BYTE)('a' + i / record_size % 26);
+
+	ElasticFileAPI::FileClose(file);
+
+	return valid;
+}
+
+int append_benchmark(int argc, char* argv[])
+{
+	std::string file_name("benchmark_data");
+
+	size_file_t records = benchmark_argument(argc, argv, 2, 100000);
+	size_file_t record_size = benchmark_argument(argc, argv, 3, 32);
+	size_file_t buffer_size = benchmark_argument(argc, argv, 4, 64 * 1024);
+
+	INFO("Append. " << records << " records with length " << record_size << " are written to the end of the file");
+
+	DWORD direct_time = append_records(file_name, records, record_size, 0);
+	bool direct_valid = check_records(file_name, records, record_size);
+
+	DWORD combined_time = append_records(file_name, records, record_size, buffer_size);
+	bool combined_valid = check_records(file_name, records, record_size);
+
+	INFO("Every record is written at once: " << direct_time << " ms");
+	INFO("Records are combined in a buffer of " << buffer_size << " bytes: " << combined_time << " ms");
+
+	if(!direct_valid || !combined_valid)
+	{
+		INFO("The written data is not valid");
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,97 @@
+#include "benchmark.h"
+
+size_file_t benchmark_argument(int argc, char* argv[], int index, size_file_t default_value)
+{
+	if(index >= argc)
+		return default_value;
+
+	return (size_file_t)atol(argv[index]);
+}
+
+std::vector<size_file_t> benchmark_arguments(int argc, char* argv[], int index, size_file_t default_value)
+{
+	std::vector<size_file_t> values;
+	if(index >= argc)
+	{
+		values.push_back(default_value);
+		return values;
+	}
+
+	std::string list(argv[index]);
+	for(size_t begin = 0; begin <= list.size(); )
+	{
+		size_t end = list.find(',', begin);
+		if(end == std::string::npos)
+			end = list.size();
+
+		if(end > begin)
+			values.push_back((size_file_t)atol(list.substr(begin, end - begin).c_str()));
+
+		begin = end + 1;
+	}
+
+	if(values.empty())
+		values.push_back(default_value);
+
+	return values;
+}
+
+void print_usage()
+{
+	std::cout << std::endl << " Usage: benchmark <name> [parameters]" << std::endl << std::endl;
+	std::cout << " read_order [records] [record_size] [repeats]" << std::endl;
+	std::cout << "     Reads a fragmented file in the logical and in the physical order of sectors" << std::endl << std::endl;
+	std::cout << " append [records] [record_size] [buffer_size]" << std::endl;
+	std::cout << "     Writes small records to the end of a file one by one and through the write-combining buffer" << std::endl << std::endl;
+	std::cout << " edit_batch [records] [small_record_size] [record_size]" << std::endl;
+	std::cout << "     Inserts records between others and deletes every other pair one by one and by edit batches" << std::endl << std::endl;
+	std::cout << " table [sectors] [free_percent] [shuffle_percent] [operations] [allocation_policy]" << std::endl;
+	std::cout << "     Operations of the sectors table on a generated fragmented table of an in-memory file, ns/op and allocations/op" << std::endl << std::endl;
+	std::cout << " workloads [records_list] [small_record_size_list] [large_record_size_list] [repeats] [json_file] [backend] [perf_counters]" << std::endl;
+	std::cout << "     The workloads of test_util and random edits over all the combinations of the comma-separated parameters," << std::endl;
+	std::cout << "     compared with a plain file rewritten on every edit. Latency percentiles and throughput are written as JSON" << std::endl << std::endl;
+	std::cout << " replay <trace_file> [original_timing] [backend]" << std::endl;
+	std::cout << "     Runs the operations of a trace written by ElasticFileAPI::TraceStart on new files, at full speed or with the original timing" << std::endl << std::endl;
+	std::cout << " latency [records] [record_size] [rounds] [spans_file]" << std::endl;
+	std::cout << "     Latency percentiles of every operation of inserts, reads and cuts in a reopened file, the spans of the long steps as a Chrome trace" << std::endl << std::endl;
+	std::cout << " roundtrip" << std::endl;
+	std::cout << "     Checks that in-memory files are read back after syncs, journal replay, format conversion, torn chunks and every compaction step, and that a trace of a file in a directory is replayed, exits with 1 on a mismatch" << std::endl << std::endl;
+}
+
+int main(int argc, char* argv[])
+{
+	if(argc < 2)
+	{
+		print_usage();
+		return 1;
+	}
+
+	std::string name(argv[1]);
+
+	if(name == "read_order")
+		return read_order_benchmark(argc, argv);
+
+	if(name == "append")
+		return append_benchmark(argc, argv);
+
+	if(name == "edit_batch")
+		return edit_batch_benchmark(argc, argv);
+
+	if(name == "table")
+		return table_benchmark(argc, argv);
+
+	if(name == "workloads")
+		return workload_benchmark(argc, argv);
+
+	if(name == "replay")
+		return replay_benchmark(argc, argv);
+
+	if(name == "latency")
+		return latency_benchmark(argc, argv);
+
+	if(name == "roundtrip")
+		return roundtrip_check(argc, argv);
+
+	print_usage();
+	return 1;
+}
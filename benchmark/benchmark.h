@@ -0,0 +1,34 @@
+#pragma once
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <chrono>
+
+#define LOG_INFO
+
+#include <ElasticFileAPI.h>
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+// Milliseconds of a steady clock, like on Windows
+inline DWORD GetTickCount()
+{
+	return (DWORD)std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+#endif
+
+// Benchmarks take their parameters from the command line, a missing one gets the default value
+size_file_t benchmark_argument(int argc, char* argv[], int index, size_file_t default_value);
+// A comma-separated list of values of a parameter, for a sweep over them
+std::vector<size_file_t> benchmark_arguments(int argc, char* argv[], int index, size_file_t default_value);
+
+int read_order_benchmark(int argc, char* argv[]);
+int append_benchmark(int argc, char* argv[]);
+int edit_batch_benchmark(int argc, char* argv[]);
+int table_benchmark(int argc, char* argv[]);
+int workload_benchmark(int argc, char* argv[]);
+int replay_benchmark(int argc, char* argv[]);
+int latency_benchmark(int argc, char* argv[]);
+int roundtrip_check(int argc, char* argv[]);
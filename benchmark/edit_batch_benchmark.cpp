@@ -0,0 +1,112 @@
+#include "benchmark.h"
+#include <vector>
+
+// Inserts a record after every small record and then deletes every other pair, the way
+// test2 and test4 of test_util do. The edits are made one by one or by two batches
+static DWORD edit_records(const std::string& file_name, size_file_t records, size_file_t small_size, size_file_t record_size, bool batch)
+{
+	TEFileDescriptor file = ElasticFileAPI::FileOpen(file_name, EF_MODE_CREATE);
+
+	std::vector<BYTE> small_records(records * small_size, 's');
+	ElasticFileAPI::FileWrite(file, &small_records[0], small_records.size());
+
+	std::vector<BYTE> record(record_size, 'R');
+	size_file_t pair_size = small_size + record_size;
+
+	DWORD time = GetTickCount();
+
+	if(batch)
+	{
+		std::vector<TEFileEdit> edits(records);
+		for(size_file_t i = 0; i != records; i++)
+		{
+			edits[i].Type = EF_EDIT_INSERT;
+			edits[i].Position = (i + 1) * small_size;
+			edits[i].Size = record_size;
+			edits[i].Buffer = &record[0];
+		}
+
+		ElasticFileAPI::FileApplyEdits(file, &edits[0], edits.size());
+
+		edits.clear();
+		for(size_file_t i = 1; i < records; i += 2)
+		{
+			TEFileEdit edit;
+			edit.Type = EF_EDIT_DELETE;
+			edit.Position = i * pair_size;
+			edit.Size = pair_size;
+			edit.Buffer = 0;
+			edits.push_back(edit);
+		}
+
+		if(!edits.empty())
+			ElasticFileAPI::FileApplyEdits(file, &edits[0], edits.size());
+	}
+	else
+	{
+		ElasticFileAPI::FileSetCursor(file, 0, EF_CURSOR_BEGIN);
+		for(size_file_t i = 0; i != records; i++)
+		{
+			ElasticFileAPI::FileSetCursor(file, small_size, EF_CURSOR_CURRENT);
+			ElasticFileAPI::FileWrite(file, &record[0], record_size);
+		}
+
+		ElasticFileAPI::FileSetCursor(file, 0, EF_CURSOR_BEGIN);
+		for(size_file_t data_size = records * pair_size; ElasticFileAPI::FileGetCursor(file) + pair_size < data_size; data_size -= pair_size)
+		{
+			ElasticFileAPI::FileSetCursor(file, pair_size, EF_CURSOR_CURRENT);
+			ElasticFileAPI::FileTruncate(file, pair_size);
+		}
+	}
+
+	time = GetTickCount() - time;
+
+	ElasticFileAPI::FileClose(file);
+
+	return time;
+}
+
+static void read_records(const std::string& file_name, std::vector<BYTE>& data)
+{
+	TEFileDescriptor file = ElasticFileAPI::FileOpen(file_name, EF_MODE_OPEN);
+
+	ElasticFileAPI::FileSetCursor(file, 0, EF_CURSOR_END);
+	data.resize(ElasticFileAPI::FileGetCursor(file));
+
+	ElasticFileAPI::FileSetCursor(file, 0, EF_CURSOR_BEGIN);
+	if(!data.empty())
+		ElasticFileAPI::FileRead(file, &data[0], data.size());
+
+	ElasticFileAPI::FileClose(file);
+}
+
+int edit_batch_benchmark(int argc, char* argv[])
+{
+	std::string file_name("benchmark_data");
+
+	size_file_t records = benchmark_argument(argc, argv, 2, 20000);
+	size_file_t small_size = benchmark_argument(argc, argv, 3, 16);
+	size_file_t record_size = benchmark_argument(argc, argv, 4, 64);
+
+	INFO("Edit batch. " << records << " records with length " << record_size << " are inserted between records with length " << small_size << ", then every other pair is deleted");
+
+	std::vector<BYTE> single_data;
+	std::vector<BYTE> batch_data;
+
+	DWORD single_time = edit_records(file_name, records, small_size, record_size, false);
+	read_records(file_name, single_data);
+
+	DWORD batch_time = edit_records(file_name, records, small_size, record_size, true);
+	read_records(file_name, batch_data);
+
+	INFO("Every edit is made at once: " << single_time << " ms");
+	INFO("Edits are applied by batches: " << batch_time << " ms");
+
+	if(single_data != batch_data)
+	{
+		INFO("The data differs between the modes");
+		return 1;
+	}
+
+	return 0;
+}
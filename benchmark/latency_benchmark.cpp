@@ -0,0 +1,85 @@
+#include "benchmark.h"
+#include <EFileLatency.h>
+
+// Inserts records between others, reads and cuts them, reopening the file every round, and prints
+// the latency percentiles of every operation which has been called. The tail shows the rare calls
+// which extend the file or rewrite the sectors table. The spans of these steps can be written too
+int latency_benchmark(int argc, char* argv[])
+{
+	size_file_t records = benchmark_argument(argc, argv, 2, 10000);
+	size_file_t record_size = benchmark_argument(argc, argv, 3, 64);
+	size_file_t rounds = benchmark_argument(argc, argv, 4, 10);
+	std::string spans_file_name(argc > 5 ? argv[5] : "");
+
+	const std::string file_name("latency_benchmark.ef");
+	remove(file_name.c_str());
+
+	if(!spans_file_name.empty() && !ElasticFileAPI::SpansStart(spans_file_name))
+	{
+		INFO("Can't write the spans to " << spans_file_name);
+		return 1;
+	}
+
+	ElasticFileAPI::ResetLatencyHistograms();
+
+	std::vector<BYTE> buffer(record_size * 4, 1);
+	size_file_t data_size(0);
+	srand(1);
+
+	for(size_file_t round = 0; round < rounds; round++)
+	{
+		TEFileDescriptor file = ElasticFileAPI::FileOpen(file_name, round == 0 ? EF_MODE_CREATE : EF_MODE_OPEN);
+		if(file == EF_NULL_DESCRIPTOR)
+		{
+			INFO("Can't open " << file_name);
+			return 1;
+		}
+
+		for(size_file_t record = 0; record < records; record++)
+		{
+			// Every tenth record goes to the end, the others between the records
+			size_file_t position = record % 10 == 0 || data_size == 0 ? data_size : ((size_file_t)rand() * record_size) % data_size;
+			ElasticFileAPI::FileSetCursor(file, position, EF_CURSOR_BEGIN);
+			data_size += ElasticFileAPI::FileWrite(file, &buffer[0], record_size);
+
+			if(record % 4 == 0)
+			{
+				size_file_t read_size = std::min<size_file_t>(record_size * 4, data_size);
+				ElasticFileAPI::FileReadAt(file, ((size_file_t)rand() * record_size) % (data_size - read_size + 1), &buffer[0], read_size);
+			}
+		}
+
+		// Half of the data is cut by parts from the middle
+		for(size_file_t record = 0; record < records / 2; record++)
+		{
+			ElasticFileAPI::FileSetCursor(file, data_size / 2, EF_CURSOR_BEGIN);
+			if(ElasticFileAPI::FileTruncate(file, record_size))
+				data_size -= record_size;
+		}
+
+		ElasticFileAPI::FileClose(file);
+	}
+
+	if(!spans_file_name.empty())
+		ElasticFileAPI::SpansStop();
+
+	INFO("Latencies of " << rounds << " rounds of " << records << " records of " << record_size << " bytes, ns:");
+
+	for(int operation = 0; operation < EF_OPERATIONS_COUNT; operation++)
+	{
+		TEFileLatencyHistogram histogram;
+		if(!ElasticFileAPI::GetLatencyHistogram((TEFileOperation)operation, histogram) || histogram.Count == 0)
+			continue;
+
+		INFO(EFileLatencyRecorder::GetOperationName((TEFileOperation)operation) << ": " << histogram.Count << " calls"
+			<< ", mean " << histogram.Sum / histogram.Count
+			<< ", p50 " << EFileLatencyHistogram::GetPercentile(histogram, 0.5)
+			<< ", p99 " << EFileLatencyHistogram::GetPercentile(histogram, 0.99)
+			<< ", p99.9 " << EFileLatencyHistogram::GetPercentile(histogram, 0.999)
+			<< ", max " << histogram.Max);
+	}
+
+	remove(file_name.c_str());
+
+	return 0;
+}
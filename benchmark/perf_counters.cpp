@@ -0,0 +1,104 @@
+#include "perf_counters.h"
+#include <string.h>
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+static const char* counter_names[PERF_COUNTERS_COUNT] = { "cycles", "instructions", "cache_misses", "branch_misses" };
+
+TPerfCounters::TPerfCounters(bool enabled)
+	: m_enabled(false)
+{
+	for(int counter = 0; counter < PERF_COUNTERS_COUNT; counter++)
+		m_descriptors[counter] = -1;
+
+#if defined(__linux__)
+	if(!enabled)
+		return;
+
+	static const unsigned long long counter_configs[PERF_COUNTERS_COUNT] = { PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES };
+
+	for(int counter = 0; counter < PERF_COUNTERS_COUNT; counter++)
+	{
+		struct perf_event_attr attr;
+		memset(&attr, 0, sizeof(attr));
+		attr.type = PERF_TYPE_HARDWARE;
+		attr.size = sizeof(attr);
+		attr.config = counter_configs[counter];
+		attr.disabled = 1;
+		attr.exclude_kernel = 1;
+		attr.exclude_hv = 1;
+
+		m_descriptors[counter] = (int)syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+		if(m_descriptors[counter] < 0)
+		{
+			Close();
+			return;
+		}
+	}
+
+	m_enabled = true;
+#else
+	(void)enabled;
+#endif
+}
+
+TPerfCounters::~TPerfCounters(void)
+{
+	Close();
+}
+
+bool TPerfCounters::IsEnabled() const
+{
+	return m_enabled;
+}
+
+void TPerfCounters::Start()
+{
+#if defined(__linux__)
+	for(int counter = 0; m_enabled && counter < PERF_COUNTERS_COUNT; counter++)
+	{
+		ioctl(m_descriptors[counter], PERF_EVENT_IOC_RESET, 0);
+		ioctl(m_descriptors[counter], PERF_EVENT_IOC_ENABLE, 0);
+	}
+#endif
+}
+
+void TPerfCounters::Stop(long long* values)
+{
+#if defined(__linux__)
+	for(int counter = 0; m_enabled && counter < PERF_COUNTERS_COUNT; counter++)
+	{
+		ioctl(m_descriptors[counter], PERF_EVENT_IOC_DISABLE, 0);
+
+		long long value(0);
+		if(read(m_descriptors[counter], &value, sizeof(value)) == sizeof(value))
+			values[counter] += value;
+	}
+#else
+	(void)values;
+#endif
+}
+
+const char* TPerfCounters::GetName(int counter)
+{
+	return counter_names[counter];
+}
+
+void TPerfCounters::Close()
+{
+#if defined(__linux__)
+	for(int counter = 0; counter < PERF_COUNTERS_COUNT; counter++)
+	{
+		if(m_descriptors[counter] >= 0)
+			close(m_descriptors[counter]);
+
+		m_descriptors[counter] = -1;
+	}
+#endif
+
+	m_enabled = false;
+}
@@ -0,0 +1,32 @@
+#pragma once
+#include <string>
+
+#define PERF_COUNTERS_COUNT 4
+
+// Hardware counters of the calling thread in the user space (perf_event_open). They are
+// available only on Linux and only if the kernel allows them (kernel.perf_event_paranoid),
+// otherwise IsEnabled returns false and nothing is counted
+class TPerfCounters
+{
+public:
+	TPerfCounters(bool enabled);
+	~TPerfCounters(void);
+
+	bool IsEnabled() const;
+
+	void Start();
+	// Adds the counted values since Start to the values
+	void Stop(long long* values);
+
+	static const char* GetName(int counter);
+
+private:
+	TPerfCounters(const TPerfCounters&);
+	TPerfCounters& operator=(const TPerfCounters&);
+
+	void Close();
+
+private:
+	int m_descriptors[PERF_COUNTERS_COUNT];
+	bool m_enabled;
+};
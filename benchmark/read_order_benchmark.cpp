@@ -0,0 +1,88 @@
+#include "benchmark.h"
+#include <vector>
+
+// Every record is inserted before the previous ones, so the logical order of sectors is
+// opposite to the physical one. Then every third record is deleted, so there are holes
+// between the sectors
+static void create_fragmented_file(const std::string& file_name, size_file_t records, size_file_t record_size)
+{
+	TEFileDescriptor file = ElasticFileAPI::FileOpen(file_name, EF_MODE_CREATE);
+
+	std::vector<BYTE> record(record_size);
+	for(size_file_t i = 0; i != records; i++)
+	{
+		record.assign(record_size, (BYTE)('a' + i % 26));
+		ElasticFileAPI::FileSetCursor(file, 0, EF_CURSOR_BEGIN);
+		ElasticFileAPI::FileWrite(file, &record[0], record_size);
+	}
+
+	for(size_file_t i = 0; i < records / 3; i++)
+	{
+		ElasticFileAPI::FileSetCursor(file, i * 2 * record_size, EF_CURSOR_BEGIN);
+		ElasticFileAPI::FileTruncate(file, record_size);
+	}
+
+	ElasticFileAPI::FileClose(file);
+}
+
+static DWORD read_whole_file(const std::string& file_name, const TEFileReadOrder& order, size_file_t gap_tolerance, size_file_t repeats, size_file_t& checksum)
+{
+	TEFileDescriptor file = ElasticFileAPI::FileOpen(file_name, EF_MODE_OPEN);
+	ElasticFileAPI::FileSetReadOrder(file, order, gap_tolerance);
+
+	ElasticFileAPI::FileSetCursor(file, 0, EF_CURSOR_END);
+	size_file_t data_size = ElasticFileAPI::FileGetCursor(file);
+
+	std::vector<BYTE> buffer(data_size);
+	checksum = 0;
+
+	DWORD time = GetTickCount();
+
+	for(size_file_t repeat = 0; repeat != repeats; repeat++)
+	{
+		ElasticFileAPI::FileSetCursor(file, 0, EF_CURSOR_BEGIN);
+		if(data_size > 0 && ElasticFileAPI::FileRead(file, &buffer[0], data_size) != data_size)
+			INFO("Can't read " << data_size << " bytes");
+
+		checksum += buffer.empty() ? 0 : buffer[repeat % data_size];
+	}
+
+	time = GetTickCount() - time;
+
+	ElasticFileAPI::FileClose(file);
+
+	return time;
+}
+
+int read_order_benchmark(int argc, char* argv[])
+{
+	std::string file_name("benchmark_data");
+
+	size_file_t records = benchmark_argument(argc, argv, 2, 20000);
+	size_file_t record_size = benchmark_argument(argc, argv, 3, 512);
+	size_file_t repeats = benchmark_argument(argc, argv, 4, 20);
+
+	INFO("Read order. " << records << " records with length " << record_size << ", every third one is deleted. The whole file is read " << repeats << " times");
+
+	create_fragmented_file(file_name, records, record_size);
+
+	size_file_t logical_checksum(0);
+	size_file_t physical_checksum(0);
+	size_file_t gaps_checksum(0);
+
+	DWORD logical_time = read_whole_file(file_name, EF_READ_LOGICAL, 0, repeats, logical_checksum);
+	DWORD physical_time = read_whole_file(file_name, EF_READ_PHYSICAL, 0, repeats, physical_checksum);
+	DWORD gaps_time = read_whole_file(file_name, EF_READ_PHYSICAL, EF_READ_GAP_TOLERANCE, repeats, gaps_checksum);
+
+	INFO("Logical order: " << logical_time << " ms");
+	INFO("Physical order: " << physical_time << " ms");
+	INFO("Physical order, holes up to " << EF_READ_GAP_TOLERANCE << " bytes are read through: " << gaps_time << " ms");
+
+	if(logical_checksum != physical_checksum || logical_checksum != gaps_checksum)
+	{
+		INFO("The data differs between the orders");
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,46 @@
+#include "benchmark.h"
+
+static const char* operation_names[EF_TRACE_OPERATIONS_COUNT] = { "FileOpen", "FileSetCursor", "FileRead", "FileWrite", "FileTruncate", "FileClose" };
+
+// Replays a trace written by ElasticFileAPI::TraceStart and compares the time of the operations
+// with the time they took in the traced process
+int replay_benchmark(int argc, char* argv[])
+{
+	if(argc < 3)
+	{
+		INFO("The trace file is not given");
+		return 1;
+	}
+
+	std::string trace_file_name(argv[2]);
+
+	TEFileTraceReplayOptions options;
+	options.Timing = benchmark_argument(argc, argv, 3, 0) != 0 ? EF_REPLAY_ORIGINAL_TIMING : EF_REPLAY_FULL_SPEED;
+	if(argc > 4)
+	{
+		options.UseTracedBackend = false;
+		options.Backend = (TEFileBackendType)benchmark_argument(argc, argv, 4, EF_BACKEND_DEFAULT);
+	}
+
+	INFO("Replay of " << trace_file_name << (options.Timing == EF_REPLAY_ORIGINAL_TIMING ? " with the original timing" : " at full speed"));
+
+	TEFileTraceReplayStats stats;
+	if(!ElasticFileAPI::TraceReplay(trace_file_name, options, stats))
+	{
+		INFO("Can't replay " << trace_file_name);
+		return 1;
+	}
+
+	for(int operation = 0; operation < EF_TRACE_OPERATIONS_COUNT; operation++)
+	{
+		unsigned __int64 count = stats.OperationsCount[operation];
+		if(count == 0)
+			continue;
+
+		INFO(operation_names[operation] << ": " << count << " operations, " << stats.OperationsNanoseconds[operation] / count << " ns/op, traced " << stats.TracedNanoseconds[operation] / count << " ns/op");
+	}
+
+	INFO(stats.Operations << " operations in " << stats.Nanoseconds / 1000000 << " ms, " << stats.Divergences << " of them returned other results than in the trace");
+
+	return 0;
+}
@@ -0,0 +1,438 @@
+#include "benchmark.h"
+#include <random>
+#include <stdio.h>
+#include <string.h>
+#include <TEFileBackend.h>
+#include <TEFileMemoryBackend.h>
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Names of the in-memory files of the check
+#define ROUNDTRIP_FILE		"roundtrip"
+#define ROUNDTRIP_COPY		"roundtrip_copy"
+
+// Names on the disk for the check of the trace replay
+#define ROUNDTRIP_DIRECTORY	"roundtrip_directory"
+#define ROUNDTRIP_TRACE		"roundtrip_trace"
+
+// Bytes of an in-memory file as they are on the "disk", without opening it as an elastic file
+static std::vector<BYTE> read_image(const std::string& file_name)
+{
+	std::vector<BYTE> image;
+
+	TEFileHandle handle = TEFileBackend::Create(EF_BACKEND_MEMORY);
+	size_file_t size(0);
+	if(!handle->Open(file_name, false) || !handle->GetSize(size))
+		return image;
+
+	image.resize((size_t)size);
+	if(!image.empty() && handle->ReadAt(0, &image[0], size) != size)
+		image.clear();
+
+	handle->Close();
+	return image;
+}
+
+static void write_image(const std::string& file_name, const std::vector<BYTE>& image)
+{
+	TEFileHandle handle = TEFileBackend::Create(EF_BACKEND_MEMORY);
+	handle->Open(file_name, true);
+
+	if(!image.empty())
+		handle->WriteAt(0, &image[0], image.size());
+
+	handle->Close();
+}
+
+template<class T> static void append_bytes(std::vector<BYTE>& image, const T& value)
+{
+	image.insert(image.end(), (const BYTE*)&value, (const BYTE*)&value + sizeof(T));
+}
+
+// Opens the file as a new one would be after a crash, false if it can't be opened
+static bool read_content(const std::string& file_name, std::vector<BYTE>& content)
+{
+	content.clear();
+
+	TEFileDescriptor file = ElasticFileAPI::FileOpen(file_name, EF_MODE_OPEN, EF_BACKEND_MEMORY);
+	if(file == EF_NULL_DESCRIPTOR)
+		return false;
+
+	ElasticFileAPI::FileSetCursor(file, 0, EF_CURSOR_END);
+	content.resize((size_t)ElasticFileAPI::FileGetCursor(file));
+	ElasticFileAPI::FileSetCursor(file, 0, EF_CURSOR_BEGIN);
+
+	bool valid = content.empty() || ElasticFileAPI::FileRead(file, &content[0], content.size()) == content.size();
+
+	return ElasticFileAPI::FileClose(file) && valid;
+}
+
+// A copy of the current bytes of the file is opened, as if the process had stopped here
+static bool check_crash_copy(const std::string& file_name, const std::vector<BYTE>& model)
+{
+	write_image(ROUNDTRIP_COPY, read_image(file_name));
+
+	std::vector<BYTE> content;
+	bool valid = read_content(ROUNDTRIP_COPY, content) && content == model;
+
+	TEFileMemoryBackend::Remove(ROUNDTRIP_COPY);
+	return valid;
+}
+
+static bool get_footer(const std::vector<BYTE>& image, TEFileTableFooter& footer)
+{
+	if(image.size() < sizeof(TEFileTableFooter))
+		return false;
+
+	memcpy(&footer, &image[image.size() - sizeof(TEFileTableFooter)], sizeof(TEFileTableFooter));
+	return footer.Magic == EF_FOOTER_MAGIC;
+}
+
+// Random inserts and deletes, the table is synced every sync_period edits, so it is written as a
+// snapshot and a chain of journal chunks, which is folded into a new snapshot from time to time.
+// The file is reopened after every sync without closing. chunk_image gets the last synced file
+// whose table ends with a journal chunk
+static bool check_journal_replay(std::vector<BYTE>& chunk_image)
+{
+	std::mt19937_64 random(1);
+	std::vector<BYTE> model(64 * 1024);
+	for(size_t i = 0; i < model.size(); i++)
+		model[i] = (BYTE)random();
+
+	TEFileDescriptor file = ElasticFileAPI::FileOpen(ROUNDTRIP_FILE, EF_MODE_CREATE, EF_BACKEND_MEMORY);
+	ElasticFileAPI::FileWrite(file, &model[0], model.size());
+	ElasticFileAPI::FileSync(file);
+
+	const int edits_count = 2000;
+	const int sync_period = 50;
+
+	bool valid = check_crash_copy(ROUNDTRIP_FILE, model);
+	std::vector<BYTE> record;
+
+	for(int edit = 1; valid && edit <= edits_count; edit++)
+	{
+		size_file_t position = random() % (model.size() + 1);
+
+		if(random() % 3 != 0 || model.size() < 1024)
+		{
+			record.resize(1 + random() % 300);
+			for(size_t i = 0; i < record.size(); i++)
+				record[i] = (BYTE)random();
+
+			ElasticFileAPI::FileWriteAt(file, position, &record[0], record.size());
+			model.insert(model.begin() + position, record.begin(), record.end());
+		}
+		else
+		{
+			size_file_t size = std::min<size_file_t>(1 + random() % 300, model.size() - position);
+
+			ElasticFileAPI::FileSetCursor(file, position, EF_CURSOR_BEGIN);
+			ElasticFileAPI::FileTruncate(file, size);
+			model.erase(model.begin() + position, model.begin() + position + size);
+		}
+
+		if(edit % sync_period == 0)
+		{
+			ElasticFileAPI::FileSync(file);
+			valid = check_crash_copy(ROUNDTRIP_FILE, model);
+
+			std::vector<BYTE> image = read_image(ROUNDTRIP_FILE);
+			TEFileTableFooter footer;
+			if(get_footer(image, footer) && footer.LastChunkAddr != EF_NO_SECTOR)
+				chunk_image.swap(image);
+		}
+	}
+
+	valid = ElasticFileAPI::FileClose(file) && valid;
+
+	std::vector<BYTE> content;
+	valid = valid && read_content(ROUNDTRIP_FILE, content) && content == model;
+
+	TEFileMemoryBackend::Remove(ROUNDTRIP_FILE);
+
+	// The replay is checked only if the table has really been written as a journal
+	return valid && !chunk_image.empty();
+}
+
+// The chunk of the last sync lost its records: the header reached the file, the records didn't.
+// The chunk must not be applied partly, a file whose table can't be read is opened as plain data
+static bool check_torn_chunk(const std::vector<BYTE>& image)
+{
+	TEFileTableFooter footer;
+	if(!get_footer(image, footer) || footer.LastChunkAddr == EF_NO_SECTOR)
+		return false;
+
+	TEFileJournalHeader header;
+	memcpy(&header, &image[(size_t)footer.LastChunkAddr], sizeof(TEFileJournalHeader));
+
+	std::vector<BYTE> torn_image(image);
+	size_t records_addr = (size_t)footer.LastChunkAddr + sizeof(TEFileJournalHeader);
+	memset(&torn_image[records_addr], 0, header.RecordsSize);
+
+	write_image(ROUNDTRIP_FILE, torn_image);
+
+	std::vector<BYTE> content;
+	bool valid = read_content(ROUNDTRIP_FILE, content) && content == torn_image;
+
+	TEFileMemoryBackend::Remove(ROUNDTRIP_FILE);
+	return valid;
+}
+
+// Data of the crafted files: 128 bytes in two sectors, the second one goes first logically
+static std::vector<BYTE> crafted_data()
+{
+	std::vector<BYTE> data(128);
+	for(size_t i = 0; i < data.size(); i++)
+		data[i] = (BYTE)('a' + i % 26);
+
+	return data;
+}
+
+// The file is read, converted to the current format and read again
+static bool check_conversion(const std::vector<BYTE>& image, const std::vector<BYTE>& model)
+{
+	write_image(ROUNDTRIP_FILE, image);
+
+	std::vector<BYTE> content;
+	bool valid = read_content(ROUNDTRIP_FILE, content) && content == model;
+
+	valid = valid && ElasticFileAPI::FileConvert(ROUNDTRIP_FILE, EF_BACKEND_MEMORY);
+	valid = valid && read_content(ROUNDTRIP_FILE, content) && content == model;
+
+	TEFileTableFooter footer;
+	valid = valid && get_footer(read_image(ROUNDTRIP_FILE), footer);
+
+	TEFileMemoryBackend::Remove(ROUNDTRIP_FILE);
+	return valid;
+}
+
+// The whole table of the first format is in the end of the file, with the count of the sectors last
+static bool check_legacy_table()
+{
+	std::vector<BYTE> data = crafted_data();
+	std::vector<BYTE> image(data);
+
+	TEFileLegacySector sectors[2];
+	memset(sectors, 0, sizeof(sectors));
+	sectors[0].Free = EF_SECTOR_DATA;
+	sectors[0].SectorAddr = 64;
+	sectors[0].SectorSize = 64;
+	sectors[1].Free = EF_SECTOR_DATA;
+	sectors[1].SectorAddr = 0;
+	sectors[1].SectorSize = 64;
+
+	append_bytes(image, sectors);
+	append_bytes(image, (DWORD)2);
+
+	std::vector<BYTE> model(data.begin() + 64, data.end());
+	model.insert(model.end(), data.begin(), data.begin() + 64);
+
+	return check_conversion(image, model);
+}
+
+// A snapshot with 32-bit offsets and a journal chunk which splits the first sector and frees its tail
+static bool check_table32()
+{
+	std::vector<BYTE> data = crafted_data();
+	std::vector<BYTE> image(data);
+
+	DWORD table_addr = (DWORD)image.size();
+	DWORD chunk_addr = table_addr + sizeof(TEFileTableHeader32) + 3 * sizeof(TEFileSector32);
+	DWORD table_size = chunk_addr - table_addr + sizeof(TEFileJournalHeader32) + 2 * sizeof(TEFileJournalRecord32);
+
+	TEFileTableHeader32 header;
+	header.Magic = EF_TABLE_MAGIC32;
+	header.SectorsCount = 3;
+	append_bytes(image, header);
+
+	TEFileSector32 sectors[3];
+	memset(sectors, 0, sizeof(sectors));
+	sectors[0].SectorAddr = 64;
+	sectors[0].SectorSize = 64;
+	sectors[0].Free = EF_SECTOR_DATA;
+	sectors[1].SectorAddr = 0;
+	sectors[1].SectorSize = 64;
+	sectors[1].Free = EF_SECTOR_DATA;
+	sectors[2].SectorAddr = table_addr;
+	sectors[2].SectorSize = table_size;
+	sectors[2].Free = EF_SECTOR_TABLE;
+	append_bytes(image, sectors);
+
+	TEFileJournalHeader32 chunk_header;
+	chunk_header.Magic = EF_JOURNAL_MAGIC32;
+	chunk_header.PrevChunkAddr = EF_NO_SECTOR32;
+	chunk_header.RecordsCount = 2;
+	append_bytes(image, chunk_header);
+
+	TEFileJournalRecord32 records[2];
+	memset(records, 0, sizeof(records));
+	records[0].Type = EF_JOURNAL_SPLIT;
+	records[0].SectorAddr = 64;
+	records[0].Size = 32;
+	records[0].NextAddr = EF_NO_SECTOR32;
+	records[1].Type = EF_JOURNAL_FREE;
+	records[1].State = EF_SECTOR_FREE;
+	records[1].SectorAddr = 96;
+	records[1].NextAddr = EF_NO_SECTOR32;
+	append_bytes(image, records);
+
+	TEFileTableFooter32 footer;
+	footer.Magic = EF_FOOTER_MAGIC32;
+	footer.BaseAddr = table_addr;
+	footer.LastChunkAddr = chunk_addr;
+	footer.JournalRecords = 2;
+	append_bytes(image, footer);
+
+	std::vector<BYTE> model(data.begin() + 64, data.begin() + 96);
+	model.insert(model.end(), data.begin(), data.begin() + 64);
+
+	return check_conversion(image, model);
+}
+
+// The file is compacted step by step, and a copy of it is opened after every call as if the
+// process had stopped there. The space freed by a step must not be reused before the table is synced
+static bool check_compaction(const TEFileCompactMode& mode, size_file_t bytes_limit)
+{
+	const size_t part_size = 1024 * 1024;
+
+	std::vector<BYTE> model(2 * part_size);
+	for(size_t i = 0; i < model.size(); i++)
+		model[i] = (BYTE)(i < part_size ? i * 7 + 1 : i * 13 + 5);
+
+	TEFileDescriptor file = ElasticFileAPI::FileOpen(ROUNDTRIP_FILE, EF_MODE_CREATE, EF_BACKEND_MEMORY);
+	ElasticFileAPI::FileWrite(file, &model[0], part_size);
+	ElasticFileAPI::FileSync(file);
+	ElasticFileAPI::FileWrite(file, &model[part_size], part_size);
+	ElasticFileAPI::FileSync(file);
+
+	ElasticFileAPI::FileSetCursor(file, 0, EF_CURSOR_BEGIN);
+	ElasticFileAPI::FileTruncate(file, part_size / 2);
+	ElasticFileAPI::FileSync(file);
+	model.erase(model.begin(), model.begin() + part_size / 2);
+
+	bool valid(true);
+	bool completed(false);
+	for(int calls = 0; valid && !completed && calls < 10000; calls++)
+	{
+		valid = ElasticFileAPI::FileCompact(file, mode, bytes_limit, completed);
+		valid = valid && check_crash_copy(ROUNDTRIP_FILE, model);
+	}
+
+	valid = ElasticFileAPI::FileClose(file) && valid && completed;
+
+	std::vector<BYTE> content;
+	valid = valid && read_content(ROUNDTRIP_FILE, content) && content == model;
+
+	TEFileMemoryBackend::Remove(ROUNDTRIP_FILE);
+	return valid;
+}
+
+static void create_directory(const std::string& name)
+{
+#ifdef _WIN32
+	_mkdir(name.c_str());
+#else
+	mkdir(name.c_str(), 0755);
+#endif
+}
+
+static void remove_directory(const std::string& name)
+{
+#ifdef _WIN32
+	_rmdir(name.c_str());
+#else
+	rmdir(name.c_str());
+#endif
+}
+
+// Size of the data of a file on the disk, EF_NO_SECTOR if it can't be opened
+static size_file_t get_data_size(const std::string& file_name)
+{
+	TEFileDescriptor file = ElasticFileAPI::FileOpen(file_name, EF_MODE_OPEN);
+	if(file == EF_NULL_DESCRIPTOR)
+		return EF_NO_SECTOR;
+
+	ElasticFileAPI::FileSetCursor(file, 0, EF_CURSOR_END);
+	size_file_t size = ElasticFileAPI::FileGetCursor(file);
+
+	return ElasticFileAPI::FileClose(file) ? size : EF_NO_SECTOR;
+}
+
+// A file in a directory is traced and replayed, the replay file must be in the same directory.
+// If the directory is removed before the replay, the file opened in the trace can't be opened
+// again and the replay must fail instead of counting every following operation as a divergence
+static bool check_trace_replay(bool remove_traced_directory)
+{
+	std::string file_name = std::string(ROUNDTRIP_DIRECTORY) + "/traced";
+	std::string replay_name = std::string(ROUNDTRIP_DIRECTORY) + "/replay_traced";
+
+	create_directory(ROUNDTRIP_DIRECTORY);
+
+	if(!ElasticFileAPI::TraceStart(ROUNDTRIP_TRACE))
+		return false;
+
+	std::vector<BYTE> data(4096, 'd');
+
+	TEFileDescriptor file = ElasticFileAPI::FileOpen(file_name, EF_MODE_CREATE);
+	ElasticFileAPI::FileWrite(file, &data[0], data.size());
+	ElasticFileAPI::FileClose(file);
+
+	file = ElasticFileAPI::FileOpen(file_name, EF_MODE_OPEN);
+	ElasticFileAPI::FileSetCursor(file, 1024, EF_CURSOR_BEGIN);
+	ElasticFileAPI::FileRead(file, &data[0], 1024);
+	ElasticFileAPI::FileTruncate(file, 1024);
+	ElasticFileAPI::FileClose(file);
+
+	bool valid = ElasticFileAPI::TraceStop();
+
+	size_file_t traced_size = get_data_size(file_name);
+	remove(file_name.c_str());
+
+	if(remove_traced_directory)
+		remove_directory(ROUNDTRIP_DIRECTORY);
+
+	TEFileTraceReplayOptions options;
+	TEFileTraceReplayStats stats;
+	bool replayed = ElasticFileAPI::TraceReplay(ROUNDTRIP_TRACE, options, stats);
+
+	if(remove_traced_directory)
+		valid = valid && !replayed;
+	else
+		valid = valid && replayed && stats.Operations == 8 && stats.Divergences == 0 && traced_size != EF_NO_SECTOR && get_data_size(replay_name) == traced_size;
+
+	remove(replay_name.c_str());
+	remove(ROUNDTRIP_TRACE);
+	remove_directory(ROUNDTRIP_DIRECTORY);
+
+	return valid;
+}
+
+static int report(const std::string& name, bool valid)
+{
+	INFO(name << ": " << (valid ? "ok" : "FAILED"));
+	return valid ? 0 : 1;
+}
+
+int roundtrip_check(int, char*[])
+{
+	INFO("Round trip. In-memory files are written, reopened, converted and compacted, and their data is checked after every step. A trace of a file in a directory is replayed");
+
+	int failures(0);
+
+	std::vector<BYTE> image;
+	failures += report("Snapshot and journal replay", check_journal_replay(image));
+	failures += report("Torn journal chunk", !image.empty() && check_torn_chunk(image));
+	failures += report("Legacy table", check_legacy_table());
+	failures += report("32-bit table", check_table32());
+	failures += report("Full compaction", check_compaction(EF_COMPACT_FULL, 0));
+	failures += report("Incremental compaction by 1 MB", check_compaction(EF_COMPACT_INCREMENTAL, 1024 * 1024));
+	failures += report("Incremental compaction by 64 KB", check_compaction(EF_COMPACT_INCREMENTAL, 64 * 1024));
+	failures += report("Trace replay of a file in a directory", check_trace_replay(false));
+	failures += report("Trace replay into a removed directory", check_trace_replay(true));
+
+	return failures > 0 ? 1 : 0;
+}
@@ -0,0 +1,369 @@
+#include <atomic>
+#include <chrono>
+#include <new>
+#include <random>
+#include <vector>
+#include "benchmark.h"
+#include <ElasticFile.h>
+#include <TEFileMemoryBackend.h>
+
+// Sizes of the generated sectors
+#define TABLE_BENCHMARK_MIN_SECTOR	64
+#define TABLE_BENCHMARK_MAX_SECTOR	8192
+
+// Every allocation of the process is counted, so an operation reports the allocations it makes
+static std::atomic<size_t> allocations_count(0);
+
+void* operator new(size_t size)
+{
+	allocations_count.fetch_add(1, std::memory_order_relaxed);
+
+	void* memory = malloc(size > 0 ? size : 1);
+	if(memory == NULL)
+		throw std::bad_alloc();
+
+	return memory;
+}
+
+void* operator new[](size_t size)
+{
+	return operator new(size);
+}
+
+// All the forms of delete are replaced, so the sized ones don't go to the default deallocation
+void operator delete(void* memory) throw()
+{
+	free(memory);
+}
+
+void operator delete[](void* memory) throw()
+{
+	free(memory);
+}
+
+void operator delete(void* memory, size_t) throw()
+{
+	free(memory);
+}
+
+void operator delete[](void* memory, size_t) throw()
+{
+	free(memory);
+}
+
+struct TTableShape
+{
+	size_file_t SectorsCount;
+	size_file_t FreePercent;
+	size_file_t ShufflePercent;
+	TEFileAllocationPolicy Policy;
+};
+
+struct TOperationStats
+{
+	TOperationStats() : Count(0), Nanoseconds(0), Allocations(0) {}
+
+	size_file_t Count;
+	long long Nanoseconds;
+	size_t Allocations;
+};
+
+// Times one operation at a time, the cost of the timer itself is measured once and subtracted
+class TOperationTimer
+{
+public:
+	TOperationTimer() : m_allocations(0), m_overhead(0)
+	{
+		const int calibration_count = 10000;
+
+		TOperationStats stats;
+		for(int i = 0; i < calibration_count; i++)
+		{
+			Begin();
+			End(stats);
+		}
+
+		m_overhead = stats.Nanoseconds / calibration_count;
+	}
+
+	void Begin()
+	{
+		m_allocations = allocations_count.load(std::memory_order_relaxed);
+		m_begin = std::chrono::steady_clock::now();
+	}
+
+	void End(TOperationStats& stats)
+	{
+		std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+
+		stats.Count++;
+		stats.Nanoseconds += std::chrono::duration_cast<std::chrono::nanoseconds>(end - m_begin).count() - m_overhead;
+		stats.Allocations += allocations_count.load(std::memory_order_relaxed) - m_allocations;
+	}
+
+private:
+	std::chrono::steady_clock::time_point m_begin;
+	size_t m_allocations;
+	long long m_overhead;
+};
+
+static size_file_t random_number(std::mt19937_64& random, size_file_t from, size_file_t to)
+{
+	return from + random() % (to - from + 1);
+}
+
+// Returns the first byte of a data sector which is not the first byte of the sector
+static TEFileSectorsList::iterator random_inner_position(TEFileSectorsTable& table, std::mt19937_64& random, size_file_t& offset_in_sector)
+{
+	TEFileSectorsList::iterator sector_it;
+	do
+	{
+		sector_it = table.GetSectorInPosition(random() % table.GetDataSize(), offset_in_sector);
+	}
+	while(offset_in_sector == 0);
+
+	return sector_it;
+}
+
+// Builds a table of the given count of sectors with random sizes. The share of free sectors
+// is FreePercent, but two free sectors never follow each other, because the table unites them,
+// so it is not more than a half. ShufflePercent of the data sectors are moved to random logical
+// positions, the rest keep the logical order the same as the physical one. Neighbour sectors are
+// not united, so the count of sectors is as given. The table is written to the file in the end,
+// so the following changes are journaled like in an open file. Returns false if the table
+// doesn't have the given count of sectors, then the times wouldn't be of the given shape
+static bool generate_table(TEFileSectorsTable& table, const TTableShape& shape, std::mt19937_64& random)
+{
+	table.Load();
+	if(table.GetSectorsCount() != 0)
+	{
+		INFO("The file already has a table of " << table.GetSectorsCount() << " sectors");
+		return false;
+	}
+
+	table.SetAllocationPolicy(shape.Policy);
+
+	bool previous_free(false);
+	for(size_file_t i = 0; i < shape.SectorsCount; i++)
+	{
+		TEFileSectorsList::iterator sector_it = table.AllocateNewSector(random_number(random, TABLE_BENCHMARK_MIN_SECTOR, TABLE_BENCHMARK_MAX_SECTOR));
+
+		bool free = !previous_free && random() % 100 < shape.FreePercent;
+		if(!free)
+			table.SetSectorFree(sector_it, 0);
+
+		previous_free = free;
+	}
+
+	size_file_t data_sectors_count = table.GetSectorsCount() * (100 - std::min<size_file_t>(shape.FreePercent, (size_file_t)50)) / 100;
+	size_file_t moves_count = data_sectors_count * shape.ShufflePercent / 100;
+
+	for(size_file_t i = 0; i < moves_count && table.GetDataSize() > 0; i++)
+	{
+		size_file_t offset_in_sector;
+		TEFileSectorsIterators sectors_to_move(1, table.GetSectorInPosition(random() % table.GetDataSize(), offset_in_sector));
+		TEFileSectorsList::iterator before_it = table.GetSectorInPosition(random() % table.GetDataSize(), offset_in_sector);
+
+		table.MoveSectorsBefore(sectors_to_move, before_it);
+	}
+
+	// Before the write, which adds the sector of the table itself
+	if(table.GetSectorsCount() != shape.SectorsCount)
+	{
+		INFO("Generated " << table.GetSectorsCount() << " sectors instead of " << shape.SectorsCount);
+		return false;
+	}
+
+	table.Write();
+
+	return true;
+}
+
+static void report(const std::string& name, const TOperationStats& stats)
+{
+	if(stats.Count == 0)
+	{
+		INFO(name << ": no operations");
+		return;
+	}
+
+	INFO(name << ": " << stats.Nanoseconds / (long long)stats.Count << " ns/op, " << (double)stats.Allocations / stats.Count << " allocations/op");
+}
+
+static void benchmark_get_sector_in_position(TEFileSectorsTable& table, std::mt19937_64& random, size_file_t operations, TOperationTimer& timer)
+{
+	TOperationStats stats;
+	for(size_file_t i = 0; i < operations; i++)
+	{
+		size_file_t position = random() % table.GetDataSize();
+		size_file_t offset_in_sector;
+
+		timer.Begin();
+		table.GetSectorInPosition(position, offset_in_sector);
+		timer.End(stats);
+	}
+
+	report("GetSectorInPosition", stats);
+}
+
+static void benchmark_split_and_unite(TEFileSectorsTable& table, std::mt19937_64& random, size_file_t operations, TOperationTimer& timer)
+{
+	// A split sector is united again, so the table keeps its shape
+	TOperationStats split_stats;
+	TOperationStats unite_stats;
+	for(size_file_t i = 0; i < operations; i++)
+	{
+		size_file_t offset_in_sector;
+		TEFileSectorsList::iterator sector_it = random_inner_position(table, random, offset_in_sector);
+
+		timer.Begin();
+		table.SplitSector(sector_it, offset_in_sector);
+		timer.End(split_stats);
+
+		TUniteResult unite_result;
+
+		timer.Begin();
+		table.CheckAndUniteSector(sector_it, unite_result);
+		timer.End(unite_stats);
+	}
+
+	report("SplitSector", split_stats);
+	report("CheckAndUniteSector", unite_stats);
+}
+
+static void benchmark_truncate(TEFileSectorsTable& table, std::mt19937_64& random, size_file_t operations, TOperationTimer& timer)
+{
+	TOperationStats stats;
+	for(size_file_t i = 0; i < operations && table.GetDataSize() > TABLE_BENCHMARK_MAX_SECTOR; i++)
+	{
+		size_file_t offset_in_sector;
+		TEFileSectorsList::iterator sector_it = random_inner_position(table, random, offset_in_sector);
+		size_file_t truncation_size = random_number(random, 1, sector_it->SectorSize - offset_in_sector);
+
+		timer.Begin();
+		std::pair<TEFileSectorsList::iterator, TEFileSectorsList::iterator> truncated = table.TruncateSector(sector_it, offset_in_sector, truncation_size);
+		timer.End(stats);
+
+		// The freed part is united with its neighbours like in a delete of the data
+		TUniteResult unite_result;
+		table.CheckAndUniteSector(truncated.first, unite_result);
+	}
+
+	report("TruncateSector", stats);
+}
+
+static void benchmark_insert(TEFileSectorsTable& table, std::mt19937_64& random, size_file_t operations, TOperationTimer& timer)
+{
+	// The same steps as an insert of the data: allocation, placement in the logical position and the switch to data
+	TOperationStats allocate_stats;
+	TOperationStats move_stats;
+	for(size_file_t i = 0; i < operations; i++)
+	{
+		TEFileSectorsIterators allocated_sectors_iterators;
+		size_file_t size = random_number(random, TABLE_BENCHMARK_MIN_SECTOR, TABLE_BENCHMARK_MAX_SECTOR);
+		size_file_t position = random() % (table.GetDataSize() + 1);
+
+		timer.Begin();
+		table.Allocate(size, allocated_sectors_iterators);
+		timer.End(allocate_stats);
+
+		timer.Begin();
+		table.MoveSectorsTo(allocated_sectors_iterators, position);
+		timer.End(move_stats);
+
+		for(TEFileSectorsIterators::iterator sector_it = allocated_sectors_iterators.begin(); sector_it != allocated_sectors_iterators.end(); ++sector_it)
+		{
+			table.SetSectorFree(*sector_it, 0);
+
+			TUniteResult unite_result;
+			table.CheckAndUniteSector(*sector_it, unite_result);
+		}
+	}
+
+	report("Allocate", allocate_stats);
+	report("MoveSectorsTo", move_stats);
+}
+
+typedef void (*TTablePhase)(TEFileSectorsTable& table, std::mt19937_64& random, size_file_t operations, TOperationTimer& timer);
+
+// Every phase generates its table in a new in-memory file, so it doesn't load the table left by the previous one
+static bool run_phase(const std::string& file_name, TTablePhase phase, const TTableShape& shape, size_file_t operations, TOperationTimer& timer)
+{
+	ElasticFile file;
+	file.Open(file_name, EF_MODE_CREATE, EF_BACKEND_MEMORY);
+
+	bool generated;
+	{
+		std::mt19937_64 random(1);
+		TEFileSectorsTable table(file);
+
+		generated = generate_table(table, shape, random);
+		if(generated)
+			phase(table, random, operations, timer);
+	}
+
+	file.Close();
+	TEFileMemoryBackend::Remove(file_name);
+
+	return generated;
+}
+
+int table_benchmark(int argc, char* argv[])
+{
+	std::string file_name("table_benchmark");
+
+	TTableShape shape;
+	shape.SectorsCount = benchmark_argument(argc, argv, 2, 100000);
+	shape.FreePercent = benchmark_argument(argc, argv, 3, 20);
+	shape.ShufflePercent = benchmark_argument(argc, argv, 4, 50);
+	size_file_t operations = benchmark_argument(argc, argv, 5, 100000);
+	shape.Policy = (TEFileAllocationPolicy)benchmark_argument(argc, argv, 6, EF_ALLOCATE_BEST_FIT);
+
+	INFO("Sectors table. " << shape.SectorsCount << " sectors, " << shape.FreePercent << "% of them are free, " << shape.ShufflePercent << "% of the data sectors are shuffled. " << operations << " operations of every kind, allocation policy " << shape.Policy);
+
+	// The table is read and written through an in-memory file, so the disk is not measured
+	ElasticFile file;
+	file.Open(file_name, EF_MODE_CREATE, EF_BACKEND_MEMORY);
+
+	bool generated;
+	size_file_t data_size;
+	{
+		std::mt19937_64 random(1);
+		TEFileSectorsTable table(file);
+
+		std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+		generated = generate_table(table, shape, random);
+		long long generation_time = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - begin).count();
+
+		INFO("Generated " << table.GetSectorsCount() << " sectors with " << table.FreeSectors().size() << " free ones, " << table.GetDataSize() << " bytes of data in " << generation_time << " ms");
+		data_size = table.GetDataSize();
+	}
+
+	file.Close();
+	TEFileMemoryBackend::Remove(file_name);
+
+	if(!generated)
+		return 1;
+
+	if(data_size == 0)
+	{
+		INFO("The table has no data");
+		return 1;
+	}
+
+	TOperationTimer timer;
+
+	if(!run_phase(file_name + "_get_sector_in_position", benchmark_get_sector_in_position, shape, operations, timer))
+		return 1;
+
+	if(!run_phase(file_name + "_split_and_unite", benchmark_split_and_unite, shape, operations, timer))
+		return 1;
+
+	if(!run_phase(file_name + "_truncate", benchmark_truncate, shape, operations, timer))
+		return 1;
+
+	if(!run_phase(file_name + "_insert", benchmark_insert, shape, operations, timer))
+		return 1;
+
+	return 0;
+}
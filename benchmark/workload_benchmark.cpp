@@ -0,0 +1,705 @@
+#include "benchmark.h"
+#include "perf_counters.h"
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <random>
+#include <vector>
+
+// Count of the full rewrites measured for a workload of the baseline, the other edits only change its data in memory
+#define WORKLOAD_BASELINE_REWRITES	100
+
+// Measurements of one workload with one implementation and one set of parameters, summed over the repeats
+struct TWorkloadResult
+{
+	TWorkloadResult() : Operations(0), Bytes(0), Nanoseconds(0), OpenNanoseconds(0), CloseNanoseconds(0), Valid(true)
+	{
+		for(int counter = 0; counter < PERF_COUNTERS_COUNT; counter++)
+			Counters[counter] = 0;
+	}
+
+	std::string Workload;
+	std::string Implementation;
+	size_file_t Records;
+	size_file_t SmallSize;
+	size_file_t LargeSize;
+
+	size_file_t Operations;
+	size_file_t Bytes;
+	long long Nanoseconds;
+	long long OpenNanoseconds;
+	long long CloseNanoseconds;
+	std::vector<long long> Latencies;
+	long long Counters[PERF_COUNTERS_COUNT];
+	bool Valid; // The data is the same as the data of the baseline
+};
+
+typedef std::vector<TWorkloadResult> TWorkloadResults;
+
+// Parameters and state of one run of all the workloads
+struct TWorkloadRun
+{
+	std::string FileName;
+	std::string PlainFileName;
+	TEFileBackendType Backend;
+	size_file_t Records;
+	size_file_t SmallSize;
+	size_file_t LargeSize;
+	std::vector<BYTE> Record; // Data of the records, not smaller than any record
+	std::vector<BYTE> Model; // Data of the file after the last workload of the baseline
+	TPerfCounters* Counters;
+};
+
+static long long now_nanoseconds()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Measures the operations of a workload one by one and the perf counters over all of them
+class TWorkloadTimer
+{
+public:
+	TWorkloadTimer(TWorkloadRun& run, TWorkloadResult& result)
+		: m_run(run)
+		, m_result(result)
+		, m_begin(0)
+		, m_operation_begin(0)
+	{
+	}
+
+	void Start()
+	{
+		m_run.Counters->Start();
+		m_begin = now_nanoseconds();
+	}
+
+	void Stop()
+	{
+		m_result.Nanoseconds += now_nanoseconds() - m_begin;
+		m_run.Counters->Stop(m_result.Counters);
+	}
+
+	void BeginOperation()
+	{
+		m_operation_begin = now_nanoseconds();
+	}
+
+	void EndOperation(size_file_t bytes)
+	{
+		m_result.Latencies.push_back(now_nanoseconds() - m_operation_begin);
+		m_result.Operations++;
+		m_result.Bytes += bytes;
+	}
+
+private:
+	TWorkloadRun& m_run;
+	TWorkloadResult& m_result;
+	long long m_begin;
+	long long m_operation_begin;
+};
+
+static TEFileDescriptor open_timed(const TWorkloadRun& run, const TEFileOpenMode& mode, TWorkloadResult& result)
+{
+	long long begin = now_nanoseconds();
+	TEFileDescriptor file = ElasticFileAPI::FileOpen(run.FileName, mode, run.Backend);
+	result.OpenNanoseconds += now_nanoseconds() - begin;
+
+	if(file == EF_NULL_DESCRIPTOR)
+		result.Valid = false;
+
+	return file;
+}
+
+static void close_timed(const TEFileDescriptor& file, TWorkloadResult& result)
+{
+	long long begin = now_nanoseconds();
+	if(!ElasticFileAPI::FileClose(file))
+		result.Valid = false;
+
+	result.CloseNanoseconds += now_nanoseconds() - begin;
+}
+
+static size_file_t get_data_size(const TEFileDescriptor& file)
+{
+	ElasticFileAPI::FileSetCursor(file, 0, EF_CURSOR_END);
+	size_file_t data_size = ElasticFileAPI::FileGetCursor(file);
+	ElasticFileAPI::FileSetCursor(file, 0, EF_CURSOR_BEGIN);
+
+	return data_size;
+}
+
+// The file is read after the workload and compared with the data of the baseline
+static void check_elastic_file(const TWorkloadRun& run, TWorkloadResult& result)
+{
+	TEFileDescriptor file = ElasticFileAPI::FileOpen(run.FileName, EF_MODE_OPEN, run.Backend);
+
+	std::vector<BYTE> data((size_t)get_data_size(file));
+	if(!data.empty() && ElasticFileAPI::FileRead(file, &data[0], data.size()) != data.size())
+		result.Valid = false;
+
+	ElasticFileAPI::FileClose(file);
+
+	if(data != run.Model)
+		result.Valid = false;
+}
+
+static bool rewrite_plain_file(const std::string& file_name, const std::vector<BYTE>& data)
+{
+	FILE* file = fopen(file_name.c_str(), "wb");
+	if(file == NULL)
+		return false;
+
+	bool written = data.empty() || fwrite(&data[0], sizeof(BYTE), data.size(), file) == data.size();
+
+	return fclose(file) == 0 && written;
+}
+
+static bool seek_plain_file(FILE* file, size_file_t position)
+{
+#ifdef _WIN32
+	return _fseeki64(file, position, SEEK_SET) == 0;
+#else
+	return fseeko(file, position, SEEK_SET) == 0;
+#endif
+}
+
+// Test 1 of test_util: [m][m][m]...[m]
+static void append_elastic(TWorkloadRun& run, TWorkloadResult& result)
+{
+	TEFileDescriptor file = open_timed(run, EF_MODE_CREATE | EF_MODE_APPEND, result);
+
+	TWorkloadTimer timer(run, result);
+	timer.Start();
+
+	for(size_file_t i = 0; i != run.Records; i++)
+	{
+		timer.BeginOperation();
+		if(ElasticFileAPI::FileWrite(file, &run.Record[0], run.SmallSize) != run.SmallSize)
+			result.Valid = false;
+		timer.EndOperation(run.SmallSize);
+	}
+
+	timer.Stop();
+
+	close_timed(file, result);
+}
+
+static void append_baseline(TWorkloadRun& run, TWorkloadResult& result)
+{
+	run.Model.clear();
+
+	FILE* file = fopen(run.PlainFileName.c_str(), "wb");
+	if(file == NULL)
+	{
+		result.Valid = false;
+		return;
+	}
+
+	TWorkloadTimer timer(run, result);
+	timer.Start();
+
+	for(size_file_t i = 0; i != run.Records; i++)
+	{
+		timer.BeginOperation();
+		if(fwrite(&run.Record[0], sizeof(BYTE), (size_t)run.SmallSize, file) != run.SmallSize)
+			result.Valid = false;
+		timer.EndOperation(run.SmallSize);
+
+		run.Model.insert(run.Model.end(), run.Record.begin(), run.Record.begin() + (size_t)run.SmallSize);
+	}
+
+	timer.Stop();
+
+	if(fclose(file) != 0)
+		result.Valid = false;
+}
+
+// Test 2 of test_util: [m][M][m][M]...[m][M], every large record is inserted after a small one
+static void insert_elastic(TWorkloadRun& run, TWorkloadResult& result)
+{
+	TEFileDescriptor file = open_timed(run, EF_MODE_OPEN, result);
+
+	TWorkloadTimer timer(run, result);
+	timer.Start();
+
+	ElasticFileAPI::FileSetCursor(file, 0, EF_CURSOR_BEGIN);
+	for(size_file_t i = 0; i != run.Records; i++)
+	{
+		timer.BeginOperation();
+		ElasticFileAPI::FileSetCursor(file, run.SmallSize, EF_CURSOR_CURRENT);
+		if(ElasticFileAPI::FileWrite(file, &run.Record[0], run.LargeSize) != run.LargeSize)
+			result.Valid = false;
+		timer.EndOperation(run.LargeSize);
+	}
+
+	timer.Stop();
+
+	close_timed(file, result);
+}
+
+static void insert_baseline(TWorkloadRun& run, TWorkloadResult& result)
+{
+	size_file_t rewrite_step = std::max<size_file_t>(run.Records / WORKLOAD_BASELINE_REWRITES, (size_file_t)1);
+	size_file_t position(0);
+
+	TWorkloadTimer timer(run, result);
+	timer.Start();
+
+	for(size_file_t i = 0; i != run.Records; i++)
+	{
+		bool rewrite = i % rewrite_step == 0;
+		if(rewrite)
+			timer.BeginOperation();
+
+		position += run.SmallSize;
+		run.Model.insert(run.Model.begin() + (size_t)position, run.Record.begin(), run.Record.begin() + (size_t)run.LargeSize);
+		position += run.LargeSize;
+
+		if(rewrite)
+		{
+			if(!rewrite_plain_file(run.PlainFileName, run.Model))
+				result.Valid = false;
+			timer.EndOperation(run.LargeSize);
+		}
+	}
+
+	timer.Stop();
+
+	rewrite_plain_file(run.PlainFileName, run.Model);
+}
+
+// Test 3 of test_util: every 10th record is read
+static void read_elastic(TWorkloadRun& run, TWorkloadResult& result)
+{
+	TEFileDescriptor file = open_timed(run, EF_MODE_OPEN, result);
+	size_file_t data_size = get_data_size(file);
+	size_file_t offset = run.SmallSize * 5 + run.LargeSize * 4;
+
+	std::vector<BYTE> record((size_t)run.LargeSize);
+
+	TWorkloadTimer timer(run, result);
+	timer.Start();
+
+	while(ElasticFileAPI::FileGetCursor(file) + offset + run.LargeSize < data_size)
+	{
+		size_file_t position = ElasticFileAPI::FileGetCursor(file) + offset;
+
+		timer.BeginOperation();
+		ElasticFileAPI::FileSetCursor(file, offset, EF_CURSOR_CURRENT);
+		if(ElasticFileAPI::FileRead(file, &record[0], run.LargeSize) != run.LargeSize)
+			result.Valid = false;
+		timer.EndOperation(run.LargeSize);
+
+		if(!std::equal(record.begin(), record.end(), run.Model.begin() + (size_t)position))
+			result.Valid = false;
+	}
+
+	timer.Stop();
+
+	close_timed(file, result);
+}
+
+static void read_baseline(TWorkloadRun& run, TWorkloadResult& result)
+{
+	FILE* file = fopen(run.PlainFileName.c_str(), "rb");
+	if(file == NULL)
+	{
+		result.Valid = false;
+		return;
+	}
+
+	size_file_t data_size = run.Model.size();
+	size_file_t offset = run.SmallSize * 5 + run.LargeSize * 4;
+
+	std::vector<BYTE> record((size_t)run.LargeSize);
+
+	TWorkloadTimer timer(run, result);
+	timer.Start();
+
+	for(size_file_t position = 0; position + offset + run.LargeSize < data_size; position += run.LargeSize)
+	{
+		position += offset;
+
+		timer.BeginOperation();
+		if(!seek_plain_file(file, position) || fread(&record[0], sizeof(BYTE), record.size(), file) != record.size())
+			result.Valid = false;
+		timer.EndOperation(run.LargeSize);
+	}
+
+	timer.Stop();
+
+	fclose(file);
+}
+
+// Test 4 of test_util: every other pair of records is deleted
+static void delete_elastic(TWorkloadRun& run, TWorkloadResult& result)
+{
+	TEFileDescriptor file = open_timed(run, EF_MODE_OPEN, result);
+	size_file_t data_size = get_data_size(file);
+	size_file_t pair_size = run.SmallSize + run.LargeSize;
+
+	TWorkloadTimer timer(run, result);
+	timer.Start();
+
+	for(; ElasticFileAPI::FileGetCursor(file) + pair_size < data_size; data_size -= pair_size)
+	{
+		timer.BeginOperation();
+		ElasticFileAPI::FileSetCursor(file, pair_size, EF_CURSOR_CURRENT);
+		if(!ElasticFileAPI::FileTruncate(file, pair_size))
+			result.Valid = false;
+		timer.EndOperation(pair_size);
+	}
+
+	timer.Stop();
+
+	close_timed(file, result);
+}
+
+static void delete_baseline(TWorkloadRun& run, TWorkloadResult& result)
+{
+	size_file_t pair_size = run.SmallSize + run.LargeSize;
+	size_file_t deletes_count = run.Model.size() / pair_size / 2;
+	size_file_t rewrite_step = std::max<size_file_t>(deletes_count / WORKLOAD_BASELINE_REWRITES, (size_file_t)1);
+
+	TWorkloadTimer timer(run, result);
+	timer.Start();
+
+	size_file_t i(0);
+	for(size_file_t position = pair_size; position + pair_size <= run.Model.size(); position += pair_size, i++)
+	{
+		bool rewrite = i % rewrite_step == 0;
+		if(rewrite)
+			timer.BeginOperation();
+
+		run.Model.erase(run.Model.begin() + (size_t)position, run.Model.begin() + (size_t)(position + pair_size));
+
+		if(rewrite)
+		{
+			if(!rewrite_plain_file(run.PlainFileName, run.Model))
+				result.Valid = false;
+			timer.EndOperation(pair_size);
+		}
+	}
+
+	timer.Stop();
+
+	rewrite_plain_file(run.PlainFileName, run.Model);
+}
+
+// Inserts, deletes and overwrites of large records in random positions. Both implementations
+// take the same sequence of edits from the same seed
+struct TRandomEdit
+{
+	TEFileEditType Type;
+	bool Overwrite;
+	size_file_t Position;
+	size_file_t Size;
+};
+
+static void make_random_edits(const TWorkloadRun& run, std::vector<TRandomEdit>& edits)
+{
+	std::mt19937_64 random(run.Records);
+
+	size_file_t data_size = run.Model.size();
+	for(size_file_t i = 0; i != run.Records; i++)
+	{
+		TRandomEdit edit;
+		size_file_t kind = random() % 10;
+
+		edit.Type = kind < 3 && data_size > 0 ? EF_EDIT_DELETE : EF_EDIT_INSERT;
+		edit.Overwrite = kind >= 8 && data_size >= run.LargeSize;
+		edit.Position = random() % (data_size + 1);
+
+		if(edit.Type == EF_EDIT_DELETE)
+		{
+			edit.Position = std::min<size_file_t>(edit.Position, data_size - 1);
+			edit.Size = std::min<size_file_t>(run.LargeSize, data_size - edit.Position);
+			data_size -= edit.Size;
+		}
+		else if(edit.Overwrite)
+		{
+			edit.Position = std::min<size_file_t>(edit.Position, data_size - run.LargeSize);
+			edit.Size = run.LargeSize;
+		}
+		else
+		{
+			edit.Size = run.LargeSize;
+			data_size += edit.Size;
+		}
+
+		edits.push_back(edit);
+	}
+}
+
+static void random_edits_elastic(TWorkloadRun& run, const std::vector<TRandomEdit>& edits, TWorkloadResult& result)
+{
+	TEFileDescriptor file = open_timed(run, EF_MODE_OPEN, result);
+
+	TWorkloadTimer timer(run, result);
+	timer.Start();
+
+	for(std::vector<TRandomEdit>::const_iterator edit_it = edits.begin(); edit_it != edits.end(); ++edit_it)
+	{
+		timer.BeginOperation();
+
+		ElasticFileAPI::FileSetCursor(file, edit_it->Position, EF_CURSOR_BEGIN);
+		if(edit_it->Type == EF_EDIT_DELETE)
+		{
+			if(!ElasticFileAPI::FileTruncate(file, edit_it->Size))
+				result.Valid = false;
+		}
+		else if(ElasticFileAPI::FileWrite(file, &run.Record[0], edit_it->Size, edit_it->Overwrite) != edit_it->Size)
+		{
+			result.Valid = false;
+		}
+
+		timer.EndOperation(edit_it->Size);
+	}
+
+	timer.Stop();
+
+	close_timed(file, result);
+}
+
+static void random_edits_baseline(TWorkloadRun& run, const std::vector<TRandomEdit>& edits, TWorkloadResult& result)
+{
+	size_file_t rewrite_step = std::max<size_file_t>((size_file_t)edits.size() / WORKLOAD_BASELINE_REWRITES, (size_file_t)1);
+
+	TWorkloadTimer timer(run, result);
+	timer.Start();
+
+	for(size_t i = 0; i != edits.size(); i++)
+	{
+		const TRandomEdit& edit = edits[i];
+		std::vector<BYTE>::iterator position_it = run.Model.begin() + (size_t)edit.Position;
+
+		bool rewrite = i % rewrite_step == 0;
+		if(rewrite)
+			timer.BeginOperation();
+
+		if(edit.Type == EF_EDIT_DELETE)
+			run.Model.erase(position_it, position_it + (size_t)edit.Size);
+		else if(edit.Overwrite)
+			std::copy(run.Record.begin(), run.Record.begin() + (size_t)edit.Size, position_it);
+		else
+			run.Model.insert(position_it, run.Record.begin(), run.Record.begin() + (size_t)edit.Size);
+
+		if(!rewrite)
+			continue;
+
+		// A plain file is overwritten in place, but anything else moves the data after the position
+		if(edit.Overwrite)
+		{
+			FILE* file = fopen(run.PlainFileName.c_str(), "rb+");
+			if(file == NULL || !seek_plain_file(file, edit.Position) || fwrite(&run.Record[0], sizeof(BYTE), (size_t)edit.Size, file) != edit.Size)
+				result.Valid = false;
+
+			if(file != NULL)
+				fclose(file);
+		}
+		else if(!rewrite_plain_file(run.PlainFileName, run.Model))
+		{
+			result.Valid = false;
+		}
+
+		timer.EndOperation(edit.Size);
+	}
+
+	timer.Stop();
+
+	rewrite_plain_file(run.PlainFileName, run.Model);
+}
+
+static TWorkloadResult& find_result(TWorkloadResults& results, const TWorkloadRun& run, const std::string& workload, const std::string& implementation)
+{
+	for(TWorkloadResults::iterator result_it = results.begin(); result_it != results.end(); ++result_it)
+	{
+		if(result_it->Workload == workload && result_it->Implementation == implementation && result_it->Records == run.Records && result_it->SmallSize == run.SmallSize && result_it->LargeSize == run.LargeSize)
+			return *result_it;
+	}
+
+	TWorkloadResult result;
+	result.Workload = workload;
+	result.Implementation = implementation;
+	result.Records = run.Records;
+	result.SmallSize = run.SmallSize;
+	result.LargeSize = run.LargeSize;
+
+	results.push_back(result);
+	return results.back();
+}
+
+// The workloads follow each other on the same file like the tests of test_util. The baseline
+// goes first at every step, so the elastic file is compared with its data after the step
+static void run_workloads(TWorkloadRun& run, TWorkloadResults& results)
+{
+	append_baseline(run, find_result(results, run, "append", "plain_file"));
+	append_elastic(run, find_result(results, run, "append", "elastic_file"));
+	check_elastic_file(run, find_result(results, run, "append", "elastic_file"));
+
+	insert_baseline(run, find_result(results, run, "interleaved_insert", "plain_file_rewrite"));
+	insert_elastic(run, find_result(results, run, "interleaved_insert", "elastic_file"));
+	check_elastic_file(run, find_result(results, run, "interleaved_insert", "elastic_file"));
+
+	read_baseline(run, find_result(results, run, "strided_read", "plain_file"));
+	read_elastic(run, find_result(results, run, "strided_read", "elastic_file"));
+
+	delete_baseline(run, find_result(results, run, "alternate_delete", "plain_file_rewrite"));
+	delete_elastic(run, find_result(results, run, "alternate_delete", "elastic_file"));
+	check_elastic_file(run, find_result(results, run, "alternate_delete", "elastic_file"));
+
+	std::vector<TRandomEdit> edits;
+	make_random_edits(run, edits);
+
+	random_edits_baseline(run, edits, find_result(results, run, "random_edits", "plain_file_rewrite"));
+	random_edits_elastic(run, edits, find_result(results, run, "random_edits", "elastic_file"));
+	check_elastic_file(run, find_result(results, run, "random_edits", "elastic_file"));
+}
+
+// Nearest rank of the sorted latencies
+static long long percentile(const std::vector<long long>& latencies, double fraction)
+{
+	if(latencies.empty())
+		return 0;
+
+	return latencies[(size_t)(fraction * (latencies.size() - 1) + 0.5)];
+}
+
+static void write_result(std::ostream& out, TWorkloadResult& result, bool counters_enabled)
+{
+	std::sort(result.Latencies.begin(), result.Latencies.end());
+
+	double seconds = result.Nanoseconds / 1e9;
+	long long latencies_sum(0);
+	for(std::vector<long long>::iterator latency_it = result.Latencies.begin(); latency_it != result.Latencies.end(); ++latency_it)
+		latencies_sum += *latency_it;
+
+	out << "    {" << std::endl;
+	out << "      \"workload\": \"" << result.Workload << "\"," << std::endl;
+	out << "      \"implementation\": \"" << result.Implementation << "\"," << std::endl;
+	out << "      \"records\": " << result.Records << "," << std::endl;
+	out << "      \"small_record_size\": " << result.SmallSize << "," << std::endl;
+	out << "      \"large_record_size\": " << result.LargeSize << "," << std::endl;
+	out << "      \"valid\": " << (result.Valid ? "true" : "false") << "," << std::endl;
+	out << "      \"operations\": " << result.Operations << "," << std::endl;
+	out << "      \"bytes\": " << result.Bytes << "," << std::endl;
+	out << "      \"seconds\": " << seconds << "," << std::endl;
+	out << "      \"operations_per_second\": " << (seconds > 0 ? result.Operations / seconds : 0) << "," << std::endl;
+	out << "      \"megabytes_per_second\": " << (seconds > 0 ? result.Bytes / seconds / (1024 * 1024) : 0) << "," << std::endl;
+	// Opening of the plain file is not measured separately
+	if(result.Implementation == "elastic_file")
+	{
+		out << "      \"open_ns\": " << result.OpenNanoseconds << "," << std::endl;
+		out << "      \"close_ns\": " << result.CloseNanoseconds << "," << std::endl;
+	}
+	else
+	{
+		out << "      \"open_ns\": null," << std::endl;
+		out << "      \"close_ns\": null," << std::endl;
+	}
+	out << "      \"latency_ns\": { \"mean\": " << (result.Latencies.empty() ? 0 : latencies_sum / (long long)result.Latencies.size())
+		<< ", \"p50\": " << percentile(result.Latencies, 0.5)
+		<< ", \"p90\": " << percentile(result.Latencies, 0.9)
+		<< ", \"p99\": " << percentile(result.Latencies, 0.99)
+		<< ", \"p999\": " << percentile(result.Latencies, 0.999)
+		<< ", \"max\": " << (result.Latencies.empty() ? 0 : result.Latencies.back()) << " }," << std::endl;
+
+	out << "      \"counters\": ";
+	if(counters_enabled)
+	{
+		out << "{";
+		for(int counter = 0; counter < PERF_COUNTERS_COUNT; counter++)
+			out << (counter > 0 ? ", " : " ") << "\"" << TPerfCounters::GetName(counter) << "\": " << result.Counters[counter];
+		out << " }" << std::endl;
+	}
+	else
+	{
+		out << "null" << std::endl;
+	}
+
+	out << "    }";
+}
+
+int workload_benchmark(int argc, char* argv[])
+{
+	std::vector<size_file_t> records_counts = benchmark_arguments(argc, argv, 2, 10000);
+	std::vector<size_file_t> small_sizes = benchmark_arguments(argc, argv, 3, 16);
+	std::vector<size_file_t> large_sizes = benchmark_arguments(argc, argv, 4, 256);
+	size_file_t repeats = benchmark_argument(argc, argv, 5, 3);
+	std::string json_file_name(argc > 6 ? argv[6] : "benchmark_results.json");
+	TEFileBackendType backend = (TEFileBackendType)benchmark_argument(argc, argv, 7, EF_BACKEND_DEFAULT);
+	bool counters_requested = benchmark_argument(argc, argv, 8, 0) != 0;
+
+	TPerfCounters counters(counters_requested);
+	if(counters_requested && !counters.IsEnabled())
+		INFO("Perf counters are not available");
+
+	TWorkloadResults results;
+
+	TWorkloadRun run;
+	run.FileName = "benchmark_data";
+	run.PlainFileName = "benchmark_plain_data";
+	run.Backend = backend;
+	run.Counters = &counters;
+
+	for(size_t records_index = 0; records_index < records_counts.size(); records_index++)
+	{
+		for(size_t small_index = 0; small_index < small_sizes.size(); small_index++)
+		{
+			for(size_t large_index = 0; large_index < large_sizes.size(); large_index++)
+			{
+				run.Records = records_counts[records_index];
+				run.SmallSize = std::max<size_file_t>(small_sizes[small_index], (size_file_t)1);
+				run.LargeSize = std::max<size_file_t>(large_sizes[large_index], (size_file_t)1);
+
+				INFO("Workloads. " << run.Records << " records, small records of " << run.SmallSize << " bytes, large records of " << run.LargeSize << " bytes, " << repeats << " repeats");
+
+				// The same data in every run
+				std::mt19937_64 random(1);
+				run.Record.resize((size_t)std::max<size_file_t>(run.SmallSize, run.LargeSize));
+				for(size_t i = 0; i < run.Record.size(); i++)
+					run.Record[i] = (BYTE)('a' + random() % 26);
+
+				for(size_file_t repeat = 0; repeat < repeats; repeat++)
+					run_workloads(run, results);
+			}
+		}
+	}
+
+	remove(run.FileName.c_str());
+	remove(run.PlainFileName.c_str());
+
+	std::ofstream json_file(json_file_name.c_str());
+	json_file << "{" << std::endl;
+	json_file << "  \"benchmark\": \"workloads\"," << std::endl;
+	json_file << "  \"backend\": " << backend << "," << std::endl;
+	json_file << "  \"repeats\": " << repeats << "," << std::endl;
+	json_file << "  \"baseline_rewrites\": " << WORKLOAD_BASELINE_REWRITES << "," << std::endl;
+	json_file << "  \"results\": [" << std::endl;
+
+	bool valid(true);
+	for(TWorkloadResults::iterator result_it = results.begin(); result_it != results.end(); ++result_it)
+	{
+		write_result(json_file, *result_it, counters.IsEnabled());
+		json_file << (result_it + 1 != results.end() ? "," : "") << std::endl;
+
+		INFO(result_it->Workload << ", " << result_it->Implementation << ", " << result_it->Records << "/" << result_it->SmallSize << "/" << result_it->LargeSize << ": "
+			<< result_it->Operations << " operations, p50 " << percentile(result_it->Latencies, 0.5) << " ns, p99 " << percentile(result_it->Latencies, 0.99) << " ns"
+			<< (result_it->Valid ? "" : ", INVALID"));
+
+		valid = valid && result_it->Valid;
+	}
+
+	json_file << "  ]" << std::endl;
+	json_file << "}" << std::endl;
+
+	if(!json_file)
+	{
+		INFO("Can't write " << json_file_name);
+		return 1;
+	}
+
+	INFO("The results are written to " << json_file_name);
+
+	return valid ? 0 : 1;
+}
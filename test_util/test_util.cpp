@@ -5,6 +5,8 @@
 #define LOG_INFO
 
 #include <ElasticFileAPI.h>
+#define NOMINMAX
+#include <windows.h>
 
 static const char alphanum[] =
 	"ABCDEFGHIJKLMNOPQRSTUVWXYZ"
@@ -58,7 +60,7 @@ void test1(const std::string& fileName, size_file_t m_length, size_file_t N)
 	DWORD time = GetTickCount();
 	DWORD gentime(0);
 	DWORD local_time(0);
-	TEFileHandle file = ElasticFileAPI::FileOpen(fileName, EF_MODE_CREATE | EF_MODE_APPEND);
+	TEFileDescriptor file = ElasticFileAPI::FileOpen(fileName, EF_MODE_CREATE | EF_MODE_APPEND);
 
 	INFO("Time to open: " << GetTickCount() - time);
 	
@@ -93,7 +95,7 @@ void test2(const std::string& fileName, size_file_t m_length, size_file_t M_leng
 
 	INFO("Open file and load sectors table");
 
-	TEFileHandle file = ElasticFileAPI::FileOpen(fileName, EF_MODE_OPEN);
+	TEFileDescriptor file = ElasticFileAPI::FileOpen(fileName, EF_MODE_OPEN);
 	
 	INFO("Time to open: " << GetTickCount() - time);
 	
@@ -132,7 +134,7 @@ void test3(const std::string& fileName, size_file_t M_length,  size_file_t m_len
 
 	INFO("Open file and load sectors table");
 
-	TEFileHandle file = ElasticFileAPI::FileOpen(fileName, EF_MODE_OPEN);
+	TEFileDescriptor file = ElasticFileAPI::FileOpen(fileName, EF_MODE_OPEN);
 
 	INFO("Time to open: " << GetTickCount() - start_time);
 
@@ -208,7 +210,7 @@ void test4(const std::string& fileName, size_file_t M_length,  size_file_t m_len
 
 	INFO("Open file and load sectors table");
 
-	TEFileHandle file = ElasticFileAPI::FileOpen(fileName, EF_MODE_OPEN);
+	TEFileDescriptor file = ElasticFileAPI::FileOpen(fileName, EF_MODE_OPEN);
 
 	INFO("Time to open: " << GetTickCount() - time);
 